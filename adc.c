@@ -0,0 +1,242 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "adc.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "replay.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+10-bit ADC with 8 single ended channels, the 1.1V bandgap and GND.
+
+A conversion takes 13 ADC clock cycles, 25 for the first one after ADEN is set. It is not
+stepped: starting it schedules an event at its end, where the input is sampled at the
+sample and hold instant (1.5 ADC clocks after the start, 13.5 for the first conversion),
+ADC is written, ADIF is set and, in free running mode, the next conversion is scheduled.
+Other auto trigger sources than free running are not modeled.
+
+The input of a channel is a constant voltage, or a sample file: raw little endian uint16
+values in millivolts, one every cyclesPerSample cycles, indexed by the cycle of the sample
+and hold. The file is memory-mapped, so only the pages around the current time are ever
+read from disk; after its last sample the input holds the last value.
+*/
+
+struct channel{
+    const uint16_t *samples;        // Mapped sample file, 0 for a constant voltage
+    uint64_t count;
+    uint64_t cyclesPerSample;
+    uint16_t millivolts;
+};
+
+static const uint8_t divisions[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+
+static MCUSTATE struct channel channels[ADCCHANNELS];
+static MCUSTATE uint16_t avccMillivolts = 5000;
+static MCUSTATE uint16_t arefMillivolts = 5000;
+static MCUSTATE uint64_t sampleCycle;
+static MCUSTATE uint8_t first;          // Next conversion is the first one after enabling
+
+static uint16_t input(int mux, uint64_t cycle){
+    struct channel *c;
+    uint64_t i;
+
+    if(mux == 14){
+        return 1100;
+    }
+    if(mux >= ADCCHANNELS){
+        return 0;
+    }
+
+    c = &channels[mux];
+    if(c->samples == 0){
+        return c->millivolts;
+    }
+
+    i = cycle / c->cyclesPerSample;
+    if(i >= c->count){
+        i = c->count - 1;
+    }
+    return c->samples[i];
+}
+
+static uint16_t reference(){
+    switch(DATA[ADMUX] >> 6){
+    case 0:
+        return arefMillivolts;
+    case 3:
+        return 1100;
+    }
+    return avccMillivolts;
+}
+
+static void conversionDone(uint64_t when);
+
+static void startConversion(uint64_t when){
+    uint64_t clock = divisions[DATA[ADCSRA] & 0x07];
+
+    if(first){
+        sampleCycle = when + clock * 27 / 2;
+        schedule(conversionDone, when + 25 * clock);
+        first = 0;
+    }
+    else{
+        sampleCycle = when + clock * 3 / 2;
+        schedule(conversionDone, when + 13 * clock);
+    }
+}
+
+// The input at the sample and hold instant, an input of the MCU for replay.c
+static uint16_t sample(){
+    int mux = DATA[ADMUX] & 0x0F;
+    uint16_t millivolts;
+
+    if(REPLAY == REPLAYING){
+        return replayInput(INPUT_ADC, mux);
+    }
+    millivolts = input(mux, sampleCycle);
+    if(REPLAY == RECORDING){
+        recordInput(INPUT_ADC, mux, millivolts);
+    }
+    return millivolts;
+}
+
+static void conversionDone(uint64_t when){
+    uint32_t result = (uint32_t)sample() * 1024 / reference();
+
+    if(result > 1023){
+        result = 1023;
+    }
+
+    if(DATA[ADMUX] & 0x20){
+        // ADLAR: left adjusted result
+        result <<= 6;
+    }
+    DATA[ADCL] = result & 0xFF;
+    DATA[ADCH] = result >> 8;
+
+    DATA[ADCSRA] |= 1 << ADIF;
+
+    if((DATA[ADCSRA] & (1 << ADATE)) && (DATA[ADCSRB] & 0x07) == 0){
+        startConversion(when);
+    }
+    else{
+        DATA[ADCSRA] &= ~(1 << ADSC);
+    }
+
+    updateInterrupts();
+}
+
+static void writeADCSRA(uint16_t addr, uint8_t value){
+    uint8_t old = DATA[ADCSRA];
+
+    // ADIF is cleared by writing a one to it, ADSC stays set until the conversion ends
+    DATA[ADCSRA] = (value & ~(1 << ADIF) & ~(1 << ADSC)) | (old & ~value & (1 << ADIF)) | (old & (1 << ADSC));
+
+    if(!(value & (1 << ADEN))){
+        // Disabling the ADC aborts the conversion
+        DATA[ADCSRA] &= ~(1 << ADSC);
+        unschedule(conversionDone);
+    }
+    else{
+        if(!(old & (1 << ADEN))){
+            first = 1;
+        }
+        if((value & (1 << ADSC)) && !(old & (1 << ADSC))){
+            DATA[ADCSRA] |= 1 << ADSC;
+            startConversion(CYCLES);
+        }
+    }
+
+    updateInterrupts();
+}
+
+static int pendingADC(){
+    return DATA[ADCSRA] & (1 << ADIF) && DATA[ADCSRA] & (1 << ADIE);
+}
+
+static void acknowledgeADC(){
+    DATA[ADCSRA] &= ~(1 << ADIF);
+}
+
+void initAdc(){
+    first = 1;
+
+    keepState(&sampleCycle, sizeof(sampleCycle));
+    keepState(&first, sizeof(first));
+
+    keepHandler(conversionDone);
+
+    setIOHandlers(ADCSRA, 0, writeADCSRA);
+    setInterrupt(ADC_vect, pendingADC, acknowledgeADC);
+}
+
+/* Feeds channel from a sample file, one uint16 millivolt sample every cyclesPerSample cycles.
+Returns 0 if the file cannot be mapped. */
+int adcAttach(int channel, const char *path, uint64_t cyclesPerSample){
+    struct channel *c = &channels[channel];
+    struct stat st;
+    void *samples;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &st) < 0 || st.st_size < 2){
+        if(fd >= 0){
+            close(fd);
+        }
+        return 0;
+    }
+
+    samples = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(samples == MAP_FAILED){
+        return 0;
+    }
+    madvise(samples, st.st_size, MADV_SEQUENTIAL);
+
+    if(c->samples){
+        munmap((void *)c->samples, c->count * 2);
+    }
+    c->samples = samples;
+    c->count = st.st_size / 2;
+    c->cyclesPerSample = cyclesPerSample ? cyclesPerSample : 1;
+
+    return 1;
+}
+
+/* Feeds channel with a constant voltage. */
+void adcSetVoltage(int channel, uint16_t millivolts){
+    struct channel *c = &channels[channel];
+
+    if(c->samples){
+        munmap((void *)c->samples, c->count * 2);
+        c->samples = 0;
+    }
+    c->millivolts = millivolts;
+}
+
+/* Voltages of AVCC and of the AREF pin, in millivolts. */
+void adcSetReference(uint16_t avcc, uint16_t aref){
+    avccMillivolts = avcc;
+    arefMillivolts = aref;
+}
@@ -0,0 +1,42 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+
+/* ADC registers, as data space addresses */
+#define ADCL 0x78
+#define ADCH 0x79
+#define ADCSRA 0x7A
+#define ADCSRB 0x7B
+#define ADMUX 0x7C
+#define DIDR0 0x7E
+
+/* ADCSRA bits */
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+
+#define ADCCHANNELS 8
+
+void initAdc();
+int adcAttach(int channel, const char *path, uint64_t cyclesPerSample);
+void adcSetVoltage(int channel, uint16_t millivolts);
+void adcSetReference(uint16_t avcc, uint16_t aref);
@@ -0,0 +1,1018 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "assembler.h"
+#include "registers.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Assembles AVR source text straight into a flash image, so tests do not need avr-as.
+
+The syntax is the one of avr-as: one statement per line, "label:" definitions, numeric
+local labels ("1:" referred to as 1b or 1f), ';' or "//" comments, registers r0-r31 and
+X, Y, Z, the pointer forms X+, -Y, Z+q of LD, ST, LDD and STD. Addresses and labels are in
+bytes, as in avr-as: JMP and CALL take a byte address, and in the operand of a relative
+branch '.' is the address of the next instruction, so "rjmp .-2" loops on itself, as
+avr-objdump shows it.
+
+Expressions have the C operators and precedence, numbers in decimal, 0x/$ hex, 0b binary
+or 'c' characters, '.' (the current address) and the functions lo8, hi8, hh8, pm, pm_lo8
+and pm_hi8. The directives are .org, .byte (numbers and "strings"), .word, .equ/.set
+(or name = value); .text, .global and .globl are accepted and ignored.
+
+Labels may be used before they are defined: the source is read twice, the first time
+only to find the address of every label.
+*/
+
+#define MAXNAME 64
+#define MAXLINE 256
+#define HASHSIZE 251
+
+/* Operand formats */
+enum{
+    NONE,       // nop
+    RDRR,       // add rd,rr
+    RDD,        // tst rd, assembled as and rd,rd
+    RD,         // inc rd
+    RDK,        // ldi rd,K with r16-r31
+    RDNK,       // cbr rd,K, assembled as andi rd,~K
+    SER,        // ser rd, assembled as ldi rd,$FF
+    IW,         // adiw rd,K with r24, r26, r28, r30
+    MULS,       // muls rd,rr with r16-r31
+    FMUL,       // fmul rd,rr with r16-r23
+    MOVW,       // movw rd,rr with even registers
+    BRANCH,     // breq k
+    BRBX,       // brbs s,k
+    RJMP,       // rjmp k
+    JMP,        // jmp k, two words
+    IN,         // in rd,A
+    OUT,        // out A,rr
+    IOBIT,      // sbi A,b
+    REGBIT,     // sbrc rr,b
+    SBIT,       // bset s
+    LDS,        // lds rd,k, two words
+    STS,        // sts k,rr, two words
+    LD,         // ld rd,X+
+    ST,         // st X+,rr
+    LDD,        // ldd rd,Y+q
+    STD,        // std Y+q,rr
+    LPM         // lpm, lpm rd,Z, lpm rd,Z+
+};
+
+struct mnemonic{
+    const char *name;
+    int format;
+    uint16_t opcode;
+};
+
+static const struct mnemonic mnemonics[] = {
+    {"nop", NONE, 0x0000}, {"sec", NONE, 0x9408}, {"clc", NONE, 0x9488}, {"sez", NONE, 0x9418},
+    {"clz", NONE, 0x9498}, {"sen", NONE, 0x9428}, {"cln", NONE, 0x94A8}, {"sev", NONE, 0x9438},
+    {"clv", NONE, 0x94B8}, {"ses", NONE, 0x9448}, {"cls", NONE, 0x94C8}, {"seh", NONE, 0x9458},
+    {"clh", NONE, 0x94D8}, {"set", NONE, 0x9468}, {"clt", NONE, 0x94E8}, {"sei", NONE, 0x9478},
+    {"cli", NONE, 0x94F8}, {"ret", NONE, 0x9508}, {"reti", NONE, 0x9518}, {"sleep", NONE, 0x9588},
+    {"break", NONE, 0x9598}, {"wdr", NONE, 0x95A8}, {"ijmp", NONE, 0x9409}, {"icall", NONE, 0x9509},
+    {"spm", NONE, 0x95E8},
+
+    {"add", RDRR, 0x0C00}, {"adc", RDRR, 0x1C00}, {"sub", RDRR, 0x1800}, {"sbc", RDRR, 0x0800},
+    {"and", RDRR, 0x2000}, {"or", RDRR, 0x2800}, {"eor", RDRR, 0x2400}, {"cp", RDRR, 0x1400},
+    {"cpc", RDRR, 0x0400}, {"cpse", RDRR, 0x1000}, {"mov", RDRR, 0x2C00}, {"mul", RDRR, 0x9C00},
+
+    {"tst", RDD, 0x2000}, {"clr", RDD, 0x2400}, {"lsl", RDD, 0x0C00}, {"rol", RDD, 0x1C00},
+
+    {"com", RD, 0x9400}, {"neg", RD, 0x9401}, {"swap", RD, 0x9402}, {"inc", RD, 0x9403},
+    {"asr", RD, 0x9405}, {"lsr", RD, 0x9406}, {"ror", RD, 0x9407}, {"dec", RD, 0x940A},
+    {"push", RD, 0x920F}, {"pop", RD, 0x900F},
+
+    {"ldi", RDK, 0xE000}, {"cpi", RDK, 0x3000}, {"sbci", RDK, 0x4000}, {"subi", RDK, 0x5000},
+    {"ori", RDK, 0x6000}, {"sbr", RDK, 0x6000}, {"andi", RDK, 0x7000}, {"cbr", RDNK, 0x7000},
+    {"ser", SER, 0xEF0F},
+
+    {"adiw", IW, 0x9600}, {"sbiw", IW, 0x9700},
+    {"muls", MULS, 0x0200},
+    {"mulsu", FMUL, 0x0300}, {"fmul", FMUL, 0x0308}, {"fmuls", FMUL, 0x0380}, {"fmulsu", FMUL, 0x0388},
+    {"movw", MOVW, 0x0100},
+
+    {"brcs", BRANCH, 0xF000}, {"brlo", BRANCH, 0xF000}, {"breq", BRANCH, 0xF001}, {"brmi", BRANCH, 0xF002},
+    {"brvs", BRANCH, 0xF003}, {"brlt", BRANCH, 0xF004}, {"brhs", BRANCH, 0xF005}, {"brts", BRANCH, 0xF006},
+    {"brie", BRANCH, 0xF007}, {"brcc", BRANCH, 0xF400}, {"brsh", BRANCH, 0xF400}, {"brne", BRANCH, 0xF401},
+    {"brpl", BRANCH, 0xF402}, {"brvc", BRANCH, 0xF403}, {"brge", BRANCH, 0xF404}, {"brhc", BRANCH, 0xF405},
+    {"brtc", BRANCH, 0xF406}, {"brid", BRANCH, 0xF407},
+    {"brbs", BRBX, 0xF000}, {"brbc", BRBX, 0xF400},
+    {"rjmp", RJMP, 0xC000}, {"rcall", RJMP, 0xD000},
+    {"jmp", JMP, 0x940C}, {"call", JMP, 0x940E},
+
+    {"in", IN, 0xB000}, {"out", OUT, 0xB800},
+    {"cbi", IOBIT, 0x9800}, {"sbic", IOBIT, 0x9900}, {"sbi", IOBIT, 0x9A00}, {"sbis", IOBIT, 0x9B00},
+    {"bld", REGBIT, 0xF800}, {"bst", REGBIT, 0xFA00}, {"sbrc", REGBIT, 0xFC00}, {"sbrs", REGBIT, 0xFE00},
+    {"bset", SBIT, 0x9408}, {"bclr", SBIT, 0x9488},
+
+    {"lds", LDS, 0x9000}, {"sts", STS, 0x9200},
+    {"ld", LD, 0x0000}, {"st", ST, 0x0200}, {"ldd", LDD, 0x8000}, {"std", STD, 0x8200},
+    {"lpm", LPM, 0x9004}, {"elpm", LPM, 0x9006},
+
+    {0, 0, 0}
+};
+
+// Open addressing table of the mnemonics, built on first use
+static MCUSTATE uint8_t mnemonicTable[HASHSIZE];
+static MCUSTATE int mnemonicsHashed;
+
+static unsigned hash(const char *name){
+    unsigned h = 0;
+
+    while(*name){
+        h = h * 31 + (unsigned char)*name++;
+    }
+    return h;
+}
+
+static const struct mnemonic *findMnemonic(const char *name){
+    unsigned h;
+    int i;
+
+    if(!mnemonicsHashed){
+        for(i = 0; mnemonics[i].name; i++){
+            for(h = hash(mnemonics[i].name) % HASHSIZE; mnemonicTable[h]; h = (h + 1) % HASHSIZE){
+            }
+            mnemonicTable[h] = i + 1;
+        }
+        mnemonicsHashed = 1;
+    }
+
+    for(h = hash(name) % HASHSIZE; mnemonicTable[h]; h = (h + 1) % HASHSIZE){
+        if(strcmp(mnemonics[mnemonicTable[h] - 1].name, name) == 0){
+            return &mnemonics[mnemonicTable[h] - 1];
+        }
+    }
+    return 0;
+}
+
+struct symbol{
+    char name[MAXNAME];
+    int64_t value;
+};
+
+// Numeric local label, in the order of the source
+struct local{
+    int number;
+    int statement;
+    int64_t address;
+};
+
+static MCUSTATE struct symbol *symbols;
+static MCUSTATE int nsymbols;
+static MCUSTATE struct local *locals;
+static MCUSTATE int nlocals;
+
+static MCUSTATE int pass;
+static MCUSTATE int line;
+static MCUSTATE int statement;
+static MCUSTATE int64_t address;     // Location counter, in bytes
+static MCUSTATE int64_t dot;         // Value of '.' in the expression being read
+static MCUSTATE uint16_t *image;
+static MCUSTATE int imageWords;
+static MCUSTATE int used;            // Words up to the last one written
+static MCUSTATE char *message;
+static MCUSTATE int messageSize;
+static MCUSTATE int failed;
+
+static void fail(const char *format, ...){
+    va_list args;
+    int n;
+
+    if(failed){
+        return;
+    }
+    failed = 1;
+    if(message && messageSize > 0){
+        n = snprintf(message, messageSize, "line %d: ", line);
+        va_start(args, format);
+        if(n < messageSize){
+            vsnprintf(message + n, messageSize - n, format, args);
+        }
+        va_end(args);
+    }
+}
+
+static const char *skip(const char *p){
+    while(*p == ' ' || *p == '\t' || *p == '\r'){
+        p++;
+    }
+    return p;
+}
+
+static int isName(int c){
+    return isalnum(c) || c == '_' || c == '.' || c == '$';
+}
+
+static struct symbol *lookup(const char *name){
+    int i;
+
+    for(i = 0; i < nsymbols; i++){
+        if(strcmp(symbols[i].name, name) == 0){
+            return &symbols[i];
+        }
+    }
+    return 0;
+}
+
+static void define(const char *name, int64_t value){
+    struct symbol *s = lookup(name);
+
+    if(s == 0){
+        symbols = realloc(symbols, (nsymbols + 1) * sizeof(struct symbol));
+        s = &symbols[nsymbols++];
+        snprintf(s->name, MAXNAME, "%s", name);
+    }
+    else if(pass == 1){
+        fail("%s is already defined", name);
+    }
+    s->value = value;
+}
+
+static int64_t localLabel(int number, int forward){
+    int i;
+
+    if(forward){
+        for(i = 0; i < nlocals; i++){
+            if(locals[i].number == number && locals[i].statement > statement){
+                return locals[i].address;
+            }
+        }
+    }
+    else{
+        for(i = nlocals - 1; i >= 0; i--){
+            if(locals[i].number == number && locals[i].statement <= statement){
+                return locals[i].address;
+            }
+        }
+    }
+
+    if(pass == 2){
+        fail("local label %d%c is not defined", number, forward ? 'f' : 'b');
+    }
+    return 0;
+}
+
+/* Expressions, by precedence */
+
+static int64_t expression(const char **p);
+
+static int64_t function(const char *name, int64_t value){
+    if(strcmp(name, "lo8") == 0 || strcmp(name, "low") == 0){
+        return value & 0xFF;
+    }
+    if(strcmp(name, "hi8") == 0 || strcmp(name, "high") == 0){
+        return (value >> 8) & 0xFF;
+    }
+    if(strcmp(name, "hh8") == 0){
+        return (value >> 16) & 0xFF;
+    }
+    if(strcmp(name, "pm") == 0){
+        return value >> 1;
+    }
+    if(strcmp(name, "pm_lo8") == 0){
+        return (value >> 1) & 0xFF;
+    }
+    if(strcmp(name, "pm_hi8") == 0){
+        return (value >> 9) & 0xFF;
+    }
+
+    fail("unknown function %s", name);
+    return 0;
+}
+
+static int64_t primary(const char **p){
+    const char *s = skip(*p);
+    char name[MAXNAME];
+    int64_t value = 0;
+    int n = 0;
+
+    if(*s == '('){
+        s++;
+        value = expression(&s);
+        s = skip(s);
+        if(*s != ')'){
+            fail("missing )");
+        }
+        *p = s + 1;
+        return value;
+    }
+
+    if(*s == '\''){
+        value = (unsigned char)s[1];
+        if(s[1] == '\\'){
+            value = s[2] == 'n' ? '\n' : s[2] == 't' ? '\t' : s[2] == '0' ? 0 : s[2];
+            s++;
+        }
+        if(s[2] != '\''){
+            fail("bad character constant");
+        }
+        *p = s + 3;
+        return value;
+    }
+
+    if(isdigit((unsigned char)*s) || *s == '$'){
+        char *end;
+
+        if(*s == '$'){
+            value = strtoll(s + 1, &end, 16);
+        }
+        else if(s[0] == '0' && (s[1] == 'b' || s[1] == 'B') && (s[2] == '0' || s[2] == '1')){
+            value = strtoll(s + 2, &end, 2);
+        }
+        else{
+            value = strtoll(s, &end, 0);
+            if((*end == 'b' || *end == 'f') && !isName((unsigned char)end[1])){
+                value = localLabel(value, *end == 'f');
+                end++;
+            }
+        }
+        if(isName((unsigned char)*end)){
+            fail("bad number");
+        }
+        *p = end;
+        return value;
+    }
+
+    if(*s == '.' && !isName((unsigned char)s[1])){
+        *p = s + 1;
+        return dot;
+    }
+
+    while(isName((unsigned char)*s) && n < MAXNAME - 1){
+        name[n++] = *s++;
+    }
+    name[n] = 0;
+    if(n == 0){
+        fail("expression expected");
+        *p = s;
+        return 0;
+    }
+
+    s = skip(s);
+    if(*s == '('){
+        s++;
+        value = expression(&s);
+        s = skip(s);
+        if(*s != ')'){
+            fail("missing )");
+        }
+        *p = s + 1;
+        return function(name, value);
+    }
+
+    *p = s;
+    struct symbol *symbol = lookup(name);
+    if(symbol){
+        return symbol->value;
+    }
+    if(pass == 2){
+        fail("%s is not defined", name);
+    }
+    return 0;
+}
+
+static int64_t unary(const char **p){
+    const char *s = skip(*p);
+
+    switch(*s){
+    case '-':
+        *p = s + 1;
+        return -unary(p);
+    case '+':
+        *p = s + 1;
+        return unary(p);
+    case '~':
+        *p = s + 1;
+        return ~unary(p);
+    case '!':
+        *p = s + 1;
+        return !unary(p);
+    }
+    return primary(p);
+}
+
+static int64_t product(const char **p){
+    int64_t value = unary(p);
+
+    for(;;){
+        const char *s = skip(*p);
+        int64_t right;
+
+        if(*s != '*' && *s != '/' && *s != '%'){
+            return value;
+        }
+        *p = s + 1;
+        right = unary(p);
+        if(*s == '*'){
+            value *= right;
+        }
+        else if(right == 0){
+            fail("division by zero");
+        }
+        else{
+            value = *s == '/' ? value / right : value % right;
+        }
+    }
+}
+
+static int64_t sum(const char **p){
+    int64_t value = product(p);
+
+    for(;;){
+        const char *s = skip(*p);
+
+        if(*s != '+' && *s != '-'){
+            return value;
+        }
+        *p = s + 1;
+        value = *s == '+' ? value + product(p) : value - product(p);
+    }
+}
+
+static int64_t shift(const char **p){
+    int64_t value = sum(p);
+
+    for(;;){
+        const char *s = skip(*p);
+
+        if(!((s[0] == '<' && s[1] == '<') || (s[0] == '>' && s[1] == '>'))){
+            return value;
+        }
+        *p = s + 2;
+        value = *s == '<' ? value << sum(p) : value >> sum(p);
+    }
+}
+
+static int64_t bitwise(const char **p, int level){
+    static const char operators[] = "|^&";
+    int64_t value = level == 2 ? shift(p) : bitwise(p, level + 1);
+
+    for(;;){
+        const char *s = skip(*p);
+        int64_t right;
+
+        if(*s != operators[level] || s[1] == operators[level]){
+            return value;
+        }
+        *p = s + 1;
+        right = level == 2 ? shift(p) : bitwise(p, level + 1);
+        value = level == 0 ? value | right : level == 1 ? value ^ right : value & right;
+    }
+}
+
+static int64_t expression(const char **p){
+    return bitwise(p, 0);
+}
+
+// Evaluates a whole operand
+static int64_t value(const char *operand){
+    const char *p = operand;
+    int64_t v = expression(&p);
+
+    if(*skip(p)){
+        fail("junk after expression: %s", p);
+    }
+    return v;
+}
+
+static int64_t range(int64_t v, int64_t min, int64_t max, const char *what){
+    if(pass == 2 && (v < min || v > max)){
+        fail("%s %lld out of range", what, (long long)v);
+    }
+    return v;
+}
+
+static int reg(const char *operand, int min, int max){
+    const char *p = skip(operand);
+    char *end;
+    long n;
+
+    if(*p != 'r' && *p != 'R'){
+        fail("register expected: %s", operand);
+        return min;
+    }
+    n = strtol(p + 1, &end, 10);
+    if(end == p + 1 || *skip(end) || n < min || n > max){
+        fail("register r%d-r%d expected: %s", min, max, operand);
+        return min;
+    }
+    return n;
+}
+
+/* Output */
+
+static void emit(uint16_t word){
+    if(address & 1){
+        fail("instruction at odd address");
+    }
+    if(pass == 2 && !failed){
+        if(address / 2 >= imageWords || address < 0){
+            fail("address $%llx is outside the flash", (long long)address);
+            return;
+        }
+        image[address / 2] = word;
+        if(address / 2 + 1 > used){
+            used = address / 2 + 1;
+        }
+    }
+    address += 2;
+}
+
+static void emitByte(uint8_t byte){
+    if(pass == 2 && !failed){
+        if(address / 2 >= imageWords || address < 0){
+            fail("address $%llx is outside the flash", (long long)address);
+            return;
+        }
+        if(address & 1){
+            image[address / 2] = (image[address / 2] & 0x00FF) | (byte << 8);
+        }
+        else{
+            image[address / 2] = (image[address / 2] & 0xFF00) | byte;
+        }
+        if(address / 2 + 1 > used){
+            used = address / 2 + 1;
+        }
+    }
+    address++;
+}
+
+// Splits the operands at the top level commas. Returns how many there are.
+static int operands(char *text, char **list, int max){
+    int n = 0, depth = 0, quoted = 0;
+    char *p = text;
+
+    if(*skip(text) == 0){
+        return 0;
+    }
+    list[n++] = text;
+    for(; *p; p++){
+        if(*p == '"'){
+            quoted = !quoted;
+        }
+        else if(!quoted && *p == '('){
+            depth++;
+        }
+        else if(!quoted && *p == ')'){
+            depth--;
+        }
+        else if(!quoted && depth == 0 && *p == ','){
+            *p = 0;
+            if(n == max){
+                fail("too many operands");
+                return n;
+            }
+            list[n++] = p + 1;
+        }
+    }
+    return n;
+}
+
+// X, X+, -X and the Y and Z forms. Returns the mode bits of LD, 0 if not a pointer.
+static int pointer(const char *operand){
+    char text[8];
+    int n = 0;
+    const char *p = skip(operand);
+
+    while(*p && n < 7){
+        if(*p != ' ' && *p != '\t'){
+            text[n++] = toupper((unsigned char)*p);
+        }
+        p++;
+    }
+    text[n] = 0;
+
+    if(strcmp(text, "X") == 0) return 0x900C;
+    if(strcmp(text, "X+") == 0) return 0x900D;
+    if(strcmp(text, "-X") == 0) return 0x900E;
+    if(strcmp(text, "Y") == 0) return 0x8008;
+    if(strcmp(text, "Y+") == 0) return 0x9009;
+    if(strcmp(text, "-Y") == 0) return 0x900A;
+    if(strcmp(text, "Z") == 0) return 0x8000;
+    if(strcmp(text, "Z+") == 0) return 0x9001;
+    if(strcmp(text, "-Z") == 0) return 0x9002;
+
+    fail("pointer register expected: %s", operand);
+    return 0;
+}
+
+// Y+q or Z+q of LDD and STD. Returns the opcode bits of the pointer and displacement.
+static int displacement(const char *operand){
+    const char *p = skip(operand);
+    int base;
+    int64_t q;
+
+    if(toupper((unsigned char)*p) == 'Y'){
+        base = 0x0008;
+    }
+    else if(toupper((unsigned char)*p) == 'Z'){
+        base = 0x0000;
+    }
+    else{
+        fail("Y+q or Z+q expected: %s", operand);
+        return 0;
+    }
+    p = skip(p + 1);
+    if(*p != '+'){
+        fail("Y+q or Z+q expected: %s", operand);
+        return 0;
+    }
+
+    q = range(value(p + 1), 0, 63, "displacement");
+    return base | ((q & 0x20) << 8) | ((q & 0x18) << 7) | (q & 0x07);
+}
+
+// Relative branch target, in words from the next instruction
+static int64_t relative(const char *operand, int64_t min, int64_t max){
+    int64_t target;
+
+    dot = address + 2;
+    target = value(operand);
+    dot = address;
+
+    if(target & 1){
+        fail("odd branch target");
+    }
+    return range((target - address - 2) / 2, min, max, "branch offset");
+}
+
+static void instruction(const struct mnemonic *m, char *text){
+    char *op[3];
+    int n = operands(text, op, 3);
+    static const int counts[] = {
+        [NONE] = 0, [RDRR] = 2, [RDD] = 1, [RD] = 1, [RDK] = 2, [RDNK] = 2, [SER] = 1, [IW] = 2,
+        [MULS] = 2, [FMUL] = 2, [MOVW] = 2, [BRANCH] = 1, [BRBX] = 2, [RJMP] = 1, [JMP] = 1,
+        [IN] = 2, [OUT] = 2, [IOBIT] = 2, [REGBIT] = 2, [SBIT] = 1, [LDS] = 2, [STS] = 2,
+        [LD] = 2, [ST] = 2, [LDD] = 2, [STD] = 2, [LPM] = -1
+    };
+    int d, r;
+    int64_t k;
+
+    if(counts[m->format] >= 0 && n != counts[m->format]){
+        fail("%s takes %d operands", m->name, counts[m->format]);
+        return;
+    }
+
+    switch(m->format){
+    case NONE:
+        emit(m->opcode);
+        break;
+    case RDRR:
+        d = reg(op[0], 0, 31);
+        r = reg(op[1], 0, 31);
+        emit(m->opcode | ((r & 0x10) << 5) | (d << 4) | (r & 0x0F));
+        break;
+    case RDD:
+        d = reg(op[0], 0, 31);
+        emit(m->opcode | ((d & 0x10) << 5) | (d << 4) | (d & 0x0F));
+        break;
+    case RD:
+        d = reg(op[0], 0, 31);
+        emit(m->opcode | (d << 4));
+        break;
+    case RDK:
+    case RDNK:
+        d = reg(op[0], 16, 31);
+        k = range(value(op[1]), -128, 255, "constant");
+        if(m->format == RDNK){
+            k = ~k;
+        }
+        emit(m->opcode | ((k & 0xF0) << 4) | ((d - 16) << 4) | (k & 0x0F));
+        break;
+    case SER:
+        d = reg(op[0], 16, 31);
+        emit(m->opcode | ((d - 16) << 4));
+        break;
+    case IW:
+        d = reg(op[0], 24, 30);
+        if(d & 1){
+            fail("r24, r26, r28 or r30 expected");
+        }
+        k = range(value(op[1]), 0, 63, "constant");
+        emit(m->opcode | ((k & 0x30) << 2) | (((d - 24) / 2) << 4) | (k & 0x0F));
+        break;
+    case MULS:
+        d = reg(op[0], 16, 31);
+        r = reg(op[1], 16, 31);
+        emit(m->opcode | ((d - 16) << 4) | (r - 16));
+        break;
+    case FMUL:
+        d = reg(op[0], 16, 23);
+        r = reg(op[1], 16, 23);
+        emit(m->opcode | ((d - 16) << 4) | (r - 16));
+        break;
+    case MOVW:
+        d = reg(op[0], 0, 30);
+        r = reg(op[1], 0, 30);
+        if((d | r) & 1){
+            fail("even registers expected");
+        }
+        emit(m->opcode | ((d / 2) << 4) | (r / 2));
+        break;
+    case BRANCH:
+        k = relative(op[0], -64, 63);
+        emit(m->opcode | ((k & 0x7F) << 3));
+        break;
+    case BRBX:
+        r = range(value(op[0]), 0, 7, "bit");
+        k = relative(op[1], -64, 63);
+        emit(m->opcode | ((k & 0x7F) << 3) | (r & 0x07));
+        break;
+    case RJMP:
+        k = relative(op[0], -2048, 2047);
+        emit(m->opcode | (k & 0x0FFF));
+        break;
+    case JMP:
+        k = value(op[0]);
+        if(k & 1){
+            fail("odd jump target");
+        }
+        k = range(k / 2, 0, 0x3FFFFF, "address");
+        emit(m->opcode | ((k >> 13) & 0x01F0) | ((k >> 16) & 0x01));
+        emit(k & 0xFFFF);
+        break;
+    case IN:
+        d = reg(op[0], 0, 31);
+        k = range(value(op[1]), 0, 63, "I/O address");
+        emit(m->opcode | ((k & 0x30) << 5) | (d << 4) | (k & 0x0F));
+        break;
+    case OUT:
+        k = range(value(op[0]), 0, 63, "I/O address");
+        r = reg(op[1], 0, 31);
+        emit(m->opcode | ((k & 0x30) << 5) | (r << 4) | (k & 0x0F));
+        break;
+    case IOBIT:
+        k = range(value(op[0]), 0, 31, "I/O address");
+        r = range(value(op[1]), 0, 7, "bit");
+        emit(m->opcode | (k << 3) | r);
+        break;
+    case REGBIT:
+        d = reg(op[0], 0, 31);
+        r = range(value(op[1]), 0, 7, "bit");
+        emit(m->opcode | (d << 4) | r);
+        break;
+    case SBIT:
+        r = range(value(op[0]), 0, 7, "bit");
+        emit(m->opcode | (r << 4));
+        break;
+    case LDS:
+        d = reg(op[0], 0, 31);
+        k = range(value(op[1]), 0, 0xFFFF, "address");
+        emit(m->opcode | (d << 4));
+        emit(k);
+        break;
+    case STS:
+        k = range(value(op[0]), 0, 0xFFFF, "address");
+        r = reg(op[1], 0, 31);
+        emit(m->opcode | (r << 4));
+        emit(k);
+        break;
+    case LD:
+        d = reg(op[0], 0, 31);
+        emit(pointer(op[1]) | (d << 4));
+        break;
+    case ST:
+        r = reg(op[1], 0, 31);
+        emit((pointer(op[0]) | m->opcode | (r << 4)));
+        break;
+    case LDD:
+        d = reg(op[0], 0, 31);
+        emit(m->opcode | displacement(op[1]) | (d << 4));
+        break;
+    case STD:
+        r = reg(op[1], 0, 31);
+        emit(m->opcode | displacement(op[0]) | (r << 4));
+        break;
+    case LPM:
+        // lpm alone is lpm r0,Z
+        if(n == 0){
+            emit(m->opcode == 0x9004 ? 0x95C8 : 0x95D8);
+            break;
+        }
+        if(n != 2){
+            fail("%s takes 0 or 2 operands", m->name);
+            break;
+        }
+        d = reg(op[0], 0, 31);
+        r = pointer(op[1]);
+        if(r != 0x8000 && r != 0x9001){
+            fail("Z or Z+ expected");
+        }
+        emit(m->opcode | (d << 4) | (r == 0x9001));
+        break;
+    }
+}
+
+static void directive(const char *name, char *text){
+    char *op[64];
+    int n, i;
+
+    if(strcmp(name, ".org") == 0){
+        int64_t target = value(text);
+
+        if(pass == 1 && target < address){
+            fail(".org cannot move backwards");
+        }
+        address = target;
+    }
+    else if(strcmp(name, ".byte") == 0 || strcmp(name, ".word") == 0){
+        n = operands(text, op, 64);
+        for(i = 0; i < n; i++){
+            const char *p = skip(op[i]);
+
+            if(name[1] == 'b' && *p == '"'){
+                for(p++; *p && *p != '"'; p++){
+                    if(*p == '\\' && p[1]){
+                        p++;
+                        emitByte(*p == 'n' ? '\n' : *p == 't' ? '\t' : *p == '0' ? 0 : *p);
+                    }
+                    else{
+                        emitByte(*p);
+                    }
+                }
+            }
+            else if(name[1] == 'b'){
+                emitByte(range(value(op[i]), -128, 255, "byte"));
+            }
+            else{
+                uint16_t word = range(value(op[i]), -32768, 65535, "word");
+
+                emitByte(word & 0xFF);
+                emitByte(word >> 8);
+            }
+        }
+    }
+    else if(strcmp(name, ".equ") == 0 || strcmp(name, ".set") == 0){
+        char symbol[MAXNAME];
+        char *comma = strchr(text, ',');
+        const char *p = skip(text);
+        int length = comma ? comma - p : 0;
+
+        if(comma == 0 || length <= 0 || length >= MAXNAME){
+            fail("%s name, value expected", name);
+            return;
+        }
+        memcpy(symbol, p, length);
+        while(length > 0 && (symbol[length - 1] == ' ' || symbol[length - 1] == '\t')){
+            length--;
+        }
+        symbol[length] = 0;
+        define(symbol, value(comma + 1));
+    }
+    else if(strcmp(name, ".text") != 0 && strcmp(name, ".global") != 0 && strcmp(name, ".globl") != 0){
+        fail("unknown directive %s", name);
+    }
+}
+
+static void parse(char *text){
+    char name[MAXNAME];
+    char *p;
+    int n, i;
+    int quoted = 0;
+
+    // comments
+    for(p = text; *p; p++){
+        if(*p == '"'){
+            quoted = !quoted;
+        }
+        else if(!quoted && (*p == ';' || (p[0] == '/' && p[1] == '/'))){
+            *p = 0;
+            break;
+        }
+    }
+
+    p = (char *)skip(text);
+    dot = address;
+
+    for(;;){
+        n = 0;
+        while(isName((unsigned char)p[n]) && n < MAXNAME - 1){
+            name[n] = p[n];
+            n++;
+        }
+        name[n] = 0;
+        if(n == 0){
+            if(*p){
+                fail("syntax error: %s", p);
+            }
+            return;
+        }
+
+        const char *after = skip(p + n);
+        if(*after == ':'){
+            if(isdigit((unsigned char)name[0])){
+                if(pass == 1){
+                    locals = realloc(locals, (nlocals + 1) * sizeof(struct local));
+                    locals[nlocals].number = atoi(name);
+                    locals[nlocals].statement = statement;
+                    locals[nlocals].address = address;
+                    nlocals++;
+                }
+            }
+            else{
+                define(name, address);
+            }
+            statement++;
+            p = (char *)skip(after + 1);
+            continue;
+        }
+        if(*after == '=' && after[1] != '='){
+            define(name, value(after + 1));
+            return;
+        }
+
+        p = (char *)after;
+        break;
+    }
+
+    if(name[0] == '.'){
+        directive(name, p);
+        statement++;
+        return;
+    }
+
+    for(i = 0; name[i]; i++){
+        name[i] = tolower((unsigned char)name[i]);
+    }
+    const struct mnemonic *m = findMnemonic(name);
+    if(m == 0){
+        fail("unknown instruction %s", name);
+        return;
+    }
+    instruction(m, p);
+    statement++;
+}
+
+/* Assembles source into flash, an image of the given number of words. Only the words the
+source sets are written. Returns the number of words up to the last one written, or -1 with
+the first error, "line N: ...", in error. */
+int assemble(const char *source, uint16_t *flash, int words, char *error, int errorSize){
+    char buffer[MAXLINE];
+    char *text;
+    int length;
+
+    image = flash;
+    imageWords = words;
+    message = error;
+    messageSize = errorSize;
+    failed = 0;
+    used = 0;
+    nsymbols = 0;
+    nlocals = 0;
+    if(error && errorSize > 0){
+        error[0] = 0;
+    }
+
+    for(pass = 1; pass <= 2 && !failed; pass++){
+        const char *p = source;
+
+        address = 0;
+        line = 0;
+        statement = 0;
+        while(*p && !failed){
+            const char *end = strchr(p, '\n');
+
+            length = end ? end - p : (int)strlen(p);
+            text = length < MAXLINE ? buffer : malloc(length + 1);
+            memcpy(text, p, length);
+            text[length] = 0;
+
+            line++;
+            parse(text);
+            if(text != buffer){
+                free(text);
+            }
+
+            p += length + (end != 0);
+        }
+    }
+
+    free(symbols);
+    free(locals);
+    symbols = 0;
+    locals = 0;
+
+    return failed ? -1 : used;
+}
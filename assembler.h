@@ -0,0 +1,24 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+
+/* AVR assembler, from source text to a flash image in memory */
+
+int assemble(const char *source, uint16_t *flash, int words, char *error, int errorSize);
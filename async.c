@@ -0,0 +1,354 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "async.h"
+#include "registers.h"
+#include "scheduler.h"
+#include "replay.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+A peripheral model that does slow host I/O (a network bridge, a file, a recording) runs
+on its own thread, and talks to the MCU through a channel: two lock-free SPSC queues
+(queue.c) of cycle-stamped bytes, one each way.
+
+The MCU sends with asyncSend(), stamped with CYCLES, without waiting. The model answers
+with asyncPost(), stamped with the cycle the byte must reach the MCU at; the byte is
+delivered to the receive function of the channel, on the MCU thread, as an event at that
+cycle. So what the MCU sees only depends on the stamps, never on how fast the model is.
+
+For that, the MCU must not run past a cycle before it has every byte stamped at or before
+it. The model promises, with asyncAdvance(), a horizon: it will never post a byte stamped
+before it (asyncPost() also moves it to the byte it posts). The MCU runs freely up to the
+horizon, and only there publishes its cycle and waits for the model to move it. A model
+that answers every request after a latency L can move the horizon to the published cycle
+plus L, since any later request is stamped after that cycle:
+
+    void model(struct channel *channel){
+        struct message m;
+        uint64_t cycle;
+
+        while((cycle = asyncWait(channel)) != NEVER){
+            while(asyncReceive(channel, &m)){
+                asyncPost(channel, m.cycle + L, m.port, slowIO(m.data));
+            }
+            asyncAdvance(channel, cycle + L);
+        }
+    }
+
+and the MCU waits for it once every L cycles at most. A model that plays a recording can
+post far ahead and never make it wait. Bytes stamped at the same cycle on several channels
+are delivered in the order the channels were opened.
+
+Channels are opened after reset() and closed before the next one.
+*/
+
+#define INBOXSIZE 4096
+
+struct channel{
+    struct queue toModel;
+    struct queue toCore;
+    _Alignas(64) _Atomic uint64_t horizon;      // Written by the model
+    _Alignas(64) _Atomic uint64_t published;    // Cycle the MCU waits at, written by the MCU
+    uint64_t waits;                             // Times the MCU waited, under lock
+    uint64_t answered;                          // Waits seen by the model
+    atomic_int closing;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    void (*model)(struct channel *channel);
+    void (*receive)(int port, uint8_t data);
+};
+
+struct entry{
+    struct message m;
+    int channel;
+};
+
+static MCUSTATE struct channel *channels[MAXCHANNELS];
+static MCUSTATE int nchannels;
+
+// Bytes taken from the channels and not delivered yet, ordered by cycle then channel.
+// Allocated by the first asyncOpen() of the thread, so MCUs without channels do not carry it.
+static MCUSTATE struct entry *inbox;
+static MCUSTATE int ninbox;
+
+static void deliver(uint64_t when){
+    int i, n = 0;
+
+    while(n < ninbox && inbox[n].m.cycle <= when){
+        struct channel *c = channels[inbox[n].channel];
+
+        // While a recording replays, the bytes come from it instead (replay.c)
+        if(c && c->receive && REPLAY != REPLAYING){
+            if(REPLAY == RECORDING){
+                recordInput(INPUT_CHANNEL, inbox[n].channel << 16 | inbox[n].m.port, inbox[n].m.data);
+            }
+            c->receive(inbox[n].m.port, inbox[n].m.data);
+        }
+        n++;
+    }
+    for(i = n; i < ninbox; i++){
+        inbox[i - n] = inbox[i];
+    }
+    ninbox -= n;
+
+    if(ninbox){
+        schedule(deliver, inbox[0].m.cycle);
+    }
+}
+
+static void take(int index){
+    struct channel *c = channels[index];
+    struct message m;
+    int j;
+
+    while(queuePeek(&c->toCore, &m)){
+        queuePop(&c->toCore);
+
+        if(ninbox == INBOXSIZE){
+            printf("INBOX FULL.");
+            exit(1);
+        }
+
+        for(j = ninbox; j > 0 && (inbox[j - 1].m.cycle > m.cycle ||
+            (inbox[j - 1].m.cycle == m.cycle && inbox[j - 1].channel > index)); j--){
+            inbox[j] = inbox[j - 1];
+        }
+        inbox[j].m = m;
+        inbox[j].channel = index;
+        ninbox++;
+    }
+}
+
+// Publishes the cycle the MCU is at and waits until the model promises it is past it
+static void waitFor(struct channel *c, uint64_t cycle){
+    pthread_mutex_lock(&c->lock);
+    atomic_store_explicit(&c->published, cycle, memory_order_release);
+    c->waits++;
+    pthread_cond_broadcast(&c->changed);
+    while(atomic_load_explicit(&c->horizon, memory_order_acquire) <= cycle){
+        pthread_cond_wait(&c->changed, &c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* Runs at the nearest horizon: takes everything the models posted and waits for the ones
+that have not promised past this cycle yet. */
+static void synchronize(uint64_t when){
+    uint64_t next = NEVER;
+    int i;
+
+    for(i = 0; i < nchannels; i++){
+        struct channel *c = channels[i];
+
+        if(c == 0){
+            continue;
+        }
+        if(atomic_load_explicit(&c->horizon, memory_order_acquire) <= CYCLES){
+            waitFor(c, CYCLES);
+        }
+        take(i);
+
+        uint64_t horizon = atomic_load_explicit(&c->horizon, memory_order_acquire);
+        if(horizon < next){
+            next = horizon;
+        }
+    }
+
+    // a byte stamped inside the instruction that crossed the horizon is delivered right away
+    if(ninbox){
+        schedule(deliver, inbox[0].m.cycle);
+    }
+    if(next != NEVER){
+        schedule(synchronize, next);
+    }
+}
+
+static void *runModel(void *arg){
+    struct channel *c = arg;
+
+    c->model(c);
+
+    return 0;
+}
+
+/* Opens a channel to a model started on a new thread. receive gets, on this thread, the
+bytes the model posts, at their cycle. */
+struct channel *asyncOpen(void (*model)(struct channel *channel), void (*receive)(int port, uint8_t data)){
+    struct channel *c;
+
+    if(nchannels == MAXCHANNELS){
+        printf("TOO MANY CHANNELS.");
+        exit(1);
+    }
+
+    c = aligned_alloc(64, (sizeof(struct channel) + 63) / 64 * 64);
+    queueInit(&c->toModel);
+    queueInit(&c->toCore);
+    atomic_store(&c->horizon, CYCLES);
+    atomic_store(&c->published, CYCLES);
+    c->waits = 0;
+    c->answered = 0;
+    atomic_store(&c->closing, 0);
+    pthread_mutex_init(&c->lock, 0);
+    pthread_cond_init(&c->changed, 0);
+    c->model = model;
+    c->receive = receive;
+
+    if(inbox == 0){
+        inbox = malloc(INBOXSIZE * sizeof(struct entry));
+    }
+    if(nchannels == 0){
+        ninbox = 0;
+    }
+    channels[nchannels++] = c;
+
+    pthread_create(&c->thread, 0, runModel, c);
+    schedule(synchronize, CYCLES);
+
+    return c;
+}
+
+/* Delivers a byte as if the model of the channel, the index-th opened, had posted it. */
+void asyncInject(int index, int port, uint8_t data){
+    struct channel *c = index < nchannels ? channels[index] : 0;
+
+    if(c && c->receive){
+        c->receive(port, data);
+    }
+}
+
+/* Sends a byte to the model, stamped with CYCLES. Only waits if the model is so far behind
+that the queue is full. */
+void asyncSend(struct channel *c, int port, uint8_t data){
+    struct message m;
+
+    m.cycle = CYCLES;
+    m.port = port;
+    m.data = data;
+
+    while(!queuePush(&c->toModel, m)){
+        sched_yield();
+    }
+}
+
+/* Stops the model (asyncWait() returns NEVER) and waits for its thread to end. Bytes it has
+not delivered yet are dropped. */
+void asyncClose(struct channel *c){
+    int i, j, n = 0;
+
+    pthread_mutex_lock(&c->lock);
+    atomic_store(&c->closing, 1);
+    atomic_store_explicit(&c->horizon, NEVER, memory_order_release);
+    pthread_cond_broadcast(&c->changed);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, 0);
+
+    for(i = 0; i < nchannels && channels[i] != c; i++){
+    }
+    if(i < nchannels){
+        channels[i] = 0;
+    }
+    for(j = 0; j < ninbox; j++){
+        if(inbox[j].channel != i){
+            inbox[n++] = inbox[j];
+        }
+    }
+    ninbox = n;
+    // The slots of the last channels open again; the others keep their index for replay.c
+    while(nchannels > 0 && channels[nchannels - 1] == 0){
+        nchannels--;
+    }
+
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->changed);
+    free(c);
+}
+
+/* Model side: waits until the MCU waits for the model, and returns the cycle it waits at,
+or NEVER when the channel is closed. Every byte the MCU sent before that cycle can be
+received. */
+uint64_t asyncWait(struct channel *c){
+    uint64_t cycle;
+
+    pthread_mutex_lock(&c->lock);
+    while(c->answered == c->waits && !c->closing){
+        pthread_cond_wait(&c->changed, &c->lock);
+    }
+    c->answered = c->waits;
+    cycle = c->closing ? NEVER : atomic_load_explicit(&c->published, memory_order_acquire);
+    pthread_mutex_unlock(&c->lock);
+
+    return cycle;
+}
+
+/* Model side: takes the oldest byte sent by the MCU. Returns 0 if there is none. */
+int asyncReceive(struct channel *c, struct message *m){
+    if(!queuePeek(&c->toModel, m)){
+        return 0;
+    }
+    queuePop(&c->toModel);
+    return 1;
+}
+
+/* Model side: posts a byte for the MCU at the given cycle, which cannot be before the
+horizon. The horizon moves to it. */
+void asyncPost(struct channel *c, uint64_t cycle, int port, uint8_t data){
+    struct message m;
+
+    // the MCU is not listening any more
+    if(atomic_load_explicit(&c->closing, memory_order_relaxed)){
+        return;
+    }
+    if(cycle < atomic_load_explicit(&c->horizon, memory_order_acquire)){
+        // or asyncClose() moved the horizon to NEVER since closing was read
+        if(atomic_load_explicit(&c->closing, memory_order_relaxed)){
+            return;
+        }
+        printf("ASYNC MESSAGE IN THE PAST.");
+        exit(1);
+    }
+
+    m.cycle = cycle;
+    m.port = port;
+    m.data = data;
+    while(!queuePush(&c->toCore, m)){
+        sched_yield();
+    }
+
+    asyncAdvance(c, cycle);
+}
+
+/* Model side: promises that no byte will be posted before horizon, letting the MCU run up
+to it. */
+void asyncAdvance(struct channel *c, uint64_t horizon){
+    if(horizon <= atomic_load_explicit(&c->horizon, memory_order_relaxed)){
+        return;
+    }
+
+    pthread_mutex_lock(&c->lock);
+    if(!c->closing){
+        atomic_store_explicit(&c->horizon, horizon, memory_order_release);
+    }
+    pthread_cond_broadcast(&c->changed);
+    pthread_mutex_unlock(&c->lock);
+}
@@ -0,0 +1,44 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <stdint.h>
+#include "queue.h"
+
+/* Peripheral models running on a host thread of their own */
+
+#define MAXCHANNELS 8
+
+struct channel;
+
+// Core side, on the thread of the MCU
+struct channel *asyncOpen(void (*model)(struct channel *channel), void (*receive)(int port, uint8_t data));
+void asyncSend(struct channel *channel, int port, uint8_t data);
+void asyncClose(struct channel *channel);
+void asyncInject(int index, int port, uint8_t data);
+
+// Peripheral side, on the thread of the model
+uint64_t asyncWait(struct channel *channel);
+int asyncReceive(struct channel *channel, struct message *m);
+void asyncPost(struct channel *channel, uint64_t cycle, int port, uint8_t data);
+void asyncAdvance(struct channel *channel, uint64_t horizon);
+
+#endif
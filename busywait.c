@@ -0,0 +1,186 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "busywait.h"
+#include "registers.h"
+#include "functions.h"
+#include "scheduler.h"
+
+/*
+Loops recognized at PC:
+
+    sbis A,b / rjmp .-4                3 cycles per iteration
+    sbic A,b / rjmp .-4                3 cycles per iteration
+    in rT,A / sbrs rT,b / rjmp .-6     4 cycles per iteration (or sbrc)
+    lds rT,k / sbrs rT,b / rjmp .-8    5 cycles per iteration (or sbrc)
+    dec rC / brne .-4                  3 cycles per iteration
+    sbiw rC,1 / brne .-4               4 cycles per iteration
+
+A polling loop only reads its I/O register. If that register has no peripheral read
+handler, its value can only change when a peripheral event runs (or an interrupt routine
+writes it), so the polled bit stays the same until NEXTEVENT. The iterations that end
+before NEXTEVENT are skipped in one step; the loop then goes on stepping and sees the
+event at the same instruction as it would have.
+
+A delay loop runs until its counter reaches zero. All iterations but the last are done
+at once, also never past NEXTEVENT, leaving the counter and the flags as the last of
+them would. The last one is stepped by the decoder.
+*/
+
+#define RJMP_BACK2 0xCFFE
+#define RJMP_BACK3 0xCFFD
+#define RJMP_BACK4 0xCFFC
+#define BRNE_BACK2 0xF7F1
+
+// Iterations of a loop of cost cycles each that end before limit
+static uint64_t fit(uint64_t n, int cost, uint64_t limit){
+    if(n > limit / cost){
+        n = limit / cost;
+    }
+    return n;
+}
+
+// True if the value at addr cannot change before the next event
+static int stable(uint16_t addr){
+    return addr >= 0x20 && addr <= RAMEND && !hasReadHandler(addr) && NEXTEVENT != NEVER;
+}
+
+// Skip the iterations of a polling loop on bit b of addr. Skip if set tells the
+// polarity of the SBIS/SBRS or SBIC/SBRC ending the loop.
+static uint64_t poll(uint16_t addr, int b, int skipIfSet, int cost, uint64_t limit){
+    uint64_t n;
+
+    if(!stable(addr)){
+        return 0;
+    }
+    if(((readDATA(addr) >> b) & 1) == skipIfSet){
+        return 0;
+    }
+
+    n = fit(NEVER, cost, limit);
+
+    return n * cost;
+}
+
+// dec rC / brne
+static int countDown8(int rc, uint64_t limit){
+    uint32_t n = R[rc] ? R[rc] : 256;
+    uint8_t v;
+
+    n = fit(n - 1, 3, limit);
+    if(n == 0){
+        return 0;
+    }
+
+    // The flags of the last DEC, which did not reach zero
+    v = R[rc] - n;
+    SREG.V = (v == 0x7F);
+    SREG.N = v >> 7;
+    SREG.Z = 0;
+    computeS();
+    R[rc] = v;
+
+    return 3 * n;
+}
+
+// sbiw rC,1 / brne
+static int countDown16(int rc, uint64_t limit){
+    uint32_t n = getPointer(rc) ? getPointer(rc) : 65536;
+    uint16_t v;
+
+    n = fit(n - 1, 4, limit);
+    if(n == 0){
+        return 0;
+    }
+
+    v = getPointer(rc) - n;
+    computeSBIWflags(v + 1, v);
+    setPointer(rc, v);
+
+    return 4 * n;
+}
+
+/* Matches the busy-wait loop starting at pc. With run set, skips it for at most limit cycles
+and returns the cycles skipped; otherwise returns nonzero if pc is at one. */
+static uint64_t busyLoop(pc_t pc, uint64_t limit, int run){
+    uint16_t w0 = FLASH[pc];
+
+    if(pc + 3 >= FLASHSIZE){
+        return 0;
+    }
+
+    uint16_t w1 = FLASH[pc + 1];
+    uint16_t w2 = FLASH[pc + 2];
+    uint16_t w3 = FLASH[pc + 3];
+
+    // sbis/sbic A,b / rjmp .-4
+    if((w0 & 0xFD00) == 0x9900 && w1 == RJMP_BACK2){
+        return !run ? 1 : poll(((w0 >> 3) & 0x1F) + 0x20, w0 & 0x07, (w0 >> 9) & 1, 3, limit);
+    }
+
+    // in rT,A / sbrs/sbrc rT,b / rjmp .-6
+    if((w0 & 0xF800) == 0xB000 && (w1 & 0xFC08) == 0xFC00 && ((w1 >> 4) & 0x1F) == ((w0 >> 4) & 0x1F) && w2 == RJMP_BACK3){
+        uint16_t addr = (((w0 >> 5) & 0x30) | (w0 & 0x0F)) + 0x20;
+
+        if(!run){
+            return 1;
+        }
+        uint64_t cycles = poll(addr, w1 & 0x07, (w1 >> 9) & 1, 4, limit);
+
+        if(cycles){
+            R[(w0 >> 4) & 0x1F] = readDATA(addr);
+        }
+        return cycles;
+    }
+
+    // lds rT,k / sbrs/sbrc rT,b / rjmp .-8
+    if((w0 & 0xFE0F) == 0x9000 && (w2 & 0xFC08) == 0xFC00 && ((w2 >> 4) & 0x1F) == ((w0 >> 4) & 0x1F) && w3 == RJMP_BACK4){
+        if(!run){
+            return 1;
+        }
+        uint64_t cycles = poll(w1, w2 & 0x07, (w2 >> 9) & 1, 5, limit);
+
+        if(cycles){
+            R[(w0 >> 4) & 0x1F] = readDATA(w1);
+        }
+        return cycles;
+    }
+
+    // dec rC / brne .-4
+    if((w0 & 0xFE0F) == 0x940A && w1 == BRNE_BACK2){
+        return !run ? 1 : countDown8((w0 >> 4) & 0x1F, limit);
+    }
+
+    // sbiw rC,1 / brne .-4
+    if((w0 & 0xFFCF) == 0x9701 && w1 == BRNE_BACK2){
+        return !run ? 1 : countDown16(24 + ((w0 >> 3) & 0x06), limit);
+    }
+
+    return 0;
+}
+
+/* Skips the busy-wait loop starting at PC, for at most limit cycles. Returns the cycles
+skipped, 0 if PC is not at such a loop. */
+uint64_t skipBusyWait(uint64_t limit){
+    return busyLoop(PC, limit, 1);
+}
+
+/* Nonzero if a busy-wait loop starts at pc. Only FLASH is looked at. */
+int busyWaitAt(pc_t pc){
+    return busyLoop(pc, 0, 0) != 0;
+}
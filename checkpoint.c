@@ -0,0 +1,351 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#define _GNU_SOURCE
+#include "checkpoint.h"
+#include "registers.h"
+#include "decoder.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "eeprom.h"
+#include "elf.h"
+#include "sram.h"
+#include "native.h"
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Checkpoint files: the snapshot of the MCU (snapshot.c, EEPROM included) followed by the
+flash, saved so that a later run of the same build can resume from it.
+
+    header      struct header
+    bitmap      one bit per block of 64 bytes of the snapshot and the flash, set if stored
+    blocks      the blocks that are not all zeros, in order
+
+Most of a snapshot and of the flash is zeros, so a checkpoint is a few KB. It is read by
+mapping the file and copying the stored blocks back in place.
+
+A checkpoint only fits the build of the simulator that saved it, set up the same way: the
+header holds the build id of the executable or library with this code (its GNU build id
+note, or a hash of the file if it has none), the layout of the snapshot (stateLayout())
+and the indices of the event handlers (handlerLayout()), and a file that differs in any of
+them is not loaded.
+
+warmBoot() keeps one checkpoint per firmware: the first boot runs from reset to main() (or
+another symbol), past __do_copy_data, __do_clear_bss and the constructors, and saves it;
+later boots of the same ELF file by the same build restore it instead.
+*/
+
+#define CHECKPOINT_MAGIC 0x54504B43     // "CKPT"
+#define CHECKPOINT_VERSION 2
+#define BLOCK 64
+#define BUILDID 20
+
+struct header{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stateSize;
+    uint32_t layout;
+    uint32_t handlers;      // handlerLayout()
+    uint32_t blocks;        // Blocks stored
+    uint64_t cycles;
+    uint8_t build[BUILDID]; // Build id of the simulator that saved it
+    uint8_t reserved[4];
+};
+
+struct object{
+    uintptr_t code;         // An address in the object looked for
+    uint8_t *id;
+    int found;
+    char path[1024];        // Its file, if it has no build id note
+};
+
+// The build id note of the object holding o->code, if it is this one
+static int objectId(struct dl_phdr_info *info, size_t size, void *data){
+    struct object *o = data;
+    const ElfW(Phdr) *p;
+    int i, ours = 0;
+
+    for(i = 0; i < info->dlpi_phnum; i++){
+        p = &info->dlpi_phdr[i];
+        if(p->p_type == PT_LOAD && o->code - info->dlpi_addr - p->p_vaddr < p->p_memsz){
+            ours = 1;
+        }
+    }
+    if(!ours){
+        return 0;
+    }
+
+    for(i = 0; i < info->dlpi_phnum && !o->found; i++){
+        p = &info->dlpi_phdr[i];
+        if(p->p_type == PT_NOTE){
+            const uint8_t *note = (const uint8_t *)(info->dlpi_addr + p->p_vaddr);
+            const uint8_t *end = note + p->p_memsz;
+
+            while(!o->found && note + sizeof(ElfW(Nhdr)) <= end){
+                const ElfW(Nhdr) *n = (const ElfW(Nhdr) *)note;
+                const uint8_t *name = note + sizeof(ElfW(Nhdr));
+                const uint8_t *desc = name + ((n->n_namesz + 3) & ~3);
+
+                if(n->n_type == NT_GNU_BUILD_ID && n->n_namesz == 4 && memcmp(name, "GNU", 4) == 0){
+                    memcpy(o->id, desc, n->n_descsz < BUILDID ? n->n_descsz : BUILDID);
+                    o->found = 1;
+                }
+                note = desc + ((n->n_descsz + 3) & ~3);
+            }
+        }
+    }
+    snprintf(o->path, sizeof(o->path), "%s", info->dlpi_name[0] ? info->dlpi_name : "/proc/self/exe");
+    return 1;
+}
+
+/* The build id of the executable or library this code is part of, padded with zeros. */
+static void buildId(uint8_t id[BUILDID]){
+    struct object o = {(uintptr_t)buildId, id};
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    uint8_t chunk[65536];
+    size_t n, i;
+    FILE *f;
+
+    memset(id, 0, BUILDID);
+    dl_iterate_phdr(objectId, &o);
+    if(o.found || o.path[0] == 0 || (f = fopen(o.path, "rb")) == 0){
+        return;
+    }
+    while((n = fread(chunk, 1, sizeof(chunk), f)) > 0){
+        for(i = 0; i < n; i++){
+            hash = (hash ^ chunk[i]) * 0x100000001B3ULL;
+        }
+    }
+    fclose(f);
+    memcpy(id, &hash, sizeof(hash));
+}
+
+// Snapshot and flash, padded to whole blocks
+static uint8_t *image(size_t *size){
+    size_t state = stateSize();
+    uint8_t *buffer;
+
+    *size = (state + FLASHSIZE * 2 + BLOCK - 1) / BLOCK * BLOCK;
+    buffer = calloc(*size, 1);
+    return buffer;
+}
+
+static int zeros(const uint8_t *block){
+    int i;
+
+    for(i = 0; i < BLOCK; i++){
+        if(block[i]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Saves the MCU of this thread to path. Returns 0 if the file cannot be written. */
+int checkpointSave(const char *path){
+    struct header h = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION};
+    char temporary[1024];
+    size_t size, nblocks, i;
+    uint8_t *buffer = image(&size);
+    uint8_t *bitmap;
+    FILE *f;
+    int ok;
+
+    saveState(buffer);
+    memcpy(buffer + stateSize(), FLASH, FLASHSIZE * 2);
+
+    nblocks = size / BLOCK;
+    bitmap = calloc((nblocks + 7) / 8, 1);
+    for(i = 0; i < nblocks; i++){
+        if(!zeros(buffer + i * BLOCK)){
+            bitmap[i >> 3] |= 1 << (i & 7);
+            h.blocks++;
+        }
+    }
+    h.stateSize = stateSize();
+    h.layout = stateLayout();
+    h.handlers = handlerLayout();
+    h.cycles = CYCLES;
+    buildId(h.build);
+
+    // Written aside and renamed, so a reader never maps half a checkpoint
+    snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid());
+    f = fopen(temporary, "wb");
+    ok = f != 0;
+    if(f){
+        ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(bitmap, (nblocks + 7) / 8, 1, f) == 1;
+        for(i = 0; ok && i < nblocks; i++){
+            if((bitmap[i >> 3] >> (i & 7)) & 1){
+                ok = fwrite(buffer + i * BLOCK, BLOCK, 1, f) == 1;
+            }
+        }
+        ok = fclose(f) == 0 && ok && rename(temporary, path) == 0;
+        if(!ok){
+            unlink(temporary);
+        }
+    }
+
+    free(bitmap);
+    free(buffer);
+
+    return ok;
+}
+
+/* Restores the MCU of this thread from path. Returns 0, and leaves the MCU as it was, if
+the file cannot be read or was saved by another build or with another snapshot layout. */
+int checkpointLoad(const char *path){
+    const struct header *h;
+    const uint8_t *map, *bitmap, *block;
+    size_t size, nblocks, i;
+    uint8_t *buffer;
+    uint8_t build[BUILDID];
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct header)){
+        if(fd >= 0){
+            close(fd);
+        }
+        return 0;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        return 0;
+    }
+
+    buffer = image(&size);
+    nblocks = size / BLOCK;
+    h = (const struct header *)map;
+    bitmap = map + sizeof(struct header);
+    block = bitmap + (nblocks + 7) / 8;
+    buildId(build);
+
+    if(h->magic != CHECKPOINT_MAGIC || h->version != CHECKPOINT_VERSION || memcmp(h->build, build, BUILDID) != 0 ||
+        h->stateSize != stateSize() || h->layout != stateLayout() || h->handlers != handlerLayout() ||
+        sizeof(struct header) + (nblocks + 7) / 8 + (size_t)h->blocks * BLOCK != (size_t)st.st_size){
+        munmap((void *)map, st.st_size);
+        free(buffer);
+        return 0;
+    }
+
+    for(i = 0; i < nblocks; i++){
+        if((bitmap[i >> 3] >> (i & 7)) & 1){
+            memcpy(buffer + i * BLOCK, block, BLOCK);
+            block += BLOCK;
+        }
+    }
+
+    restoreState(buffer);
+    dropEvents();
+    memcpy(FLASH, buffer + stateSize(), FLASHSIZE * 2);
+    invalidateFlash(0, FLASHSIZE);
+
+    munmap((void *)map, st.st_size);
+    free(buffer);
+
+    return 1;
+}
+
+static MCUSTATE int invalid;
+
+// Bounds the run to the symbol
+static void deadline(uint64_t when){
+}
+
+// Fails the boot instead of ending the program
+static void invalidOpcode(uint16_t opcode){
+    invalid = 1;
+}
+
+/* Boots the firmware in the ELF file from reset to symbol (main if 0), running at most the
+given cycles, and keeps a checkpoint of it in directory; if there already is one, restores
+it instead. Returns 0 if the file cannot be loaded, or the symbol is not reached or an invalid
+opcode is run before it. */
+int warmBoot(const char *elfPath, const char *symbol, const char *directory, uint64_t cycles){
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    uint8_t build[BUILDID];
+    char path[1024];
+    uint32_t value, size;
+    struct elf elf;
+    size_t i;
+    uint64_t end;
+
+    if(!elfOpen(elfPath, &elf)){
+        return 0;
+    }
+    if(symbol == 0){
+        symbol = "main";
+    }
+
+    // The firmware, the symbol and the build of the simulator
+    for(i = 0; i < elf.size; i++){
+        hash = (hash ^ elf.data[i]) * 0x100000001B3ULL;
+    }
+    for(i = 0; symbol[i]; i++){
+        hash = (hash ^ (uint8_t)symbol[i]) * 0x100000001B3ULL;
+    }
+    buildId(build);
+    for(i = 0; i < BUILDID; i++){
+        hash = (hash ^ build[i]) * 0x100000001B3ULL;
+    }
+    snprintf(path, sizeof(path), "%s/%016llx.ckpt", directory, (unsigned long long)hash);
+
+    reset();
+    sramRegions(&elf);
+    if(checkpointLoad(path)){
+        nativeSymbols(&elf);
+        elfClose(&elf);
+        return 1;
+    }
+
+    if(!elfLoad(&elf, (uint8_t *)FLASH, FLASHSIZE * 2, eepromContents(), EEPROMSIZE) ||
+        !elfSymbol(&elf, symbol, &value, &size)){
+        elfClose(&elf);
+        return 0;
+    }
+    nativeSymbols(&elf);
+    elfClose(&elf);
+    invalidateFlash(0, FLASHSIZE);
+
+    end = CYCLES + cycles;
+    invalid = 0;
+    onInvalidOpcode(invalidOpcode);
+    schedule(deadline, end);
+    while(PC != value / 2){
+        if(CYCLES >= end || step() == 0 || invalid){
+            unschedule(deadline);
+            onInvalidOpcode(0);
+            return 0;
+        }
+    }
+    unschedule(deadline);
+    onInvalidOpcode(0);
+
+    mkdir(directory, 0755);
+    checkpointSave(path);
+
+    return 1;
+}
@@ -0,0 +1,30 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+
+/* Checkpoint files of the whole MCU (see checkpoint.c) */
+
+int checkpointSave(const char *path);
+int checkpointLoad(const char *path);
+int warmBoot(const char *elfPath, const char *symbol, const char *directory, uint64_t cycles);
+
+#endif
@@ -0,0 +1,492 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "cosim.h"
+#include "queue.h"
+#include "registers.h"
+#include "decoder.h"
+#include "flash.h"
+#include "scheduler.h"
+#include "usart.h"
+#include "spi.h"
+#include "twi.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+Every MCU runs on its own thread with its own copy of the MCU state (MCUSTATE). The MCUs
+run independently for a quantum of cycles and only wait for each other at the end of it.
+
+A virtual wire is a link from one MCU to another on a port (UART, SPI, TWI...). Bytes
+sent on it are stamped with the cycle they were sent at and go through a lock-free
+queue. At the end of the quantum ending at cycle B, once every MCU has reached B, each
+MCU takes from its incoming links the messages sent before B and delivers them as
+events at their arrival cycle (sent + latency), or right away if it is already past it.
+
+The messages taken at each boundary and their order only depend on the cycles they were
+sent at, never on the speed of the threads, so runs are deterministic. Timing is exact
+when the latency of every link is at least the quantum.
+
+A queue holds the quantum being taken and the one being sent, so a link carries at most
+LINKBUDGET bytes per quantum: past it cosimSend() returns 0 and the byte is lost on that
+link. The budget only depends on what the sender did, so losses are deterministic too.
+
+cosimRun() makes the threads itself. A host with threads of its own (simulador.c) calls
+cosimBegin(), then cosimLoop() on the thread of each MCU, then cosimEnd().
+*/
+
+#define MAXLINKS 256
+#define INBOXSIZE 4096
+#define LINKBUDGET (QUEUESIZE / 2 - 64)     // Bytes per quantum, with room for an instruction past the boundary
+
+struct link{
+    int from;
+    int to;
+    int port;
+    uint64_t latency;
+    int sent;               // In this quantum, by the thread of from
+    struct queue queue;
+};
+
+static struct link *links[MAXLINKS];
+static int nlinks;
+static int nmcus;
+static uint64_t quantum;
+static uint64_t startCycle;
+static uint64_t endCycle;
+static void (*setups[MAXMCUS])(int mcu);
+static void (*finishes[MAXMCUS])(int mcu);
+static pthread_barrier_t barrier;
+
+// MCU simulated by this thread, -1 outside co-simulation
+static MCUSTATE int mcu = -1;
+static MCUSTATE void (*receivers[MAXPORTS])(int port, uint8_t data);
+
+// Messages taken from the links and not delivered yet, ordered by arrival
+static MCUSTATE struct message *inbox;
+static MCUSTATE int ninbox;
+static MCUSTATE int inboxSize;
+
+void cosimInit(int mcus, uint64_t cycles){
+    int i;
+
+    for(i = 0; i < nlinks; i++){
+        free(links[i]);
+    }
+    nlinks = 0;
+    nmcus = mcus;
+    quantum = cycles;
+    endCycle = 0;
+
+    for(i = 0; i < MAXMCUS; i++){
+        setups[i] = 0;
+        finishes[i] = 0;
+    }
+}
+
+int cosimMCUs(){
+    return nmcus;
+}
+
+// Connect port of MCU from to the same port of MCU to. Returns the link number, -1 if MAXLINKS are used.
+int cosimConnect(int from, int to, int port, uint64_t latency){
+    struct link *l;
+
+    if(nlinks == MAXLINKS || from < 0 || from >= nmcus || to < 0 || to >= nmcus){
+        return -1;
+    }
+
+    l = aligned_alloc(64, (sizeof(struct link) + 63) / 64 * 64);
+    l->from = from;
+    l->to = to;
+    l->port = port & 0xFF;
+    l->latency = latency;
+    l->sent = 0;
+    queueInit(&l->queue);
+
+    links[nlinks] = l;
+
+    return nlinks++;
+}
+
+// setup runs on the thread of the MCU after reset (to load its program), finish before the thread ends
+void cosimSetup(int n, void (*setup)(int mcu), void (*finish)(int mcu)){
+    setups[n] = setup;
+    finishes[n] = finish;
+}
+
+int cosimMCU(){
+    return mcu;
+}
+
+void cosimReceiver(int port, void (*receive)(int port, uint8_t data)){
+    receivers[(port & 0xFF) % MAXPORTS] = receive;
+}
+
+/* Send a byte on every link leaving this MCU on port. Returns 0 if a link had used its
+budget for the quantum and lost the byte. */
+int cosimSend(int port, uint8_t data){
+    struct message m;
+    int i, sent = 1;
+
+    m.cycle = CYCLES;
+    m.port = port;
+    m.data = data;
+
+    for(i = 0; i < nlinks; i++){
+        struct link *l = links[i];
+
+        if(l->from == mcu && l->port == (port & 0xFF)){
+            if(l->sent == LINKBUDGET || !queuePush(&l->queue, m)){
+                sent = 0;
+                continue;
+            }
+            l->sent++;
+        }
+    }
+    return sent;
+}
+
+static void deliver(uint64_t when){
+    int i, n = 0;
+
+    while(n < ninbox && inbox[n].cycle <= when){
+        void (*receive)(int port, uint8_t data) = receivers[(inbox[n].port & 0xFF) % MAXPORTS];
+
+        if(receive){
+            receive(inbox[n].port, inbox[n].data);
+        }
+        n++;
+    }
+    for(i = n; i < ninbox; i++){
+        inbox[i - n] = inbox[i];
+    }
+    ninbox -= n;
+
+    if(ninbox){
+        schedule(deliver, inbox[0].cycle);
+    }
+}
+
+// Take the messages sent before boundary, in link order, keeping the inbox sorted by arrival
+static void collect(uint64_t boundary){
+    struct message m;
+    int i, j;
+
+    for(i = 0; i < nlinks; i++){
+        if(links[i]->to != mcu){
+            continue;
+        }
+        while(queuePeek(&links[i]->queue, &m) && m.cycle < boundary){
+            queuePop(&links[i]->queue);
+
+            if(ninbox == inboxSize){
+                inboxSize *= 2;
+                inbox = realloc(inbox, inboxSize * sizeof(struct message));
+            }
+
+            m.cycle += links[i]->latency;
+            for(j = ninbox; j > 0 && inbox[j - 1].cycle > m.cycle; j--){
+                inbox[j] = inbox[j - 1];
+            }
+            inbox[j] = m;
+            ninbox++;
+        }
+    }
+
+    if(ninbox){
+        schedule(deliver, inbox[0].cycle);
+    }
+}
+
+/* Starts a co-simulation of the given cycles, from the end of the last one. */
+void cosimBegin(uint64_t cycles){
+    startCycle = endCycle;
+    endCycle += cycles;
+    pthread_barrier_init(&barrier, 0, nmcus);
+}
+
+void cosimEnd(){
+    pthread_barrier_destroy(&barrier);
+}
+
+/* Simulates MCU n on this thread, between cosimBegin() and cosimEnd(): runTo runs it until
+CYCLES reaches end. Every MCU must be in the loop, or the others wait for it. Messages
+still on their way at the end are kept for the next co-simulation. */
+void cosimLoop(int n, void (*runTo)(uint64_t end)){
+    uint64_t boundary = startCycle;
+    int i;
+
+    mcu = n;
+    if(inbox == 0){
+        inboxSize = INBOXSIZE;
+        inbox = malloc(inboxSize * sizeof(struct message));
+        ninbox = 0;
+    }
+
+    while(boundary < endCycle){
+        boundary += quantum;
+        if(boundary > endCycle){
+            boundary = endCycle;
+        }
+
+        if(CYCLES < boundary){
+            runTo(boundary);
+        }
+
+        pthread_barrier_wait(&barrier);
+        collect(boundary);
+        for(i = 0; i < nlinks; i++){
+            if(links[i]->from == mcu){
+                links[i]->sent = 0;
+            }
+        }
+    }
+
+    mcu = -1;
+}
+
+/* Forgets the messages on their way to the MCU of this thread. */
+void cosimDrop(){
+    unschedule(deliver);
+    free(inbox);
+    inbox = 0;
+    ninbox = 0;
+}
+
+static void runTo(uint64_t end){
+    run(end - CYCLES);
+}
+
+static void *simulate(void *arg){
+    int n = (int)(intptr_t)arg;
+
+    reset();
+    if(setups[n]){
+        setups[n](n);
+    }
+
+    cosimLoop(n, runTo);
+
+    if(finishes[n]){
+        finishes[n](n);
+    }
+    cosimDrop();
+    dropFlash();
+
+    return 0;
+}
+
+/* Runs every MCU from reset for the given number of cycles */
+void cosimRun(uint64_t cycles){
+    pthread_t threads[MAXMCUS];
+    int i;
+
+    endCycle = 0;
+    cosimBegin(cycles);
+
+    for(i = 0; i < nmcus; i++){
+        pthread_create(&threads[i], 0, simulate, (void *)(intptr_t)i);
+    }
+    for(i = 0; i < nmcus; i++){
+        pthread_join(threads[i], 0);
+    }
+
+    cosimEnd();
+}
+
+/*
+Bridges from the wires to the buses.
+
+UART: the USART of an MCU on the wire (cosimUart()) sends each byte it transmits on
+PORT_UART at the end of its frame, and its receiver gets the bytes coming on PORT_UART at
+their arrival cycle. Both sides are expected to use the same baud rate and frame format.
+
+SPI: the master MCU has a device on its bus (cosimSpiMaster()) that sends MOSI on PORT_SPI
+and the slave MCU (cosimSpiSlave()) clocks it into its SPI as a slave (spiSlaveExchange())
+and sends what it shifted out back on PORT_SPI. The answer cannot be known when the master
+ends the byte, so MISO is the last answer that came back, 0xFF at first: with the bytes
+further apart than the round trip, the answer to the byte before, as command/response
+protocols with a dummy byte expect.
+
+TWI: the master MCU has a device at an address (cosimTwiMaster()) that acknowledges
+everything and sends the START, the bytes and the STOP on PORT_TWI, told apart by the high
+byte of the port. The slave MCU (cosimTwiSlave()) collects a transaction and, at its STOP,
+writes it as a master outside the MCU would (twiMaster()), at the address of the START,
+once the transaction before it is over. Reads over the wire are not carried: the master
+reads 0xFF and the slave MCU sees nothing.
+*/
+
+#define TWI_START (PORT_TWI | 1 << 8)
+#define TWI_DATA PORT_TWI
+#define TWI_STOP (PORT_TWI | 2 << 8)
+#define MAXTRANSACTIONS 8
+#define TRANSACTIONSIZE 256
+#define TWIPOLL 256                         // Cycles between looks at the transaction being written
+
+static MCUSTATE struct spidevice spiWire;
+static MCUSTATE uint8_t miso = 0xFF;        // Answer of the slave to the last byte
+
+static MCUSTATE struct twidevice twiWire;
+static MCUSTATE uint8_t transactions[MAXTRANSACTIONS][TRANSACTIONSIZE];
+static MCUSTATE struct twitransfer transfers[MAXTRANSACTIONS];
+static MCUSTATE int first;                  // Transaction written to the MCU, or next to be
+static MCUSTATE int ntransactions;          // Complete ones, then the one being collected
+static MCUSTATE int collecting;
+
+static void uartSend(uint8_t data){
+    cosimSend(PORT_UART, data);
+}
+
+static void uartReceived(int port, uint8_t data){
+    usartReceive(data);
+}
+
+/* Connects the USART of this MCU to the wires on PORT_UART, both ways. */
+void cosimUart(){
+    usartAttach(uartSend);
+    cosimReceiver(PORT_UART, uartReceived);
+}
+
+static void spiSelect(struct spidevice *device, int selected){
+}
+
+static uint8_t spiExchange(struct spidevice *device, uint8_t mosi){
+    cosimSend(PORT_SPI, mosi);
+    return miso;
+}
+
+static void spiAnswer(int port, uint8_t data){
+    miso = data;
+}
+
+static void spiClocked(int port, uint8_t mosi){
+    cosimSend(PORT_SPI, spiSlaveExchange(mosi));
+}
+
+/* Puts the wire on the SPI bus of this MCU, selected by pin of port (spiAttach()). Returns 0
+if the bus is full. */
+int cosimSpiMaster(int port, int pin){
+    spiWire.select = spiSelect;
+    spiWire.exchange = spiExchange;
+    miso = 0xFF;
+    cosimReceiver(PORT_SPI, spiAnswer);
+    spiDetach(&spiWire);
+    return spiAttach(&spiWire, port, pin);
+}
+
+/* Clocks the bytes coming on the wire into the SPI of this MCU, as a slave. */
+void cosimSpiSlave(){
+    cosimReceiver(PORT_SPI, spiClocked);
+}
+
+static int twiStart(struct twidevice *device, int read){
+    cosimSend(TWI_START, device->address << 1 | read);
+    return 1;
+}
+
+static int twiWrite(struct twidevice *device, uint8_t data){
+    cosimSend(TWI_DATA, data);
+    return 1;
+}
+
+static uint8_t twiRead(struct twidevice *device){
+    return 0xFF;
+}
+
+static void twiStop(struct twidevice *device){
+    cosimSend(TWI_STOP, 0);
+}
+
+static void twiPoll(uint64_t when);
+
+// Writes the complete transactions to the MCU in order, each once the one before is over
+static void twiNext(){
+    struct twitransfer *t;
+
+    while(ntransactions > collecting){
+        t = &transfers[first];
+        if(t->data == 0){
+            t->data = transactions[first];
+            if(!twiMaster(t)){
+                t->data = 0;
+                break;
+            }
+        }
+        if(!t->finished){
+            break;
+        }
+        first = (first + 1) % MAXTRANSACTIONS;
+        ntransactions--;
+    }
+
+    if(ntransactions > collecting){
+        schedule(twiPoll, CYCLES + TWIPOLL);
+    }
+}
+
+static void twiPoll(uint64_t when){
+    twiNext();
+}
+
+static void twiBus(int port, uint8_t data){
+    int last = (first + ntransactions + MAXTRANSACTIONS - 1) % MAXTRANSACTIONS;
+    struct twitransfer *t = &transfers[last];
+
+    if(port == TWI_START){
+        // A repeated START ends the transaction before it
+        collecting = !(data & 1) && ntransactions < MAXTRANSACTIONS;
+        if(collecting){
+            t = &transfers[(first + ntransactions++) % MAXTRANSACTIONS];
+            t->address = data >> 1;
+            t->read = 0;
+            t->data = 0;
+            t->length = 0;
+        }
+    }
+    else if(port == TWI_STOP){
+        collecting = 0;
+    }
+    else if(collecting && t->length < TRANSACTIONSIZE){
+        transactions[last][t->length++] = data;
+    }
+
+    twiNext();
+}
+
+/* Puts the wire on the TWI bus of this MCU at the 7 bit address (twiAttach()). Returns 0 if
+the bus is full. */
+int cosimTwiMaster(uint8_t address){
+    twiWire.address = address;
+    twiWire.start = twiStart;
+    twiWire.write = twiWrite;
+    twiWire.read = twiRead;
+    twiWire.stop = twiStop;
+    twiDetach(&twiWire);
+    return twiAttach(&twiWire);
+}
+
+/* Writes the transactions coming on the wire to this MCU, as a TWI slave. */
+void cosimTwiSlave(){
+    first = 0;
+    ntransactions = 0;
+    collecting = 0;
+    unschedule(twiPoll);
+    cosimReceiver(PORT_TWI, twiBus);
+}
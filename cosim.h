@@ -0,0 +1,57 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef COSIM_H
+#define COSIM_H
+
+#include <stdint.h>
+
+/* Co-simulation of several MCUs, one host thread each */
+
+#define MAXMCUS 64
+#define MAXPORTS 16
+
+/* Ports of the virtual wires. The high byte of a port is free for the bridges to tell
+messages apart: links and receivers only look at the low byte. */
+#define PORT_UART 0
+#define PORT_SPI 1
+#define PORT_TWI 2
+
+void cosimInit(int mcus, uint64_t quantum);
+int cosimConnect(int from, int to, int port, uint64_t latency);
+void cosimSetup(int mcu, void (*setup)(int mcu), void (*finish)(int mcu));
+void cosimRun(uint64_t cycles);
+
+/* For hosts with their own threads (simulador.c) */
+int cosimMCUs();
+void cosimBegin(uint64_t cycles);
+void cosimEnd();
+
+/* Called from the thread of an MCU */
+int cosimMCU();
+int cosimSend(int port, uint8_t data);
+void cosimReceiver(int port, void (*receive)(int port, uint8_t data));
+void cosimLoop(int mcu, void (*runTo)(uint64_t end));
+void cosimDrop();
+void cosimUart();
+int cosimSpiMaster(int port, int pin);
+void cosimSpiSlave();
+int cosimTwiMaster(uint8_t address);
+void cosimTwiSlave();
+
+#endif
@@ -0,0 +1,260 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "coverage.h"
+#include "functions.h"
+#include "elf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+The decoder sets the EXECUTED bit of every instruction it executes and the TAKEN or
+NOTTAKEN bit of every BRBS/BRBC (all the BRxx aliases) it executes: one OR each. Loops run
+on the host (idioms.c, busywait.c) mark their instructions, and their backward branch as
+taken. The maps add up over reset() until coverageClear().
+
+coverageSave() writes the maps to a file and coverageMerge() ORs such a file into them,
+so the maps of runs done in parallel can be put together. coverageLcov() writes an lcov
+tracefile (genhtml, lcov --summary) with line and branch coverage, using the DWARF line
+table of the ELF file of the firmware, which must be the one in FLASH.
+*/
+
+#define COVERAGE_MAGIC 0x52564F43       // "COVR"
+#define COVERAGE_VERSION 1
+
+MCUSTATE uint8_t EXECUTED[FLASHSIZE / 8];
+MCUSTATE uint8_t TAKEN[FLASHSIZE / 8];
+MCUSTATE uint8_t NOTTAKEN[FLASHSIZE / 8];
+
+struct header{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t words;
+    uint32_t reserved;
+};
+
+// Instruction at a source line, collected from the line table
+struct record{
+    int file;
+    uint32_t line;
+    pc_t word;
+};
+
+static MCUSTATE struct record *records;
+static MCUSTATE int nrecords, maxrecords;
+static MCUSTATE char **files;
+static MCUSTATE int nfiles;
+
+static int isBranch(uint16_t opcode){
+    return (opcode & 0xF800) == 0xF000;
+}
+
+void coverageClear(){
+    memset(EXECUTED, 0, sizeof(EXECUTED));
+    memset(TAKEN, 0, sizeof(TAKEN));
+    memset(NOTTAKEN, 0, sizeof(NOTTAKEN));
+}
+
+/* Marks the loop at pc, after it ran on the host: its instructions up to the branch or jump
+back, and the branch as taken. */
+void coverLoop(pc_t pc){
+    int i;
+
+    for(i = 0; i < 4 && pc < FLASHSIZE; i++){
+        uint16_t opcode = FLASH[pc];
+
+        COVER(EXECUTED, pc);
+        if(isBranch(opcode)){
+            COVER(TAKEN, pc);
+            return;
+        }
+        if((opcode & 0xF000) == 0xC000){
+            return;
+        }
+        pc += isTwoWord(opcode) ? 2 : 1;
+    }
+}
+
+/* Writes the maps to path. Returns 0 on failure. */
+int coverageSave(const char *path){
+    struct header h = {COVERAGE_MAGIC, COVERAGE_VERSION, FLASHSIZE, 0};
+    FILE *f = fopen(path, "wb");
+    int ok;
+
+    if(f == 0){
+        return 0;
+    }
+    ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(EXECUTED, sizeof(EXECUTED), 1, f) == 1 &&
+         fwrite(TAKEN, sizeof(TAKEN), 1, f) == 1 && fwrite(NOTTAKEN, sizeof(NOTTAKEN), 1, f) == 1;
+
+    return fclose(f) == 0 && ok;
+}
+
+/* Adds the maps saved in path to the current ones. Returns 0 on failure. */
+int coverageMerge(const char *path){
+    uint8_t maps[3][FLASHSIZE / 8];
+    struct header h;
+    FILE *f = fopen(path, "rb");
+    int i, ok;
+
+    if(f == 0){
+        return 0;
+    }
+    ok = fread(&h, sizeof(h), 1, f) == 1 && h.magic == COVERAGE_MAGIC && h.version == COVERAGE_VERSION &&
+         h.words == FLASHSIZE && fread(maps, sizeof(maps), 1, f) == 1;
+    fclose(f);
+    if(!ok){
+        return 0;
+    }
+
+    for(i = 0; i < FLASHSIZE / 8; i++){
+        EXECUTED[i] |= maps[0][i];
+        TAKEN[i] |= maps[1][i];
+        NOTTAKEN[i] |= maps[2][i];
+    }
+
+    return 1;
+}
+
+static int fileIndex(const char *name){
+    int i;
+
+    for(i = nfiles - 1; i >= 0; i--){
+        if(strcmp(files[i], name) == 0){
+            return i;
+        }
+    }
+
+    files = realloc(files, (nfiles + 1) * sizeof(char *));
+    files[nfiles] = strdup(name);
+
+    return nfiles++;
+}
+
+// Line table row: one record per instruction of the range
+static void addRow(const char *file, uint32_t line, uint32_t start, uint32_t end){
+    int index = fileIndex(file);
+    uint32_t word = start / 2;
+
+    while(word < end / 2 && word < FLASHSIZE){
+        if(nrecords == maxrecords){
+            maxrecords = maxrecords ? 2 * maxrecords : 4096;
+            records = realloc(records, maxrecords * sizeof(struct record));
+        }
+        records[nrecords].file = index;
+        records[nrecords].line = line;
+        records[nrecords].word = word;
+        nrecords++;
+
+        word += isTwoWord(FLASH[word]) ? 2 : 1;
+    }
+}
+
+static int compareRecords(const void *a, const void *b){
+    const struct record *x = a, *y = b;
+
+    if(x->file != y->file){
+        return x->file < y->file ? -1 : 1;
+    }
+    if(x->line != y->line){
+        return x->line < y->line ? -1 : 1;
+    }
+    return x->word < y->word ? -1 : x->word > y->word;
+}
+
+static void writeLcov(FILE *f, const char *test){
+    int i = 0;
+
+    while(i < nrecords){
+        int file = records[i].file;
+        int lines = 0, linesHit = 0, branches = 0, branchesHit = 0;
+
+        fprintf(f, "TN:%s\nSF:%s\n", test ? test : "", files[file]);
+
+        while(i < nrecords && records[i].file == file){
+            uint32_t line = records[i].line;
+            int hit = 0, block = 0;
+            int j;
+
+            for(j = i; j < nrecords && records[j].file == file && records[j].line == line; j++){
+                pc_t word = records[j].word;
+
+                if(j > i && word == records[j - 1].word){
+                    continue;
+                }
+                hit |= COVERED(EXECUTED, word);
+
+                if(isBranch(FLASH[word])){
+                    if(COVERED(EXECUTED, word)){
+                        fprintf(f, "BRDA:%u,%d,0,%d\nBRDA:%u,%d,1,%d\n", line, block, COVERED(TAKEN, word), line, block, COVERED(NOTTAKEN, word));
+                        branchesHit += COVERED(TAKEN, word) + COVERED(NOTTAKEN, word);
+                    }
+                    else{
+                        fprintf(f, "BRDA:%u,%d,0,-\nBRDA:%u,%d,1,-\n", line, block, line, block);
+                    }
+                    branches += 2;
+                    block++;
+                }
+            }
+
+            fprintf(f, "DA:%u,%d\n", line, hit);
+            lines++;
+            linesHit += hit;
+            i = j;
+        }
+
+        fprintf(f, "BRF:%d\nBRH:%d\nLF:%d\nLH:%d\nend_of_record\n", branches, branchesHit, lines, linesHit);
+    }
+}
+
+/* Writes the coverage of the program in FLASH, built as elfPath, to the lcov tracefile path.
+Returns 0 if the ELF file has no line table or path cannot be written. */
+int coverageLcov(const char *elfPath, const char *path, const char *test){
+    struct elf elf;
+    FILE *f;
+    int i, ok;
+
+    if(!elfOpen(elfPath, &elf)){
+        return 0;
+    }
+    nrecords = 0;
+    ok = elfLines(&elf, addRow);
+    elfClose(&elf);
+
+    f = ok ? fopen(path, "w") : 0;
+    if(f){
+        qsort(records, nrecords, sizeof(struct record), compareRecords);
+        writeLcov(f, test);
+        ok = fclose(f) == 0;
+    }
+    else{
+        ok = 0;
+    }
+
+    for(i = 0; i < nfiles; i++){
+        free(files[i]);
+    }
+    free(files);
+    free(records);
+    files = 0;
+    records = 0;
+    nfiles = nrecords = maxrecords = 0;
+
+    return ok;
+}
@@ -0,0 +1,36 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+#include "registers.h"
+
+/* Code coverage, one bit per flash word */
+
+extern MCUSTATE uint8_t EXECUTED[FLASHSIZE / 8];
+extern MCUSTATE uint8_t TAKEN[FLASHSIZE / 8];
+extern MCUSTATE uint8_t NOTTAKEN[FLASHSIZE / 8];
+
+#define COVER(map, word) ((map)[(word) >> 3] |= 1 << ((word) & 7))
+#define COVERED(map, word) (((map)[(word) >> 3] >> ((word) & 7)) & 1)
+
+void coverageClear();
+void coverLoop(pc_t pc);
+int coverageSave(const char *path);
+int coverageMerge(const char *path);
+int coverageLcov(const char *elfPath, const char *path, const char *test);
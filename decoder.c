@@ -0,0 +1,658 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "decoder.h"
+#include "instruction_set.h"
+#include "idioms.h"
+#include "registers.h"
+#include "functions.h"
+#include "scheduler.h"
+#include "interrupts.h"
+#include "timer0.h"
+#include "busywait.h"
+#include "usart.h"
+#include "gpio.h"
+#include "spi.h"
+#include "twi.h"
+#include "adc.h"
+#include "eeprom.h"
+#include "spm.h"
+#include "stats.h"
+#include "coverage.h"
+#include "flash.h"
+#include "snapshot.h"
+#include "sram.h"
+#include "replay.h"
+#include "native.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+The decoder matches the opcode fetched from FLASH[PC] against the encodings listed
+on each instruction of instruction_set.c and calls the matching function. Aliases
+(LSL, TST, CLR, SBR, CBR, BRxx, SEx, CLx) share the encoding of the base instruction,
+so only the base instruction is decoded.
+
+Cycle counts are the ones of the ATmega328p instruction set summary.
+*/
+
+// 7 bit two's complement offset of the conditional branches, bits 9..3
+static int branchOffset(uint16_t opcode){
+    int k = (opcode >> 3) & 0x7F;
+
+    if(k & 0x40){
+        k -= 128;
+    }
+
+    return k;
+}
+
+/*
+What starts at each flash word, as far as idioms.c and busywait.c are concerned. It is
+found the first time the word is executed, or for every word at once when a shared image
+is made (deriveFlash()), and only depends on FLASH, so step() does not have to match the
+loop patterns again on every instruction. Anything that changes FLASH must call
+invalidateFlash() on the words it changed. The table, LOOPKIND, lives next to FLASH
+(flash.c).
+*/
+#define UNKNOWN 0
+#define PLAIN 1
+#define IDIOM 2
+#define BUSYWAIT 3
+
+// longest loop pattern, in words
+#define PATTERNSIZE 4
+
+/* Forgets what was derived from the count flash words starting at first. A loop pattern that
+starts up to three words before first reads them too. Only words already derived are
+written, so the pages of LOOPKIND nothing was derived on stay shared (flash.c). */
+void invalidateFlash(pc_t first, pc_t count){
+    int i = first < PATTERNSIZE - 1 ? 0 : first - (PATTERNSIZE - 1);
+
+    if(first + count > FLASHSIZE){
+        count = FLASHSIZE - first;
+    }
+    for(; i < first + count; i++){
+        if(LOOPKIND[i] != UNKNOWN){
+            LOOPKIND[i] = UNKNOWN;
+        }
+    }
+}
+
+static uint8_t loopKindAt(pc_t pc){
+    return idiomAt(pc) ? IDIOM : busyWaitAt(pc) ? BUSYWAIT : PLAIN;
+}
+
+/* Derives what starts at every flash word, so that step() never writes LOOPKIND. */
+void deriveFlash(){
+    int pc;
+
+    for(pc = 0; pc < FLASHSIZE; pc++){
+        LOOPKIND[pc] = loopKindAt(pc);
+    }
+}
+
+/* Marks every flash word as plain code, so that step() executes the idioms and busy-wait
+loops one instruction at a time, as the accelerated runs are compared against. Undone by
+invalidateFlash(). */
+void plainFlash(){
+    int pc;
+
+    for(pc = 0; pc < FLASHSIZE; pc++){
+        LOOPKIND[pc] = PLAIN;
+    }
+}
+
+static MCUSTATE opcodeHandler invalidOpcode;
+
+/* Makes an invalid opcode call handler, with PC still on it, instead of ending the program.
+Cleared by reset(). Returns the handler it replaces. */
+opcodeHandler onInvalidOpcode(opcodeHandler handler){
+    opcodeHandler previous = invalidOpcode;
+
+    invalidOpcode = handler;
+    return previous;
+}
+
+/* An opcode the decoder does not know, or one this device does not have: the handler of
+onInvalidOpcode(), if there is one, otherwise the end of the program. */
+static void invalid(uint16_t opcode){
+    if(invalidOpcode){
+        invalidOpcode(opcode);
+        return;
+    }
+    printf("INVALID OPCODE %04X AT %04X.", opcode, PC);
+    exit(1);
+}
+
+/* Puts the MCU in its reset state and connects the peripherals. */
+void reset(){
+    int i;
+
+    replayStop();
+    clearState();
+    keepState(R, sizeof(R));
+    keepState(&SREG, sizeof(SREG));
+    keepState(&PC, sizeof(PC));
+    keepState(DATA, sizeof(DATA));
+    keepState(&CYCLES, sizeof(CYCLES));
+    keepState(&SLEEPING, sizeof(SLEEPING));
+    keepState(&ILAST, sizeof(ILAST));
+    keepState(&DEPTH, sizeof(DEPTH));
+
+    for(i = 0; i < 32; i++){
+        R[i] = 0;
+    }
+    for(i = 0; i < DATASIZE; i++){
+        DATA[i] = 0;
+    }
+    setSREG(0);
+    setSP(RAMEND);
+    PC = 0;
+    CYCLES = 0;
+    SLEEPING = 0;
+    ILAST = 0;
+    DEPTH = 0;
+    invalidOpcode = 0;
+    onStackCollision(0);
+
+    clearEvents();
+    clearIOHandlers();
+    clearInterrupts();
+    initFlash();
+
+    initTimer0();
+    initUsart();
+    initGpio();
+    initSpi();
+    initTwi();
+    initAdc();
+    initEeprom();
+    initSpm();
+}
+
+/* Executes the instruction at PC and returns the number of cycles it took, including the
+peripheral events and the interrupt that came before it.
+
+While sleeping, no instruction is executed: CYCLES jumps to the next event, which may
+request the interrupt that wakes the MCU. If nothing is scheduled, the MCU sleeps forever
+and step() returns 0. */
+uint64_t step(){
+    uint64_t start = CYCLES;
+    uint64_t cycles;
+
+    if(NEXTEVENT <= CYCLES){
+        runEvents();
+    }
+
+    if(SLEEPING){
+        if(!canWake()){
+            if(NEXTEVENT == NEVER){
+                return 0;
+            }
+            if(STATS){
+                COUNT(STATS->sleepCycles, NEXTEVENT - CYCLES);
+                atomic_store_explicit(&STATS->cycles, NEXTEVENT, memory_order_relaxed);
+            }
+            CYCLES = NEXTEVENT;
+            runEvents();
+            return CYCLES - start;
+        }
+        serviceInterrupt();
+        ILAST = 0;
+        return CYCLES - start;
+    }
+
+    if(IRQ && SREG.I && ILAST){
+        serviceInterrupt();
+        ILAST = 0;
+        return CYCLES - start;
+    }
+    ILAST = SREG.I;
+
+    PC = PC % FLASHSIZE;
+
+    if(LOOPKIND[PC] == UNKNOWN){
+        LOOPKIND[PC] = loopKindAt(PC);
+    }
+
+    // An interrupt held back by SEI or RETI is taken after this one instruction, not after the loop
+    int held = IRQ && SREG.I;
+
+    if(NATIVECALLS && !held){
+        cycles = nativeCall(NEXTEVENT - CYCLES);
+        if(cycles){
+            return cycles;
+        }
+    }
+
+    cycles = 0;
+    if(LOOPKIND[PC] == IDIOM && !held){
+        cycles = acceleratedIdiom(NEXTEVENT - CYCLES);
+    }
+    else if(LOOPKIND[PC] == BUSYWAIT && !held){
+        cycles = skipBusyWait(NEXTEVENT - CYCLES);
+    }
+    if(cycles){
+        CYCLES += cycles;
+        coverLoop(PC);
+        if(STATS){
+            COUNT(STATS->skippedCycles, cycles);
+            atomic_store_explicit(&STATS->cycles, CYCLES, memory_order_relaxed);
+        }
+        return cycles;
+    }
+
+    uint16_t opcode = FLASH[PC];
+    uint16_t next = FLASH[(PC + 1) % FLASHSIZE];
+
+    COVER(EXECUTED, PC);
+
+    int d = (opcode >> 4) & 0x1F;
+    int r = ((opcode >> 5) & 0x10) | (opcode & 0x0F);
+    uint8_t K = ((opcode >> 4) & 0xF0) | (opcode & 0x0F);
+    int d16 = 16 + ((opcode >> 4) & 0x0F);
+
+    cycles = 1;
+
+    if(opcode == 0x0000){
+        NOP();
+    }
+    else if((opcode & 0xFF00) == 0x0100){
+        MOVW((opcode >> 3) & 0x1E, (opcode << 1) & 0x1E);
+    }
+    else if((opcode & 0xFF00) == 0x0200){
+        MULS(16 + ((opcode >> 4) & 0x0F), 16 + (opcode & 0x0F));
+        cycles = 2;
+    }
+    else if((opcode & 0xFF00) == 0x0300){
+        // MULSU, FMUL, FMULS, FMULSU, 0000 0011 fddd frrr
+        int d8 = 16 + ((opcode >> 4) & 0x07);
+        int r8 = 16 + (opcode & 0x07);
+
+        switch(opcode & 0x0088){
+        case 0x0000:
+            MULSU(d8, r8);
+            break;
+        case 0x0008:
+            FMUL(d8, r8, 0, 0);
+            break;
+        case 0x0080:
+            FMUL(d8, r8, 1, 1);
+            break;
+        default:
+            FMUL(d8, r8, 1, 0);
+        }
+        cycles = 2;
+    }
+    else if((opcode & 0xFC00) == 0x0400){
+        CPC(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x0800){
+        SBC(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x0C00){
+        ADD(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x1000){
+        pc_t pc = PC;
+
+        CPSE(d, r);
+        cycles = PC - pc;
+    }
+    else if((opcode & 0xFC00) == 0x1400){
+        CP(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x1800){
+        SUB(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x1C00){
+        ADC(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x2000){
+        AND(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x2400){
+        EOR(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x2800){
+        OR(d, r);
+    }
+    else if((opcode & 0xFC00) == 0x2C00){
+        MOV(d, r);
+    }
+    else if((opcode & 0xF000) == 0x3000){
+        CPI(d16, K);
+    }
+    else if((opcode & 0xF000) == 0x4000){
+        SBCI(d16, K);
+    }
+    else if((opcode & 0xF000) == 0x5000){
+        SUBI(d16, K);
+    }
+    else if((opcode & 0xF000) == 0x6000){
+        SBR(d16, K);
+    }
+    else if((opcode & 0xF000) == 0x7000){
+        ANDI(d16, K);
+    }
+    else if((opcode & 0xF000) == 0xE000){
+        LDI(d16, K);
+    }
+    else if((opcode & 0xD000) == 0x8000){
+        // LDD/STD, 10q0 qqsd dddd yqqq
+        int q = ((opcode >> 8) & 0x20) | ((opcode >> 7) & 0x18) | (opcode & 0x07);
+        int p = (opcode & 0x0008) ? REGY : REGZ;
+
+        if(opcode & 0x0200){
+            STD(d, p, q);
+        }
+        else{
+            LDD(d, p, q);
+        }
+        cycles = 2;
+    }
+    else if((opcode & 0xFC00) == 0x9000){
+        // LD/ST/LDS/STS/LPM/ELPM, 1001 00sd dddd oooo
+        int store = opcode & 0x0200;
+
+        switch(opcode & 0x000F){
+        case 0x0:
+            if(store){
+                STS(next, d);
+            }
+            else{
+                LDS(d, next);
+            }
+            cycles = 2;
+            break;
+        case 0x1:
+        case 0x2:
+        case 0x9:
+        case 0xA:
+        case 0xC:
+        case 0xD:
+        case 0xE:
+        {
+            int p = (opcode & 0x000C) == 0x000C ? REGX : ((opcode & 0x0008) ? REGY : REGZ);
+            int mode = (opcode & 0x0003) == 0x0001 ? POSTINC : ((opcode & 0x0003) == 0x0002 ? PREDEC : UNCHANGED);
+
+            if(store){
+                ST(d, p, mode);
+            }
+            else{
+                LD(d, p, mode);
+            }
+            cycles = 2;
+            break;
+        }
+        case 0x4:
+        case 0x5:
+            if(store){
+                invalid(opcode);
+                break;
+            }
+            LPM(d, opcode & 0x0001);
+            cycles = 3;
+            break;
+        case 0x6:
+        case 0x7:
+            if(store){
+                invalid(opcode);
+                break;
+            }
+            ELPM(d, opcode & 0x0001);
+            cycles = 3;
+            break;
+        case 0xF:
+            if(store){
+                PUSH(d);
+            }
+            else{
+                POP(d);
+            }
+            cycles = 2;
+            break;
+        default:
+            invalid(opcode);
+        }
+    }
+    else if(opcode == 0x95C8){
+        LPM(0, 0);
+        cycles = 3;
+    }
+    else if(opcode == 0x95D8){
+        ELPM(0, 0);
+        cycles = 3;
+    }
+    else if(opcode == 0x95A8){
+        WDR();
+    }
+    else if((opcode & 0xFF8F) == 0x9408){
+        BSET((opcode >> 4) & 0x07);
+    }
+    else if((opcode & 0xFF8F) == 0x9488){
+        BCLR((opcode >> 4) & 0x07);
+    }
+    else if((opcode & 0xFE0E) == 0x940C){
+        JMP((((opcode >> 3) & 0x3E) | (opcode & 0x01)) << 16 | next);
+        cycles = 3;
+    }
+    else if((opcode & 0xFE0E) == 0x940E){
+        CALL((((opcode >> 3) & 0x3E) | (opcode & 0x01)) << 16 | next);
+        cycles = 2 + PCBYTES;
+    }
+    else if(opcode == 0x9508){
+        RET();
+        cycles = 2 + PCBYTES;
+    }
+    else if(opcode == 0x9518){
+        RETI();
+        cycles = 2 + PCBYTES;
+    }
+    else if(opcode == 0x9409){
+        IJMP();
+        cycles = 2;
+    }
+    else if(opcode == 0x9509){
+        ICALL();
+        cycles = 1 + PCBYTES;
+    }
+#if HAS_EIND
+    else if(opcode == 0x9419){
+        EIJMP();
+        cycles = 2;
+    }
+    else if(opcode == 0x9519){
+        EICALL();
+        cycles = 4;
+    }
+#endif
+    else if(opcode == 0x9588){
+        SLEEP();
+    }
+    else if(opcode == 0x95E8){
+        SPM();
+    }
+    else if((opcode & 0xFE00) == 0x9400){
+        // One operand instructions, 1001 010d dddd oooo
+        switch(opcode & 0x000F){
+        case 0x0:
+            COM(d);
+            break;
+        case 0x1:
+            NEG(d);
+            break;
+        case 0x3:
+            INC(d);
+            break;
+        case 0x6:
+            LSR(d);
+            break;
+        case 0x2:
+            SWAP(d);
+            break;
+        case 0x5:
+            ASR(d);
+            break;
+        case 0x7:
+            ROR(d);
+            break;
+        case 0xA:
+            DEC(d);
+            break;
+        default:
+            invalid(opcode);
+        }
+    }
+    else if((opcode & 0xFF00) == 0x9600){
+        ADIW(24 + ((opcode >> 3) & 0x06), ((opcode >> 2) & 0x30) | (opcode & 0x0F));
+        cycles = 2;
+    }
+    else if((opcode & 0xFF00) == 0x9700){
+        SBIW(24 + ((opcode >> 3) & 0x06), ((opcode >> 2) & 0x30) | (opcode & 0x0F));
+        cycles = 2;
+    }
+    else if((opcode & 0xFC00) == 0x9C00){
+        MUL(d, r);
+        cycles = 2;
+    }
+    else if((opcode & 0xFF00) == 0x9800){
+        CBI((opcode >> 3) & 0x1F, opcode & 0x07);
+        cycles = 2;
+    }
+    else if((opcode & 0xFF00) == 0x9A00){
+        SBI((opcode >> 3) & 0x1F, opcode & 0x07);
+        cycles = 2;
+    }
+    else if((opcode & 0xFD00) == 0x9900){
+        // SBIC/SBIS take 1 cycle, 2 or 3 if the next instruction is skipped
+        pc_t pc = PC;
+
+        if(opcode & 0x0200){
+            SBIS((opcode >> 3) & 0x1F, opcode & 0x07);
+        }
+        else{
+            SBIC((opcode >> 3) & 0x1F, opcode & 0x07);
+        }
+        cycles = PC - pc;
+    }
+    else if((opcode & 0xF000) == 0xB000){
+        int A = ((opcode >> 5) & 0x30) | (opcode & 0x0F);
+
+        if(opcode & 0x0800){
+            OUT(A, d);
+        }
+        else{
+            IN(d, A);
+        }
+    }
+    else if((opcode & 0xF000) == 0xC000){
+        int k = opcode & 0x0FFF;
+
+        if(k & 0x0800){
+            k -= 4096;
+        }
+        RJMP(k);
+        cycles = 2;
+    }
+    else if((opcode & 0xF000) == 0xD000){
+        int k = opcode & 0x0FFF;
+
+        if(k & 0x0800){
+            k -= 4096;
+        }
+        RCALL(k);
+        cycles = 1 + PCBYTES;
+    }
+    else if((opcode & 0xFC00) == 0xF000 || (opcode & 0xFC00) == 0xF400){
+        // Taken or not is the flag, not where PC ends up: BRxx .+0 goes to the next word either way
+        pc_t pc = PC;
+        int taken = getSREGflag(opcode & 0x07) == !(opcode & 0x0400);
+
+        if(opcode & 0x0400){
+            BRBC(opcode & 0x07, branchOffset(opcode));
+        }
+        else{
+            BRBS(opcode & 0x07, branchOffset(opcode));
+        }
+        if(taken){
+            cycles = 2;
+            COVER(TAKEN, pc);
+        }
+        else{
+            COVER(NOTTAKEN, pc);
+        }
+        if(STATS){
+            if(taken){
+                COUNT(STATS->taken[(opcode & 0x07) | ((opcode >> 7) & 0x08)], 1);
+            }
+            else{
+                COUNT(STATS->notTaken[(opcode & 0x07) | ((opcode >> 7) & 0x08)], 1);
+            }
+        }
+    }
+    else if((opcode & 0xFE08) == 0xF800){
+        BLD(d, opcode & 0x07);
+    }
+    else if((opcode & 0xFE08) == 0xFA00){
+        BST(d, opcode & 0x07);
+    }
+    else if((opcode & 0xFC08) == 0xFC00){
+        pc_t pc = PC;
+
+        if(opcode & 0x0200){
+            SBRS(d, opcode & 0x07);
+        }
+        else{
+            SBRC(d, opcode & 0x07);
+        }
+        cycles = PC - pc;
+    }
+    else{
+        invalid(opcode);
+    }
+
+    CYCLES += cycles;
+
+    if(STATS){
+        COUNT(STATS->instructions, 1);
+        COUNT(STATS->opcodes[opcode], 1);
+        atomic_store_explicit(&STATS->cycles, CYCLES, memory_order_relaxed);
+    }
+
+    return CYCLES - start;
+}
+
+// Marks the end of run(), so sleeping and skipped loops stop there
+static void endOfRun(uint64_t when){
+}
+
+/* Runs instructions until at least the given number of cycles has elapsed. A sleeping
+MCU jumps from event to event, and stops exactly at the end if none comes before it. */
+void run(uint64_t cycles){
+    uint64_t end = CYCLES + cycles;
+
+    schedule(endOfRun, end);
+    while(CYCLES < end){
+        step();
+    }
+    unschedule(endOfRun);
+
+    flushPins();
+}
@@ -0,0 +1,33 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+#include "registers.h"
+
+/* Fetch, decode and execute */
+
+void reset();
+uint64_t step();
+void run(uint64_t cycles);
+void invalidateFlash(pc_t first, pc_t count);
+void deriveFlash();
+void plainFlash();
+typedef void (*opcodeHandler)(uint16_t opcode);
+
+opcodeHandler onInvalidOpcode(opcodeHandler handler);
@@ -0,0 +1,208 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef DEVICE_H
+#define DEVICE_H
+
+/*
+The simulated device, chosen when building: -DATMEGA168, -DATMEGA2560, or nothing for the
+ATmega328P. Everything the core needs to know about it is a constant, so address masks,
+sizes and the width of return addresses are folded in by the compiler and a build only
+has the code of its device.
+
+    FLASHSIZE       program memory, in 16 bit words
+    DATASIZE        data space: registers, I/O, extended I/O and SRAM
+    SRAMSTART       first SRAM address, after the extended I/O
+    RAMEND          last SRAM address
+    EEPROMSIZE      EEPROM bytes
+    PCWIDTH         bits of the Program Counter
+    PCBYTES         bytes of a return address on the stack (3 on devices with a 22 bit PC)
+    PAGESIZE        flash page, in words
+    BOOTSTART       first word of the Boot Loader section, for the largest one (BOOTSZ = 00)
+    HAS_RAMPZ       RAMPZ extends Z for ELPM and SPM
+    HAS_EIND        EIND extends Z for EIJMP and EICALL
+    SPI_SS          bit of the SPI slave select pin in port B
+    NPORTS          I/O ports, from port B on (gpio.h): B, C, D and E on the ATmega2560
+    NEXTINT         external interrupts INT0 to INTn; the vector of INTn is INT0_vect + n
+    EXTINT_PINS     the pin of each, as port << 3 | bit with the ports numbered as in gpio.h
+    NVECTORS        interrupt vectors, reset included; each is VECTORSIZE words
+
+followed by the numbers of the vectors, from the datasheet of each device.
+*/
+
+#if defined(ATMEGA168)
+
+#define DEVICE_NAME "ATmega168"
+#define FLASHSIZE 8192          // 16KB
+#define DATASIZE 1280           // 32 registers + 64 I/O + 160 ext I/O + 1024 SRAM
+#define SRAMSTART 0x0100
+#define RAMEND 0x04FF
+#define EEPROMSIZE 512
+#define PCWIDTH 13
+#define PCBYTES 2
+#define PAGESIZE 64
+#define BOOTSTART 0x1C00
+#define HAS_RAMPZ 0
+#define HAS_EIND 0
+#define SPI_SS 2
+#define NPORTS 3
+#define NEXTINT 2
+#define EXTINT_PINS {2 << 3 | 2, 2 << 3 | 3}                // PD2, PD3
+
+#elif defined(ATMEGA2560)
+
+#define DEVICE_NAME "ATmega2560"
+#define FLASHSIZE 131072        // 256KB
+#define DATASIZE 8704           // 32 registers + 64 I/O + 416 ext I/O + 8192 SRAM
+#define SRAMSTART 0x0200
+#define RAMEND 0x21FF
+#define EEPROMSIZE 4096
+#define PCWIDTH 17
+#define PCBYTES 3
+#define PAGESIZE 128
+#define BOOTSTART 0x1F000
+#define HAS_RAMPZ 1
+#define HAS_EIND 1
+#define SPI_SS 0
+#define NPORTS 4
+#define NEXTINT 8
+#define EXTINT_PINS {2 << 3 | 0, 2 << 3 | 1, 2 << 3 | 2, 2 << 3 | 3, \
+                     3 << 3 | 4, 3 << 3 | 5, 3 << 3 | 6, 3 << 3 | 7}   // PD0-PD3, PE4-PE7
+
+#else
+
+#define ATMEGA328P
+#define DEVICE_NAME "ATmega328P"
+#define FLASHSIZE 16384         // 32KB
+#define DATASIZE 2304           // 32 registers + 64 I/O + 160 ext I/O + 2048 SRAM
+#define SRAMSTART 0x0100
+#define RAMEND 0x08FF
+#define EEPROMSIZE 1024
+#define PCWIDTH 14
+#define PCBYTES 2
+#define PAGESIZE 64
+#define BOOTSTART 0x3800
+#define HAS_RAMPZ 0
+#define HAS_EIND 0
+#define SPI_SS 2
+#define NPORTS 3
+#define NEXTINT 2
+#define EXTINT_PINS {2 << 3 | 2, 2 << 3 | 3}                // PD2, PD3
+
+#endif
+
+#define VECTORSIZE 2
+
+/* Interrupt vectors, in priority order */
+#if defined(ATMEGA2560)
+
+#define INT0_vect 1
+#define INT1_vect 2
+#define INT2_vect 3
+#define INT3_vect 4
+#define INT4_vect 5
+#define INT5_vect 6
+#define INT6_vect 7
+#define INT7_vect 8
+#define PCINT0_vect 9
+#define PCINT1_vect 10
+#define PCINT2_vect 11
+#define WDT_vect 12
+#define TIMER2_COMPA_vect 13
+#define TIMER2_COMPB_vect 14
+#define TIMER2_OVF_vect 15
+#define TIMER1_CAPT_vect 16
+#define TIMER1_COMPA_vect 17
+#define TIMER1_COMPB_vect 18
+#define TIMER1_COMPC_vect 19
+#define TIMER1_OVF_vect 20
+#define TIMER0_COMPA_vect 21
+#define TIMER0_COMPB_vect 22
+#define TIMER0_OVF_vect 23
+#define SPI_STC_vect 24
+#define USART0_RX_vect 25
+#define USART0_UDRE_vect 26
+#define USART0_TX_vect 27
+#define ANALOG_COMP_vect 28
+#define ADC_vect 29
+#define EE_READY_vect 30
+#define TIMER3_CAPT_vect 31
+#define TIMER3_COMPA_vect 32
+#define TIMER3_COMPB_vect 33
+#define TIMER3_COMPC_vect 34
+#define TIMER3_OVF_vect 35
+#define USART1_RX_vect 36
+#define USART1_UDRE_vect 37
+#define USART1_TX_vect 38
+#define TWI_vect 39
+#define SPM_READY_vect 40
+#define TIMER4_CAPT_vect 41
+#define TIMER4_COMPA_vect 42
+#define TIMER4_COMPB_vect 43
+#define TIMER4_COMPC_vect 44
+#define TIMER4_OVF_vect 45
+#define TIMER5_CAPT_vect 46
+#define TIMER5_COMPA_vect 47
+#define TIMER5_COMPB_vect 48
+#define TIMER5_COMPC_vect 49
+#define TIMER5_OVF_vect 50
+#define USART2_RX_vect 51
+#define USART2_UDRE_vect 52
+#define USART2_TX_vect 53
+#define USART3_RX_vect 54
+#define USART3_UDRE_vect 55
+#define USART3_TX_vect 56
+#define NVECTORS 57
+
+// USART0 is the USART of the ATmega328P (usart.c)
+#define USART_RX_vect USART0_RX_vect
+#define USART_UDRE_vect USART0_UDRE_vect
+#define USART_TX_vect USART0_TX_vect
+
+#else
+
+#define INT0_vect 1
+#define INT1_vect 2
+#define PCINT0_vect 3
+#define PCINT1_vect 4
+#define PCINT2_vect 5
+#define WDT_vect 6
+#define TIMER2_COMPA_vect 7
+#define TIMER2_COMPB_vect 8
+#define TIMER2_OVF_vect 9
+#define TIMER1_CAPT_vect 10
+#define TIMER1_COMPA_vect 11
+#define TIMER1_COMPB_vect 12
+#define TIMER1_OVF_vect 13
+#define TIMER0_COMPA_vect 14
+#define TIMER0_COMPB_vect 15
+#define TIMER0_OVF_vect 16
+#define SPI_STC_vect 17
+#define USART_RX_vect 18
+#define USART_UDRE_vect 19
+#define USART_TX_vect 20
+#define ADC_vect 21
+#define EE_READY_vect 22
+#define ANALOG_COMP_vect 23
+#define TWI_vect 24
+#define SPM_READY_vect 25
+#define NVECTORS 26
+
+#endif
+
+#endif
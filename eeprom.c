@@ -0,0 +1,199 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "eeprom.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+1KB EEPROM.
+
+A write starts when EEPE is written to one while EEMPE is set; EEMPE clears itself four
+cycles after being set. The programming mode in EEPM1:0 selects erase and write (3.4 ms),
+erase only or write only (1.8 ms). The write is one scheduled event at its end, where the
+byte changes and EEPE is cleared. Setting EERE reads EEAR into EEDR. The CPU is halted 2
+cycles when a write starts and 4 cycles on a read.
+
+The contents can be a host file mapped with MAP_SHARED (eepromOpen), so they persist from
+run to run and can be read or pre-seeded with any tool. A new file is created erased
+(all $FF). Without a file the contents are in memory. They are not changed by reset().
+*/
+
+#define EEPM 0x30
+
+static MCUSTATE uint8_t internal[EEPROMSIZE];
+static MCUSTATE uint8_t *contents;
+static MCUSTATE uint16_t writeAddress;
+static MCUSTATE uint8_t writeData;
+static MCUSTATE uint8_t writeMode;
+
+static uint16_t address(){
+    return ((DATA[EEARH] << 8) | DATA[EEARL]) & (EEPROMSIZE - 1);
+}
+
+static void clearEEMPE(uint64_t when){
+    DATA[EECR] &= ~(1 << EEMPE);
+}
+
+static void writeDone(uint64_t when){
+    switch(writeMode){
+    case 0x00:
+        contents[writeAddress] = writeData;
+        break;
+    case 0x10:
+        contents[writeAddress] = 0xFF;
+        break;
+    case 0x20:
+        contents[writeAddress] &= writeData;
+        break;
+    }
+
+    DATA[EECR] &= ~(1 << EEPE);
+    updateInterrupts();
+}
+
+static void startWrite(){
+    writeAddress = address();
+    writeData = DATA[EEDR];
+    writeMode = DATA[EECR] & EEPM;
+
+    DATA[EECR] = (DATA[EECR] & ~(1 << EEMPE)) | (1 << EEPE);
+    unschedule(clearEEMPE);
+    schedule(writeDone, CYCLES + (writeMode == 0 ? 34 : 18) * F_CPU / 10000);
+
+    CYCLES += 2;
+}
+
+static void writeEECR(uint16_t addr, uint8_t value){
+    uint8_t old = DATA[EECR];
+    int writing = old & (1 << EEPE);
+
+    // EEPE, EEMPE and EERE are only set below, EEPM cannot change while a write runs
+    DATA[EECR] = (old & ((1 << EEPE) | (1 << EEMPE) | (writing ? EEPM : 0))) | (value & ((1 << EERIE) | (writing ? 0 : EEPM)));
+
+    if((value & (1 << EEPE)) && (old & (1 << EEMPE)) && !writing){
+        startWrite();
+    }
+    else if(value & (1 << EEMPE)){
+        DATA[EECR] |= 1 << EEMPE;
+        schedule(clearEEMPE, CYCLES + 4);
+    }
+
+    if((value & (1 << EERE)) && !writing){
+        DATA[EEDR] = contents[address()];
+        CYCLES += 4;
+    }
+
+    updateInterrupts();
+}
+
+// EE_READY is requested as long as no write is running
+static int pendingEE(){
+    return (DATA[EECR] & (1 << EERIE)) && !(DATA[EECR] & (1 << EEPE));
+}
+
+void initEeprom(){
+    static MCUSTATE int erased;
+
+    if(!erased){
+        memset(internal, 0xFF, EEPROMSIZE);
+        erased = 1;
+    }
+    if(contents == 0){
+        contents = internal;
+    }
+
+    keepState(contents, EEPROMSIZE);
+    keepState(&writeAddress, sizeof(writeAddress));
+    keepState(&writeData, sizeof(writeData));
+    keepState(&writeMode, sizeof(writeMode));
+
+    keepHandler(writeDone);
+    keepHandler(clearEEMPE);
+
+    setIOHandlers(EECR, 0, writeEECR);
+    setInterrupt(EE_READY_vect, pendingEE, 0);
+}
+
+/* Maps the EEPROM contents to a host file, created erased if it does not exist.
+Returns 0 if the file cannot be mapped. */
+int eepromOpen(const char *path){
+    struct stat st;
+    uint8_t *map;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if(fd < 0){
+        return 0;
+    }
+    if(fstat(fd, &st) < 0){
+        close(fd);
+        return 0;
+    }
+    if(st.st_size < EEPROMSIZE){
+        uint8_t erased[EEPROMSIZE];
+
+        memset(erased, 0xFF, EEPROMSIZE);
+        if(pwrite(fd, erased + st.st_size, EEPROMSIZE - st.st_size, st.st_size) < 0){
+            close(fd);
+            return 0;
+        }
+    }
+
+    map = mmap(0, EEPROMSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        return 0;
+    }
+
+    forgetState(contents);
+    if(contents != internal && contents != 0){
+        munmap(contents, EEPROMSIZE);
+    }
+    contents = map;
+    keepState(contents, EEPROMSIZE);
+
+    return 1;
+}
+
+/* Unmaps the host file of eepromOpen(); the EEPROM keeps its contents in memory. */
+void eepromClose(){
+    if(contents == internal || contents == 0){
+        return;
+    }
+    forgetState(contents);
+    memcpy(internal, contents, EEPROMSIZE);
+    munmap(contents, EEPROMSIZE);
+    contents = internal;
+    keepState(contents, EEPROMSIZE);
+}
+
+/* The EEPROM bytes, for the host to inspect or seed. */
+uint8_t *eepromContents(){
+    if(contents == 0){
+        initEeprom();
+    }
+    return contents;
+}
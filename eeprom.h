@@ -0,0 +1,37 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+
+/* EEPROM registers, as data space addresses */
+#define EECR 0x3F
+#define EEDR 0x40
+#define EEARL 0x41
+#define EEARH 0x42
+
+/* EECR bits */
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+
+void initEeprom();
+int eepromOpen(const char *path);
+void eepromClose();
+uint8_t *eepromContents();
@@ -0,0 +1,535 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "elf.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Minimal reader of 32 bit little-endian ELF files, the format of avr-gcc, mapped read only.
+
+elfLoad() copies the program to flash and the .eeprom section to EEPROM, from the program
+headers and their load (physical) addresses, so initialized data is placed after the code
+as the linker laid it out.
+
+elfSymbol() looks a name up in .symtab. avr-gcc gives code symbols their byte address and
+data symbols their data address plus $800000.
+
+elfLines() runs the DWARF line number programs of .debug_line (DWARF versions 2 to 5) and
+reports every row as the range of addresses up to the next row of its sequence. Directory
+0, the compilation directory, is only known from DWARF 5 tables; before that, files
+relative to it are reported as they are.
+*/
+
+#define PT_LOAD 1
+#define DATA_ADDRESS 0x800000
+#define EEPROM_ADDRESS 0x810000
+
+#define MAXFILES 1024
+#define MAXPATH 512
+
+/* DWARF constants */
+#define DW_LNS_copy 1
+#define DW_LNS_advance_pc 2
+#define DW_LNS_advance_line 3
+#define DW_LNS_set_file 4
+#define DW_LNS_const_add_pc 8
+#define DW_LNS_fixed_advance_pc 9
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address 2
+#define DW_LNE_define_file 3
+#define DW_LNCT_path 1
+#define DW_LNCT_directory_index 2
+#define DW_FORM_block 0x09
+#define DW_FORM_data1 0x0b
+#define DW_FORM_data2 0x05
+#define DW_FORM_data4 0x06
+#define DW_FORM_data8 0x07
+#define DW_FORM_data16 0x1e
+#define DW_FORM_string 0x08
+#define DW_FORM_strp 0x0e
+#define DW_FORM_udata 0x0f
+#define DW_FORM_line_strp 0x1f
+
+static uint16_t get16(const uint8_t *p){
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t uleb(const uint8_t **p){
+    uint64_t value = 0;
+    int shift = 0;
+
+    do{
+        value |= (uint64_t)(**p & 0x7F) << shift;
+        shift += 7;
+    }while(*(*p)++ & 0x80);
+
+    return value;
+}
+
+static int64_t sleb(const uint8_t **p){
+    int64_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do{
+        byte = *(*p)++;
+        value |= (int64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    }while(byte & 0x80);
+
+    if(shift < 64 && (byte & 0x40)){
+        value -= (int64_t)1 << shift;
+    }
+
+    return value;
+}
+
+/* Maps the file. Returns 0 if it cannot be read or is not a 32 bit little-endian ELF file. */
+int elfOpen(const char *path, struct elf *elf){
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &st) < 0 || st.st_size < 52){
+        if(fd >= 0){
+            close(fd);
+        }
+        return 0;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        return 0;
+    }
+
+    elf->data = map;
+    elf->size = st.st_size;
+    if(memcmp(elf->data, "\177ELF", 4) != 0 || elf->data[4] != 1 || elf->data[5] != 1){
+        elfClose(elf);
+        return 0;
+    }
+
+    return 1;
+}
+
+void elfClose(struct elf *elf){
+    munmap((void *)elf->data, elf->size);
+    elf->data = 0;
+    elf->size = 0;
+}
+
+/* The contents of the section called name, 0 if there is none. */
+const uint8_t *elfSection(const struct elf *elf, const char *name, uint32_t *size){
+    uint32_t shoff = get32(elf->data + 32);
+    uint16_t shentsize = get16(elf->data + 46);
+    uint16_t shnum = get16(elf->data + 48);
+    uint16_t shstrndx = get16(elf->data + 50);
+    const uint8_t *names;
+    int i;
+
+    if(shstrndx >= shnum || shoff + (uint64_t)shnum * shentsize > elf->size){
+        return 0;
+    }
+    names = elf->data + get32(elf->data + shoff + shstrndx * shentsize + 16);
+
+    for(i = 0; i < shnum; i++){
+        const uint8_t *sh = elf->data + shoff + i * shentsize;
+        uint32_t offset = get32(sh + 16);
+
+        if(strcmp((const char *)names + get32(sh), name) == 0){
+            if((uint64_t)offset + get32(sh + 20) > elf->size){
+                return 0;
+            }
+            *size = get32(sh + 20);
+            return elf->data + offset;
+        }
+    }
+
+    return 0;
+}
+
+/* The value and size of the symbol called name. Returns 0 if there is none. */
+int elfSymbol(const struct elf *elf, const char *name, uint32_t *value, uint32_t *size){
+    uint32_t symtabSize, strtabSize;
+    const uint8_t *symtab = elfSection(elf, ".symtab", &symtabSize);
+    const uint8_t *strtab = elfSection(elf, ".strtab", &strtabSize);
+    uint32_t i;
+
+    if(symtab == 0 || strtab == 0){
+        return 0;
+    }
+
+    for(i = 0; i + 16 <= symtabSize; i += 16){
+        uint32_t offset = get32(symtab + i);
+
+        if(offset < strtabSize && strncmp((const char *)strtab + offset, name, strtabSize - offset) == 0){
+            *value = get32(symtab + i + 4);
+            *size = get32(symtab + i + 8);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Reads one attribute of a DWARF 5 directory or file entry, as a string or a number.
+// Returns 0 for a form that cannot be in a line table header.
+static int attribute(const struct elf *elf, const uint8_t **p, uint64_t code, int offsetSize, const char **string, uint64_t *number){
+    const uint8_t *strings;
+    uint32_t size;
+    uint64_t offset;
+
+    *string = 0;
+    *number = 0;
+    switch(code){
+    case DW_FORM_string:
+        *string = (const char *)*p;
+        *p += strlen(*string) + 1;
+        return 1;
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+        offset = offsetSize == 8 ? get32(*p) | (uint64_t)get32(*p + 4) << 32 : get32(*p);
+        *p += offsetSize;
+        strings = elfSection(elf, code == DW_FORM_strp ? ".debug_str" : ".debug_line_str", &size);
+        *string = strings && offset < size ? (const char *)strings + offset : "";
+        return 1;
+    case DW_FORM_udata:
+        *number = uleb(p);
+        return 1;
+    case DW_FORM_data1:
+        *number = **p;
+        *p += 1;
+        return 1;
+    case DW_FORM_data2:
+        *number = get16(*p);
+        *p += 2;
+        return 1;
+    case DW_FORM_data4:
+        *number = get32(*p);
+        *p += 4;
+        return 1;
+    case DW_FORM_data8:
+        *p += 8;
+        return 1;
+    case DW_FORM_data16:
+        *p += 16;
+        return 1;
+    case DW_FORM_block:
+        offset = uleb(p);
+        *p += offset;
+        return 1;
+    }
+
+    return 0;
+}
+
+// Reads a DWARF 5 directory or file name table into names and, for files, their directories.
+// Returns the number of entries, -1 if the table cannot be read.
+static int entries(const struct elf *elf, const uint8_t **p, int offsetSize, const char **names, uint32_t *directories){
+    uint64_t formats[32];
+    uint8_t count = *(*p)++;
+    uint64_t n, i;
+    int j;
+
+    if(count > 16){
+        return -1;
+    }
+    for(j = 0; j < count; j++){
+        formats[2 * j] = uleb(p);
+        formats[2 * j + 1] = uleb(p);
+    }
+
+    n = uleb(p);
+    for(i = 0; i < n; i++){
+        for(j = 0; j < count; j++){
+            const char *string;
+            uint64_t number;
+
+            if(!attribute(elf, p, formats[2 * j + 1], offsetSize, &string, &number)){
+                return -1;
+            }
+            if(i < MAXFILES && formats[2 * j] == DW_LNCT_path){
+                names[i] = string ? string : "";
+            }
+            if(i < MAXFILES && formats[2 * j] == DW_LNCT_directory_index && directories){
+                directories[i] = number;
+            }
+        }
+    }
+
+    return n < MAXFILES ? n : MAXFILES;
+}
+
+static void path(char *buffer, const char *directory, const char *name){
+    if(name[0] == '/' || directory == 0 || directory[0] == 0){
+        snprintf(buffer, MAXPATH, "%s", name);
+    }
+    else{
+        snprintf(buffer, MAXPATH, "%s/%s", directory, name);
+    }
+}
+
+/* Copies the loadable segments to flash and EEPROM by their load address: avr-gcc puts flash
+at 0 and EEPROM at $810000. Returns 0 if a segment does not fit. */
+int elfLoad(const struct elf *elf, uint8_t *flash, uint32_t flashSize, uint8_t *eeprom, uint32_t eepromSize){
+    uint32_t phoff = get32(elf->data + 28);
+    uint16_t phentsize = get16(elf->data + 42);
+    uint16_t phnum = get16(elf->data + 44);
+    int i;
+
+    if(phoff + (uint64_t)phnum * phentsize > elf->size){
+        return 0;
+    }
+
+    for(i = 0; i < phnum; i++){
+        const uint8_t *ph = elf->data + phoff + i * phentsize;
+        uint32_t offset = get32(ph + 4);
+        uint32_t address = get32(ph + 12);
+        uint32_t size = get32(ph + 16);
+
+        if(get32(ph) != PT_LOAD || size == 0){
+            continue;
+        }
+        if((uint64_t)offset + size > elf->size){
+            return 0;
+        }
+
+        if(address >= EEPROM_ADDRESS){
+            if(address - EEPROM_ADDRESS + (uint64_t)size > eepromSize){
+                return 0;
+            }
+            memcpy(eeprom + address - EEPROM_ADDRESS, elf->data + offset, size);
+        }
+        else if(address < DATA_ADDRESS){
+            if(address + (uint64_t)size > flashSize){
+                return 0;
+            }
+            memcpy(flash + address, elf->data + offset, size);
+        }
+    }
+
+    return 1;
+}
+
+// The directory and file tables of a line number program, too large for the stack
+struct tables{
+    const char *directories[MAXFILES];
+    const char *names[MAXFILES];
+    uint32_t fileDirectory[MAXFILES];
+    char files[MAXFILES][MAXPATH];
+};
+
+static int lines(const struct elf *elf, lineRow row, struct tables *t){
+    const char **directories = t->directories;
+    const char **names = t->names;
+    uint32_t *fileDirectory = t->fileDirectory;
+    char (*files)[MAXPATH] = t->files;
+    uint32_t size;
+    const uint8_t *section = elfSection(elf, ".debug_line", &size);
+    const uint8_t *unit = section;
+
+    if(section == 0){
+        return 0;
+    }
+
+    while(unit + 4 <= section + size){
+        int offsetSize = 4;
+        uint64_t length = get32(unit);
+        const uint8_t *p = unit + 4;
+        const uint8_t *end, *program;
+        uint16_t version;
+        uint8_t minLength, lineBase, lineRange, opcodeBase;
+        const uint8_t *opcodeLengths;
+        int nfiles = 0, ndirectories = 0, i;
+
+        if(length == 0xFFFFFFFF){
+            length = get32(p) | (uint64_t)get32(p + 4) << 32;
+            offsetSize = 8;
+            p += 8;
+        }
+        end = p + length;
+        if(end > section + size){
+            return 0;
+        }
+
+        version = get16(p);
+        p += 2;
+        if(version < 2 || version > 5){
+            return 0;
+        }
+        if(version >= 5){
+            p += 2;     // address and segment selector sizes
+        }
+        program = p + offsetSize + (offsetSize == 8 ? get32(p) | (uint64_t)get32(p + 4) << 32 : get32(p));
+        p += offsetSize;
+
+        minLength = *p++;
+        if(version >= 4){
+            p++;        // maximum operations per instruction, 1 on AVR
+        }
+        p++;            // default is_stmt
+        lineBase = *p++;
+        lineRange = *p++;
+        opcodeBase = *p++;
+        opcodeLengths = p;
+        p += opcodeBase - 1;
+
+        if(version >= 5){
+            ndirectories = entries(elf, &p, offsetSize, directories, 0);
+            nfiles = entries(elf, &p, offsetSize, names, fileDirectory);
+            if(ndirectories < 0 || nfiles < 0){
+                return 0;
+            }
+        }
+        else{
+            // directory and file indexes start at 1, 0 is the compilation directory
+            directories[0] = 0;
+            ndirectories = 1;
+            while(*p && ndirectories < MAXFILES){
+                directories[ndirectories++] = (const char *)p;
+                p += strlen((const char *)p) + 1;
+            }
+            p++;
+            names[0] = "";
+            fileDirectory[0] = 0;
+            nfiles = 1;
+            while(*p && nfiles < MAXFILES){
+                names[nfiles] = (const char *)p;
+                p += strlen((const char *)p) + 1;
+                fileDirectory[nfiles++] = uleb(&p);
+                uleb(&p);
+                uleb(&p);
+            }
+        }
+        for(i = 0; i < nfiles; i++){
+            path(files[i], fileDirectory[i] < (uint32_t)ndirectories ? directories[fileDirectory[i]] : 0, names[i]);
+        }
+
+        // state machine registers, and the row waiting for the address of the next one
+        uint32_t address = 0, file = 1 - (version >= 5), line = 1;
+        uint32_t lastAddress = 0, lastFile = 0, lastLine = 0;
+        int pending = 0;
+
+        p = program;
+        while(p < end){
+            uint8_t opcode = *p++;
+            int emit = 0, endSequence = 0;
+
+            if(opcode >= opcodeBase){
+                opcode -= opcodeBase;
+                address += (opcode / lineRange) * minLength;
+                line += (int8_t)lineBase + opcode % lineRange;
+                emit = 1;
+            }
+            else if(opcode == 0){
+                uint64_t n = uleb(&p);
+                const uint8_t *next = p + n;
+
+                switch(n ? *p : 0){
+                case DW_LNE_end_sequence:
+                    emit = 1;
+                    endSequence = 1;
+                    break;
+                case DW_LNE_set_address:
+                    address = n >= 5 ? get32(p + 1) : get16(p + 1);
+                    break;
+                case DW_LNE_define_file:
+                    if(nfiles < MAXFILES){
+                        const uint8_t *q = p + 1 + strlen((const char *)p + 1) + 1;
+                        uint64_t directory = uleb(&q);
+
+                        path(files[nfiles++], directory < (uint64_t)ndirectories ? directories[directory] : 0, (const char *)p + 1);
+                    }
+                    break;
+                }
+                p = next;
+            }
+            else{
+                switch(opcode){
+                case DW_LNS_copy:
+                    emit = 1;
+                    break;
+                case DW_LNS_advance_pc:
+                    address += uleb(&p) * minLength;
+                    break;
+                case DW_LNS_advance_line:
+                    line += sleb(&p);
+                    break;
+                case DW_LNS_set_file:
+                    file = uleb(&p);
+                    break;
+                case DW_LNS_const_add_pc:
+                    address += ((255 - opcodeBase) / lineRange) * minLength;
+                    break;
+                case DW_LNS_fixed_advance_pc:
+                    address += get16(p);
+                    p += 2;
+                    break;
+                default:
+                    for(i = 0; i < opcodeLengths[opcode - 1]; i++){
+                        uleb(&p);
+                    }
+                }
+            }
+
+            if(emit){
+                if(pending && address > lastAddress && lastFile < (uint32_t)nfiles){
+                    row(files[lastFile], lastLine, lastAddress, address);
+                }
+                pending = !endSequence;
+                lastAddress = address;
+                lastFile = file;
+                lastLine = line;
+            }
+            if(endSequence){
+                address = 0;
+                file = 1 - (version >= 5);
+                line = 1;
+            }
+        }
+
+        unit = end;
+    }
+
+    return 1;
+}
+
+/* Runs all the line number programs of .debug_line. Returns 0 if there is none or one
+cannot be read. The tables are allocated per call, so instances can read ELF files on
+their threads at the same time. */
+int elfLines(const struct elf *elf, lineRow row){
+    struct tables *t = malloc(sizeof(struct tables));
+    int result;
+
+    if(t == 0){
+        return 0;
+    }
+    result = lines(elf, row, t);
+    free(t);
+    return result;
+}
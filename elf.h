@@ -0,0 +1,43 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Reading the ELF files made by avr-gcc */
+
+struct elf{
+    const uint8_t *data;
+    size_t size;
+};
+
+/* Called for each address range of a line table row. Addresses are byte addresses. */
+typedef void (*lineRow)(const char *file, uint32_t line, uint32_t start, uint32_t end);
+
+int elfOpen(const char *path, struct elf *elf);
+void elfClose(struct elf *elf);
+const uint8_t *elfSection(const struct elf *elf, const char *name, uint32_t *size);
+int elfSymbol(const struct elf *elf, const char *name, uint32_t *value, uint32_t *size);
+int elfLoad(const struct elf *elf, uint8_t *flash, uint32_t flashSize, uint8_t *eeprom, uint32_t eepromSize);
+int elfLines(const struct elf *elf, lineRow row);
+
+#endif
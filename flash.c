@@ -0,0 +1,170 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#define _GNU_SOURCE
+#include "flash.h"
+#include "registers.h"
+#include "decoder.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+Program memory of the MCU of this thread.
+
+FLASH and LOOPKIND point into a private mapping of one block: the flash words, followed by
+one LOOPKIND byte per word. The block is either anonymous, an erased flash of zeros with
+nothing derived yet (privateFlash(), what reset() gives a thread without flash), or the
+file of an image (useImage()).
+
+An image is made once from a program by imageCreate(), with LOOPKIND derived for every
+word, and is then mapped by any number of MCUs on any threads. The mapping is private, so
+its pages are shared until an MCU writes one (SPM, or the host writing FLASH): the kernel
+then copies that page for that MCU alone. The copy is of a host page (4KB, that is 32 SPM
+pages, or the LOOPKIND of 4096 words); the others stay shared. An MCU running a shared
+image has no flash of its own, only its page tables.
+
+Images are reference counted: imageCreate() returns one reference, every MCU using the
+image holds one, and the file goes away with the last one.
+*/
+
+#define BLOCKSIZE (FLASHSIZE * 2 + FLASHSIZE)
+
+struct image{
+    int fd;
+    atomic_int references;
+};
+
+MCUSTATE uint8_t *LOOPKIND;
+
+// Image mapped by this thread, 0 for a private flash
+static MCUSTATE struct image *current;
+
+static uint8_t *map(int fd){
+    int flags = fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_PRIVATE;
+    void *block = mmap(0, BLOCKSIZE, PROT_READ | PROT_WRITE, flags, fd, 0);
+
+    if(block == MAP_FAILED){
+        printf("CANNOT MAP FLASH.");
+        exit(1);
+    }
+    return block;
+}
+
+static void attach(uint8_t *block, struct image *image){
+    dropFlash();
+    FLASH = (uint16_t *)block;
+    LOOPKIND = block + FLASHSIZE * 2;
+    current = image;
+}
+
+/* Makes an image of the first count words of flash, the others erased to zero. Returns 0 if
+the host cannot make one. */
+struct image *imageCreate(const uint16_t *words, int count){
+    struct image *image = malloc(sizeof(struct image));
+    uint16_t *flash = FLASH;
+    uint8_t *loopKind = LOOPKIND;
+    uint8_t *block;
+
+    if(image == 0){
+        return 0;
+    }
+    image->fd = memfd_create("simulador-flash", MFD_CLOEXEC);
+    if(image->fd < 0 || ftruncate(image->fd, BLOCKSIZE) != 0){
+        if(image->fd >= 0){
+            close(image->fd);
+        }
+        free(image);
+        return 0;
+    }
+    block = mmap(0, BLOCKSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, image->fd, 0);
+    if(block == MAP_FAILED){
+        close(image->fd);
+        free(image);
+        return 0;
+    }
+
+    if(count > FLASHSIZE){
+        count = FLASHSIZE;
+    }
+    memcpy(block, words, count * 2);
+
+    // The decoder looks at the FLASH of this thread
+    FLASH = (uint16_t *)block;
+    LOOPKIND = block + FLASHSIZE * 2;
+    deriveFlash();
+    FLASH = flash;
+    LOOPKIND = loopKind;
+
+    munmap(block, BLOCKSIZE);
+    atomic_init(&image->references, 1);
+
+    return image;
+}
+
+void imageRetain(struct image *image){
+    atomic_fetch_add(&image->references, 1);
+}
+
+void imageRelease(struct image *image){
+    if(atomic_fetch_sub(&image->references, 1) == 1){
+        close(image->fd);
+        free(image);
+    }
+}
+
+/* Called by reset(). A thread without flash gets an erased private one. A private flash may
+have been written directly, so what was derived from it is forgotten; an image cannot
+have been, other than through invalidateFlash(). */
+void initFlash(){
+    if(FLASH == 0){
+        privateFlash();
+    }
+    else if(current == 0){
+        invalidateFlash(0, FLASHSIZE);
+    }
+}
+
+/* Runs the program of image from now on, in place of the flash the MCU had. */
+void useImage(struct image *image){
+    uint8_t *block = map(image->fd);
+
+    imageRetain(image);
+    attach(block, image);
+}
+
+/* Gives the MCU an erased flash of its own, in place of the one it had. */
+void privateFlash(){
+    attach(map(-1), 0);
+}
+
+/* Unmaps the flash of this thread, before the thread ends. */
+void dropFlash(){
+    if(FLASH){
+        munmap(FLASH, BLOCKSIZE);
+    }
+    if(current){
+        imageRelease(current);
+    }
+    FLASH = 0;
+    LOOPKIND = 0;
+    current = 0;
+}
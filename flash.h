@@ -0,0 +1,39 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef FLASH_H
+#define FLASH_H
+
+#include "registers.h"
+
+/* Flash image shared by several MCUs (see flash.c) */
+struct image;
+
+// What the decoder derived from each flash word (see decoder.c)
+extern MCUSTATE uint8_t *LOOPKIND;
+
+struct image *imageCreate(const uint16_t *words, int count);
+void imageRetain(struct image *image);
+void imageRelease(struct image *image);
+
+void initFlash();
+void useImage(struct image *image);
+void privateFlash();
+void dropFlash();
+
+#endif
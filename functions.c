@@ -18,7 +18,11 @@ email: rrramires@homail.com
 */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "registers.h"
+#include "sram.h"
+#include "functions.h"
 
 void printSREG(){
     printf("I: %d\n",SREG.I);
@@ -45,7 +49,7 @@ void computeZ8bits(uint8_t result){
 // Check bit 7 or result
 // Set if MSB of the result is set; cleared otherwise.
 void computeN8bits(uint8_t result){
-    if(result & 0b10000000 > 0){
+    if((result & 0b10000000) > 0){
         SREG.N = 1;
     }
     else{
@@ -70,48 +74,52 @@ void computeS(){
 }
 
 //Set if there was a carry from bit 3; cleared otherwise.
+//result is the sum, carry in included (ADD, ADC).
 void computeH8bits(uint8_t rd, uint8_t rr, uint8_t result){
-    uint8_t mask = 0b00001000;
+    uint8_t h = (rd & rr) | (rr & ~result) | (~result & rd);
 
-    uint8_t rd3 = rd & mask;
-    uint8_t rr3 = rr & mask;
-    uint8_t r3 = (rd + rr) & mask;
-
-    uint8_t h = (rd3 & rr3) | (rr3 & ~r3) | (~r3 & rd3);
-
-    h = h >> 3;
-
-    SREG.H = h;
+    SREG.H = (h >> 3) & 1;
 }
 
 //Set if two’s complement overflow resulted from the operation; cleared otherwise.
 void computeV8bits(uint8_t rd, uint8_t rr, uint8_t result){
-    uint8_t mask = 0b10000000;
-
-    uint8_t rd7 = rd & mask;
-    uint8_t rr7 = rr & mask;
-    uint8_t r7 = (rd + rr) & mask;
+    uint8_t v = (rd & rr & ~result) | (~rd & ~rr & result);
 
-    uint8_t v = (rd7 & rr7 & ~r7) | (~rd7 & ~rr7 & r7);
-
-    v = v >> 7;
-
-    SREG.V = v;
+    SREG.V = (v >> 7) & 1;
 }
 
 //Set if there was carry from the MSB of the result; cleared otherwise.
 void computeC8bits(uint8_t rd, uint8_t rr, uint8_t result){
-    uint8_t mask = 0b10000000;
+    uint8_t c = (rd & rr) | (rr & ~result) | (~result & rd);
+
+    SREG.C = (c >> 7) & 1;
+}
 
-    uint8_t rd7 = rd & mask;
-    uint8_t rr7 = rr & mask;
-    uint8_t r7 = (rd + rr) & mask;
+//H, V, N, Z, C and S of a subtraction, from Rd, Rr (or K) and the result
+void computeSUBflags(uint8_t rd, uint8_t rr, uint8_t result){
+    uint8_t borrow = (~rd & rr) | (rr & result) | (result & ~rd);
 
-    uint8_t c = (rd7 & rr7) | (rr7 & ~r7) | (~r7 & rd7);
+    SREG.H = (borrow >> 3) & 1;
+    SREG.V = (((rd & ~rr & ~result) | (~rd & rr & result)) >> 7) & 1;
+    SREG.N = result >> 7;
+    SREG.Z = (result == 0);
+    SREG.C = (borrow >> 7) & 1;
+    computeS();
+}
 
-    c = c >> 7;
+//C and Z of MUL, MULS and MULSU, from the 16 bit product
+void computeMULflags(uint16_t result){
+    SREG.C = result >> 15;
+    SREG.Z = (result == 0);
+}
 
-    SREG.C = c;
+//V, N, Z, C and S of SBIW, from the register pair before and after the subtraction
+void computeSBIWflags(uint16_t rd, uint16_t result){
+    SREG.V = ((rd & ~result) >> 15) & 1;
+    SREG.N = (result >> 15) & 1;
+    SREG.Z = (result == 0);
+    SREG.C = ((result & ~rd) >> 15) & 1;
+    computeS();
 }
 
 //Return SREG flag
@@ -150,4 +158,166 @@ uint8_t getSREGflag(int s){
     }
 
     return flag;
+}
+
+//Return SREG packed as the byte seen at its I/O address
+uint8_t getSREG(){
+    return (SREG.I << 7) | (SREG.T << 6) | (SREG.H << 5) | (SREG.S << 4) |
+           (SREG.V << 3) | (SREG.N << 2) | (SREG.Z << 1) | SREG.C;
+}
+
+//Unpack a byte written to the SREG I/O address into the flags
+void setSREG(uint8_t value){
+    SREG.I = (value >> 7) & 1;
+    SREG.T = (value >> 6) & 1;
+    SREG.H = (value >> 5) & 1;
+    SREG.S = (value >> 4) & 1;
+    SREG.V = (value >> 3) & 1;
+    SREG.N = (value >> 2) & 1;
+    SREG.Z = (value >> 1) & 1;
+    SREG.C = value & 1;
+}
+
+//Handlers of the I/O registers modeled by a peripheral, indexed by data address
+static MCUSTATE uint8_t (*ioRead[SRAMSTART])(uint16_t addr);
+static MCUSTATE void (*ioWrite[SRAMSTART])(uint16_t addr, uint8_t value);
+
+//Route the accesses to an I/O register to a peripheral. A null handler leaves the plain byte in DATA.
+void setIOHandlers(uint16_t addr, uint8_t (*read)(uint16_t addr), void (*write)(uint16_t addr, uint8_t value)){
+    ioRead[addr] = read;
+    ioWrite[addr] = write;
+}
+
+void clearIOHandlers(){
+    int i;
+
+    for(i = 0; i < SRAMSTART; i++){
+        ioRead[i] = 0;
+        ioWrite[i] = 0;
+    }
+}
+
+//Read a byte from the data space
+//Addresses $00-$1F are the general purpose registers, the rest is I/O and SRAM.
+uint8_t readDATA(uint16_t addr){
+    if(addr < 32){
+        return R[addr];
+    }
+    if(addr == SREGADDR){
+        return getSREG();
+    }
+    if(addr < SRAMSTART && ioRead[addr]){
+        return ioRead[addr](addr);
+    }
+    if(addr > RAMEND){
+        return 0;
+    }
+    if(addr >= SRAMSTART){
+        MARK(SRAMREAD, addr);
+    }
+    return DATA[addr];
+}
+
+//Write a byte to the data space
+void writeDATA(uint16_t addr, uint8_t value){
+    if(addr < 32){
+        R[addr] = value;
+    }
+    else if(addr == SREGADDR){
+        setSREG(value);
+    }
+    else if(addr < SRAMSTART && ioWrite[addr]){
+        ioWrite[addr](addr, value);
+    }
+    else if(addr < SRAMSTART){
+        DATA[addr] = value;
+        if(addr == SPL){
+            STACKMOVED(getSP());
+        }
+    }
+    else if(addr <= RAMEND){
+        DATA[addr] = value;
+        MARK(SRAMWRITTEN, addr);
+    }
+}
+
+//Return the 16 bit pointer held in the register pair r+1:r (X = 26, Y = 28, Z = 30)
+uint16_t getPointer(int r){
+    return (R[r + 1] << 8) | R[r];
+}
+
+//Store a 16 bit pointer in the register pair r+1:r
+void setPointer(int r, uint16_t value){
+    R[r] = value & 0xFF;
+    R[r + 1] = value >> 8;
+}
+
+//True if the accesses to the I/O register at addr go through a peripheral read handler
+int hasReadHandler(uint16_t addr){
+    return addr < SRAMSTART && ioRead[addr];
+}
+
+//True if the opcode is the first word of a two word instruction (LDS, STS, JMP, CALL)
+int isTwoWord(uint16_t opcode){
+    return (opcode & 0xFC0F) == 0x9000 || (opcode & 0xFE0C) == 0x940C;
+}
+
+//Skip the instruction after the one at PC, used by SBRC, SBRS, SBIC and SBIS
+void skipNext(){
+    if(isTwoWord(FLASH[(PC + 1) % FLASHSIZE])){
+        PC = PC + 3;
+    }
+    else{
+        PC = PC + 2;
+    }
+}
+
+//Stack Pointer, kept in SPH:SPL
+uint16_t getSP(){
+    return (DATA[SPH] << 8) | DATA[SPL];
+}
+
+void setSP(uint16_t value){
+    DATA[SPL] = value & 0xFF;
+    DATA[SPH] = value >> 8;
+    STACKMOVED(value);
+}
+
+//The Stack Pointer uses a post-decrement scheme on push
+void push(uint8_t value){
+    uint16_t sp = getSP();
+
+    writeDATA(sp, value);
+    setSP(sp - 1);
+}
+
+uint8_t pop(){
+    uint16_t sp = getSP() + 1;
+
+    setSP(sp);
+    return readDATA(sp);
+}
+
+//Return addresses are pushed low byte first, PCBYTES bytes of them
+void pushPC(){
+    DEPTH++;
+    push(PC & 0xFF);
+    push((PC >> 8) & 0xFF);
+#if PCBYTES == 3
+    push(PC >> 16);
+#endif
+}
+
+void popPC(){
+    pc_t pc = 0;
+
+#if PCBYTES == 3
+    pc = (pc_t)pop() << 16;
+#endif
+    pc |= pop() << 8;
+    pc |= pop();
+    PC = pc;
+    if(DEPTH){
+        DEPTH--;
+    }
 }
\ No newline at end of file
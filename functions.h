@@ -28,4 +28,30 @@ void computeH8bits(uint8_t rd, uint8_t rr, uint8_t result);
 void computeV8bits(uint8_t rd, uint8_t rr, uint8_t result);
 void computeC8bits(uint8_t rd, uint8_t rr, uint8_t result);
 void computeS();
-uint8_t getSREGflag(int s);
\ No newline at end of file
+void computeSBIWflags(uint16_t rd, uint16_t result);
+void computeSUBflags(uint8_t rd, uint8_t rr, uint8_t result);
+void computeMULflags(uint16_t result);
+uint8_t getSREGflag(int s);
+uint8_t getSREG();
+void setSREG(uint8_t value);
+
+/* Data space access */
+
+uint8_t readDATA(uint16_t addr);
+void writeDATA(uint16_t addr, uint8_t value);
+uint16_t getPointer(int r);
+void setPointer(int r, uint16_t value);
+void setIOHandlers(uint16_t addr, uint8_t (*read)(uint16_t addr), void (*write)(uint16_t addr, uint8_t value));
+void clearIOHandlers();
+int hasReadHandler(uint16_t addr);
+int isTwoWord(uint16_t opcode);
+void skipNext();
+
+/* Stack */
+
+uint16_t getSP();
+void setSP(uint16_t value);
+void push(uint8_t value);
+uint8_t pop();
+void pushPC();
+void popPC();
\ No newline at end of file
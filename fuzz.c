@@ -0,0 +1,252 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "fuzz.h"
+#include "registers.h"
+#include "functions.h"
+#include "decoder.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+Fuzzing a parser of the firmware without booting it for every input.
+
+fuzzBoot() runs the firmware, already loaded and reset, up to the entry point (a function
+or a place in the main loop where the parser is about to read its buffer) and takes a
+snapshot of the MCU (snapshot.c). fuzzRun() then, for each input, restores the snapshot,
+copies the input to the SRAM buffer of the target, sets its length and runs up to the exit
+point. An input crashes the firmware if it runs an invalid opcode, jumps to the reset
+vector (a null function pointer or a smashed return address) or moves the stack out of
+SRAM. Restoring is a few KB of memcpy, so an input costs about what the firmware spends on
+it.
+
+Every control transfer, and every conditional instruction however it goes, counts an
+edge in FUZZMAP as AFL does: the hashes of both ends, the source one shifted, give the
+index. fuzzRun() only adds to the map; clearing it between inputs is up to the caller.
+
+fuzzServe() speaks the AFL fork server protocol: the booted process forks a child that runs
+inputs in a loop, stopping itself after each (AFL persistent mode), and is only replaced
+after a crash or PERSISTENT inputs. FUZZMAP is then the shared memory of afl-fuzz.
+
+The entry and exit points are only seen when the CPU executes them, so they must not be in
+a loop run on the host (idioms.c, busywait.c). Flash is not part of the snapshot.
+*/
+
+#define FORKSRV_FD 198
+#define PERSISTENT 100000
+#define MAXINPUT 65536
+
+MCUSTATE uint8_t *FUZZMAP;
+
+static MCUSTATE struct fuzzTarget target;
+static MCUSTATE uint8_t *snapshot;
+static MCUSTATE int crashed;
+
+static void invalidOpcode(uint16_t opcode){
+    crashed = 1;
+}
+
+// Bounds loops skipped and sleep to the end of the input
+static void deadline(uint64_t when){
+}
+
+// BRBS/BRBC, CPSE, SBRC/SBRS and SBIC/SBIS, whose edges are counted both ways
+static int conditional(uint16_t opcode){
+    return (opcode & 0xF800) == 0xF000 || (opcode & 0xFC00) == 0x1000 ||
+           (opcode & 0xFC08) == 0xFC00 || (opcode & 0xFD00) == 0x9900;
+}
+
+static uint16_t location(pc_t pc){
+    return ((uint32_t)pc * 0x9E3779B1u) >> 16;
+}
+
+/* Runs from the current state up to target->entry and takes the snapshot the inputs start
+from. Returns 0 if the entry point is not reached within the given cycles, or an invalid
+opcode is run before it. */
+int fuzzBoot(const struct fuzzTarget *t, uint64_t cycles){
+    uint64_t end = CYCLES + cycles;
+
+    if(t->buffer + t->capacity > DATASIZE || t->length + 2 > DATASIZE){
+        return 0;
+    }
+    target = *t;
+    if(FUZZMAP == 0){
+        FUZZMAP = calloc(FUZZMAPSIZE, 1);
+    }
+
+    onInvalidOpcode(invalidOpcode);
+    crashed = 0;
+    schedule(deadline, end);
+    while(PC != target.entry){
+        if(CYCLES >= end || step() == 0 || crashed){
+            unschedule(deadline);
+            return 0;
+        }
+    }
+    unschedule(deadline);
+
+    free(snapshot);
+    snapshot = malloc(stateSize());
+    saveState(snapshot);
+
+    return 1;
+}
+
+/* Runs one input from the snapshot and returns its outcome. */
+int fuzzRun(const uint8_t *data, size_t size){
+    uint64_t end;
+
+    restoreState(snapshot);
+    crashed = 0;
+
+    if(size > target.capacity){
+        size = target.capacity;
+    }
+    memcpy(DATA + target.buffer, data, size);
+    if(target.length){
+        DATA[target.length] = size & 0xFF;
+        DATA[target.length + 1] = size >> 8;
+    }
+    if(target.arguments){
+        setPointer(24, target.buffer);
+        setPointer(22, size);
+    }
+
+    end = CYCLES + target.timeout;
+    schedule(deadline, end);
+    while(CYCLES < end){
+        pc_t from = PC;
+
+        if(step() == 0){
+            break;
+        }
+        if(crashed){
+            return FUZZ_CRASH;
+        }
+        if(PC != from + 1 || conditional(FLASH[from])){
+            FUZZMAP[location(PC) ^ (location(from) >> 1)]++;
+        }
+        if(PC == target.exit){
+            return FUZZ_OK;
+        }
+        if(PC == 0 || getSP() < SRAMSTART - 1 || getSP() > RAMEND){
+            return FUZZ_CRASH;
+        }
+    }
+
+    return FUZZ_TIMEOUT;
+}
+
+// Runs the input in the file, or in stdin, read again from its start
+static int runFile(const char *path){
+    static uint8_t input[MAXINPUT];
+    int fd = path ? open(path, O_RDONLY) : 0;
+    ssize_t size;
+
+    if(fd < 0){
+        return FUZZ_OK;
+    }
+    if(path == 0){
+        lseek(0, 0, SEEK_SET);
+    }
+    size = read(fd, input, MAXINPUT);
+    if(path){
+        close(fd);
+    }
+
+    return fuzzRun(input, size < 0 ? 0 : size);
+}
+
+// The child of the fork server: a crash kills it, other inputs stop it until the next one
+static void persist(const char *path){
+    int i;
+
+    close(FORKSRV_FD);
+    close(FORKSRV_FD + 1);
+
+    for(i = 1; ; i++){
+        if(runFile(path) == FUZZ_CRASH){
+            abort();
+        }
+        if(i == PERSISTENT){
+            _exit(0);
+        }
+        raise(SIGSTOP);
+    }
+}
+
+/* Serves afl-fuzz after fuzzBoot(), taking the inputs from the file at path (afl-fuzz @@)
+or from stdin if path is 0; never returns. Outside of afl-fuzz, runs the input once and
+returns its outcome. */
+int fuzzServe(const char *path){
+    const char *id = getenv("__AFL_SHM_ID");
+    uint32_t message = 0;
+    pid_t child = -1;
+    int status, stopped = 0;
+
+    if(id){
+        void *map = shmat(atoi(id), 0, 0);
+
+        if(map != (void *)-1){
+            FUZZMAP = map;
+        }
+    }
+
+    if(write(FORKSRV_FD + 1, &message, 4) != 4){
+        return runFile(path);
+    }
+
+    while(read(FORKSRV_FD, &message, 4) == 4){
+        // afl-fuzz killed the stopped child on a timeout
+        if(stopped && message){
+            waitpid(child, &status, 0);
+            stopped = 0;
+        }
+
+        if(stopped){
+            kill(child, SIGCONT);
+        }
+        else{
+            child = fork();
+            if(child < 0){
+                _exit(1);
+            }
+            if(child == 0){
+                persist(path);
+            }
+        }
+
+        if(write(FORKSRV_FD + 1, &child, 4) != 4 || waitpid(child, &status, WUNTRACED) < 0){
+            _exit(1);
+        }
+        stopped = WIFSTOPPED(status);
+        if(write(FORKSRV_FD + 1, &status, 4) != 4){
+            _exit(1);
+        }
+    }
+
+    _exit(0);
+}
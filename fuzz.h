@@ -0,0 +1,52 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include "registers.h"
+#include <stddef.h>
+
+/* Snapshot fuzzing of the firmware (see fuzz.c) */
+
+/* Size of the edge map, the one of AFL */
+#define FUZZMAPSIZE 65536
+
+/* Outcome of an input */
+#define FUZZ_OK 0           // Reached the exit point
+#define FUZZ_CRASH 1        // Invalid opcode, jump to the reset vector or stack out of SRAM
+#define FUZZ_TIMEOUT 2      // Ran out of cycles, or slept with nothing to wake it
+
+struct fuzzTarget{
+    pc_t entry;             // Word address where the snapshot is taken
+    pc_t exit;              // Word address that ends an input
+    uint16_t buffer;        // Data address the input is copied to
+    uint16_t capacity;      // Bytes of the buffer; longer inputs are cut
+    uint16_t length;        // Data address of a uint16_t set to the input length, 0 for none
+    int arguments;          // Nonzero to also pass buffer and length as f(buffer, length) does
+    uint64_t timeout;       // Cycles an input may run
+};
+
+// Edge hit counts, AFL style
+extern MCUSTATE uint8_t *FUZZMAP;
+
+int fuzzBoot(const struct fuzzTarget *target, uint64_t cycles);
+int fuzzRun(const uint8_t *data, size_t size);
+int fuzzServe(const char *path);
+
+#endif
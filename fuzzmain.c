@@ -0,0 +1,130 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "fuzz.h"
+#include "registers.h"
+#include "decoder.h"
+#include "eeprom.h"
+#include "elf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+fuzz.exe, the target of afl-fuzz:
+
+    afl-fuzz -i inputs -o findings -- ./fuzz.exe [options] firmware.elf entry exit buffer @@
+
+entry, exit and buffer are symbols of the firmware or numbers (byte addresses for entry and
+exit, data addresses for buffer). Options:
+
+    -c bytes    capacity of the buffer (the size of its symbol by default)
+    -l symbol   uint16_t variable set to the input length
+    -a          pass buffer and length in r25:r24 and r23:r22, entry being f(buffer, length)
+    -t cycles   cycles an input may run (default 1000000)
+    -b cycles   cycles the boot may take to reach entry (default 100000000)
+
+Without afl-fuzz it runs the input once, prints its outcome and aborts on a crash.
+*/
+
+#define DATA_ADDRESS 0x800000
+
+static uint32_t address(const struct elf *elf, const char *s, uint32_t *size){
+    char *end;
+    uint32_t value = strtoul(s, &end, 0);
+
+    *size = 0;
+    if(*s && *end == 0){
+        return value;
+    }
+    if(!elfSymbol(elf, s, &value, size)){
+        printf("UNKNOWN SYMBOL %s.", s);
+        exit(1);
+    }
+    return value >= DATA_ADDRESS ? value - DATA_ADDRESS : value;
+}
+
+int main(int argc, char **argv){
+    static const char *outcomes[] = {"OK", "CRASH", "TIMEOUT"};
+    struct fuzzTarget target = {0};
+    uint64_t boot = 100000000;
+    const char *length = 0;
+    uint32_t capacity = 0, size;
+    struct elf elf;
+    int option, outcome;
+
+    target.timeout = 1000000;
+    while((option = getopt(argc, argv, "c:l:at:b:")) != -1){
+        switch(option){
+        case 'c':
+            capacity = strtoul(optarg, 0, 0);
+            break;
+        case 'l':
+            length = optarg;
+            break;
+        case 'a':
+            target.arguments = 1;
+            break;
+        case 't':
+            target.timeout = strtoull(optarg, 0, 0);
+            break;
+        case 'b':
+            boot = strtoull(optarg, 0, 0);
+            break;
+        default:
+            return 2;
+        }
+    }
+    if(argc - optind < 4){
+        printf("usage: fuzz.exe [-c bytes] [-l symbol] [-a] [-t cycles] [-b cycles] firmware.elf entry exit buffer [input]\n");
+        return 2;
+    }
+
+    if(!elfOpen(argv[optind], &elf)){
+        printf("CANNOT READ %s.", argv[optind]);
+        return 1;
+    }
+    target.entry = address(&elf, argv[optind + 1], &size) / 2;
+    target.exit = address(&elf, argv[optind + 2], &size) / 2;
+    target.buffer = address(&elf, argv[optind + 3], &size);
+    target.capacity = capacity ? capacity : size;
+    if(length){
+        target.length = address(&elf, length, &size);
+    }
+
+    reset();
+    if(!elfLoad(&elf, (uint8_t *)FLASH, FLASHSIZE * 2, eepromContents(), EEPROMSIZE)){
+        printf("CANNOT LOAD %s.", argv[optind]);
+        return 1;
+    }
+    elfClose(&elf);
+    invalidateFlash(0, FLASHSIZE);
+
+    if(!fuzzBoot(&target, boot)){
+        printf("ENTRY POINT NOT REACHED.");
+        return 1;
+    }
+
+    outcome = fuzzServe(argc - optind > 4 ? argv[optind + 4] : 0);
+    printf("%s\n", outcomes[outcome]);
+    if(outcome == FUZZ_CRASH){
+        abort();
+    }
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "gpio.h"
+#include "pinring.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "snapshot.h"
+#include "replay.h"
+
+/*
+Ports B, C and D (and E on the ATmega2560), pin change interrupts PCINT0-2 on ports B, C
+and D, and the external interrupts of the device, INT0 (PD2) and INT1 (PD3) on the
+ATmega328P, INT0-INT7 on the ATmega2560: their pins are EXTINT_PINS of device.h, INT0-3
+sensed by EICRA and INT4-7 by EICRB.
+
+Each port is PINx, DDRx and PORTx at consecutive addresses. A pin configured as output
+follows PORTx. An input pin follows the level the host drives on it with setPin(), or
+its pull-up (PORTx bit) when the host leaves it released.
+
+PINx is kept up to date in DATA whenever a level changes, so reading it needs no handler
+and polling loops on it can be skipped until the next event. Writing a one to a PINx bit
+toggles the PORTx bit.
+
+Every level change is written to the pin ring given to observePins(), if any.
+*/
+
+#define PIN(port) (PINB + 3 * (port))
+#define DDR(port) (DDRB + 3 * (port))
+#define PORT(port) (PORTB + 3 * (port))
+
+static const uint8_t extintPins[NEXTINT] = EXTINT_PINS;
+
+static MCUSTATE uint8_t driven[NPORTS]; // Input pins driven by the host
+static MCUSTATE uint8_t inputs[NPORTS]; // Levels driven by the host
+static MCUSTATE struct pinring *ring;
+static MCUSTATE void (*watcher)(int port);
+
+static uint8_t levels(int port){
+    uint8_t ddr = DATA[DDR(port)];
+    uint8_t out = DATA[PORT(port)];
+
+    return (ddr & out) | (~ddr & ((driven[port] & inputs[port]) | (~driven[port] & out)));
+}
+
+// External interrupt sense control of INTn, from EICRA, or EICRB from INT4 on
+static int senseControl(int n){
+    return (DATA[n < 4 ? EICRA : EICRB] >> (2 * (n & 3))) & 0x03;
+}
+
+// Level of the pin of INTn
+static int extintLevel(int n){
+    return (DATA[PIN(extintPins[n] >> 3)] >> (extintPins[n] & 7)) & 1;
+}
+
+// Recompute the levels of a port and raise the interrupts of the pins that changed
+static void update(int port){
+    uint8_t old = DATA[PIN(port)];
+    uint8_t now = levels(port);
+    uint8_t changed = old ^ now;
+    int n;
+
+    DATA[PIN(port)] = now;
+
+    if(watcher){
+        watcher(port);
+    }
+
+    if(changed == 0){
+        return;
+    }
+
+    if(ring){
+        struct pinevent e = {CYCLES, port, now, DATA[DDR(port)]};
+
+        pinRingPush(ring, e);
+    }
+
+    if(port <= GPIOD && (changed & DATA[PCMSK0 + port])){
+        DATA[PCIFR] |= 1 << port;
+    }
+
+    for(n = 0; n < NEXTINT; n++){
+        uint8_t bit = 1 << (extintPins[n] & 7);
+
+        if(extintPins[n] >> 3 == port && (changed & bit)){
+            int isc = senseControl(n);
+
+            if(isc == 1 || (isc == 2 && !(now & bit)) || (isc == 3 && (now & bit))){
+                DATA[EIFR] |= 1 << n;
+            }
+        }
+    }
+
+    updateInterrupts();
+}
+
+static void writePort(uint16_t addr, uint8_t value){
+    DATA[addr] = value;
+    update((addr - PINB) / 3);
+}
+
+// Writing a logic one to PINxn toggles PORTxn
+static void writePin(uint16_t addr, uint8_t value){
+    DATA[addr + 2] ^= value;
+    update((addr - PINB) / 3);
+}
+
+// Flags are cleared by writing a logical one to them
+static void writeFlags(uint16_t addr, uint8_t value){
+    DATA[addr] &= ~value;
+    updateInterrupts();
+}
+
+static void writeControl(uint16_t addr, uint8_t value){
+    DATA[addr] = value;
+    updateInterrupts();
+}
+
+// INTn is requested on a flagged edge, or while the pin is low in low level mode
+static int pendingINT(int n){
+    if(!(DATA[EIMSK] & (1 << n))){
+        return 0;
+    }
+    if(senseControl(n) == 0){
+        return !extintLevel(n);
+    }
+    return DATA[EIFR] & (1 << n);
+}
+
+#define EXTINT(n) \
+    static int pendingINT##n(){ \
+        return pendingINT(n); \
+    } \
+    static void acknowledgeINT##n(){ \
+        DATA[EIFR] &= ~(1 << n); \
+    }
+
+EXTINT(0)
+EXTINT(1)
+EXTINT(2)
+EXTINT(3)
+EXTINT(4)
+EXTINT(5)
+EXTINT(6)
+EXTINT(7)
+
+static int (*const pendingINTs[8])() = {pendingINT0, pendingINT1, pendingINT2, pendingINT3, pendingINT4, pendingINT5, pendingINT6, pendingINT7};
+static void (*const acknowledgeINTs[8])() = {acknowledgeINT0, acknowledgeINT1, acknowledgeINT2, acknowledgeINT3, acknowledgeINT4, acknowledgeINT5, acknowledgeINT6, acknowledgeINT7};
+
+static int pendingPCINT0(){
+    return DATA[PCICR] & DATA[PCIFR] & (1 << 0);
+}
+
+static int pendingPCINT1(){
+    return DATA[PCICR] & DATA[PCIFR] & (1 << 1);
+}
+
+static int pendingPCINT2(){
+    return DATA[PCICR] & DATA[PCIFR] & (1 << 2);
+}
+
+static void acknowledgePCINT0(){
+    DATA[PCIFR] &= ~(1 << 0);
+}
+
+static void acknowledgePCINT1(){
+    DATA[PCIFR] &= ~(1 << 1);
+}
+
+static void acknowledgePCINT2(){
+    DATA[PCIFR] &= ~(1 << 2);
+}
+
+void initGpio(){
+    int port, n;
+
+    ring = 0;
+    watcher = 0;
+
+    for(port = 0; port < NPORTS; port++){
+        driven[port] = 0;
+        inputs[port] = 0;
+
+        setIOHandlers(PIN(port), 0, writePin);
+        setIOHandlers(DDR(port), 0, writePort);
+        setIOHandlers(PORT(port), 0, writePort);
+    }
+
+    keepState(driven, sizeof(driven));
+    keepState(inputs, sizeof(inputs));
+
+    setIOHandlers(PCIFR, 0, writeFlags);
+    setIOHandlers(EIFR, 0, writeFlags);
+    setIOHandlers(EIMSK, 0, writeControl);
+    setIOHandlers(PCICR, 0, writeControl);
+    setIOHandlers(EICRA, 0, writeControl);
+    if(NEXTINT > 4){
+        setIOHandlers(EICRB, 0, writeControl);
+    }
+    setIOHandlers(PCMSK0, 0, writeControl);
+    setIOHandlers(PCMSK1, 0, writeControl);
+    setIOHandlers(PCMSK2, 0, writeControl);
+
+    for(n = 0; n < NEXTINT; n++){
+        setInterrupt(INT0_vect + n, pendingINTs[n], acknowledgeINTs[n]);
+    }
+    setInterrupt(PCINT0_vect, pendingPCINT0, acknowledgePCINT0);
+    setInterrupt(PCINT1_vect, pendingPCINT1, acknowledgePCINT1);
+    setInterrupt(PCINT2_vect, pendingPCINT2, acknowledgePCINT2);
+}
+
+/* Drives a pin high (1) or low (0), or releases it (2). The host calls are inputs of the MCU
+(replay.c): recorded, and ignored while a recording replays. */
+void drivePin(int port, int pin, int level){
+    if(level == 2){
+        driven[port] &= ~(1 << pin);
+    }
+    else{
+        driven[port] |= 1 << pin;
+    }
+    if(level == 1){
+        inputs[port] |= 1 << pin;
+    }
+    else if(level == 0){
+        inputs[port] &= ~(1 << pin);
+    }
+    update(port);
+}
+
+static void hostPin(int port, int pin, int level){
+    if(REPLAY == REPLAYING){
+        return;
+    }
+    if(REPLAY == RECORDING){
+        recordInput(INPUT_PIN, port << 8 | pin, level);
+    }
+    drivePin(port, pin, level);
+}
+
+/* Host side: drive an input pin high (1) or low (0) at the current cycle. */
+void setPin(int port, int pin, int level){
+    hostPin(port, pin, level != 0);
+}
+
+/* Host side: stop driving a pin, leaving it to its pull-up. */
+void releasePin(int port, int pin){
+    hostPin(port, pin, 2);
+}
+
+/* Calls watch after every write to the registers of a port and every change of its inputs,
+whether a level changed or not, for a peripheral that depends on the direction of the
+pins too, such as the chip selects of spi.c. Reset removes it. */
+void watchPorts(void (*watch)(int port)){
+    watcher = watch;
+}
+
+/* Send every pin change of this MCU to ring, 0 to stop. */
+void observePins(struct pinring *r){
+    flushPins();
+    ring = r;
+}
+
+/* Publish the pin changes not published yet. */
+void flushPins(){
+    if(ring){
+        pinRingFlush(ring);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+
+struct pinring;
+
+/* I/O ports and external interrupt registers, as data space addresses */
+#define PINB 0x23
+#define DDRB 0x24
+#define PORTB 0x25
+#define PINC 0x26
+#define DDRC 0x27
+#define PORTC 0x28
+#define PIND 0x29
+#define DDRD 0x2A
+#define PORTD 0x2B
+#define PINE 0x2C          // ATmega2560
+#define DDRE 0x2D
+#define PORTE 0x2E
+#define PCIFR 0x3B
+#define EIFR 0x3C
+#define EIMSK 0x3D
+#define PCICR 0x68
+#define EICRA 0x69
+#define EICRB 0x6A          // ATmega2560
+#define PCMSK0 0x6B
+#define PCMSK1 0x6C
+#define PCMSK2 0x6D
+
+/* Port numbers */
+#define GPIOB 0
+#define GPIOC 1
+#define GPIOD 2
+#define GPIOE 3             // ATmega2560
+
+void initGpio();
+void setPin(int port, int pin, int level);
+void releasePin(int port, int pin);
+void drivePin(int port, int pin, int level);
+void watchPorts(void (*watch)(int port));
+void observePins(struct pinring *ring);
+void flushPins();
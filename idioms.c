@@ -0,0 +1,244 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "idioms.h"
+#include "registers.h"
+#include "functions.h"
+#include "sram.h"
+#include <string.h>
+
+/*
+The loops below are the inner loops of avr-libc memcpy, memset and strlen:
+
+    memcpy:  ld rT,P+ / st Q+,rT / sbiw rC,1 / brne .-8     8 cycles per byte
+    memset:  st Q+,rS / sbiw rC,1 / brne .-6                6 cycles per byte
+    strlen:  ld rT,P+ / tst rT / brne .-6                   5 cycles per byte
+
+When PC is at the first instruction of one of them, every iteration but the last is
+done at once on the host and charged its exact cycle cost. The last iteration is left
+to the decoder, so the flags and the branch at the exit are computed by the real
+instructions and the state is the same as if every instruction had been stepped.
+The iterations done at once never go past the next peripheral event, so events and
+interrupts are seen at the same instruction as when stepping, and the flags are left as
+the last of them would leave them.
+
+Only iterations that stay inside SRAM are accelerated; accesses to registers or I/O
+are always stepped.
+*/
+
+#define BRNE_BACK3 0xF7E9
+#define BRNE_BACK4 0xF7E1
+
+// Pointer register of a post-increment LD/ST opcode, 0 if it is not one
+static int postIncPointer(uint16_t opcode){
+    switch(opcode & 0x000F){
+    case 0x1:
+        return REGZ;
+    case 0x9:
+        return REGY;
+    case 0xD:
+        return REGX;
+    }
+    return 0;
+}
+
+// Register pair of SBIW rC,1, 0 if the opcode is not one
+static int decrementPair(uint16_t opcode){
+    if((opcode & 0xFFCF) != 0x9701){
+        return 0;
+    }
+    return 24 + ((opcode >> 3) & 0x06);
+}
+
+// True if register r belongs to the pair starting at p
+static int inPair(int r, int p){
+    return r == p || r == p + 1;
+}
+
+// Number of iterations that can run on the host for a block of n bytes at addr
+static uint32_t sramSpan(uint16_t addr, uint32_t n){
+    if(addr < SRAMSTART || addr > RAMEND){
+        return 0;
+    }
+    if(n > (uint32_t)(RAMEND + 1 - addr)){
+        n = RAMEND + 1 - addr;
+    }
+    return n;
+}
+
+// Iterations of cost cycles each that fit before limit
+static uint32_t fit(uint32_t n, int cost, uint64_t limit){
+    if(n > limit / cost){
+        n = limit / cost;
+    }
+    return n;
+}
+
+static int blockCopy(int rt, int p, int q, int rc, uint64_t limit){
+    uint32_t n = getPointer(rc);
+    uint16_t src = getPointer(p);
+    uint16_t dst = getPointer(q);
+    uint32_t i;
+
+    if(n == 0){
+        n = 65536;
+    }
+    n--;
+    n = sramSpan(src, n);
+    n = sramSpan(dst, n);
+    n = fit(n, 8, limit);
+    if(n == 0){
+        return 0;
+    }
+
+    sramMarkRange(SRAMREAD, src, n);
+    sramMarkRange(SRAMWRITTEN, dst, n);
+
+    if(dst > src && dst < src + n){
+        // Overlapping forward copy repeats the leading bytes, exactly like the loop does
+        for(i = 0; i < n; i++){
+            DATA[dst + i] = DATA[src + i];
+        }
+    }
+    else{
+        memmove(&DATA[dst], &DATA[src], n);
+    }
+
+    R[rt] = DATA[src + n - 1];
+    setPointer(p, src + n);
+    setPointer(q, dst + n);
+    setPointer(rc, getPointer(rc) - n);
+    computeSBIWflags(getPointer(rc) + 1, getPointer(rc));
+
+    return 8 * n;
+}
+
+static int blockSet(int rs, int q, int rc, uint64_t limit){
+    uint32_t n = getPointer(rc);
+    uint16_t dst = getPointer(q);
+
+    if(n == 0){
+        n = 65536;
+    }
+    n = sramSpan(dst, n - 1);
+    n = fit(n, 6, limit);
+    if(n == 0){
+        return 0;
+    }
+
+    memset(&DATA[dst], R[rs], n);
+    sramMarkRange(SRAMWRITTEN, dst, n);
+
+    setPointer(q, dst + n);
+    setPointer(rc, getPointer(rc) - n);
+    computeSBIWflags(getPointer(rc) + 1, getPointer(rc));
+
+    return 6 * n;
+}
+
+static int stringLength(int rt, int p, uint64_t limit){
+    uint16_t src = getPointer(p);
+    uint32_t n = sramSpan(src, 65536);
+    uint8_t *end;
+
+    if(n == 0){
+        return 0;
+    }
+
+    // The terminating zero is loaded and tested by the decoder
+    end = memchr(&DATA[src], 0, n);
+    if(end != NULL){
+        n = end - &DATA[src];
+    }
+    n = fit(n, 5, limit);
+    if(n == 0){
+        return 0;
+    }
+
+    R[rt] = DATA[src + n - 1];
+    setPointer(p, src + n);
+    sramMarkRange(SRAMREAD, src, n);
+
+    // The flags of the last TST, on a byte that is not zero
+    SREG.V = 0;
+    SREG.N = R[rt] >> 7;
+    SREG.Z = 0;
+    computeS();
+
+    return 5 * n;
+}
+
+/* Matches the block loop starting at pc. With run set, runs it on the host for at most limit
+cycles and returns the cycles it took; otherwise returns nonzero if pc is at one. */
+static int blockLoop(pc_t pc, uint64_t limit, int run){
+    uint16_t w0 = FLASH[pc];
+
+    if((w0 & 0xFC00) != 0x9000 || pc + 3 >= FLASHSIZE){
+        return 0;
+    }
+
+    uint16_t w1 = FLASH[pc + 1];
+    uint16_t w2 = FLASH[pc + 2];
+    uint16_t w3 = FLASH[pc + 3];
+    int r0 = (w0 >> 4) & 0x1F;
+    int p0 = postIncPointer(w0);
+
+    if(p0 == 0){
+        return 0;
+    }
+
+    if(w0 & 0x0200){
+        // st Q+,rS / sbiw rC,1 / brne
+        int rc = decrementPair(w1);
+
+        if(rc && w2 == BRNE_BACK3 && rc != p0 && !inPair(r0, p0) && !inPair(r0, rc)){
+            return !run ? 1 : blockSet(r0, p0, rc, limit);
+        }
+        return 0;
+    }
+
+    // ld rT,P+ / st Q+,rT / sbiw rC,1 / brne
+    int q = postIncPointer(w1);
+    if((w1 & 0xFE00) == 0x9200 && q && ((w1 >> 4) & 0x1F) == r0){
+        int rc = decrementPair(w2);
+
+        if(rc && w3 == BRNE_BACK4 && q != p0 && rc != p0 && rc != q &&
+           !inPair(r0, p0) && !inPair(r0, q) && !inPair(r0, rc)){
+            return !run ? 1 : blockCopy(r0, p0, q, rc, limit);
+        }
+        return 0;
+    }
+
+    // ld rT,P+ / tst rT / brne
+    if(w1 == (0x2000 | ((r0 & 0x10) << 5) | (r0 << 4) | (r0 & 0x0F)) && w2 == BRNE_BACK3 && !inPair(r0, p0)){
+        return !run ? 1 : stringLength(r0, p0, limit);
+    }
+
+    return 0;
+}
+
+/* Runs the block loop starting at PC on the host, for at most limit cycles. Returns the cycles
+it took, 0 if PC is not at one. */
+int acceleratedIdiom(uint64_t limit){
+    return blockLoop(PC, limit, 1);
+}
+
+/* Nonzero if a block loop starts at pc. Only FLASH is looked at. */
+int idiomAt(pc_t pc){
+    return blockLoop(pc, 0, 0);
+}
@@ -0,0 +1,26 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+#include "registers.h"
+
+/* Host acceleration of the avr-libc block copy loops */
+
+int acceleratedIdiom(uint64_t limit);
+int idiomAt(pc_t pc);
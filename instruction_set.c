@@ -19,7 +19,9 @@ email: rrramires@homail.com
 #include "instruction_set.h"
 #include "registers.h"
 #include "functions.h"
+#include "spm.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 /*
 Bit assignments:
@@ -102,6 +104,33 @@ void ADD(int rd, int rr){
     PC++;
 }
 
+/* ADIW – Add Immediate to Word
+Adds an immediate value (0 - 63) to a register pair and places the result in the register pair. This
+instruction operates on the upper four register pairs, and is well suited for operations on the pointer
+registers.
+
+Rd+1:Rd ← Rd+1:Rd + K
+PC ← PC + 1
+
+d ∈ {24,26,28,30}, 0 ≤ K ≤ 63
+
+1001 0110 KKdd KKKK */
+void ADIW(int rd, uint8_t K){
+    uint16_t Rd = getPointer(rd);
+
+    uint16_t result = Rd + K;
+
+    SREG.V = ((~Rd & result) >> 15) & 1;
+    SREG.N = (result >> 15) & 1;
+    SREG.Z = (result == 0);
+    SREG.C = ((~result & Rd) >> 15) & 1;
+    computeS();
+
+    setPointer(rd, result);
+
+    PC++;
+}
+
 /* AND - Logical AND
 Performs the logical AND between the contents of register Rd and register Rr, and places the result in the
 destination register Rd.
@@ -143,10 +172,34 @@ void ANDI(int rd, uint8_t k){
 
     uint8_t result = Rd & k;
 
-    computeN8bits(result);
     SREG.V = 0;
+    computeN8bits(result);
+    computeZ8bits(result);
     computeS();
+
+    R[rd] = result;
+
+    PC++;
+}
+
+/* ASR – Arithmetic Shift Right
+Shifts all bits in Rd one place to the right. Bit 7 is held constant. Bit 0 is loaded into the C Flag of the
+SREG. This operation effectively divides a signed value by two without changing its sign. The Carry Flag
+can be used to round the result.
+
+0 ≤ d ≤ 31
+
+1001 010d dddd 0101 */
+void ASR(int rd){
+    uint8_t Rd = R[rd];
+
+    uint8_t result = (Rd & 0x80) | (Rd >> 1);
+
+    SREG.C = Rd & 1;
+    computeN8bits(result);
     computeZ8bits(result);
+    SREG.V = SREG.N ^ SREG.C;
+    computeS();
 
     R[rd] = result;
 
@@ -218,7 +271,9 @@ Rd(b) ← T
 void BLD(uint8_t rd, uint8_t b){
     uint8_t Rd = R[rd];
 
-    Rd |= SREG.T << b;
+    Rd = (Rd & ~(1 << b)) | (SREG.T << b);
+
+    R[rd] = Rd;
 
     PC++;
 }
@@ -262,7 +317,7 @@ else
 0 ≤ s ≤ 7, -64 ≤ k ≤ +63
 
 1111 00kk kkkk ksss */
-void BRBS(int k, int s){
+void BRBS(int s, int k){
     uint8_t flag;
 
     flag = getSREGflag(s);
@@ -772,6 +827,8 @@ void BST(int rd, int b){
     else{
         SREG.T = 0;
     }
+
+    PC++;
 }
 
 /*CALL – Long Call to a Subroutine
@@ -780,13 +837,20 @@ CALL) will be stored onto the Stack. (See also RCALL). The Stack Pointer uses a
 scheme during CALL.
 
 PC ← k Devices with 16-bit PC, 128KB Program memory maximum.
+STACK ← PC + 2
+SP ← SP - 2, (2 bytes, 16 bits)
 
 PC ← k Devices with 22-bit PC, 8MB Program memory maximum.
+STACK ← PC + 2
+SP ← SP - 3 (3 bytes, 22 bits)
 
 0 ≤ k < 64K
 
 1001 010k kkkk 111k kkkk kkkk kkkk kkkk */
 void CALL(int k){
+    PC = PC + 2;
+    pushPC();
+
     PC = k;
 }
 
@@ -801,14 +865,13 @@ I/O(A,b) ← 0
 
 1001 1000 AAAA Abbb */
 void CBI(int A, uint8_t b){
-    uint8_t mask = 1;
-    mask = 0 << b;
+    uint8_t mask = ~(1 << b);
 
-    uint8_t RA = R[A];
+    uint8_t RA = readDATA(A + 0x20);
 
     RA = RA & mask;
 
-    R[A] = RA;
+    writeDATA(A + 0x20, RA);
 
     PC++;
 }
@@ -828,10 +891,10 @@ void CBR(int rd, uint8_t k){
     
     R[rd] = Rd;
 
-    computeS();
     SREG.V = 0;
     computeN8bits(Rd);
     computeZ8bits(Rd);
+    computeS();
 
     PC++;
 }
@@ -952,17 +1015,15 @@ Rd ← $FF - Rd
 void COM(int rd){
     uint8_t Rd = R[rd];
 
-    uint8_t result = Rd & (255 - Rd);
+    uint8_t result = 255 - Rd;
 
     R[rd] = result;
 
-    computeS();
-
     SREG.V = 0;
-
     computeN8bits(result);
     computeZ8bits(result);
     SREG.C = 1;
+    computeS();
 
     PC++;
 }
@@ -981,19 +1042,14 @@ void CP(int rd, int rr){
 
     uint8_t result = Rd - Rr;
 
-    computeH8bits(Rd, Rr, result);
-    computeS();
-    computeV8bits(Rd, Rr, result);
-    computeN8bits(result);
-    computeZ8bits(result);
-    computeC8bits(Rd, Rr, result);
+    computeSUBflags(Rd, Rr, result);
 
     PC++;
 }
 
 /* This instruction performs a compare between two registers Rd and Rr and also takes into account the
 previous carry. None of the registers are changed. All conditional branches can be used after this
-instruction.
+instruction. Z is only cleared, as in SBC.
 
 Rd - Rr - C
 
@@ -1004,14 +1060,12 @@ void CPC(int rd, int rr){
     uint8_t Rr = R[rr];
     uint8_t Rd = R[rd];
 
+    uint8_t Z = SREG.Z;
+
     uint8_t result = Rd - Rr - SREG.C;
 
-    computeH8bits(Rd, Rr, result);
-    computeS();
-    computeV8bits(Rd, Rr, result);
-    computeN8bits(result);
-    computeZ8bits(result);
-    computeC8bits(Rd, Rr, result);
+    computeSUBflags(Rd, Rr, result);
+    SREG.Z = SREG.Z & Z;
 
     PC++;
 }
@@ -1029,12 +1083,27 @@ void CPI(int rd, uint8_t K){
 
     uint8_t result = Rd - K;
 
-    computeH8bits(Rd, K, result);
-    computeS();
-    computeV8bits(Rd, K, result);
-    computeN8bits(result);
-    computeZ8bits(result);
-    computeC8bits(Rd, K, result);
+    computeSUBflags(Rd, K, result);
+
+    PC++;
+}
+
+/* CPSE – Compare Skip if Equal
+This instruction performs a compare between registers Rd and Rr, and skips the next instruction if Rd =
+Rr.
+
+If Rd = Rr then PC ← PC + 2 (or 3) else PC ← PC + 1
+
+0 ≤ d ≤ 31, 0 ≤ r ≤ 31
+
+0001 00rd dddd rrrr */
+void CPSE(int rd, int rr){
+    if(R[rd] == R[rr]){
+        skipNext();
+    }
+    else{
+        PC++;
+    }
 }
 
 /* Subtracts one -1- from the contents of register Rd and places the result in the destination register Rd.
@@ -1055,9 +1124,10 @@ void DEC(int rd){
 
     R[rd] = result;
 
-    computeS();
+    SREG.V = (result == 0x7F);
     computeN8bits(result);
     computeZ8bits(result);
+    computeS();
 
     PC++;
 }
@@ -1078,10 +1148,129 @@ void EOR(int rd, int rr){
 
     R[rd] = result;
 
-    computeS();
     SREG.V = 0;
     computeN8bits(result);
     computeZ8bits(result);
+    computeS();
+
+    PC++;
+}
+
+/* ELPM – Extended Load Program Memory
+Loads one byte pointed to by the Z-register and the RAMPZ Register in the I/O space, and places this byte
+in the destination register Rd. Program memory is organized in 16-bit words while the Z-pointer is a byte
+address. Thus, the least significant bit of the Z-pointer selects either low byte (ZLSB = 0) or high byte
+(ZLSB = 1). On devices without RAMPZ (HAS_RAMPZ, device.h) it reads as zero and ELPM is LPM.
+
+R0 ← (RAMPZ:Z)          (i)
+Rd ← (RAMPZ:Z)          (ii)
+Rd ← (RAMPZ:Z), (RAMPZ:Z) ← (RAMPZ:Z) + 1  (iii)
+
+0 ≤ d ≤ 31
+
+(i)   1001 0101 1101 1000
+(ii)  1001 000d dddd 0110
+(iii) 1001 000d dddd 0111 */
+void ELPM(int rd, int inc){
+    uint32_t z = getPointer(REGZ);
+
+#if HAS_RAMPZ
+    z |= (uint32_t)DATA[RAMPZ] << 16;
+#endif
+
+    uint16_t word = FLASH[(z >> 1) % FLASHSIZE];
+
+    R[rd] = (z & 1) ? (word >> 8) : (word & 0xFF);
+
+    if(inc){
+        z++;
+        setPointer(REGZ, z & 0xFFFF);
+#if HAS_RAMPZ
+        DATA[RAMPZ] = (z >> 16) & 0xFF;
+#endif
+    }
+
+    PC++;
+}
+
+/* EICALL – Extended Indirect Call to Subroutine
+Indirect call of a subroutine pointed to by the Z (16 bits) Pointer Register in the Register File and the EIND
+Register in the I/O space. This instruction allows for indirect calls to the entire 4M (words) Program
+memory space. The Stack Pointer uses a post-decrement scheme during EICALL.
+This instruction is not available in all devices. Refer to the device specific instruction set summary.
+
+PC(15:0) ← Z(15:0)
+PC(21:16) ← EIND
+STACK ← PC + 1
+SP ← SP - 3 (3 bytes, 22 bits)
+
+1001 0101 0001 1001 */
+void EICALL(){
+    PC = PC + 1;
+    pushPC();
+
+    PC = ((pc_t)DATA[EIND] << 16) | getPointer(REGZ);
+}
+
+/* EIJMP – Extended Indirect Jump
+Indirect jump to the address pointed to by the Z (16 bits) Pointer Register in the Register File and the
+EIND Register in the I/O space. This instruction allows for indirect jumps to the entire 4M (words)
+Program memory space.
+This instruction is not available in all devices. Refer to the device specific instruction set summary.
+
+PC(15:0) ← Z(15:0)
+PC(21:16) ← EIND
+
+1001 0100 0001 1001 */
+void EIJMP(){
+    PC = ((pc_t)DATA[EIND] << 16) | getPointer(REGZ);
+}
+
+/* ICALL – Indirect Call to Subroutine
+Calls to a subroutine within the entire 4M (words) Program memory. The return address (to the instruction
+after the CALL) will be stored onto the Stack. See also RCALL. The Stack Pointer uses a post-decrement
+scheme during CALL. Indirect call of a subroutine pointed to by the Z (16 bits) Pointer Register in the
+Register File. The Z-pointer Register is 16 bits wide and allows call to a subroutine within the lowest
+64K words (128KB) section in the Program memory space.
+
+PC(15:0) ← Z(15:0) Devices with 16-bit PC, 128KB Program memory maximum.
+PC(15:0) ← Z(15:0) Devices with 22-bit PC, 8MB Program memory maximum.
+PC(21:16) ← 0
+STACK ← PC + 1
+
+1001 0101 0000 1001 */
+void ICALL(){
+    PC = PC + 1;
+    pushPC();
+
+    PC = getPointer(REGZ);
+}
+
+/* IJMP – Indirect Jump
+Indirect jump to the address pointed to by the Z (16 bits) Pointer Register in the Register File. The
+Z-pointer Register is 16 bits wide and allows jump within the lowest 64K words (128KB) section of Program
+memory.
+
+PC(15:0) ← Z Devices with 16-bit PC, 128KB Program memory maximum.
+PC(15:0) ← Z Devices with 22-bit PC, 8MB Program memory maximum.
+PC(21:16) ← 0
+
+1001 0100 0000 1001 */
+void IJMP(){
+    PC = getPointer(REGZ);
+}
+
+/* IN - Load an I/O Location to Register
+Loads data from the I/O Space (Ports, Timers, Configuration Registers, etc.) into register Rd in the
+Register File. The I/O location A is at data space address A + $20.
+
+Rd ← I/O(A)
+
+0 ≤ d ≤ 31, 0 ≤ A ≤ 63
+
+1011 0AAd dddd AAAA */
+void IN(int rd, int A){
+    R[rd] = readDATA(A + 0x20);
 
     PC++;
 }
@@ -1100,9 +1289,12 @@ Rd ← Rd + 1
 void INC(int rd){
     R[rd] = R[rd] + 1;
 
-    computeS();
+    SREG.V = (R[rd] == 0x80);
     computeN8bits(R[rd]);
     computeZ8bits(R[rd]);
+    computeS();
+
+    PC++;
 }
 
 /* Jump to an address within the entire 4M (words) Program memory. See also RJMP.
@@ -1117,6 +1309,52 @@ void JMP(int k){
     PC = k;
 }
 
+/* LD – Load Indirect from Data Space to Register using X, Y or Z
+Loads one byte indirect from the data space to a register. The pointer register p (X, Y or Z) can either be
+left unchanged by the operation, or it can be post-incremented or pre-decremented.
+
+Rd ← (p)                    Unchanged
+Rd ← (p), p ← p + 1         Post increment
+p ← p - 1, Rd ← (p)         Pre decrement
+
+0 ≤ d ≤ 31
+
+X: 1001 000d dddd 1100, 1001 000d dddd 1101 (X+), 1001 000d dddd 1110 (-X)
+Y: 1000 000d dddd 1000, 1001 000d dddd 1001 (Y+), 1001 000d dddd 1010 (-Y)
+Z: 1000 000d dddd 0000, 1001 000d dddd 0001 (Z+), 1001 000d dddd 0010 (-Z) */
+void LD(int rd, int p, int mode){
+    uint16_t addr = getPointer(p);
+
+    if(mode == PREDEC){
+        addr--;
+        setPointer(p, addr);
+    }
+
+    R[rd] = readDATA(addr);
+
+    if(mode == POSTINC){
+        setPointer(p, addr + 1);
+    }
+
+    PC++;
+}
+
+/* LDD – Load Indirect with Displacement
+Loads one byte indirect with displacement from the data space to a register, using the Y or Z pointer.
+The pointer is left unchanged.
+
+Rd ← (p + q)
+
+0 ≤ d ≤ 31, 0 ≤ q ≤ 63
+
+Y: 10q0 qq0d dddd 1qqq
+Z: 10q0 qq0d dddd 0qqq */
+void LDD(int rd, int p, int q){
+    R[rd] = readDATA(getPointer(p) + q);
+
+    PC++;
+}
+
 /* Loads an 8-bit constant directly to register 16 to 31
 
 Rd ← K
@@ -1130,6 +1368,49 @@ void LDI(int rd, uint8_t K){
     PC++;
 }
 
+/* LDS – Load Direct from Data Space
+Loads one byte from the data space to a register. The 16-bit address k is stored in the word following the
+opcode.
+
+Rd ← (k)
+PC ← PC + 2
+
+0 ≤ d ≤ 31, 0 ≤ k ≤ 65535
+
+1001 000d dddd 0000 kkkk kkkk kkkk kkkk */
+void LDS(int rd, uint16_t k){
+    R[rd] = readDATA(k);
+
+    PC = PC + 2;
+}
+
+/* LPM – Load Program Memory
+Loads one byte pointed to by the Z-register into the destination register Rd. The least significant bit of the
+Z-pointer selects either low byte (ZLSB = 0) or high byte (ZLSB = 1) of the program memory word.
+
+R0 ← (Z)                (i)
+Rd ← (Z)                (ii)
+Rd ← (Z), Z ← Z + 1     (iii)
+
+0 ≤ d ≤ 31
+
+(i)   1001 0101 1100 1000
+(ii)  1001 000d dddd 0100
+(iii) 1001 000d dddd 0101 */
+void LPM(int rd, int inc){
+    uint16_t z = getPointer(REGZ);
+
+    uint16_t word = FLASH[(z >> 1) % FLASHSIZE];
+
+    R[rd] = (z & 1) ? (word >> 8) : (word & 0xFF);
+
+    if(inc){
+        setPointer(REGZ, z + 1);
+    }
+
+    PC++;
+}
+
 /* Shifts all bits in Rd one place to the left. Bit 0 is cleared. Bit 7 is loaded into the C Flag of the SREG. This
 operation effectively multiplies signed and unsigned values by two.
 
@@ -1149,12 +1430,14 @@ void LSL(int rd){
     }
 
     uint8_t result = R[rd] << 1;
+
+    SREG.H = (R[rd] >> 3) & 1;
     R[rd] = result;
 
-    computeS();
-    SREG.V = SREG.N ^ SREG.C;
     computeN8bits(result);
     computeZ8bits(result);
+    SREG.V = SREG.N ^ SREG.C;
+    computeS();
 
     PC++;
 }
@@ -1180,10 +1463,10 @@ void LSR(int rd){
     uint8_t result = R[rd] >> 1;
     R[rd] = result;
 
-    computeS();
-    SREG.V = SREG.N ^ SREG.C;
     SREG.N = 0;
     computeZ8bits(result);
+    SREG.V = SREG.N ^ SREG.C;
+    computeS();
 
     PC++;
 }
@@ -1202,6 +1485,98 @@ void MOV(int rd, int rr){
     PC++;
 }
 
+/* MOVW – Copy Register Word
+This instruction makes a copy of one register pair into another register pair. The source register pair
+Rr+1:Rr is left unchanged, while the destination register pair Rd+1:Rd is loaded with a copy of Rr + 1:Rr.
+
+Rd+1:Rd ← Rr+1:Rr
+
+d ∈ {0,2,...,30}, r ∈ {0,2,...,30}
+
+0000 0001 dddd rrrr */
+void MOVW(int rd, int rr){
+    R[rd] = R[rr];
+    R[rd + 1] = R[rr + 1];
+
+    PC++;
+}
+
+/* MUL – Multiply Unsigned
+This instruction performs 8-bit × 8-bit → 16-bit unsigned multiplication. The multiplicand Rd and the
+multiplier Rr are two registers containing unsigned numbers. The 16-bit unsigned product is placed in R1
+(high byte) and R0 (low byte).
+
+R1:R0 ← Rd × Rr (unsigned ← unsigned × unsigned)
+
+0 ≤ d ≤ 31, 0 ≤ r ≤ 31
+
+1001 11rd dddd rrrr */
+void MUL(int rd, int rr){
+    uint16_t result = R[rd] * R[rr];
+
+    computeMULflags(result);
+    setPointer(0, result);
+
+    PC++;
+}
+
+/* MULS – Multiply Signed
+This instruction performs 8-bit × 8-bit → 16-bit signed multiplication.
+
+R1:R0 ← Rd × Rr (signed ← signed × signed)
+
+16 ≤ d ≤ 31, 16 ≤ r ≤ 31
+
+0000 0010 dddd rrrr */
+void MULS(int rd, int rr){
+    uint16_t result = (int8_t)R[rd] * (int8_t)R[rr];
+
+    computeMULflags(result);
+    setPointer(0, result);
+
+    PC++;
+}
+
+/* MULSU – Multiply Signed with Unsigned
+This instruction performs 8-bit × 8-bit → 16-bit multiplication of a signed and an unsigned number. The
+multiplicand Rd is signed, the multiplier Rr is unsigned.
+
+R1:R0 ← Rd × Rr (signed ← signed × unsigned)
+
+16 ≤ d ≤ 23, 16 ≤ r ≤ 23
+
+0000 0011 0ddd 0rrr */
+void MULSU(int rd, int rr){
+    uint16_t result = (int8_t)R[rd] * R[rr];
+
+    computeMULflags(result);
+    setPointer(0, result);
+
+    PC++;
+}
+
+/* FMUL, FMULS, FMULSU – Fractional Multiply
+These instructions perform 8-bit × 8-bit → 16-bit multiplication of 1.7 format numbers, unsigned, signed
+or signed with unsigned, and shift the result one bit left. C is bit 15 of the product before the shift.
+
+R1:R0 ← Rd × Rr << 1
+
+16 ≤ d ≤ 23, 16 ≤ r ≤ 23
+
+0000 0011 0ddd 1rrr (FMUL), 0000 0011 1ddd 0rrr (FMULS), 0000 0011 1ddd 1rrr (FMULSU) */
+void FMUL(int rd, int rr, int signedRd, int signedRr){
+    int a = signedRd ? (int8_t)R[rd] : R[rd];
+    int b = signedRr ? (int8_t)R[rr] : R[rr];
+    uint16_t product = a * b;
+
+    computeMULflags(product);
+    product <<= 1;
+    SREG.Z = (product == 0);
+    setPointer(0, product);
+
+    PC++;
+}
+
 /* Replaces the contents of register Rd with its two’s complement; the value $80 is left unchanged.
 
 Rd ← $00 - Rd
@@ -1210,11 +1585,11 @@ Rd ← $00 - Rd
 
 1001 010d dddd 0001 */
 void NEG(int rd){
-    R[rd] = 0 - R[rd];
+    uint8_t Rd = R[rd];
 
-    computeS();
-    computeN8bits(R[rd]);
-    computeZ8bits(R[rd]);
+    R[rd] = 0 - Rd;
+
+    computeSUBflags(0, Rd, R[rd]);
 
     PC++;
 }
@@ -1226,6 +1601,291 @@ void NOP(){
     PC++;
 }
 
+/* OR – Logical OR
+Performs the logical OR between the contents of register Rd and register Rr, and places the result in the
+destination register Rd.
+
+Rd ← Rd v Rr
+
+0 ≤ d ≤ 31, 0 ≤ r ≤ 31
+
+0010 10rd dddd rrrr */
+void OR(int rd, int rr){
+    uint8_t result = R[rd] | R[rr];
+
+    R[rd] = result;
+
+    SREG.V = 0;
+    computeN8bits(result);
+    computeZ8bits(result);
+    computeS();
+
+    PC++;
+}
+
+/* OUT – Store Register to I/O Location
+Stores data from register Rr in the Register File to I/O Space (Ports, Timers, Configuration Registers, etc.).
+
+I/O(A) ← Rr
+
+0 ≤ r ≤ 31, 0 ≤ A ≤ 63
+
+1011 1AAr rrrr AAAA */
+void OUT(int A, int rr){
+    writeDATA(A + 0x20, R[rr]);
+
+    PC++;
+}
+
+/* POP – Pop Register from Stack
+This instruction loads register Rd with a byte from the STACK. The Stack Pointer is pre-incremented by 1
+before the POP.
+
+Rd ← STACK
+
+0 ≤ d ≤ 31
+
+1001 000d dddd 1111 */
+void POP(int rd){
+    R[rd] = pop();
+
+    PC++;
+}
+
+/* PUSH – Push Register on Stack
+This instruction stores the contents of register Rr on the STACK. The Stack Pointer is post-decremented
+by 1 after the PUSH.
+
+STACK ← Rr
+
+0 ≤ r ≤ 31
+
+1001 001d dddd 1111 */
+void PUSH(int rr){
+    push(R[rr]);
+
+    PC++;
+}
+
+/* RCALL – Relative Call to Subroutine
+Relative call to an address within PC - 2K + 1 and PC + 2K (words). The return address (the instruction
+after the RCALL) is stored onto the Stack.
+
+PC ← PC + k + 1
+STACK ← PC + 1
+
+-2K ≤ k < 2K
+
+1101 kkkk kkkk kkkk */
+void RCALL(int k){
+    PC = PC + 1;
+    pushPC();
+
+    PC = PC + k;
+}
+
+/* RET – Return from Subroutine
+Returns from subroutine. The return address is loaded from the STACK. The Stack Pointer uses a preincrement
+scheme during RET.
+
+PC(15:0) ← STACK Devices with 16-bit PC, 128KB Program memory maximum.
+SP ← SP + 2, (2bytes, 16 bits)
+PC(21:0) ← STACK Devices with 22-bit PC, 8MB Program memory maximum.
+SP ← SP + 3, (3bytes, 22 bits)
+
+1001 0101 0000 1000 */
+void RET(){
+    popPC();
+}
+
+/* RETI – Return from Interrupt
+Returns from interrupt. The return address is loaded from the STACK and the Global Interrupt Flag is set.
+Note that the Status Register is not automatically stored when entering an interrupt routine, and it is not
+restored when returning from an interrupt routine.
+
+PC(15:0) ← STACK Devices with 16-bit PC, 128KB Program memory maximum.
+SP ← SP + 2, (2bytes, 16 bits)
+PC(21:0) ← STACK Devices with 22-bit PC, 8MB Program memory maximum.
+SP ← SP + 3, (3bytes, 22 bits)
+
+I ← 1
+
+1001 0101 0001 1000 */
+void RETI(){
+    popPC();
+
+    SREG.I = 1;
+}
+
+/* RJMP – Relative Jump
+Relative jump to an address within PC - 2K +1 and PC + 2K (words). For AVR microcontrollers with
+Program memory not exceeding 4K words (8KB) this instruction can address the entire memory from
+every address location.
+
+PC ← PC + k + 1
+
+-2K ≤ k < 2K
+
+1100 kkkk kkkk kkkk */
+void RJMP(int k){
+    PC = PC + k + 1;
+}
+
+/* ROR – Rotate Right through Carry
+Shifts all bits in Rd one place to the right. The C Flag is shifted into bit 7 of Rd. Bit 0 is shifted into the
+C Flag.
+
+0 ≤ d ≤ 31
+
+1001 010d dddd 0111 */
+void ROR(int rd){
+    uint8_t Rd = R[rd];
+
+    uint8_t result = (SREG.C << 7) | (Rd >> 1);
+
+    SREG.C = Rd & 1;
+    computeN8bits(result);
+    computeZ8bits(result);
+    SREG.V = SREG.N ^ SREG.C;
+    computeS();
+
+    R[rd] = result;
+
+    PC++;
+}
+
+/* SBC – Subtract with Carry
+Subtracts two registers and subtracts with the C Flag, and places the result in the destination register
+Rd. The Z Flag is only cleared, so that it stays set after a multi-byte subtraction only if every byte was
+zero.
+
+Rd ← Rd - Rr - C
+
+0 ≤ d ≤ 31, 0 ≤ r ≤ 31
+
+0000 10rd dddd rrrr */
+void SBC(int rd, int rr){
+    uint8_t Rd = R[rd];
+    uint8_t Rr = R[rr];
+    uint8_t Z = SREG.Z;
+
+    uint8_t result = Rd - Rr - SREG.C;
+
+    computeSUBflags(Rd, Rr, result);
+    SREG.Z = SREG.Z & Z;
+
+    R[rd] = result;
+
+    PC++;
+}
+
+/* SBCI – Subtract Immediate with Carry
+Subtracts a constant from a register and subtracts with the C Flag, and places the result in the
+destination register Rd. Z is only cleared, as in SBC.
+
+Rd ← Rd - K - C
+
+16 ≤ d ≤ 31, 0 ≤ K ≤ 255
+
+0100 KKKK dddd KKKK */
+void SBCI(int rd, uint8_t K){
+    uint8_t Rd = R[rd];
+    uint8_t Z = SREG.Z;
+
+    uint8_t result = Rd - K - SREG.C;
+
+    computeSUBflags(Rd, K, result);
+    SREG.Z = SREG.Z & Z;
+
+    R[rd] = result;
+
+    PC++;
+}
+
+/* SBI – Set Bit in I/O Register
+Sets a specified bit in an I/O Register. This instruction operates on the lower 32 I/O Registers –
+addresses 0-31.
+
+I/O(A,b) ← 1
+
+0 ≤ A ≤ 31, 0 ≤ b ≤ 7
+
+1001 1010 AAAA Abbb */
+void SBI(int A, uint8_t b){
+    uint8_t RA = readDATA(A + 0x20);
+
+    RA = RA | (1 << b);
+
+    writeDATA(A + 0x20, RA);
+
+    PC++;
+}
+
+/* SBIC – Skip if Bit in I/O Register is Cleared
+This instruction tests a single bit in an I/O Register and skips the next instruction if the bit is cleared.
+This instruction operates on the lower 32 I/O Registers – addresses 0-31.
+
+If I/O(A,b) = 0 then 
+    PC ← PC + 2 (or 3) skip next instruction
+else 
+    PC ← PC + 1
+
+0 ≤ A ≤ 31, 0 ≤ b ≤ 7
+
+1001 1001 AAAA Abbb */
+void SBIC(int A, uint8_t b){
+    if((readDATA(A + 0x20) & (1 << b)) == 0){
+        skipNext();
+    }
+    else{
+        PC++;
+    }
+}
+
+/* SBIS – Skip if Bit in I/O Register is Set
+This instruction tests a single bit in an I/O Register and skips the next instruction if the bit is set. This
+instruction operates on the lower 32 I/O Registers – addresses 0-31.
+
+If I/O(A,b) = 1 then 
+    PC ← PC + 2 (or 3) skip next instruction
+else 
+    PC ← PC + 1
+
+0 ≤ A ≤ 31, 0 ≤ b ≤ 7
+
+1001 1011 AAAA Abbb */
+void SBIS(int A, uint8_t b){
+    if(readDATA(A + 0x20) & (1 << b)){
+        skipNext();
+    }
+    else{
+        PC++;
+    }
+}
+
+/* SBIW – Subtract Immediate from Word
+Subtracts an immediate value (0-63) from a register pair and places the result in the register pair. This
+instruction operates on the upper four register pairs, and is well suited for operations on the Pointer
+Registers.
+
+Rd+1:Rd ← Rd+1:Rd - K
+PC ← PC + 1
+
+d ∈ {24,26,28,30}, 0 ≤ K ≤ 63
+
+1001 0111 KKdd KKKK */
+void SBIW(int rd, uint8_t K){
+    uint16_t Rd = getPointer(rd);
+
+    uint16_t result = Rd - K;
+
+    computeSBIWflags(Rd, result);
+
+    setPointer(rd, result);
+
+    PC++;
+}
+
 /* Sets specified bits in register Rd. Performs the logical ORI between the contents of register Rd and a
 constant mask K, and places the result in the destination register Rd.
 
@@ -1237,14 +1897,54 @@ Rd ← Rd v K
 void SBR(int rd, uint8_t K){
     R[rd] = R[rd] | K;
 
-    computeS();
     SREG.V = 0;
     computeN8bits(R[rd]);
     computeZ8bits(R[rd]);
+    computeS();
 
     PC++;
 }
 
+/* SBRC – Skip if Bit in Register is Cleared
+This instruction tests a single bit in a register and skips the next instruction if the bit is cleared.
+
+If Rr(b) = 0 then 
+    PC ← PC + 2 (or 3) skip next instruction
+else 
+    PC ← PC + 1
+
+0 ≤ r ≤ 31, 0 ≤ b ≤ 7
+
+1111 110r rrrr 0bbb */
+void SBRC(int rr, uint8_t b){
+    if((R[rr] & (1 << b)) == 0){
+        skipNext();
+    }
+    else{
+        PC++;
+    }
+}
+
+/* SBRS – Skip if Bit in Register is Set
+This instruction tests a single bit in a register and skips the next instruction if the bit is set.
+
+If Rr(b) = 1 then 
+    PC ← PC + 2 (or 3) skip next instruction
+else 
+    PC ← PC + 1
+
+0 ≤ r ≤ 31, 0 ≤ b ≤ 7
+
+1111 111r rrrr 0bbb */
+void SBRS(int rr, uint8_t b){
+    if(R[rr] & (1 << b)){
+        skipNext();
+    }
+    else{
+        PC++;
+    }
+}
+
 /* Sets the Carry Flag (C) in SREG (Status Register).
 
 C ← 1
@@ -1338,6 +2038,164 @@ void SEZ(){
     PC++;
 }
 
+/* SLEEP
+This instruction sets the circuit in sleep mode defined by the MCU Control Register. The sleep mode is
+only entered when the Sleep Enable bit (SE) of SMCR is set. The MCU is woken by an enabled interrupt;
+the decoder then moves CYCLES directly to the next scheduled peripheral event instead of stepping.
+
+1001 0101 1000 1000 */
+void SLEEP(){
+    if(DATA[SMCR] & 0x01){
+        SLEEPING = 1;
+    }
+
+    PC++;
+}
+
+/* SPM – Store Program Memory
+SPM can be used to erase a page in the Program memory, to write a page in the Program memory (that is
+already erased), and to set Boot Loader Lock bits. An entire page is programmed simultaneously after first
+filling a temporary page buffer, and the Program memory must be erased one page at a time. When erasing
+the Program memory, the Z-register is used as page address. When writing the Program memory, the
+Z-register is used as page or word address, and the R1:R0 register pair is used as data. When setting
+the Boot Loader Lock bits, the R1:R0 register pair is used as data. The operation is selected by SPMCSR
+and the instruction only has effect when executed from the Boot Loader section (spm.c). Devices with
+more than 64KB of flash extend Z with RAMPZ.
+
+(Z) ← R1:R0 (Write Program memory word)
+(Z) ← $ffff (Erase Program memory page)
+
+1001 0101 1110 1000 */
+void SPM(){
+    uint32_t z = getPointer(REGZ);
+
+#if HAS_RAMPZ
+    z |= (uint32_t)DATA[RAMPZ] << 16;
+#endif
+    storeProgramMemory(z, (R[1] << 8) | R[0]);
+
+    PC++;
+}
+
+/* ST – Store Indirect From Register to Data Space using X, Y or Z
+Stores one byte indirect from a register to the data space. The pointer register p (X, Y or Z) can either be
+left unchanged by the operation, or it can be post-incremented or pre-decremented.
+
+(p) ← Rr                    Unchanged
+(p) ← Rr, p ← p + 1         Post increment
+p ← p - 1, (p) ← Rr         Pre decrement
+
+0 ≤ r ≤ 31
+
+X: 1001 001r rrrr 1100, 1001 001r rrrr 1101 (X+), 1001 001r rrrr 1110 (-X)
+Y: 1000 001r rrrr 1000, 1001 001r rrrr 1001 (Y+), 1001 001r rrrr 1010 (-Y)
+Z: 1000 001r rrrr 0000, 1001 001r rrrr 0001 (Z+), 1001 001r rrrr 0010 (-Z) */
+void ST(int rr, int p, int mode){
+    uint16_t addr = getPointer(p);
+
+    if(mode == PREDEC){
+        addr--;
+        setPointer(p, addr);
+    }
+
+    writeDATA(addr, R[rr]);
+
+    if(mode == POSTINC){
+        setPointer(p, addr + 1);
+    }
+
+    PC++;
+}
+
+/* STD – Store Indirect with Displacement
+Stores one byte indirect with displacement from a register to the data space, using the Y or Z pointer.
+The pointer is left unchanged.
+
+(p + q) ← Rr
+
+0 ≤ r ≤ 31, 0 ≤ q ≤ 63
+
+Y: 10q0 qq1r rrrr 1qqq
+Z: 10q0 qq1r rrrr 0qqq */
+void STD(int rr, int p, int q){
+    writeDATA(getPointer(p) + q, R[rr]);
+
+    PC++;
+}
+
+/* STS – Store Direct to Data Space
+Stores one byte from a Register to the data space. The 16-bit address k is stored in the word following the
+opcode.
+
+(k) ← Rr
+PC ← PC + 2
+
+0 ≤ r ≤ 31, 0 ≤ k ≤ 65535
+
+1001 001r rrrr 0000 kkkk kkkk kkkk kkkk */
+void STS(uint16_t k, int rr){
+    writeDATA(k, R[rr]);
+
+    PC = PC + 2;
+}
+
+/* SUB – Subtract Without Carry
+Subtracts two registers and places the result in the destination register Rd.
+
+Rd ← Rd - Rr
+
+0 ≤ d ≤ 31, 0 ≤ r ≤ 31
+
+0001 10rd dddd rrrr */
+void SUB(int rd, int rr){
+    uint8_t Rd = R[rd];
+    uint8_t Rr = R[rr];
+
+    uint8_t result = Rd - Rr;
+
+    computeSUBflags(Rd, Rr, result);
+
+    R[rd] = result;
+
+    PC++;
+}
+
+/* SUBI – Subtract Immediate
+Subtracts a register and a constant, and places the result in the destination register Rd. This
+instruction is working on Register R16 to R31 and is very well suited for operations on the X, Y, and Z-
+pointers.
+
+Rd ← Rd - K
+
+16 ≤ d ≤ 31, 0 ≤ K ≤ 255
+
+0101 KKKK dddd KKKK */
+void SUBI(int rd, uint8_t K){
+    uint8_t Rd = R[rd];
+
+    uint8_t result = Rd - K;
+
+    computeSUBflags(Rd, K, result);
+
+    R[rd] = result;
+
+    PC++;
+}
+
+/* SWAP – Swap Nibbles
+Swaps high and low nibbles in a register.
+
+R(7:4) ← Rd(3:0), R(3:0) ← Rd(7:4)
+
+0 ≤ d ≤ 31
+
+1001 010d dddd 0010 */
+void SWAP(int rd){
+    R[rd] = (R[rd] << 4) | (R[rd] >> 4);
+
+    PC++;
+}
+
 /* Tests if a register is zero or negative. Performs a logical AND between a register and itself. The register
 will remain unchanged.
 
@@ -1348,11 +2206,19 @@ Rd ← Rd • Rd
 0010 00dd dddd dddd */
 void TST(int rd){
     R[rd] = R[rd] & R[rd];
-    
-    computeS();
+
     SREG.V = 0;
     computeN8bits(R[rd]);
     computeZ8bits(R[rd]);
+    computeS();
 
     PC++;
-}
\ No newline at end of file
+}
+
+/* WDR – Watchdog Reset
+This instruction resets the Watchdog Timer. No watchdog is modeled, so it only takes its cycle.
+
+1001 0101 1010 1000 */
+void WDR(){
+    PC++;
+}
@@ -19,11 +19,18 @@ email: rrramires@homail.com
 
 #include <stdint.h>
 
+/* Pointer addressing modes for LD and ST */
+#define UNCHANGED 0
+#define POSTINC 1
+#define PREDEC 2
+
 void ADC(int rd, int rr);
 void ADD(int rd, int rr);
+void ADIW(int rd, uint8_t K);
 
 void AND(int rd, int rr);
 void ANDI(int rd, uint8_t k);
+void ASR(int rd);
 
 void BCLR(int s);
 void BLD(uint8_t rd, uint8_t b);
@@ -45,7 +52,9 @@ void BRNE(int k);
 void BRPL(int k);
 void BRSH(int k);
 void BRTC(int k);
+void BRTS(int k);
 void BRVC(int k);
+void BRVS(int k);
 void BSET(int s);
 void BST(int rd, int b);
 void CALL(int k);
@@ -64,23 +73,60 @@ void COM(int rd);
 void CP(int rd, int rr);
 void CPC(int rd, int rr);
 void CPI(int rd, uint8_t K);
+void CPSE(int rd, int rr);
 
 void DEC(int rd);
 
+void EICALL();
+void EIJMP();
+void ELPM(int rd, int inc);
 void EOR(int rd, int rr);
 
+void ICALL();
+void IJMP();
+void IN(int rd, int A);
 void INC(int rd);
 
+void JMP(int k);
+
+void LD(int rd, int p, int mode);
+void LDD(int rd, int p, int q);
 void LDI(int rd, uint8_t K);
+void LDS(int rd, uint16_t k);
+void LPM(int rd, int inc);
 
 void LSL(int rd);
 void LSR(int rd);
 void MOV(int rd, int rr);
+void MOVW(int rd, int rr);
+void MUL(int rd, int rr);
+void MULS(int rd, int rr);
+void MULSU(int rd, int rr);
+void FMUL(int rd, int rr, int signedRd, int signedRr);
 
 void NEG(int rd);
 void NOP();
-
+void OR(int rd, int rr);
+
+void OUT(int A, int rr);
+void POP(int rd);
+void PUSH(int rr);
+
+void RCALL(int k);
+void RET();
+void RETI();
+void RJMP(int k);
+void ROR(int rd);
+
+void SBC(int rd, int rr);
+void SBCI(int rd, uint8_t K);
+void SBI(int A, uint8_t b);
+void SBIC(int A, uint8_t b);
+void SBIS(int A, uint8_t b);
+void SBIW(int rd, uint8_t K);
 void SBR(int rd, uint8_t K);
+void SBRC(int rr, uint8_t b);
+void SBRS(int rr, uint8_t b);
 
 void SEC();
 void SEH();
@@ -91,4 +137,13 @@ void SES();
 void SET();
 void SEV();
 void SEZ();
-void TST(int rd);
\ No newline at end of file
+void SLEEP();
+void SPM();
+void ST(int rr, int p, int mode);
+void STD(int rr, int p, int q);
+void STS(uint16_t k, int rr);
+void SUB(int rd, int rr);
+void SUBI(int rd, uint8_t K);
+void SWAP(int rd);
+void TST(int rd);
+void WDR();
@@ -0,0 +1,120 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "interrupts.h"
+#include "registers.h"
+#include "functions.h"
+#include "stats.h"
+#include "snapshot.h"
+
+/*
+Each peripheral registers, for its vectors, a function telling if the interrupt is
+requested (flag and enable bit set) and a function clearing the flag when the vector
+is executed. Peripherals call updateInterrupts() whenever a flag or an enable bit
+changes, so the decoder only tests IRQ and the I flag before each instruction.
+*/
+
+struct interrupt{
+    int (*pending)();
+    void (*acknowledge)();
+};
+
+static MCUSTATE struct interrupt vectors[NVECTORS];
+
+MCUSTATE int IRQ;
+
+/* Interrupts able to wake the MCU in each SMCR sleep mode */
+#define BIT(vector) (1ULL << (vector))
+#define EXTERNAL ((BIT(NEXTINT) - 1) << INT0_vect | BIT(PCINT0_vect) | BIT(PCINT1_vect) | BIT(PCINT2_vect))
+#define TIMER2 (BIT(TIMER2_COMPA_vect) | BIT(TIMER2_COMPB_vect) | BIT(TIMER2_OVF_vect))
+#define POWERDOWN (EXTERNAL | BIT(WDT_vect) | BIT(TWI_vect))
+
+static const uint64_t wakeSources[8] = {
+    ~0ULL,                                                                          // Idle
+    POWERDOWN | TIMER2 | BIT(ADC_vect) | BIT(EE_READY_vect) | BIT(SPM_READY_vect),  // ADC Noise Reduction
+    POWERDOWN,                                                                      // Power-down
+    POWERDOWN | TIMER2,                                                             // Power-save
+    0,                                                                              // Reserved
+    0,                                                                              // Reserved
+    POWERDOWN,                                                                      // Standby
+    POWERDOWN | TIMER2                                                              // Extended Standby
+};
+
+void setInterrupt(int vector, int (*pending)(), void (*acknowledge)()){
+    vectors[vector].pending = pending;
+    vectors[vector].acknowledge = acknowledge;
+}
+
+void clearInterrupts(){
+    int i;
+
+    for(i = 0; i < NVECTORS; i++){
+        vectors[i].pending = 0;
+        vectors[i].acknowledge = 0;
+    }
+    IRQ = 0;
+
+    keepState(&IRQ, sizeof(IRQ));
+}
+
+// Recompute IRQ from the peripherals
+void updateInterrupts(){
+    int i;
+
+    IRQ = 0;
+    for(i = 1; i < NVECTORS; i++){
+        if(vectors[i].pending && vectors[i].pending()){
+            IRQ = i;
+            return;
+        }
+    }
+}
+
+// True if the requested interrupt wakes the MCU from the current sleep mode
+int canWake(){
+    uint8_t mode = (DATA[SMCR] >> 1) & 0x07;
+
+    return IRQ && SREG.I && (wakeSources[mode] & BIT(IRQ));
+}
+
+/* Executes the interrupt IRQ: the return address is pushed, I is cleared and PC jumps to
+the vector. The response takes 4 cycles (5 on devices with a 3 byte return address),
+plus 4 more if the MCU was sleeping. */
+void serviceInterrupt(){
+    int vector = IRQ;
+
+    if(vectors[vector].acknowledge){
+        vectors[vector].acknowledge();
+    }
+
+    if(STATS){
+        COUNT(STATS->interrupts[vector], 1);
+    }
+
+    pushPC();
+    SREG.I = 0;
+    PC = vector * VECTORSIZE;
+
+    CYCLES += 2 + PCBYTES;
+    if(SLEEPING){
+        SLEEPING = 0;
+        CYCLES += 4;
+    }
+
+    updateInterrupts();
+}
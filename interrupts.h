@@ -0,0 +1,32 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+#include "registers.h"
+
+/* The interrupt vectors are in device.h */
+
+// Highest priority interrupt requested and enabled by its peripheral, 0 if none
+extern MCUSTATE int IRQ;
+
+void setInterrupt(int vector, int (*pending)(), void (*acknowledge)());
+void clearInterrupts();
+void updateInterrupts();
+int canWake();
+void serviceInterrupt();
@@ -0,0 +1,763 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "native.h"
+#include "registers.h"
+#include "functions.h"
+#include "decoder.h"
+#include "snapshot.h"
+#include "coverage.h"
+#include "stats.h"
+#include "sram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+The division routines of libgcc, its 16 by 16 bit multiplication __umulhisi3, and the
+memcpy, memset and strlen of avr-libc, run on the host when they are called. Each model below computes what the routine leaves behind, from
+its arguments alone: the result and every scratch register it writes, the flags of its last
+instructions, the data memory it writes and its exact cycle count, return included. When PC
+reaches the first word of one of them, the model takes the place of the whole call, the
+return is done, and CYCLES is advanced by the cycles the routine would have taken.
+
+The routines are found by the symbols of the ELF file, or put at an address by
+nativeRoutine() for a program without one. A model is only used while the flash
+words at its symbol are, word for word, the routine it was written from (listed below as
+the assembler of libgcc and avr-libc expands them on devices with MOVW), so another
+implementation of the same function, or code written later over it, is always stepped.
+
+A call is stepped instead when it would run past the next peripheral event, as idioms.c and
+busywait.c do, or when it touches data memory outside SRAM.
+
+In NATIVE_VERIFY mode every call is run twice from the same state, on the host and stepped
+instruction by instruction, and the registers, SREG, SP, PC, cycles and SRAM they end with
+are compared. The stepped result is the one kept. A routine whose results differ is
+reported (nativeReport()) and stepped from then on. A call that cannot be stepped to its
+return (an opcode the decoder does not know) is counted as unverifiable and run on the host.
+
+Not modeled: digitalWrite() and the rest of the Arduino core are compiled C that changes
+with the compiler and the board. __mulsi3 and the other 32 bit multiplications are written
+around calls to __umulhisi3, whose code has been the same for many libgcc releases, but their
+own code and the float routines have changed between libgcc and avr-libc releases, so there
+is no single instruction sequence to take cycle counts from: they are stepped, with their
+__umulhisi3 calls on the host. _delay_ms() is inlined, and its loops are already skipped by
+busywait.c.
+*/
+
+// The RET of every routine
+#define RETCYCLES (2 + PCBYTES)
+
+// Cycles the stepped run of a verified call may take, relative to the host model
+#define VERIFYSLACK(cycles) (16 * (cycles) + 10000)
+
+/* The routines, from the libgcc and avr-libc sources */
+
+static const uint16_t udivmodqi4Code[] = {
+    0x1B99,      // sub r25,r25
+    0xE079,      // ldi r23,9
+    0xC004,      // rjmp .+8
+    0x1F99,      // rol r25
+    0x1796,      // cp r25,r22
+    0xF008,      // brcs .+2
+    0x1B96,      // sub r25,r22
+    0x1F88,      // rol r24
+    0x957A,      // dec r23
+    0xF7C9,      // brne .-14
+    0x9580,      // com r24
+    0x9508       // ret
+};
+
+static const uint16_t udivmodhi4Code[] = {
+    0x1BAA,      // sub r26,r26
+    0x1BBB,      // sub r27,r27
+    0xE151,      // ldi r21,17
+    0xC007,      // rjmp .+14
+    0x1FAA,      // rol r26
+    0x1FBB,      // rol r27
+    0x17A6,      // cp r26,r22
+    0x07B7,      // cpc r27,r23
+    0xF010,      // brcs .+4
+    0x1BA6,      // sub r26,r22
+    0x0BB7,      // sbc r27,r23
+    0x1F88,      // rol r24
+    0x1F99,      // rol r25
+    0x955A,      // dec r21
+    0xF7A9,      // brne .-22
+    0x9580,      // com r24
+    0x9590,      // com r25
+    0x01BC,      // movw r22,r24
+    0x01CD,      // movw r24,r26
+    0x9508       // ret
+};
+
+static const uint16_t udivmodsi4Code[] = {
+    0xE2A1,      // ldi r26,33
+    0x2E1A,      // mov r1,r26
+    0x1BAA,      // sub r26,r26
+    0x1BBB,      // sub r27,r27
+    0x01FD,      // movw r30,r26
+    0xC00D,      // rjmp .+26
+    0x1FAA,      // rol r26
+    0x1FBB,      // rol r27
+    0x1FEE,      // rol r30
+    0x1FFF,      // rol r31
+    0x17A2,      // cp r26,r18
+    0x07B3,      // cpc r27,r19
+    0x07E4,      // cpc r30,r20
+    0x07F5,      // cpc r31,r21
+    0xF020,      // brcs .+8
+    0x1BA2,      // sub r26,r18
+    0x0BB3,      // sbc r27,r19
+    0x0BE4,      // sbc r30,r20
+    0x0BF5,      // sbc r31,r21
+    0x1F66,      // rol r22
+    0x1F77,      // rol r23
+    0x1F88,      // rol r24
+    0x1F99,      // rol r25
+    0x941A,      // dec r1
+    0xF769,      // brne .-38
+    0x9560,      // com r22
+    0x9570,      // com r23
+    0x9580,      // com r24
+    0x9590,      // com r25
+    0x019B,      // movw r18,r22
+    0x01AC,      // movw r20,r24
+    0x01BD,      // movw r22,r26
+    0x01CF,      // movw r24,r30
+    0x9508       // ret
+};
+
+// The version for devices with JMP and CALL, which has no RCALL to share the last product
+static const uint16_t umulhisi3Code[] = {
+    0x9FA2,      // mul r26,r18
+    0x01B0,      // movw r22,r0
+    0x9FB3,      // mul r27,r19
+    0x01C0,      // movw r24,r0
+    0x9FA3,      // mul r26,r19
+    0x0D70,      // add r23,r0
+    0x1D81,      // adc r24,r1
+    0x2411,      // clr r1
+    0x1D91,      // adc r25,r1
+    0x9FB2,      // mul r27,r18
+    0x0D70,      // add r23,r0
+    0x1D81,      // adc r24,r1
+    0x2411,      // clr r1
+    0x1D91,      // adc r25,r1
+    0x9508       // ret
+};
+
+static const uint16_t memcpyCode[] = {
+    0x01FB,      // movw r30,r22
+    0x01DC,      // movw r26,r24
+    0xC002,      // rjmp .+4
+    0x9001,      // ld r0,Z+
+    0x920D,      // st X+,r0
+    0x5041,      // subi r20,1
+    0x4050,      // sbci r21,0
+    0xF7D8,      // brcc .-10
+    0x9508       // ret
+};
+
+static const uint16_t memsetCode[] = {
+    0x01DC,      // movw r26,r24
+    0xC001,      // rjmp .+2
+    0x936D,      // st X+,r22
+    0x5041,      // subi r20,1
+    0x4050,      // sbci r21,0
+    0xF7E0,      // brcc .-8
+    0x9508       // ret
+};
+
+static const uint16_t strlenCode[] = {
+    0x01FC,      // movw r30,r24
+    0x9001,      // ld r0,Z+
+    0x2000,      // tst r0
+    0xF7E9,      // brne .-6
+    0x9580,      // com r24
+    0x9590,      // com r25
+    0x0F8E,      // add r24,r30
+    0x1F9F,      // adc r25,r31
+    0x9508       // ret
+};
+/* The models. Each one returns the cycles of the routine without its RET, or 0 if the call
+has to be stepped: it costs more than budget cycles or touches memory outside SRAM. Nothing
+is changed when they return 0. */
+
+/* Set bits of a quotient. For each of them the division loop falls through its BRCS and
+subtracts, one more cycle per byte of the divisor. */
+static int ones(uint32_t value){
+    int n = 0;
+
+    for(; value; value &= value - 1){
+        n++;
+    }
+    return n;
+}
+
+/* Flags left by the COM of the most significant byte of the quotient. H comes from the ROL
+before it, which saw bit 3 of that byte before its last shift. */
+static void quotientFlags(uint8_t high, uint8_t h){
+    SREG.H = h;
+    SREG.V = 0;
+    SREG.N = high >> 7;
+    SREG.S = SREG.N;
+    SREG.Z = (high == 0);
+    SREG.C = 1;
+}
+
+/* Dividing by zero leaves a quotient of all ones and the dividend as remainder. */
+
+static uint32_t udivmodqi4(uint64_t budget){
+    uint8_t dividend = R[24];
+    uint8_t divisor = R[22];
+    uint8_t quotient = divisor ? dividend / divisor : 0xFF;
+    uint8_t remainder = divisor ? dividend % divisor : dividend;
+
+    // Setup 4, 8 loops of 4 whichever way BRCS goes, 9 entries of 4 but the last of 3, COM 1
+    if(72 > budget){
+        return 0;
+    }
+
+    R[24] = quotient;
+    R[25] = remainder;
+    R[23] = 0;
+    quotientFlags(quotient, (~quotient >> 4) & 1);
+
+    return 72;
+}
+
+static uint32_t udivmodhi4(uint64_t budget){
+    uint16_t dividend = R[24] | (R[25] << 8);
+    uint16_t divisor = R[22] | (R[23] << 8);
+    uint16_t quotient = divisor ? dividend / divisor : 0xFFFF;
+    uint16_t remainder = divisor ? dividend % divisor : dividend;
+    // Setup 5, 16 loops of 6 or 7, 17 entries of 5 but the last of 4, COM and MOVW 4
+    uint32_t cycles = 189 + ones(quotient);
+
+    if(cycles > budget){
+        return 0;
+    }
+
+    setPointer(22, quotient);
+    setPointer(24, remainder);
+    setPointer(26, remainder);
+    R[21] = 0;
+    quotientFlags(quotient >> 8, (~quotient >> 12) & 1);
+
+    return cycles;
+}
+
+static uint32_t udivmodsi4(uint64_t budget){
+    uint32_t dividend = R[22] | (R[23] << 8) | ((uint32_t)R[24] << 16) | ((uint32_t)R[25] << 24);
+    uint32_t divisor = R[18] | (R[19] << 8) | ((uint32_t)R[20] << 16) | ((uint32_t)R[21] << 24);
+    uint32_t quotient = divisor ? dividend / divisor : 0xFFFFFFFF;
+    uint32_t remainder = divisor ? dividend % divisor : dividend;
+    // Setup 7, 32 loops of 10 or 13, 33 entries of 7 but the last of 6, COM and MOVW 8
+    uint32_t cycles = 565 + 3 * ones(quotient);
+
+    if(cycles > budget){
+        return 0;
+    }
+
+    setPointer(18, quotient);
+    setPointer(20, quotient >> 16);
+    setPointer(22, remainder);
+    setPointer(24, remainder >> 16);
+    setPointer(26, remainder);
+    setPointer(30, remainder >> 16);
+    R[1] = 0;
+    quotientFlags(quotient >> 24, (~quotient >> 28) & 1);
+
+    return cycles;
+}
+
+// Flags of ADD and ADC
+static void addFlags(uint8_t rd, uint8_t rr, uint8_t carry){
+    unsigned sum = rd + rr + carry;
+    uint8_t result = sum;
+
+    SREG.H = ((rd & 0x0F) + (rr & 0x0F) + carry) > 0x0F;
+    SREG.V = ((~(rd ^ rr) & (rd ^ result)) >> 7) & 1;
+    SREG.N = result >> 7;
+    SREG.S = SREG.N ^ SREG.V;
+    SREG.Z = (result == 0);
+    SREG.C = sum > 0xFF;
+}
+
+/* r25:r22 = r27:r26 * r19:r18. The two cross products are added at bits 8 to 31, and the
+flags are those of the ADC of r25 that ends the second one. */
+static uint32_t umulhisi3(uint64_t budget){
+    uint16_t first = R[26] * R[19];
+    uint16_t last = R[27] * R[18];
+    uint32_t c = (uint32_t)(R[26] * R[18]) | (uint32_t)(R[27] * R[19]) << 16;
+    unsigned c1, c2;
+
+    // 4 MUL of 2, 2 MOVW and 8 ADD, ADC and CLR of 1
+    if(18 > budget){
+        return 0;
+    }
+
+    c += (uint32_t)first << 8;
+    c1 = ((c >> 8) & 0xFF) + (last & 0xFF);
+    c2 = ((c >> 16) & 0xFF) + (last >> 8) + (c1 >> 8);
+    addFlags(c >> 24, 0, c2 >> 8);
+    c += (uint32_t)last << 8;
+
+    setPointer(22, c);
+    setPointer(24, c >> 16);
+    R[0] = last;
+    R[1] = 0;
+
+    return 18;
+}
+
+// Nonzero if the n bytes at addr are all in SRAM
+static int inSram(uint32_t addr, uint32_t n){
+    return n == 0 || (addr >= SRAMSTART && addr + n - 1 <= RAMEND);
+}
+
+/* Flags of the SBCI r21,0 that ends the byte loops of memcpy and memset, taking the count
+from 0 to 0xFFFF */
+static void countFlags(){
+    SREG.H = 1;
+    SREG.V = 0;
+    SREG.N = 1;
+    SREG.S = 1;
+    SREG.Z = 0;
+    SREG.C = 1;
+}
+
+static uint32_t memcpyModel(uint64_t budget){
+    uint16_t dst = getPointer(24);
+    uint16_t src = getPointer(22);
+    uint32_t n = getPointer(20);
+    uint32_t i;
+
+    if(7 + 8 * n > budget || !inSram(dst, n) || !inSram(src, n)){
+        return 0;
+    }
+
+    // One byte at a time, so an overlapping copy repeats bytes as the loop does
+    for(i = 0; i < n; i++){
+        R[0] = DATA[src + i];
+        DATA[dst + i] = R[0];
+    }
+    sramMarkRange(SRAMREAD, src, n);
+    sramMarkRange(SRAMWRITTEN, dst, n);
+
+    setPointer(REGX, dst + n);
+    setPointer(REGZ, src + n);
+    setPointer(20, 0xFFFF);
+    countFlags();
+
+    return 7 + 8 * n;
+}
+
+static uint32_t memsetModel(uint64_t budget){
+    uint16_t dst = getPointer(24);
+    uint32_t n = getPointer(20);
+
+    if(6 + 6 * n > budget || !inSram(dst, n)){
+        return 0;
+    }
+
+    memset(&DATA[dst], R[22], n);
+    sramMarkRange(SRAMWRITTEN, dst, n);
+
+    setPointer(REGX, dst + n);
+    setPointer(20, 0xFFFF);
+    countFlags();
+
+    return 6 + 6 * n;
+}
+
+static uint32_t strlenModel(uint64_t budget){
+    uint16_t s = getPointer(24);
+    uint8_t *end;
+    uint32_t length;
+
+    if(!inSram(s, 1)){
+        return 0;
+    }
+    end = memchr(&DATA[s], 0, RAMEND + 1 - s);
+    if(end == NULL){
+        return 0;
+    }
+    length = end - &DATA[s];
+    if(9 + 5 * length > budget){
+        return 0;
+    }
+
+    sramMarkRange(SRAMREAD, s, length + 1);
+    R[0] = 0;
+    setPointer(REGZ, s + length + 1);
+
+    // com r24 / com r25 / add r24,ZL / adc r25,ZH: Z + ~s = the length
+    uint8_t low = ~R[24];
+    uint8_t high = ~R[25];
+    unsigned carry = (low + R[REGZ]) > 0xFF;
+
+    addFlags(high, R[REGZ + 1], carry);
+    setPointer(24, length);
+
+    return 9 + 5 * length;
+}
+
+struct model{
+    const char *symbol;
+    const uint16_t *code;
+    int words;
+    uint32_t (*run)(uint64_t budget);
+};
+
+#define MODEL(symbol, code, run) {symbol, code, sizeof(code) / sizeof(code[0]), run}
+
+static const struct model models[] = {
+    MODEL("__udivmodqi4", udivmodqi4Code, udivmodqi4),
+    MODEL("__udivmodhi4", udivmodhi4Code, udivmodhi4),
+    MODEL("__udivmodsi4", udivmodsi4Code, udivmodsi4),
+    MODEL("__umulhisi3", umulhisi3Code, umulhisi3),
+    MODEL("memcpy", memcpyCode, memcpyModel),
+    MODEL("memset", memsetCode, memsetModel),
+    MODEL("strlen", strlenCode, strlenModel),
+};
+
+#define NMODELS (int)(sizeof(models) / sizeof(models[0]))
+
+/* A routine found in the program, and what its calls did */
+struct entry{
+    const struct model *model;
+    pc_t pc;
+    int disabled;               // Results differed when verified, always stepped
+    uint64_t native;            // Calls run on the host, and stepped too when verifying
+    uint64_t stepped;           // Calls stepped: too long, outside SRAM or disabled
+    uint64_t verified;
+    uint64_t unverifiable;
+    uint64_t mismatches;
+    char mismatch[256];         // The first one
+};
+
+MCUSTATE int NATIVECALLS;
+
+static MCUSTATE int mode;
+static MCUSTATE struct entry entries[NMODELS];
+static MCUSTATE int nentries;
+static MCUSTATE int verifying;
+
+static void update(){
+    NATIVECALLS = (mode != NATIVE_OFF && nentries > 0);
+}
+
+// Nonzero if the flash words at pc are the routine of model
+static int matches(const struct model *model, pc_t pc){
+    int i;
+
+    if(pc + model->words > FLASHSIZE){
+        return 0;
+    }
+    for(i = 0; i < model->words; i++){
+        if(FLASH[pc + i] != model->code[i]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Finds the routines in the symbols of the program, which must already be in FLASH. Forgets
+the ones found before and what their calls did. Returns how many were found. */
+int nativeSymbols(const struct elf *elf){
+    uint32_t value;
+    uint32_t size;
+    int i;
+
+    memset(entries, 0, sizeof(entries));
+    nentries = 0;
+    for(i = 0; i < NMODELS; i++){
+        if(elfSymbol(elf, models[i].symbol, &value, &size) && matches(&models[i], value / 2)){
+            entries[nentries].model = &models[i];
+            entries[nentries].pc = value / 2;
+            nentries++;
+        }
+    }
+    update();
+
+    return nentries;
+}
+
+/* Uses the model of symbol for the routine at the word address pc, for a program without an
+ELF file. Returns 0 if there is no such model, if the flash words at pc are not its routine,
+or if there is one at pc already. */
+int nativeRoutine(const char *symbol, pc_t pc){
+    int i;
+
+    if(nentries == NMODELS){
+        return 0;
+    }
+    for(i = 0; i < nentries; i++){
+        if(entries[i].pc == pc){
+            return 0;
+        }
+    }
+    for(i = 0; i < NMODELS; i++){
+        if(strcmp(models[i].symbol, symbol) == 0 && matches(&models[i], pc)){
+            memset(&entries[nentries], 0, sizeof(struct entry));
+            entries[nentries].model = &models[i];
+            entries[nentries].pc = pc;
+            nentries++;
+            update();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* NATIVE_OFF, NATIVE_ON or NATIVE_VERIFY. Kept by reset() and by loading another program.
+Returns how many routines were found in the program. */
+int nativeMode(int value){
+    mode = value;
+    update();
+
+    return nentries;
+}
+
+// Runs the model of the routine PC is at and returns from it, 0 if it has to be stepped
+static uint64_t runModel(struct entry *entry, uint64_t limit){
+    uint32_t cycles;
+
+    if(limit < RETCYCLES){
+        return 0;
+    }
+    cycles = entry->model->run(limit - RETCYCLES);
+    if(cycles == 0){
+        return 0;
+    }
+    popPC();
+    CYCLES += cycles + RETCYCLES;
+
+    return cycles + RETCYCLES;
+}
+
+/* What a call left behind, to compare the two runs of a verified call */
+struct outcome{
+    uint8_t r[32];
+    uint8_t sreg;
+    uint16_t sp;
+    pc_t pc;
+    uint64_t cycles;
+    uint8_t sram[SRAMBYTES];
+};
+
+static void capture(struct outcome *outcome){
+    memcpy(outcome->r, R, 32);
+    outcome->sreg = getSREG();
+    outcome->sp = getSP();
+    outcome->pc = PC;
+    outcome->cycles = CYCLES;
+    memcpy(outcome->sram, &DATA[SRAMSTART], SRAMBYTES);
+}
+
+// Writes at the end of text what differs between the host and the stepped run
+static void compare(const struct outcome *host, const struct outcome *stepped, char *text, size_t size){
+    size_t n = strlen(text);
+    int i;
+
+#define DIFFERS(...) do{ if(n < size) n += snprintf(text + n, size - n, __VA_ARGS__); }while(0)
+    for(i = 0; i < 32; i++){
+        if(host->r[i] != stepped->r[i]){
+            DIFFERS(" r%d %02x/%02x", i, host->r[i], stepped->r[i]);
+        }
+    }
+    if(host->sreg != stepped->sreg){
+        DIFFERS(" SREG %02x/%02x", host->sreg, stepped->sreg);
+    }
+    if(host->sp != stepped->sp){
+        DIFFERS(" SP %04x/%04x", host->sp, stepped->sp);
+    }
+    if(host->pc != stepped->pc){
+        DIFFERS(" PC %05x/%05x", (unsigned)host->pc, (unsigned)stepped->pc);
+    }
+    if(host->cycles != stepped->cycles){
+        DIFFERS(" cycles %llu/%llu", (unsigned long long)host->cycles, (unsigned long long)stepped->cycles);
+    }
+    for(i = 0; i < SRAMBYTES; i++){
+        if(host->sram[i] != stepped->sram[i]){
+            DIFFERS(" %04x %02x/%02x", SRAMSTART + i, host->sram[i], stepped->sram[i]);
+            break;
+        }
+    }
+#undef DIFFERS
+}
+
+static MCUSTATE int invalid;
+
+static void invalidOpcode(uint16_t opcode){
+    invalid = 1;
+}
+
+/* Steps the call PC is at the entry of until it returns, for at most end - CYCLES cycles
+(VERIFYSLACK()). Returns 0 if it did not get there. */
+static int stepCall(uint64_t end){
+    uint16_t sp = getSP();
+    pc_t ret = 0;
+    opcodeHandler previous;
+    int returned = 0;
+    int i;
+
+    for(i = 1; i <= PCBYTES; i++){
+        ret = (ret << 8) | DATA[(sp + i) % DATASIZE];
+    }
+    ret %= FLASHSIZE;
+    sp += PCBYTES;
+
+    previous = onInvalidOpcode(invalidOpcode);
+    invalid = 0;
+    verifying = 1;
+    while(!returned && !invalid && CYCLES < end){
+        if(step() == 0){
+            break;
+        }
+        returned = (PC == ret && getSP() == sp);
+    }
+    verifying = 0;
+    onInvalidOpcode(previous);
+
+    return returned;
+}
+
+/* Runs the call on the host and stepped, from the same state, and keeps the stepped one. */
+static uint64_t verify(struct entry *entry, uint64_t limit){
+    uint64_t start = CYCLES;
+    uint8_t args[8];
+    uint8_t *state = malloc(stateSize());
+    struct outcome *host = calloc(1, sizeof(struct outcome));
+    struct outcome *stepped = calloc(1, sizeof(struct outcome));
+    uint64_t cycles;
+
+    memcpy(args, &R[18], 8);
+    saveState(state);
+    cycles = runModel(entry, limit);
+    if(cycles){
+        capture(host);
+        restoreState(state);
+        if(stepCall(start + VERIFYSLACK(cycles))){
+            capture(stepped);
+            if(memcmp(host, stepped, sizeof(struct outcome)) == 0){
+                entry->verified++;
+            }
+            else{
+                if(entry->mismatches++ == 0){
+                    snprintf(entry->mismatch, sizeof(entry->mismatch),
+                             "cycle %llu, r25..r18 %02x %02x %02x %02x %02x %02x %02x %02x, host/stepped:",
+                             (unsigned long long)start, args[7], args[6], args[5], args[4],
+                             args[3], args[2], args[1], args[0]);
+                    compare(host, stepped, entry->mismatch, sizeof(entry->mismatch));
+                }
+                entry->disabled = 1;
+            }
+        }
+        else{
+            restoreState(state);
+            runModel(entry, limit);
+            entry->unverifiable++;
+        }
+        cycles = CYCLES - start;
+    }
+
+    free(state);
+    free(host);
+    free(stepped);
+
+    return cycles;
+}
+
+/* Runs the routine PC is at the entry of on the host, return included, if it is one of the
+routines found and it ends before limit cycles. Returns the cycles it took, with CYCLES
+already advanced, or 0 if the instruction at PC has to be stepped. */
+uint64_t nativeCall(uint64_t limit){
+    struct entry *entry = NULL;
+    pc_t pc = PC;
+    uint64_t cycles;
+    int i;
+
+    if(verifying){
+        return 0;
+    }
+    for(i = 0; i < nentries; i++){
+        if(entries[i].pc == pc){
+            entry = &entries[i];
+            break;
+        }
+    }
+    if(entry == NULL || !matches(entry->model, pc)){
+        return 0;
+    }
+    if(entry->disabled){
+        entry->stepped++;
+        return 0;
+    }
+
+    cycles = mode == NATIVE_VERIFY ? verify(entry, limit) : runModel(entry, limit);
+    if(cycles == 0){
+        entry->stepped++;
+        return 0;
+    }
+
+    entry->native++;
+    COVER(EXECUTED, pc);
+    if(STATS){
+        COUNT(STATS->skippedCycles, cycles);
+        atomic_store_explicit(&STATS->cycles, CYCLES, memory_order_relaxed);
+    }
+
+    return cycles;
+}
+
+/* Writes the routines found, where, and what their calls did to path, "-" for stdout, with the
+first difference found in each routine that failed verification. Returns 0 if it cannot be
+written. */
+int nativeReport(const char *path){
+    FILE *f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    int i, ok;
+
+    if(f == 0){
+        return 0;
+    }
+
+    fprintf(f, "%-14s %7s %10s %10s %10s %12s %10s\n", "routine", "address", "native",
+        "stepped", "verified", "unverifiable", "mismatches");
+    for(i = 0; i < nentries; i++){
+        struct entry *entry = &entries[i];
+
+        fprintf(f, "%-14s  $%05X %10llu %10llu %10llu %12llu %10llu\n", entry->model->symbol,
+            (unsigned)entry->pc * 2, (unsigned long long)entry->native,
+            (unsigned long long)entry->stepped, (unsigned long long)entry->verified,
+            (unsigned long long)entry->unverifiable, (unsigned long long)entry->mismatches);
+    }
+    for(i = 0; i < nentries; i++){
+        if(entries[i].mismatches){
+            fprintf(f, "%s DIFFERS at %s\n", entries[i].model->symbol, entries[i].mismatch);
+        }
+    }
+
+    ok = !ferror(f);
+    if(f != stdout){
+        ok = fclose(f) == 0 && ok;
+    }
+    return ok;
+}
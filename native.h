@@ -0,0 +1,41 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <stdint.h>
+#include "registers.h"
+#include "elf.h"
+
+/* Host models of avr-libc and libgcc routines, called in place of the routine (see native.c) */
+
+#define NATIVE_OFF 0
+#define NATIVE_ON 1
+#define NATIVE_VERIFY 2     // Every call is also stepped, and the two compared
+
+// Nonzero while calls are intercepted
+extern MCUSTATE int NATIVECALLS;
+
+int nativeSymbols(const struct elf *elf);
+int nativeRoutine(const char *symbol, pc_t pc);
+int nativeMode(int mode);
+uint64_t nativeCall(uint64_t limit);
+int nativeReport(const char *path);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "pacing.h"
+#include "registers.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+/*
+Real-time pacing, for an MCU attached to host processes that expect its clock to be real.
+
+The MCU runs in bursts of burst cycles as fast as it can, and after each one the host
+thread sleeps until the instant the burst should have ended, with clock_nanosleep() on an
+absolute CLOCK_MONOTONIC deadline. Deadlines are computed from a single anchor, the cycle
+and instant the schedule started, as anchorNs + (cycle - anchorCycle) / hz seconds, so
+neither the rounding nor the time spent between bursts accumulates: after a million
+bursts the MCU is exactly where the clock says it should be.
+
+A burst that ends late is not slept after; the following ones run back to back until the
+MCU catches up with the schedule. A hiccup longer than lagLimit (the process stopped in a
+debugger, a suspended VM) starts the schedule again from now instead, so the MCU does not
+then run flat out for as long as it was stopped.
+
+Waking up takes the scheduler some microseconds; with spin set, the thread sleeps until
+spin ns before the deadline and polls the clock for the rest, which trades a core for a
+jitter under a microsecond. Lag (how late the burst ended, negative when early) and jitter
+(how late the thread woke up) are kept for the caller.
+*/
+
+#define NS 1000000000ULL
+
+static uint64_t now(){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * NS + t.tv_nsec;
+}
+
+static void sleepUntil(uint64_t ns){
+    struct timespec t = {ns / NS, ns % NS};
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, 0) == EINTR){
+    }
+}
+
+// The instant cycle is due at, from the anchor
+static uint64_t deadline(const struct pacing *p, uint64_t cycle){
+    uint64_t n = cycle - p->anchorCycle;
+
+    return p->anchorNs + n / p->hz * NS + n % p->hz * NS / p->hz;
+}
+
+/* Paces at hz (F_CPU if 0) in bursts of burst cycles (a millisecond if 0), with a lag limit
+of 100ms and no spinning. */
+void pacingInit(struct pacing *p, uint64_t hz, uint64_t burst){
+    memset(p, 0, sizeof(*p));
+    p->hz = hz ? hz : F_CPU;
+    p->burst = burst ? burst : p->hz / 1000;
+    p->lagLimit = 100000000;
+}
+
+/* Called when the MCU starts running at cycle. The first time, or if the MCU went back in
+time (a reset), cycle is due now; otherwise the schedule goes on. */
+void pacingStart(struct pacing *p, uint64_t cycle){
+    if(!p->anchored || cycle < p->anchorCycle){
+        p->anchored = 1;
+        p->anchorNs = now();
+        p->anchorCycle = cycle;
+    }
+}
+
+/* Called after a burst that ended at cycle: waits for its deadline. */
+void pacingWait(struct pacing *p, uint64_t cycle){
+    uint64_t due = deadline(p, cycle);
+    uint64_t t = now();
+    uint64_t jitter;
+
+    p->bursts++;
+    p->lag = (int64_t)(t - due);
+    if(p->lag > p->maxLag){
+        p->maxLag = p->lag;
+    }
+
+    if(t >= due){
+        p->late++;
+        if(p->lagLimit && t - due > p->lagLimit){
+            p->resyncs++;
+            p->anchorNs = t;
+            p->anchorCycle = cycle;
+        }
+        return;
+    }
+
+    if(due - t > p->spin){
+        sleepUntil(due - p->spin);
+    }
+    do{
+        t = now();
+    } while(t < due);
+
+    jitter = t - due;
+    p->sleeps++;
+    p->jitterSum += jitter;
+    if(jitter > p->maxJitter){
+        p->maxJitter = jitter;
+    }
+}
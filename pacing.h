@@ -0,0 +1,53 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdint.h>
+
+/* Running the MCU in step with the host clock (pacing.c) */
+
+struct pacing{
+    // Settings
+    uint64_t hz;                // Simulated clock frequency
+    uint64_t burst;             // Cycles run between two deadlines
+    uint64_t spin;              // ns before a deadline spent polling the clock instead of sleeping
+    uint64_t lagLimit;          // ns behind after which the schedule starts again from now, 0 never
+
+    // Schedule: cycle anchorCycle is due at anchorNs of CLOCK_MONOTONIC
+    int anchored;
+    uint64_t anchorNs;
+    uint64_t anchorCycle;
+
+    // Statistics
+    uint64_t bursts;
+    uint64_t late;              // Bursts that ended after their deadline
+    uint64_t resyncs;           // Times the schedule started again after a hiccup
+    int64_t lag;                // ns behind the deadline at the end of the last burst, < 0 ahead
+    int64_t maxLag;             // Worst lag
+    uint64_t jitterSum;         // ns woken after the deadline, over the sleeps
+    uint64_t maxJitter;
+    uint64_t sleeps;
+};
+
+void pacingInit(struct pacing *p, uint64_t hz, uint64_t burst);
+void pacingStart(struct pacing *p, uint64_t cycle);
+void pacingWait(struct pacing *p, uint64_t cycle);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "pinring.h"
+#include "registers.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+The simulator writes pin changes into the ring without publishing them, and only moves
+head (a release store) once PINRING_BATCH of them are written or when the run ends. An
+observer, in this process or in another one mapping the same POSIX shared memory object,
+reads all the published events at once and moves tail. There is no lock, callback or
+system call on the simulation side. If the observer falls behind and the ring is full,
+new events are counted in dropped instead of stalling the MCU.
+*/
+
+// Events written but not published yet, per MCU
+static MCUSTATE uint64_t unpublished;
+
+static size_t ringBytes(uint32_t size){
+    return sizeof(struct pinring) + size * sizeof(struct pinevent);
+}
+
+/* Creates a ring of at least size events. With a name it is a POSIX shared memory object
+(e.g. "/simulador-pins") that other processes can open, otherwise it is private. */
+struct pinring *pinRingCreate(const char *name, uint32_t size){
+    struct pinring *ring;
+    uint32_t n = 1;
+
+    while(n < size){
+        n <<= 1;
+    }
+    size = n;
+
+    if(name){
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+
+        if(fd < 0 || ftruncate(fd, ringBytes(size)) < 0){
+            return 0;
+        }
+        ring = mmap(0, ringBytes(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(ring == MAP_FAILED){
+            return 0;
+        }
+    }
+    else{
+        ring = mmap(0, ringBytes(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ring == MAP_FAILED){
+            return 0;
+        }
+    }
+
+    ring->magic = PINRING_MAGIC;
+    ring->version = PINRING_VERSION;
+    ring->size = size;
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->dropped, 0);
+    unpublished = 0;
+
+    return ring;
+}
+
+/* Unmaps a ring of pinRingCreate(); the shared memory object stays for its observers. */
+void pinRingClose(struct pinring *ring){
+    munmap(ring, ringBytes(ring->size));
+}
+
+/* Maps a ring created by a simulator in another process. */
+struct pinring *pinRingOpen(const char *name){
+    struct pinring *ring;
+    struct stat st;
+    int fd = shm_open(name, O_RDWR, 0);
+
+    if(fd < 0 || fstat(fd, &st) < 0){
+        return 0;
+    }
+    ring = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(ring == MAP_FAILED || ring->magic != PINRING_MAGIC || ring->version != PINRING_VERSION){
+        return 0;
+    }
+
+    return ring;
+}
+
+void pinRingPush(struct pinring *ring, struct pinevent e){
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed) + unpublished;
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if(head - tail >= ring->size){
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    ring->events[head & (ring->size - 1)] = e;
+    unpublished++;
+
+    if(unpublished == PINRING_BATCH){
+        pinRingFlush(ring);
+    }
+}
+
+void pinRingFlush(struct pinring *ring){
+    if(unpublished){
+        atomic_store_explicit(&ring->head, atomic_load_explicit(&ring->head, memory_order_relaxed) + unpublished, memory_order_release);
+        unpublished = 0;
+    }
+}
+
+/* Observer side: copies up to max published events and frees their slots. Returns how many. */
+int pinRingRead(struct pinring *ring, struct pinevent *events, int max){
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    int n = 0;
+
+    while(tail + n < head && n < max){
+        events[n] = ring->events[(tail + n) & (ring->size - 1)];
+        n++;
+    }
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+
+    return n;
+}
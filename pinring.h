@@ -0,0 +1,59 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#ifndef PINRING_H
+#define PINRING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Ring of cycle-stamped pin changes, shared with host observers */
+
+#define PINRING_MAGIC 0x534E4950     // "PINS"
+#define PINRING_VERSION 1
+#define PINRING_BATCH 32
+
+// struct simPinEvent of simulador.h has the same layout
+struct pinevent{
+    uint64_t cycle;
+    uint8_t port;       // 0 = B, 1 = C, 2 = D, 3 = E on the ATmega2560
+    uint8_t pins;       // Levels of the 8 pins after the change
+    uint8_t ddr;        // Data direction of the 8 pins
+    uint8_t reserved[5];
+};
+
+struct pinring{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                  // Number of events, a power of two
+    uint32_t reserved;
+    _Alignas(64) _Atomic uint64_t head;     // Published by the simulator
+    _Alignas(64) _Atomic uint64_t tail;     // Advanced by the observer
+    _Atomic uint64_t dropped;       // Events lost because the ring was full
+    struct pinevent events[];
+};
+
+struct pinring *pinRingCreate(const char *name, uint32_t size);
+void pinRingClose(struct pinring *ring);
+struct pinring *pinRingOpen(const char *name);
+void pinRingPush(struct pinring *ring, struct pinevent e);
+void pinRingFlush(struct pinring *ring);
+int pinRingRead(struct pinring *ring, struct pinevent *events, int max);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "queue.h"
+
+/*
+head and tail only grow; a slot is tail % QUEUESIZE. The producer fills the slot before
+publishing it with a release store of tail, and the consumer reads tail with an acquire
+load before reading the slot, so no lock is needed between the two threads.
+*/
+
+void queueInit(struct queue *q){
+    atomic_store_explicit(&q->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, 0, memory_order_relaxed);
+}
+
+// Producer side. Returns 0 if the queue is full.
+int queuePush(struct queue *q, struct message m){
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if(tail - head == QUEUESIZE){
+        return 0;
+    }
+
+    q->slots[tail % QUEUESIZE] = m;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+    return 1;
+}
+
+// Consumer side. Copies the oldest message to m, returns 0 if the queue is empty.
+int queuePeek(struct queue *q, struct message *m){
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if(head == tail){
+        return 0;
+    }
+
+    *m = q->slots[head % QUEUESIZE];
+
+    return 1;
+}
+
+// Consumer side. Removes the oldest message.
+void queuePop(struct queue *q){
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+}
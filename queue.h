@@ -0,0 +1,47 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Lock-free single producer, single consumer queue of cycle-stamped messages */
+
+#define QUEUESIZE 4096      // Power of two
+
+struct message{
+    uint64_t cycle;
+    uint16_t port;
+    uint8_t data;
+};
+
+struct queue{
+    _Alignas(64) _Atomic uint32_t head;     // Written by the consumer only
+    _Alignas(64) _Atomic uint32_t tail;     // Written by the producer only
+    struct message slots[QUEUESIZE];
+};
+
+void queueInit(struct queue *q);
+int queuePush(struct queue *q, struct message m);
+int queuePeek(struct queue *q, struct message *m);
+void queuePop(struct queue *q);
+
+#endif
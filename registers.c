@@ -0,0 +1,36 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include "registers.h"
+
+MCUSTATE uint8_t R[32];
+
+MCUSTATE struct SREG SREG;
+
+MCUSTATE pc_t PC;
+
+MCUSTATE uint8_t DATA[DATASIZE];
+
+MCUSTATE uint16_t *FLASH;
+
+MCUSTATE uint64_t CYCLES;
+
+MCUSTATE uint8_t SLEEPING;
+
+MCUSTATE uint8_t ILAST;
@@ -17,12 +17,62 @@ email: rrramires@homail.com
 
 */
 
+#ifndef REGISTERS_H
+#define REGISTERS_H
+
 #include <stdint.h>
+#include "device.h"
+
+/* State of the simulated MCU. Every host thread has its own copy, so one process can
+simulate several MCUs at once, one per thread (see cosim.c). */
+#define MCUSTATE _Thread_local
+
+/* Clock frequency of the simulated MCU, in Hz */
+#define F_CPU 16000000UL
+
+/* A program memory word address. 16 bits hold the whole flash of the smaller devices. */
+#if PCWIDTH > 16
+typedef uint32_t pc_t;
+#else
+typedef uint16_t pc_t;
+#endif
+
+/* Pointer register pairs, given by their low register */
+#define REGX 26
+#define REGY 28
+#define REGZ 30
+
+/* I/O registers used by the core, as data space addresses */
+#define SMCR 0x53
+#define RAMPZ 0x5B
+#define EIND 0x5C
+#define SPL 0x5D
+#define SPH 0x5E
+#define SREGADDR 0x5F
 
-uint8_t R[32];
+extern MCUSTATE uint8_t R[32];
 
 struct SREG{
     uint8_t I,T,H,S,V,N,Z,C;
-}SREG;
+};
+extern MCUSTATE struct SREG SREG;
+
+extern MCUSTATE pc_t PC;
+
+// Data space (registers, I/O and SRAM), indexed by data address
+extern MCUSTATE uint8_t DATA[DATASIZE];
+
+// Program memory, indexed by word address. FLASHSIZE words, mapped by reset() (see flash.c).
+extern MCUSTATE uint16_t *FLASH;
+
+// Clock cycles executed since reset
+extern MCUSTATE uint64_t CYCLES;
+
+// Set by SLEEP, cleared by the interrupt that wakes the MCU
+extern MCUSTATE uint8_t SLEEPING;
+
+// I flag before the last instruction. Interrupts are taken only if it was already set,
+// so the instruction after SEI or RETI always executes.
+extern MCUSTATE uint8_t ILAST;
 
-uint16_t PC;
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,746 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "simulador.h"
+#include "elf.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+regress.exe, the firmware regression runner:
+
+    regress.exe [-n threads] [-C cache] [-j junit.xml] [-J summary.json] manifest|directory
+
+A manifest has one test per line, "name image option=value...", with paths relative to the
+manifest and # starting a comment. The image is an ELF, Intel HEX (.hex) or raw (.bin) file.
+Options:
+
+    cycles=N        cycles the test may run (default 10000000)
+    exit=SYMBOL     stop when PC gets to a symbol of the ELF or a byte address (default _exit
+                    for ELF images that have it)
+    status=N        expected r24 at the exit point, the value returned by main()
+    console=ADDR    I/O data address whose writes are the output of the test (default $3E,
+                    GPIOR0)
+    expect=FILE     expected output
+    eeprom=FILE     initial EEPROM contents
+
+A test passes if it gets to its exit point (when it has one), runs no invalid opcode, its
+stack stays out of .bss and the heap (ELF images only) and its status and output are the
+expected ones. A directory runs every .elf, .hex and .bin file in it with the defaults, and
+expects the output in a file of the same name ending in .out, if there is one.
+
+Tests are dealt to one deque per thread, longest budget first; a thread takes its work
+from the bottom of its own deque and, once it is empty, steals from the top of the others,
+so a few long tests do not leave threads idle. Each test runs on a fresh instance of the
+library.
+
+Results are cached in the cache directory (default .regress), under a 128 bit hash of the
+runner executable (the simulator build), the image, the EEPROM and expected output files
+and the options. The simulator is deterministic, so a test whose key is cached is not run
+again, whatever its result was.
+*/
+
+#define MAXNAME 128
+#define MAXPATH 512
+#define MAXMESSAGE 256
+#define MAXOUTPUT (1 << 20)
+
+#define PASS 0
+#define FAIL 1
+#define ERROR 2
+
+struct test{
+    char name[MAXNAME];
+    char image[MAXPATH];
+    char expect[MAXPATH];
+    char eeprom[MAXPATH];
+    char exit[MAXNAME];
+    uint16_t console;
+    uint64_t cycles;
+    long status;            // -1 for none
+
+    int outcome;
+    int cached;
+    uint64_t ran;
+    double seconds;
+    char message[MAXMESSAGE];
+};
+
+struct deque{
+    pthread_mutex_t lock;
+    int *items;
+    int top, bottom;
+};
+
+struct output{
+    uint8_t *bytes;
+    size_t size;
+};
+
+struct hash{
+    uint64_t a, b;
+};
+
+static struct test *tests;
+static int ntests;
+static struct deque *deques;
+static int nthreads;
+static const char *cache = ".regress";
+static struct hash build;
+
+static double now(){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* Hashing, two 64 bit lanes */
+
+static void hashBytes(struct hash *h, const void *data, size_t size){
+    const uint8_t *p = data;
+    size_t i;
+
+    for(i = 0; i < size; i++){
+        h->a = (h->a ^ p[i]) * 0x100000001B3ULL;
+        h->b = (h->b ^ p[i]) * 0x9E3779B97F4A7C15ULL;
+        h->b ^= h->b >> 29;
+    }
+}
+
+// The contents of the file, or its absence
+static void hashFile(struct hash *h, const char *path){
+    uint8_t buffer[65536];
+    FILE *f = path[0] ? fopen(path, "rb") : 0;
+    size_t n;
+
+    hashBytes(h, f ? "F" : "-", 1);
+    while(f && (n = fread(buffer, 1, sizeof(buffer), f)) > 0){
+        hashBytes(h, buffer, n);
+    }
+    if(f){
+        fclose(f);
+    }
+}
+
+static struct hash key(const struct test *t){
+    struct hash h = build;
+
+    hashFile(&h, t->image);
+    hashFile(&h, t->eeprom);
+    hashFile(&h, t->expect);
+    hashBytes(&h, t->exit, strlen(t->exit) + 1);
+    hashBytes(&h, &t->console, sizeof(t->console));
+    hashBytes(&h, &t->cycles, sizeof(t->cycles));
+    hashBytes(&h, &t->status, sizeof(t->status));
+
+    return h;
+}
+
+/* Result cache, one file per key */
+
+static void cachePath(char *path, struct hash h){
+    snprintf(path, MAXPATH, "%s/%016llx%016llx", cache, (unsigned long long)h.a, (unsigned long long)h.b);
+}
+
+static int cacheLoad(struct test *t, struct hash h){
+    char path[MAXPATH];
+    unsigned long long ran;
+    FILE *f;
+
+    cachePath(path, h);
+    f = fopen(path, "r");
+    if(f == 0){
+        return 0;
+    }
+    if(fscanf(f, "%d %llu ", &t->outcome, &ran) != 2){
+        fclose(f);
+        return 0;
+    }
+    t->ran = ran;
+    if(fgets(t->message, MAXMESSAGE, f) == 0){
+        t->message[0] = 0;
+    }
+    t->message[strcspn(t->message, "\n")] = 0;
+    fclose(f);
+
+    t->cached = 1;
+    return 1;
+}
+
+// Written to a temporary file and renamed, so a reader never sees half a result
+static void cacheStore(const struct test *t, struct hash h){
+    char path[MAXPATH], temporary[MAXPATH + 32];
+    FILE *f;
+
+    cachePath(path, h);
+    snprintf(temporary, sizeof(temporary), "%s.%ld", path, (long)pthread_self());
+    f = fopen(temporary, "w");
+    if(f == 0){
+        return;
+    }
+    fprintf(f, "%d %llu\n%s\n", t->outcome, (unsigned long long)t->ran, t->message);
+    fclose(f);
+    rename(temporary, path);
+}
+
+/* Running a test */
+
+static void consoleWrite(simulador *sim, uint16_t addr, uint8_t value, void *user){
+    struct output *o = user;
+
+    if(o->size < MAXOUTPUT){
+        o->bytes[o->size++] = value;
+    }
+}
+
+static uint8_t *readFile(const char *path, size_t *size){
+    FILE *f = fopen(path, "rb");
+    uint8_t *data;
+    long n;
+
+    if(f == 0 || fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) < 0){
+        if(f){
+            fclose(f);
+        }
+        return 0;
+    }
+    rewind(f);
+    data = malloc(n + 1);
+    *size = fread(data, 1, n, f);
+    fclose(f);
+
+    return data;
+}
+
+static int endsWith(const char *s, const char *suffix){
+    size_t n = strlen(s), m = strlen(suffix);
+
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// Byte address of the exit point, -1 for none
+static long exitAddress(struct test *t){
+    struct elf elf;
+    uint32_t value, size;
+    char *end;
+    long address = strtol(t->exit, &end, 0);
+
+    if(t->exit[0] && *end == 0){
+        return address;
+    }
+    if(!endsWith(t->image, ".elf") || !elfOpen(t->image, &elf)){
+        return t->exit[0] ? -2 : -1;
+    }
+    address = elfSymbol(&elf, t->exit[0] ? t->exit : "_exit", &value, &size) ? (long)value : t->exit[0] ? -2 : -1;
+    elfClose(&elf);
+
+    return address;
+}
+
+static int load(simulador *sim, const struct test *t){
+    uint8_t *data;
+    size_t size;
+    int loaded;
+
+    if(endsWith(t->image, ".elf")){
+        return simLoadElf(sim, t->image);
+    }
+    if(endsWith(t->image, ".hex")){
+        return simLoadHex(sim, t->image);
+    }
+    data = readFile(t->image, &size);
+    if(data == 0){
+        return 0;
+    }
+    loaded = simLoadBinary(sim, data, size);
+    free(data);
+
+    return loaded;
+}
+
+static void fail(struct test *t, int outcome, const char *message){
+    t->outcome = outcome;
+    snprintf(t->message, MAXMESSAGE, "%s", message);
+}
+
+static void run(struct test *t){
+    struct output output = {malloc(MAXOUTPUT), 0};
+    struct simRegisters registers;
+    struct simStack stack;
+    simulador *sim = simCreate();
+    long exit = exitAddress(t);
+    uint8_t *expected;
+    size_t size;
+    int reason;
+
+    t->outcome = PASS;
+    t->message[0] = 0;
+
+    if(sim == 0 || !load(sim, t)){
+        fail(t, ERROR, "cannot load the image");
+    }
+    else if(exit == -2){
+        fail(t, ERROR, "unknown exit symbol");
+    }
+    else{
+        if(t->eeprom[0]){
+            uint8_t *eeprom = readFile(t->eeprom, &size);
+
+            if(eeprom){
+                simWriteEeprom(sim, 0, eeprom, size);
+                free(eeprom);
+            }
+            else{
+                fail(t, ERROR, "cannot read the EEPROM file");
+            }
+        }
+        simSetIO(sim, t->console, 0, consoleWrite, &output);
+        if(exit >= 0){
+            simSetBreakpoint(sim, exit / 2, 1);
+        }
+
+        reason = simRun(sim, t->cycles);
+        t->ran = simCycles(sim);
+        simGetRegisters(sim, &registers);
+        simGetStack(sim, &stack);
+
+        if(t->outcome == PASS && reason == SIM_INVALID){
+            uint16_t opcode;
+
+            simReadFlash(sim, registers.pc, &opcode, 1);
+            snprintf(t->message, MAXMESSAGE, "invalid opcode $%04X at PC $%04X", opcode, registers.pc * 2);
+            t->outcome = FAIL;
+        }
+        else if(t->outcome == PASS && stack.collided){
+            snprintf(t->message, MAXMESSAGE, "stack collision, SP $%04X at PC $%04X", stack.collisionSp, stack.collisionPc * 2);
+            t->outcome = FAIL;
+        }
+        else if(t->outcome == PASS && exit >= 0 && reason != SIM_BREAKPOINT){
+            fail(t, FAIL, "exit not reached");
+        }
+        else if(t->outcome == PASS && t->status >= 0 && registers.r[24] != t->status){
+            snprintf(t->message, MAXMESSAGE, "status %d, expected %ld", registers.r[24], t->status);
+            t->outcome = FAIL;
+        }
+        else if(t->outcome == PASS && t->expect[0]){
+            expected = readFile(t->expect, &size);
+            if(expected == 0){
+                fail(t, ERROR, "cannot read the expected output");
+            }
+            else if(size != output.size || memcmp(expected, output.bytes, size) != 0){
+                snprintf(t->message, MAXMESSAGE, "output differs (%zu bytes, expected %zu)", output.size, size);
+                t->outcome = FAIL;
+            }
+            free(expected);
+        }
+    }
+
+    if(sim){
+        simDestroy(sim);
+    }
+    free(output.bytes);
+}
+
+/* Work stealing */
+
+static int take(struct deque *d, int own){
+    int item = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if(d->top < d->bottom){
+        item = own ? d->items[--d->bottom] : d->items[d->top++];
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return item;
+}
+
+static void *worker(void *arg){
+    int self = (int)(intptr_t)arg;
+    int i, item;
+
+    for(;;){
+        item = take(&deques[self], 1);
+        for(i = 1; item < 0 && i < nthreads; i++){
+            item = take(&deques[(self + i) % nthreads], 0);
+        }
+        // Nothing is added once the runs start, so empty deques mean the end
+        if(item < 0){
+            return 0;
+        }
+
+        struct test *t = &tests[item];
+        struct hash h = key(t);
+        double start = now();
+
+        if(!cacheLoad(t, h)){
+            run(t);
+            if(t->outcome != ERROR){
+                cacheStore(t, h);
+            }
+        }
+        t->seconds = now() - start;
+    }
+}
+
+// Longest budget first
+static int byCycles(const void *a, const void *b){
+    const struct test *x = &tests[*(const int *)a];
+    const struct test *y = &tests[*(const int *)b];
+
+    return x->cycles < y->cycles ? 1 : x->cycles > y->cycles ? -1 : 0;
+}
+
+static void runAll(){
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    int *order = malloc(ntests * sizeof(int));
+    int i;
+
+    for(i = 0; i < ntests; i++){
+        order[i] = i;
+    }
+    qsort(order, ntests, sizeof(int), byCycles);
+
+    // Dealt so that each deque has its longest test at the bottom, where its owner starts
+    deques = calloc(nthreads, sizeof(struct deque));
+    for(i = 0; i < nthreads; i++){
+        pthread_mutex_init(&deques[i].lock, 0);
+        deques[i].items = malloc((ntests / nthreads + 1) * sizeof(int));
+    }
+    for(i = ntests - 1; i >= 0; i--){
+        struct deque *d = &deques[i % nthreads];
+
+        d->items[d->bottom++] = order[i];
+    }
+
+    for(i = 0; i < nthreads; i++){
+        pthread_create(&threads[i], 0, worker, (void *)(intptr_t)i);
+    }
+    for(i = 0; i < nthreads; i++){
+        pthread_join(threads[i], 0);
+    }
+
+    free(threads);
+    free(order);
+}
+
+/* Reading the tests */
+
+static struct test *newTest(){
+    static int capacity;
+    struct test *t;
+
+    if(ntests == capacity){
+        capacity = capacity ? 2 * capacity : 64;
+        tests = realloc(tests, capacity * sizeof(struct test));
+    }
+    t = &tests[ntests++];
+    memset(t, 0, sizeof(struct test));
+    t->console = 0x3E;
+    t->cycles = 10000000;
+    t->status = -1;
+
+    return t;
+}
+
+static void relative(char *path, const char *directory, const char *name){
+    if(name[0] == '/'){
+        snprintf(path, MAXPATH, "%s", name);
+    }
+    else{
+        snprintf(path, MAXPATH, "%s/%s", directory, name);
+    }
+}
+
+static int readManifest(const char *manifest){
+    char directory[MAXPATH], line[2048];
+    FILE *f = fopen(manifest, "r");
+    int number = 0;
+
+    if(f == 0){
+        return 0;
+    }
+    snprintf(directory, MAXPATH, "%s", manifest);
+    if(strrchr(directory, '/')){
+        *strrchr(directory, '/') = 0;
+    }
+    else{
+        strcpy(directory, ".");
+    }
+
+    while(fgets(line, sizeof(line), f)){
+        char *word, *save;
+        struct test *t;
+
+        number++;
+        line[strcspn(line, "#\n")] = 0;
+        word = strtok_r(line, " \t", &save);
+        if(word == 0){
+            continue;
+        }
+        t = newTest();
+        snprintf(t->name, MAXNAME, "%s", word);
+        word = strtok_r(0, " \t", &save);
+        if(word == 0){
+            printf("%s:%d: NO IMAGE.", manifest, number);
+            exit(2);
+        }
+        relative(t->image, directory, word);
+
+        while((word = strtok_r(0, " \t", &save))){
+            char *value = strchr(word, '=');
+
+            if(value == 0){
+                printf("%s:%d: BAD OPTION %s.", manifest, number, word);
+                exit(2);
+            }
+            *value++ = 0;
+            if(strcmp(word, "cycles") == 0){
+                t->cycles = strtoull(value, 0, 0);
+            }
+            else if(strcmp(word, "exit") == 0){
+                snprintf(t->exit, MAXNAME, "%s", value);
+            }
+            else if(strcmp(word, "status") == 0){
+                t->status = strtol(value, 0, 0) & 0xFF;
+            }
+            else if(strcmp(word, "console") == 0){
+                t->console = strtoul(value, 0, 0);
+            }
+            else if(strcmp(word, "expect") == 0){
+                relative(t->expect, directory, value);
+            }
+            else if(strcmp(word, "eeprom") == 0){
+                relative(t->eeprom, directory, value);
+            }
+            else{
+                printf("%s:%d: UNKNOWN OPTION %s.", manifest, number, word);
+                exit(2);
+            }
+        }
+    }
+    fclose(f);
+
+    return 1;
+}
+
+static int byName(const void *a, const void *b){
+    return strcmp(((const struct test *)a)->name, ((const struct test *)b)->name);
+}
+
+static int readDirectory(const char *directory){
+    DIR *d = opendir(directory);
+    struct dirent *e;
+
+    if(d == 0){
+        return 0;
+    }
+    while((e = readdir(d))){
+        struct test *t;
+        char *dot;
+
+        if(!endsWith(e->d_name, ".elf") && !endsWith(e->d_name, ".hex") && !endsWith(e->d_name, ".bin")){
+            continue;
+        }
+        t = newTest();
+        snprintf(t->name, MAXNAME, "%s", e->d_name);
+        relative(t->image, directory, e->d_name);
+        relative(t->expect, directory, e->d_name);
+        dot = strrchr(t->expect, '.');
+        strcpy(dot, ".out");
+        if(access(t->expect, R_OK) != 0){
+            t->expect[0] = 0;
+        }
+    }
+    closedir(d);
+    qsort(tests, ntests, sizeof(struct test), byName);
+
+    return 1;
+}
+
+/* Reports */
+
+static const char *outcomes[] = {"pass", "fail", "error"};
+
+static void jsonString(FILE *f, const char *s){
+    fputc('"', f);
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\'){
+            fprintf(f, "\\%c", *s);
+        }
+        else if((uint8_t)*s < 0x20){
+            fprintf(f, "\\u%04x", *s);
+        }
+        else{
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void xmlString(FILE *f, const char *s){
+    for(; *s; s++){
+        switch(*s){
+        case '<':
+            fputs("&lt;", f);
+            break;
+        case '>':
+            fputs("&gt;", f);
+            break;
+        case '&':
+            fputs("&amp;", f);
+            break;
+        case '"':
+            fputs("&quot;", f);
+            break;
+        default:
+            fputc(*s, f);
+        }
+    }
+}
+
+static void writeJson(const char *path, int counts[3], int cached, double seconds){
+    FILE *f = fopen(path, "w");
+    int i;
+
+    if(f == 0){
+        printf("CANNOT WRITE %s.", path);
+        exit(2);
+    }
+    fprintf(f, "{\"tests\": %d, \"passed\": %d, \"failed\": %d, \"errors\": %d, \"cached\": %d, \"seconds\": %.3f, \"results\": [",
+        ntests, counts[PASS], counts[FAIL], counts[ERROR], cached, seconds);
+    for(i = 0; i < ntests; i++){
+        struct test *t = &tests[i];
+
+        fprintf(f, "%s\n  {\"name\": ", i ? "," : "");
+        jsonString(f, t->name);
+        fprintf(f, ", \"outcome\": \"%s\", \"cycles\": %llu, \"seconds\": %.6f, \"cached\": %s, \"message\": ",
+            outcomes[t->outcome], (unsigned long long)t->ran, t->seconds, t->cached ? "true" : "false");
+        jsonString(f, t->message);
+        fputc('}', f);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
+
+static void writeJunit(const char *path, int counts[3], double seconds){
+    FILE *f = fopen(path, "w");
+    int i;
+
+    if(f == 0){
+        printf("CANNOT WRITE %s.", path);
+        exit(2);
+    }
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(f, "<testsuite name=\"simulador\" tests=\"%d\" failures=\"%d\" errors=\"%d\" skipped=\"0\" time=\"%.3f\">\n",
+        ntests, counts[FAIL], counts[ERROR], seconds);
+    for(i = 0; i < ntests; i++){
+        struct test *t = &tests[i];
+
+        fprintf(f, "  <testcase classname=\"firmware\" name=\"");
+        xmlString(f, t->name);
+        fprintf(f, "\" time=\"%.6f\"", t->seconds);
+        if(t->outcome == PASS){
+            fprintf(f, "/>\n");
+            continue;
+        }
+        fprintf(f, ">\n    <%s message=\"", t->outcome == FAIL ? "failure" : "error");
+        xmlString(f, t->message);
+        fprintf(f, "\"/>\n  </testcase>\n");
+    }
+    fprintf(f, "</testsuite>\n");
+    fclose(f);
+}
+
+int main(int argc, char **argv){
+    const char *junit = 0, *json = 0;
+    int counts[3] = {0, 0, 0};
+    int option, cached = 0, i;
+    struct stat st;
+    double start;
+
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while((option = getopt(argc, argv, "n:C:j:J:")) != -1){
+        switch(option){
+        case 'n':
+            nthreads = atoi(optarg);
+            break;
+        case 'C':
+            cache = optarg;
+            break;
+        case 'j':
+            junit = optarg;
+            break;
+        case 'J':
+            json = optarg;
+            break;
+        default:
+            return 2;
+        }
+    }
+    if(optind != argc - 1){
+        printf("usage: regress.exe [-n threads] [-C cache] [-j junit.xml] [-J summary.json] manifest|directory\n");
+        return 2;
+    }
+    if(nthreads < 1){
+        nthreads = 1;
+    }
+
+    if(stat(argv[optind], &st) != 0 || !(S_ISDIR(st.st_mode) ? readDirectory(argv[optind]) : readManifest(argv[optind]))){
+        printf("CANNOT READ %s.", argv[optind]);
+        return 2;
+    }
+    mkdir(cache, 0755);
+
+    // The simulator build is the runner itself
+    build.a = 0xCBF29CE484222325ULL;
+    build.b = 0x6A09E667F3BCC908ULL;
+    hashFile(&build, "/proc/self/exe");
+
+    start = now();
+    runAll();
+
+    for(i = 0; i < ntests; i++){
+        struct test *t = &tests[i];
+
+        counts[t->outcome]++;
+        cached += t->cached;
+        if(t->outcome != PASS){
+            printf("%s %s: %s\n", outcomes[t->outcome], t->name, t->message);
+        }
+    }
+    printf("%d tests: %d passed, %d failed, %d errors, %d cached, %.2f s\n",
+        ntests, counts[PASS], counts[FAIL], counts[ERROR], cached, now() - start);
+
+    if(json){
+        writeJson(json, counts, cached, now() - start);
+    }
+    if(junit){
+        writeJunit(junit, counts, now() - start);
+    }
+
+    return counts[PASS] == ntests ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "replay.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "gpio.h"
+#include "async.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Everything that reaches the MCU from outside the simulator is an input: pins driven by the
+host (setPin(), releasePin()), ADC samples, values returned by host I/O callbacks
+(simSetIO()), bytes answered by SPI and TWI devices (spi.c, twi.c) and bytes delivered by
+asynchronous models (async.c). The rest, co-simulated MCUs included, is a function of the
+state, so logging the inputs with their cycle is enough to run the same execution again,
+instruction for instruction.
+
+A recording is a header and one record per input:
+
+    header      struct header: the layout of the snapshot of the build and the start cycle
+    record      cycles since the previous record, kind, a, b; each a LEB128 varint
+
+so most records take 4 to 6 bytes. They go through a 1MB stdio buffer; the simulator only
+tests REPLAY at the points inputs come in.
+
+A replay maps the file and feeds it back from the same state (the same image, reset, or
+the checkpoint the recording started from). Pushed inputs (pins, channel bytes) are applied
+by an event at their cycle, and the inputs of the host are ignored. Pulled inputs (ADC
+samples, callback reads, device answers) are taken from the file in order when the MCU asks
+for them; a request at another cycle or of another kind means the run left the
+recording, and the program ends there.
+
+reset() ends a recording or a replay.
+*/
+
+#define REPLAY_MAGIC 0x594C5052     // "RPLY"
+#define REPLAY_VERSION 1
+#define BUFFERSIZE (1 << 20)
+
+struct header{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t layout;
+    uint32_t reserved;
+    uint64_t start;
+};
+
+struct record{
+    uint64_t cycle;
+    int kind;
+    uint32_t a, b;
+};
+
+// Position in the recording, with the cycle of the record read last
+struct cursor{
+    size_t offset;
+    uint64_t cycle;
+};
+
+MCUSTATE int REPLAY;
+
+static MCUSTATE FILE *out;
+static MCUSTATE uint64_t last;
+
+static MCUSTATE const uint8_t *recording;
+static MCUSTATE size_t size;
+static MCUSTATE struct cursor pushed, pulled;
+static MCUSTATE struct record nextPush;
+
+static int isPushed(int kind){
+    return kind == INPUT_PIN || kind == INPUT_CHANNEL;
+}
+
+/* Recording */
+
+static void putVarint(uint8_t **p, uint64_t value){
+    while(value >= 0x80){
+        *(*p)++ = value | 0x80;
+        value >>= 7;
+    }
+    *(*p)++ = value;
+}
+
+/* Starts logging the inputs to path, from the current state. Returns 0 if it cannot. */
+int recordStart(const char *path){
+    struct header h = {REPLAY_MAGIC, REPLAY_VERSION, stateLayout(), 0, CYCLES};
+
+    replayStop();
+    out = fopen(path, "wb");
+    if(out == 0){
+        return 0;
+    }
+    setvbuf(out, 0, _IOFBF, BUFFERSIZE);
+    fwrite(&h, sizeof(h), 1, out);
+    last = CYCLES;
+    REPLAY = RECORDING;
+
+    return 1;
+}
+
+void recordInput(int kind, uint32_t a, uint32_t b){
+    uint8_t buffer[32], *p = buffer;
+
+    putVarint(&p, CYCLES - last);
+    *p++ = kind;
+    putVarint(&p, a);
+    putVarint(&p, b);
+    fwrite(buffer, p - buffer, 1, out);
+    last = CYCLES;
+}
+
+/* Replay */
+
+static uint64_t getVarint(size_t *offset){
+    uint64_t value = 0;
+    int shift = 0;
+
+    while(*offset < size){
+        uint8_t byte = recording[(*offset)++];
+
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)){
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+
+// Reads the next record of the pushed or of the pulled kinds. Returns 0 at the end.
+static int next(struct cursor *c, int push, struct record *r){
+    while(c->offset < size){
+        c->cycle += getVarint(&c->offset);
+        r->cycle = c->cycle;
+        r->kind = c->offset < size ? recording[c->offset++] : 0;
+        r->a = getVarint(&c->offset);
+        r->b = getVarint(&c->offset);
+        if(isPushed(r->kind) == push){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void apply(const struct record *r){
+    if(r->kind == INPUT_PIN){
+        drivePin(r->a >> 8, r->a & 0xFF, r->b);
+    }
+    else{
+        asyncInject(r->a >> 16, r->a & 0xFFFF, r->b);
+    }
+}
+
+// Applies the pushed inputs of this cycle, then waits for the next one
+static void push(uint64_t when){
+    while(nextPush.cycle <= when){
+        apply(&nextPush);
+        if(!next(&pushed, 1, &nextPush)){
+            return;
+        }
+    }
+    schedule(push, nextPush.cycle);
+}
+
+static void diverged(int kind, uint32_t a){
+    printf("REPLAY DIVERGED AT CYCLE %llu: INPUT %d %u NOT RECORDED.", (unsigned long long)CYCLES, kind, a);
+    exit(1);
+}
+
+/* Feeds the inputs recorded in path back, from now on. The state must be the one the
+recording started from. Returns 0 if the file cannot be read or is not a recording of
+this build at this cycle. */
+int replayStart(const char *path){
+    struct header h;
+    struct stat st;
+    void *map;
+    int fd;
+
+    replayStop();
+    fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return 0;
+    }
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(h)){
+        close(fd);
+        return 0;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        return 0;
+    }
+    h = *(const struct header *)map;
+    if(h.magic != REPLAY_MAGIC || h.version != REPLAY_VERSION || h.layout != stateLayout() || h.start != CYCLES){
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    recording = map;
+    size = st.st_size;
+    pushed.offset = pulled.offset = sizeof(h);
+    pushed.cycle = pulled.cycle = h.start;
+    REPLAY = REPLAYING;
+
+    if(next(&pushed, 1, &nextPush)){
+        schedule(push, nextPush.cycle);
+    }
+    return 1;
+}
+
+/* The recorded value of the input the MCU asks for: an ADC channel or an I/O address. */
+uint32_t replayInput(int kind, uint32_t a){
+    struct record r;
+
+    if(!next(&pulled, 0, &r) || r.kind != kind || r.a != a || r.cycle != CYCLES){
+        diverged(kind, a);
+    }
+    return r.b;
+}
+
+/* Ends the recording, writing what is left of it, or the replay. */
+void replayStop(){
+    if(out){
+        fclose(out);
+        out = 0;
+    }
+    if(recording){
+        munmap((void *)recording, size);
+        recording = 0;
+        unschedule(push);
+    }
+    REPLAY = REPLAY_OFF;
+}
@@ -0,0 +1,48 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include "registers.h"
+
+/* Recording the inputs of the MCU, and running them again (see replay.c) */
+
+#define REPLAY_OFF 0
+#define RECORDING 1
+#define REPLAYING 2
+
+/* Inputs. Pins and channel bytes are pushed into the MCU by the host; ADC samples, reads
+of host I/O callbacks and the answers of SPI and TWI devices are pulled by the MCU. */
+#define INPUT_PIN 1         // a: port << 8 | pin, b: level, 2 for released
+#define INPUT_ADC 2         // a: ADMUX channel, b: millivolts
+#define INPUT_READ 3        // a: data address, b: value
+#define INPUT_CHANNEL 4     // a: channel << 16 | port, b: byte
+#define INPUT_SPI 5         // a: byte sent on MOSI, b: byte received on MISO
+#define INPUT_TWI 6         // a: question << 8 | byte sent (twi.c), b: acknowledge or byte read
+
+extern MCUSTATE int REPLAY;
+
+int recordStart(const char *path);
+int replayStart(const char *path);
+void replayStop();
+void recordInput(int kind, uint32_t a, uint32_t b);
+uint32_t replayInput(int kind, uint32_t a);
+
+#endif
@@ -0,0 +1,192 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "scheduler.h"
+#include "registers.h"
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+Peripherals do not count cycle by cycle. Each one computes when its next visible change
+happens (a compare match, a finished conversion, a received byte) and schedules a handler
+for that cycle. The decoder only compares CYCLES with NEXTEVENT before each instruction,
+and a sleeping core jumps CYCLES straight to NEXTEVENT.
+
+A handler has at most one pending event: scheduling it again moves the event.
+
+Events name their handler by its index in handlers[], not by its address, so the snapshot
+of the events holds no code address and a checkpoint can be restored by another process of
+the same build. The peripherals keep their handlers (keepHandler()) when reset() sets them
+up, always in the same order, so these have the same index in every process. Any other
+handler is added when it is first scheduled; its index depends on what the process did
+before, so dropEvents() removes its events from a restored checkpoint.
+*/
+
+#define MAXEVENTS 32
+#define MAXHANDLERS 64
+
+struct event{
+    uint64_t when;
+    int handler;
+};
+
+struct handler{
+    void (*run)(uint64_t when);
+    int kept;
+};
+
+static MCUSTATE struct event events[MAXEVENTS];
+static MCUSTATE int nevents;
+
+// Never cleared, so the indices in a snapshot stay valid in this thread
+static MCUSTATE struct handler handlers[MAXHANDLERS];
+static MCUSTATE int nhandlers;
+
+MCUSTATE uint64_t NEXTEVENT = NEVER;
+
+static void updateNextEvent(){
+    int i;
+
+    NEXTEVENT = NEVER;
+    for(i = 0; i < nevents; i++){
+        if(events[i].when < NEXTEVENT){
+            NEXTEVENT = events[i].when;
+        }
+    }
+}
+
+// Index of handler in handlers[], added if it is not there
+static int handlerIndex(void (*handler)(uint64_t when)){
+    int i;
+
+    for(i = 0; i < nhandlers; i++){
+        if(handlers[i].run == handler){
+            return i;
+        }
+    }
+    if(nhandlers == MAXHANDLERS){
+        printf("TOO MANY EVENT HANDLERS.");
+        exit(1);
+    }
+    handlers[nhandlers].run = handler;
+    return nhandlers++;
+}
+
+/* Gives handler an index that is the same in every process of this build. Called by the
+peripherals when reset() sets them up, before they schedule it. */
+void keepHandler(void (*handler)(uint64_t when)){
+    handlers[handlerIndex(handler)].kept = 1;
+}
+
+// Schedule handler to run at cycle when
+void schedule(void (*handler)(uint64_t when), uint64_t when){
+    int h = handlerIndex(handler);
+    int i;
+
+    for(i = 0; i < nevents; i++){
+        if(events[i].handler == h){
+            break;
+        }
+    }
+    if(i == nevents){
+        if(nevents == MAXEVENTS){
+            printf("TOO MANY EVENTS.");
+            exit(1);
+        }
+        nevents++;
+    }
+
+    events[i].handler = h;
+    events[i].when = when;
+
+    updateNextEvent();
+}
+
+// Remove the pending event of handler, if any
+void unschedule(void (*handler)(uint64_t when)){
+    int i;
+
+    for(i = 0; i < nevents; i++){
+        if(handlers[events[i].handler].run == handler){
+            events[i] = events[--nevents];
+            updateNextEvent();
+            return;
+        }
+    }
+}
+
+// Run, in time order, every event due at or before CYCLES
+void runEvents(){
+    while(NEXTEVENT <= CYCLES){
+        int i;
+        int first = 0;
+
+        for(i = 1; i < nevents; i++){
+            if(events[i].when < events[first].when){
+                first = i;
+            }
+        }
+
+        struct event e = events[first];
+        events[first] = events[--nevents];
+        updateNextEvent();
+
+        handlers[e.handler].run(e.when);
+    }
+}
+
+/* A number that changes with the indices of the kept handlers, for a checkpoint to tell
+whether they are the ones it was saved with. */
+uint32_t handlerLayout(){
+    uint32_t layout = 0;
+    int i;
+
+    for(i = 0; i < nhandlers; i++){
+        if(handlers[i].kept){
+            layout = layout * 31 + i + 1;
+        }
+    }
+    return layout;
+}
+
+/* Removes the pending events whose handlers were not kept, after events were restored from
+a checkpoint saved by another process: their indices do not name the same handlers here.
+They are the bounds of runs (simRun(), warmBoot()), which the running code sets again. */
+void dropEvents(){
+    int i = 0;
+
+    while(i < nevents){
+        if(events[i].handler >= nhandlers || !handlers[events[i].handler].kept){
+            events[i] = events[--nevents];
+        }
+        else{
+            i++;
+        }
+    }
+    updateNextEvent();
+}
+
+void clearEvents(){
+    nevents = 0;
+    NEXTEVENT = NEVER;
+
+    keepState(events, sizeof(events));
+    keepState(&nevents, sizeof(nevents));
+    keepState(&NEXTEVENT, sizeof(NEXTEVENT));
+}
@@ -0,0 +1,36 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+#include "registers.h"
+
+/* Timed events of the peripherals, in clock cycles */
+
+#define NEVER UINT64_MAX
+
+// Cycle of the earliest scheduled event, NEVER if there is none
+extern MCUSTATE uint64_t NEXTEVENT;
+
+void schedule(void (*handler)(uint64_t when), uint64_t when);
+void unschedule(void (*handler)(uint64_t when));
+void runEvents();
+void clearEvents();
+void keepHandler(void (*handler)(uint64_t when));
+uint32_t handlerLayout();
+void dropEvents();
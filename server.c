@@ -0,0 +1,779 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "simulador.h"
+#include "registers.h"
+#include "elf.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+server.exe, the simulation server:
+
+    server.exe [-n instances] socket [id=image...]
+
+Listens on a unix domain socket and runs the jobs sent to it on a pool of instances of the
+library created at start, so a job costs neither a process nor the loading of its image.
+Clients send lines:
+
+    image ID PATH               names an image (ELF, Intel HEX or raw); jobs may also give
+                                a path directly
+    NAME IMAGE option=value...  queues a job, with the options of the regress.exe manifests
+                                (cycles, exit, status, console, expect, eeprom) and
+                                data=ADDR:HEX, bytes written to the data space before it runs
+    end                         (or an empty line) ends a batch
+
+and get a line per job as soon as it finishes, in the order jobs finish:
+
+    result NAME pass|fail|error cycles=N status=R24 output=HEX [: message]
+
+then "done PASSED FAILED ERRORS" once every job of the batch has finished. An invalid opcode
+ends its job, as an error, and not the server. A connection runs its batches one after the
+other; clients wanting more in flight open more connections. Paths are relative to the
+directory of the server.
+
+Images are loaded once, into a flash image shared by the instances (simImageCreate()), and
+loaded again when the file changes. An instance is reused by mapping the image again,
+which drops the flash pages the last job wrote, and resetting it: no allocation per job.
+*/
+
+#define MAXNAME 128
+#define MAXPATH 512
+#define MAXMESSAGE 256
+#define MAXLINE 4096
+#define MAXOUTPUT (1 << 20)
+
+#define PASS 0
+#define FAIL 1
+#define ERROR 2
+
+static const char *outcomes[] = {"pass", "fail", "error"};
+
+struct entry{
+    char id[MAXNAME];
+    char path[MAXPATH];
+    struct timespec mtime;
+    off_t size;
+    simImage *image;
+    uint8_t eeprom[EEPROMSIZE];     // contents the image sets, 0xFF elsewhere
+    struct elf elf;                 // for the exit symbols, if an ELF
+    int isElf;
+    struct entry *next;
+};
+
+/* Replies are queued and written by a thread of the connection, so a client slow to read
+holds up neither the instances nor the reading of its requests. */
+struct connection{
+    int fd;
+    pthread_t writer;
+    pthread_mutex_t lock;           // everything below
+    pthread_cond_t idle;            // pending got to 0
+    pthread_cond_t queued;          // replies to write, or closing
+    char *replies;
+    size_t size, capacity;
+    int closing;
+    int pending;
+    int counts[3];
+};
+
+struct job{
+    struct connection *connection;
+    char name[MAXNAME];
+    char image[MAXPATH];
+    char expect[MAXPATH];
+    char eeprom[MAXPATH];
+    char exit[MAXNAME];
+    char *data;                     // ADDR:HEX inputs, space separated, or 0
+    uint16_t console;
+    uint64_t cycles;
+    long status;                    // -1 for none
+    struct job *next;
+};
+
+struct output{
+    uint8_t *bytes;
+    size_t size;
+};
+
+struct instance{
+    simulador *sim;
+    struct output output;
+    uint16_t console;
+};
+
+static pthread_mutex_t imagesLock = PTHREAD_MUTEX_INITIALIZER;
+static struct entry *images;
+
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued = PTHREAD_COND_INITIALIZER;
+static struct job *head, *tail;
+
+static const char *socketPath;
+
+/* Images */
+
+static int endsWith(const char *s, const char *suffix){
+    size_t n = strlen(s), m = strlen(suffix);
+
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static uint8_t *readFile(const char *path, size_t *size){
+    FILE *f = fopen(path, "rb");
+    uint8_t *data;
+    long n;
+
+    if(f == 0 || fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) < 0){
+        if(f){
+            fclose(f);
+        }
+        return 0;
+    }
+    rewind(f);
+    data = malloc(n + 1);
+    *size = fread(data, 1, n, f);
+    fclose(f);
+
+    return data;
+}
+
+// Loads the file of e into a new image, on an instance made for it
+static int load(struct entry *e){
+    simulador *sim = simCreate();
+    uint8_t *data;
+    size_t size;
+    int loaded = 0;
+
+    if(sim == 0){
+        return 0;
+    }
+    if(endsWith(e->path, ".elf")){
+        loaded = simLoadElf(sim, e->path);
+    }
+    else if(endsWith(e->path, ".hex")){
+        loaded = simLoadHex(sim, e->path);
+    }
+    else if((data = readFile(e->path, &size))){
+        loaded = simLoadBinary(sim, data, size);
+        free(data);
+    }
+    if(loaded){
+        simReadEeprom(sim, 0, e->eeprom, EEPROMSIZE);
+        e->image = simImageCreate(sim);
+        loaded = e->image != 0;
+    }
+    simDestroy(sim);
+
+    if(loaded){
+        e->isElf = endsWith(e->path, ".elf") && elfOpen(e->path, &e->elf);
+    }
+    return loaded;
+}
+
+static void unload(struct entry *e){
+    if(e->image){
+        simImageRelease(e->image);
+        e->image = 0;
+    }
+    if(e->isElf){
+        elfClose(&e->elf);
+        e->isElf = 0;
+    }
+}
+
+// Nonzero if e holds an image of the file as st describes it
+static int current(struct entry *e, struct stat *st){
+    return e->image && st->st_size == e->size && st->st_mtim.tv_sec == e->mtime.tv_sec && st->st_mtim.tv_nsec == e->mtime.tv_nsec;
+}
+
+/* The entry of an image id, or of a path used as one. With imagesLock held. The image is
+(re)loaded if the file changed since it was; the lock is released while the file is loaded,
+so jobs of other images are not held up by it. Entries are never freed. */
+static struct entry *lookup(const char *name){
+    struct entry *e, fresh;
+    struct stat st;
+    int loaded;
+
+    for(e = images; e && strcmp(e->id, name) != 0; e = e->next);
+    if(e == 0){
+        e = calloc(1, sizeof(struct entry));
+        snprintf(e->id, MAXNAME, "%s", name);
+        snprintf(e->path, MAXPATH, "%s", name);
+        e->next = images;
+        images = e;
+    }
+
+    if(stat(e->path, &st) != 0){
+        return e->image ? e : 0;
+    }
+    if(current(e, &st)){
+        return e;
+    }
+
+    memset(&fresh, 0, sizeof(fresh));
+    snprintf(fresh.path, MAXPATH, "%s", e->path);
+    pthread_mutex_unlock(&imagesLock);
+    loaded = load(&fresh);
+    pthread_mutex_lock(&imagesLock);
+
+    // Renamed meanwhile, or loaded by another job
+    if(strcmp(fresh.path, e->path) != 0){
+        unload(&fresh);
+        return lookup(name);
+    }
+    if(current(e, &st)){
+        unload(&fresh);
+        return e;
+    }
+
+    unload(e);
+    e->size = st.st_size;
+    e->mtime = st.st_mtim;
+    if(!loaded){
+        return 0;
+    }
+    e->image = fresh.image;
+    memcpy(e->eeprom, fresh.eeprom, EEPROMSIZE);
+    e->elf = fresh.elf;
+    e->isElf = fresh.isElf;
+
+    return e;
+}
+
+static void nameImage(const char *id, const char *path){
+    struct entry *e;
+
+    pthread_mutex_lock(&imagesLock);
+    for(e = images; e && strcmp(e->id, id) != 0; e = e->next);
+    if(e && strcmp(e->path, path) != 0){
+        unload(e);
+    }
+    if(e == 0){
+        e = calloc(1, sizeof(struct entry));
+        snprintf(e->id, MAXNAME, "%s", id);
+        e->next = images;
+        images = e;
+    }
+    snprintf(e->path, MAXPATH, "%s", path);
+    lookup(id);
+    pthread_mutex_unlock(&imagesLock);
+}
+
+/* Running a job */
+
+static void consoleWrite(simulador *sim, uint16_t addr, uint8_t value, void *user){
+    struct output *o = user;
+
+    if(o->size < MAXOUTPUT){
+        o->bytes[o->size++] = value;
+    }
+}
+
+// Byte address of the exit point, -1 for none, -2 for an unknown symbol
+static long exitAddress(struct entry *e, const char *exit){
+    uint32_t value, size;
+    char *end;
+    long address = strtol(exit, &end, 0);
+
+    if(exit[0] && *end == 0){
+        return address;
+    }
+    if(!e->isElf){
+        return exit[0] ? -2 : -1;
+    }
+    return elfSymbol(&e->elf, exit[0] ? exit : "_exit", &value, &size) ? (long)value : exit[0] ? -2 : -1;
+}
+
+static int hexDigit(char c){
+    return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+// Writes the data=ADDR:HEX inputs. Returns 0 if one is malformed.
+static int writeInputs(simulador *sim, char *data){
+    uint8_t bytes[MAXLINE / 2];
+    char *word, *save;
+
+    for(word = strtok_r(data, " ", &save); word; word = strtok_r(0, " ", &save)){
+        char *hex;
+        long addr = strtol(word, &hex, 0);
+        size_t n = 0;
+
+        if(*hex++ != ':' || addr < 0){
+            return 0;
+        }
+        for(; hexDigit(hex[0]) >= 0 && hexDigit(hex[1]) >= 0; hex += 2){
+            bytes[n++] = hexDigit(hex[0]) << 4 | hexDigit(hex[1]);
+        }
+        if(*hex){
+            return 0;
+        }
+        simWriteData(sim, addr, bytes, n);
+    }
+    return 1;
+}
+
+static void fail(int *outcome, char *message, int code, const char *text){
+    *outcome = code;
+    snprintf(message, MAXMESSAGE, "%s", text);
+}
+
+// Queues a reply, with c->lock held
+static void reply(struct connection *c, const char *line, size_t size){
+    if(c->size + size > c->capacity){
+        c->capacity = (c->size + size) * 2;
+        c->replies = realloc(c->replies, c->capacity);
+    }
+    memcpy(c->replies + c->size, line, size);
+    c->size += size;
+    pthread_cond_signal(&c->queued);
+}
+
+static void *writer(void *arg){
+    struct connection *c = arg;
+    char *replies = 0;
+    size_t size, capacity = 0, done;
+    ssize_t n;
+
+    pthread_mutex_lock(&c->lock);
+    for(;;){
+        while(c->size == 0 && !c->closing){
+            pthread_cond_wait(&c->queued, &c->lock);
+        }
+        if(c->size == 0){
+            break;
+        }
+        // Swapped with an empty buffer, so workers queue while this one is written
+        char *full = c->replies;
+        size_t fullCapacity = c->capacity;
+
+        size = c->size;
+        c->replies = replies;
+        c->capacity = capacity;
+        c->size = 0;
+        replies = full;
+        capacity = fullCapacity;
+        pthread_mutex_unlock(&c->lock);
+
+        for(done = 0; done < size; done += n){
+            n = write(c->fd, replies + done, size - done);
+            if(n < 0 && errno == EINTR){
+                n = 0;
+            }
+            else if(n <= 0){
+                break;
+            }
+        }
+        pthread_mutex_lock(&c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    free(replies);
+    return 0;
+}
+
+static void report(struct instance *in, struct job *j, int outcome, uint64_t cycles, int status, const char *message){
+    struct connection *c = j->connection;
+    size_t size = 0, i;
+    char *line = malloc(MAXNAME + 64 + 2 * in->output.size + MAXMESSAGE);
+
+    size += sprintf(line, "result %s %s cycles=%llu status=%d output=", j->name, outcomes[outcome], (unsigned long long)cycles, status);
+    for(i = 0; i < in->output.size; i++){
+        size += sprintf(line + size, "%02x", in->output.bytes[i]);
+    }
+    size += sprintf(line + size, message[0] ? " : %s\n" : "\n", message);
+
+    pthread_mutex_lock(&c->lock);
+    reply(c, line, size);
+    c->counts[outcome]++;
+    if(--c->pending == 0){
+        pthread_cond_signal(&c->idle);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    free(line);
+}
+
+static void run(struct instance *in, struct job *j){
+    struct simRegisters registers;
+    char message[MAXMESSAGE] = "";
+    int outcome = PASS, reason;
+    uint64_t cycles = 0;
+    struct entry *e;
+    long exit = -1;
+    uint8_t *bytes;
+    size_t size;
+
+    // Fast reset: the image mapped again over the pages the last job wrote, then reset()
+    simSetIO(in->sim, in->console, 0, 0, 0);
+    in->output.size = 0;
+
+    pthread_mutex_lock(&imagesLock);
+    e = lookup(j->image);
+    if(e){
+        simImageUse(in->sim, e->image);
+        simWriteEeprom(in->sim, 0, e->eeprom, EEPROMSIZE);
+        exit = exitAddress(e, j->exit);
+    }
+    pthread_mutex_unlock(&imagesLock);
+
+    simReset(in->sim);
+    in->console = j->console;
+    simSetIO(in->sim, j->console, 0, consoleWrite, &in->output);
+    registers.r[24] = 0;
+
+    if(e == 0){
+        fail(&outcome, message, ERROR, "cannot load the image");
+    }
+    else if(exit == -2){
+        fail(&outcome, message, ERROR, "unknown exit symbol");
+    }
+    else if(j->eeprom[0] && (bytes = readFile(j->eeprom, &size)) == 0){
+        fail(&outcome, message, ERROR, "cannot read the EEPROM file");
+    }
+    else{
+        if(j->eeprom[0]){
+            simWriteEeprom(in->sim, 0, bytes, size);
+            free(bytes);
+        }
+        if(j->data && !writeInputs(in->sim, j->data)){
+            fail(&outcome, message, ERROR, "bad data input");
+        }
+        if(exit >= 0){
+            simSetBreakpoint(in->sim, exit / 2, 1);
+        }
+
+        reason = outcome == PASS ? simRun(in->sim, j->cycles) : SIM_DONE;
+        cycles = simCycles(in->sim);
+        simGetRegisters(in->sim, &registers);
+
+        if(exit >= 0){
+            simSetBreakpoint(in->sim, exit / 2, 0);
+        }
+
+        if(reason == SIM_INVALID){
+            uint16_t opcode;
+
+            simReadFlash(in->sim, registers.pc, &opcode, 1);
+            snprintf(message, MAXMESSAGE, "invalid opcode %04x at %05x", opcode, registers.pc * 2);
+            outcome = ERROR;
+        }
+        else if(outcome == PASS && exit >= 0 && reason != SIM_BREAKPOINT){
+            fail(&outcome, message, FAIL, "exit not reached");
+        }
+        else if(outcome == PASS && j->status >= 0 && registers.r[24] != j->status){
+            snprintf(message, MAXMESSAGE, "status %d, expected %ld", registers.r[24], j->status);
+            outcome = FAIL;
+        }
+        else if(outcome == PASS && j->expect[0]){
+            bytes = readFile(j->expect, &size);
+            if(bytes == 0){
+                fail(&outcome, message, ERROR, "cannot read the expected output");
+            }
+            else if(size != in->output.size || memcmp(bytes, in->output.bytes, size) != 0){
+                snprintf(message, MAXMESSAGE, "output differs (%zu bytes, expected %zu)", in->output.size, size);
+                outcome = FAIL;
+            }
+            free(bytes);
+        }
+    }
+
+    report(in, j, outcome, cycles, registers.r[24], message);
+}
+
+static void *worker(void *arg){
+    struct instance *in = arg;
+    struct job *j;
+
+    for(;;){
+        pthread_mutex_lock(&queueLock);
+        while(head == 0){
+            pthread_cond_wait(&queued, &queueLock);
+        }
+        j = head;
+        head = j->next;
+        if(head == 0){
+            tail = 0;
+        }
+        pthread_mutex_unlock(&queueLock);
+
+        run(in, j);
+        free(j->data);
+        free(j);
+    }
+    return 0;
+}
+
+/* Connections */
+
+static void submit(struct job *j){
+    pthread_mutex_lock(&j->connection->lock);
+    j->connection->pending++;
+    pthread_mutex_unlock(&j->connection->lock);
+
+    pthread_mutex_lock(&queueLock);
+    if(tail){
+        tail->next = j;
+    }
+    else{
+        head = j;
+    }
+    tail = j;
+    pthread_cond_signal(&queued);
+    pthread_mutex_unlock(&queueLock);
+}
+
+// Waits for the jobs of the batch and says so
+static void endBatch(struct connection *c){
+    char line[128];
+    int n;
+
+    pthread_mutex_lock(&c->lock);
+    while(c->pending){
+        pthread_cond_wait(&c->idle, &c->lock);
+    }
+    n = snprintf(line, sizeof(line), "done %d %d %d\n", c->counts[PASS], c->counts[FAIL], c->counts[ERROR]);
+    reply(c, line, n);
+    memset(c->counts, 0, sizeof(c->counts));
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void error(struct connection *c, const char *message, const char *word){
+    char line[MAXLINE];
+    int n = snprintf(line, sizeof(line), "error %s %s\n", message, word);
+
+    pthread_mutex_lock(&c->lock);
+    reply(c, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+    pthread_mutex_unlock(&c->lock);
+}
+
+// One request line. Returns 0 at "end".
+static int request(struct connection *c, char *line){
+    char *word, *save, *value;
+    struct job *j;
+
+    line[strcspn(line, "#\r\n")] = 0;
+    word = strtok_r(line, " \t", &save);
+    if(word == 0 || strcmp(word, "end") == 0){
+        return 0;
+    }
+    if(strcmp(word, "image") == 0){
+        char *id = strtok_r(0, " \t", &save);
+        char *path = strtok_r(0, " \t", &save);
+
+        if(id == 0 || path == 0){
+            error(c, "usage: image ID PATH", "");
+        }
+        else{
+            nameImage(id, path);
+        }
+        return 1;
+    }
+
+    j = calloc(1, sizeof(struct job));
+    j->connection = c;
+    j->console = 0x3E;
+    j->cycles = 10000000;
+    j->status = -1;
+    snprintf(j->name, MAXNAME, "%s", word);
+    word = strtok_r(0, " \t", &save);
+    if(word == 0){
+        error(c, "no image for", j->name);
+        free(j);
+        return 1;
+    }
+    snprintf(j->image, MAXPATH, "%s", word);
+
+    while((word = strtok_r(0, " \t", &save))){
+        value = strchr(word, '=');
+        if(value == 0){
+            error(c, "bad option", word);
+            free(j->data);
+            free(j);
+            return 1;
+        }
+        *value++ = 0;
+        if(strcmp(word, "cycles") == 0){
+            j->cycles = strtoull(value, 0, 0);
+        }
+        else if(strcmp(word, "exit") == 0){
+            snprintf(j->exit, MAXNAME, "%s", value);
+        }
+        else if(strcmp(word, "status") == 0){
+            j->status = strtol(value, 0, 0) & 0xFF;
+        }
+        else if(strcmp(word, "console") == 0){
+            j->console = strtoul(value, 0, 0);
+        }
+        else if(strcmp(word, "expect") == 0){
+            snprintf(j->expect, MAXPATH, "%s", value);
+        }
+        else if(strcmp(word, "eeprom") == 0){
+            snprintf(j->eeprom, MAXPATH, "%s", value);
+        }
+        else if(strcmp(word, "data") == 0){
+            size_t n = j->data ? strlen(j->data) : 0;
+
+            j->data = realloc(j->data, n + strlen(value) + 2);
+            sprintf(j->data + n, n ? " %s" : "%s", value);
+        }
+        else{
+            error(c, "unknown option", word);
+            free(j->data);
+            free(j);
+            return 1;
+        }
+    }
+    submit(j);
+
+    return 1;
+}
+
+static void *serve(void *arg){
+    struct connection *c = arg;
+    char line[MAXLINE];
+    FILE *in = fdopen(dup(c->fd), "r");
+
+    while(in && fgets(line, sizeof(line), in)){
+        if(!request(c, line)){
+            endBatch(c);
+        }
+    }
+    if(in){
+        fclose(in);
+    }
+    endBatch(c);
+
+    pthread_mutex_lock(&c->lock);
+    c->closing = 1;
+    pthread_cond_signal(&c->queued);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->writer, 0);
+
+    close(c->fd);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->idle);
+    pthread_cond_destroy(&c->queued);
+    free(c->replies);
+    free(c);
+
+    return 0;
+}
+
+static void stop(int signal){
+    unlink(socketPath);
+    _exit(0);
+}
+
+int main(int argc, char **argv){
+    struct sockaddr_un address = {AF_UNIX};
+    int ninstances = sysconf(_SC_NPROCESSORS_ONLN);
+    int option, listener, i;
+    pthread_t thread;
+
+    while((option = getopt(argc, argv, "n:")) != -1){
+        switch(option){
+        case 'n':
+            ninstances = atoi(optarg);
+            break;
+        default:
+            return 2;
+        }
+    }
+    if(optind >= argc){
+        printf("usage: server.exe [-n instances] socket [id=image...]\n");
+        return 2;
+    }
+    if(ninstances < 1){
+        ninstances = 1;
+    }
+    socketPath = argv[optind];
+
+    for(i = optind + 1; i < argc; i++){
+        char *path = strchr(argv[i], '=');
+
+        if(path == 0){
+            printf("BAD IMAGE %s.", argv[i]);
+            return 2;
+        }
+        *path++ = 0;
+        nameImage(argv[i], path);
+    }
+
+    // The pool: every instance and its thread exist before the first job
+    for(i = 0; i < ninstances; i++){
+        struct instance *in = calloc(1, sizeof(struct instance));
+
+        in->sim = simCreate();
+        in->output.bytes = malloc(MAXOUTPUT);
+        in->console = 0x3E;
+        if(in->sim == 0 || pthread_create(&thread, 0, worker, in) != 0){
+            printf("CANNOT CREATE INSTANCE %d.", i);
+            return 1;
+        }
+        pthread_detach(thread);
+    }
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketPath);
+    unlink(socketPath);
+    if(listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0){
+        printf("CANNOT LISTEN ON %s.", socketPath);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    for(;;){
+        int fd = accept(listener, 0, 0);
+        struct connection *c;
+
+        if(fd < 0){
+            continue;
+        }
+        c = calloc(1, sizeof(struct connection));
+        c->fd = fd;
+        pthread_mutex_init(&c->lock, 0);
+        pthread_cond_init(&c->idle, 0);
+        pthread_cond_init(&c->queued, 0);
+        if(pthread_create(&c->writer, 0, writer, c) != 0){
+            close(fd);
+            free(c);
+            continue;
+        }
+        if(pthread_create(&thread, 0, serve, c) != 0){
+            pthread_mutex_lock(&c->lock);
+            c->closing = 1;
+            pthread_cond_signal(&c->queued);
+            pthread_mutex_unlock(&c->lock);
+            pthread_join(c->writer, 0);
+            close(fd);
+            free(c);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
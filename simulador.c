@@ -0,0 +1,1318 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "simulador.h"
+#include "registers.h"
+#include "functions.h"
+#include "decoder.h"
+#include "scheduler.h"
+#include "eeprom.h"
+#include "gpio.h"
+#include "elf.h"
+#include "flash.h"
+#include "checkpoint.h"
+#include "sram.h"
+#include "replay.h"
+#include "spiflash.h"
+#include "twislaves.h"
+#include "pacing.h"
+#include "native.h"
+#include "assembler.h"
+#include "cosim.h"
+#include "pinring.h"
+#include "adc.h"
+#include "stats.h"
+#include "coverage.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Each instance is an MCU running on a thread of its own, since the MCU state is thread
+local (MCUSTATE). A call hands a job to that thread and waits for it, so the cost of a
+call is a couple of thread wake-ups, whatever it does: simRun() runs any number of cycles
+in one job, and memory and registers are read and written in blocks. Calls made from the
+callbacks, which run on the thread of the instance, are done directly.
+
+An instance is used by one thread at a time.
+
+Instances running the same program can share its flash (simImageCreate(), flash.c): the
+image is mapped by each of them and only the pages an instance writes are copied. Callback
+and breakpoint tables are allocated when first set, so an instance is otherwise little more
+than its data space and the stack of its thread.
+*/
+
+struct callback{
+    simRead read;
+    simWrite write;
+    void *user;
+};
+
+struct simulador{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    void (*job)(struct simulador *sim);
+    int quit;
+    atomic_int stop;
+    int invalid;                    // An invalid opcode was fetched
+
+    // arguments and results of the job
+    uint64_t cycles;
+    int result;
+    uint32_t addr;
+    void *buffer;
+    size_t size;
+    struct simRegisters *registers;
+    char *error;
+    size_t errorSize;
+    const char *symbol;
+    const char *directory;
+
+    struct image *image;
+
+    struct callback *io;            // SRAMSTART entries
+    uint8_t *breakpoints;           // FLASHSIZE bits
+    int nbreakpoints;
+
+    struct spidevice *flashes[MAXSPIDEVICES];
+    int nflashes;
+    struct twidevice *eeproms[MAXTWIDEVICES];
+    int neeproms;
+    struct twidevice *sensors[MAXTWIDEVICES];
+    int nsensors;
+    struct twitransfer transfer;    // Of simTwiMaster()
+    struct pinring *pins;           // Of simObservePins()
+    struct stats *stats;            // Of simStats()
+
+    struct pacing pacing;           // Of simRunRealtime()
+    struct simPacing *pacingStats;
+};
+
+// The instance whose MCU runs on this thread
+static MCUSTATE struct simulador *instance;
+
+// Hands job to the thread of sim, without waiting
+static void postJob(struct simulador *sim, void (*job)(struct simulador *sim)){
+    pthread_mutex_lock(&sim->lock);
+    sim->job = job;
+    pthread_cond_signal(&sim->wake);
+    pthread_mutex_unlock(&sim->lock);
+}
+
+// Waits for the job posted to sim
+static void waitJob(struct simulador *sim){
+    pthread_mutex_lock(&sim->lock);
+    while(sim->job){
+        pthread_cond_wait(&sim->done, &sim->lock);
+    }
+    pthread_mutex_unlock(&sim->lock);
+}
+
+static void call(struct simulador *sim, void (*job)(struct simulador *sim)){
+    if(instance == sim){
+        job(sim);
+        return;
+    }
+
+    postJob(sim, job);
+    waitJob(sim);
+}
+
+static void *worker(void *arg){
+    struct simulador *sim = arg;
+
+    instance = sim;
+
+    pthread_mutex_lock(&sim->lock);
+    while(!sim->quit){
+        while(sim->job == 0){
+            pthread_cond_wait(&sim->wake, &sim->lock);
+        }
+        pthread_mutex_unlock(&sim->lock);
+
+        sim->job(sim);
+
+        pthread_mutex_lock(&sim->lock);
+        sim->job = 0;
+        pthread_cond_signal(&sim->done);
+    }
+    pthread_mutex_unlock(&sim->lock);
+
+    return 0;
+}
+
+// What the callbacks return is an input of the MCU (replay.c)
+static uint8_t readCallback(uint16_t addr){
+    struct callback *c = &instance->io[addr];
+    uint8_t value;
+
+    if(REPLAY == REPLAYING){
+        return replayInput(INPUT_READ, addr);
+    }
+    value = c->read(instance, addr, c->user);
+    if(REPLAY == RECORDING){
+        recordInput(INPUT_READ, addr, value);
+    }
+    return value;
+}
+
+// Without a read callback, the written byte is kept in DATA for the CPU to read back
+static void writeCallback(uint16_t addr, uint8_t value){
+    struct callback *c = &instance->io[addr];
+
+    if(c->read == 0){
+        DATA[addr] = value;
+    }
+    c->write(instance, addr, value, c->user);
+}
+
+static void connect(struct simulador *sim, uint16_t addr){
+    struct callback *c = &sim->io[addr];
+
+    if(c->read || c->write){
+        setIOHandlers(addr, c->read ? readCallback : 0, c->write ? writeCallback : 0);
+    }
+}
+
+/* Jobs, run on the thread of the instance */
+
+static void resetJob(struct simulador *sim){
+    int i;
+
+    reset();
+    for(i = 0; sim->io && i < SRAMSTART; i++){
+        connect(sim, i);
+    }
+    observePins(sim->pins);
+}
+
+static void quitJob(struct simulador *sim){
+    int i;
+
+    for(i = 0; i < sim->nflashes; i++){
+        spiDetach(sim->flashes[i]);
+        spiFlashClose(sim->flashes[i]);
+    }
+    for(i = 0; i < sim->neeproms; i++){
+        twiDetach(sim->eeproms[i]);
+        twiEepromClose(sim->eeproms[i]);
+    }
+    for(i = 0; i < sim->nsensors; i++){
+        twiDetach(sim->sensors[i]);
+        twiSensorDestroy(sim->sensors[i]);
+    }
+    for(i = 0; i < ADCCHANNELS; i++){
+        adcSetVoltage(i, 0);
+    }
+    eepromClose();
+    statsClose();
+    replayStop();
+    if(sim->pins){
+        observePins(0);
+        pinRingClose(sim->pins);
+    }
+    cosimDrop();
+    dropFlash();
+    sim->quit = 1;
+}
+
+// Marks the end of simRun(), so sleeping and skipped loops stop there
+static void endOfRun(uint64_t when){
+}
+
+// Ends simRun() instead of the program
+static void invalidOpcode(uint16_t opcode){
+    instance->invalid = 1;
+}
+
+// Runs until CYCLES reaches end, a stop, a breakpoint or an invalid opcode; returns why it returned
+static int runUntil(struct simulador *sim, uint64_t end){
+    int result = SIM_DONE;
+
+    sim->invalid = 0;
+    onInvalidOpcode(invalidOpcode);
+    schedule(endOfRun, end);
+    while(CYCLES < end){
+        pc_t pc;
+
+        step();
+        if(sim->invalid){
+            result = SIM_INVALID;
+            break;
+        }
+        if(atomic_load_explicit(&sim->stop, memory_order_relaxed)){
+            result = SIM_STOPPED;
+            break;
+        }
+        // PC may point past the flash until the next step() wraps it
+        pc = PC % FLASHSIZE;
+        if(sim->nbreakpoints && ((sim->breakpoints[pc >> 3] >> (pc & 7)) & 1)){
+            result = SIM_BREAKPOINT;
+            break;
+        }
+    }
+    unschedule(endOfRun);
+
+    return result;
+}
+
+static void runJob(struct simulador *sim){
+    atomic_store_explicit(&sim->stop, 0, memory_order_relaxed);
+    sim->result = runUntil(sim, CYCLES + sim->cycles);
+
+    flushPins();
+}
+
+static void realtimeJob(struct simulador *sim){
+    struct pacing *p = &sim->pacing;
+    uint64_t end = CYCLES + sim->cycles;
+
+    atomic_store_explicit(&sim->stop, 0, memory_order_relaxed);
+    sim->result = SIM_DONE;
+    pacingStart(p, CYCLES);
+    while(CYCLES < end && sim->result == SIM_DONE){
+        sim->result = runUntil(sim, end - CYCLES > p->burst ? CYCLES + p->burst : end);
+        flushPins();
+        pacingWait(p, CYCLES);
+    }
+}
+
+static void pacingJob(struct simulador *sim){
+    struct pacing *p = &sim->pacing;
+    struct simPacing *stats = sim->pacingStats;
+
+    stats->hz = p->hz;
+    stats->bursts = p->bursts;
+    stats->late = p->late;
+    stats->resyncs = p->resyncs;
+    stats->lagNs = p->lag;
+    stats->maxLagNs = p->maxLag;
+    stats->meanJitterNs = p->sleeps ? p->jitterSum / p->sleeps : 0;
+    stats->maxJitterNs = p->maxJitter;
+}
+
+static void cyclesJob(struct simulador *sim){
+    sim->cycles = CYCLES;
+}
+
+static void readDataJob(struct simulador *sim){
+    uint8_t *buffer = sim->buffer;
+    size_t i;
+
+    for(i = 0; i < sim->size && sim->addr + i <= RAMEND; i++){
+        uint16_t addr = sim->addr + i;
+
+        buffer[i] = addr < 32 ? R[addr] : addr == SREGADDR ? getSREG() : DATA[addr];
+    }
+}
+
+static void writeDataJob(struct simulador *sim){
+    const uint8_t *buffer = sim->buffer;
+    size_t i;
+
+    for(i = 0; i < sim->size && sim->addr + i <= RAMEND; i++){
+        uint16_t addr = sim->addr + i;
+
+        if(addr < 32){
+            R[addr] = buffer[i];
+        }
+        else if(addr == SREGADDR){
+            setSREG(buffer[i]);
+        }
+        else{
+            DATA[addr] = buffer[i];
+        }
+    }
+}
+
+// What of the size units at sim->addr is inside a memory of limit units, 0 if it starts past it
+static size_t inside(struct simulador *sim, size_t limit){
+    if(sim->addr >= limit){
+        return 0;
+    }
+    return sim->size > limit - sim->addr ? limit - sim->addr : sim->size;
+}
+
+static void readFlashJob(struct simulador *sim){
+    size_t words = inside(sim, FLASHSIZE);
+
+    memcpy(sim->buffer, FLASH + sim->addr, words * 2);
+}
+
+static void writeFlashJob(struct simulador *sim){
+    size_t words = inside(sim, FLASHSIZE);
+
+    if(words){
+        memcpy(FLASH + sim->addr, sim->buffer, words * 2);
+        invalidateFlash(sim->addr, words);
+    }
+}
+
+static void readEepromJob(struct simulador *sim){
+    memcpy(sim->buffer, eepromContents() + sim->addr, inside(sim, EEPROMSIZE));
+}
+
+static void writeEepromJob(struct simulador *sim){
+    memcpy(eepromContents() + sim->addr, sim->buffer, inside(sim, EEPROMSIZE));
+}
+
+static void getRegistersJob(struct simulador *sim){
+    memcpy(sim->registers->r, R, 32);
+    sim->registers->sreg = getSREG();
+    sim->registers->sp = getSP();
+    sim->registers->pc = PC;
+}
+
+static void setRegistersJob(struct simulador *sim){
+    memcpy(R, sim->registers->r, 32);
+    setSREG(sim->registers->sreg);
+    setSP(sim->registers->sp);
+    PC = sim->registers->pc % FLASHSIZE;
+}
+
+static void loadElfJob(struct simulador *sim){
+    struct elf elf;
+
+    sim->result = elfOpen(sim->buffer, &elf);
+    if(sim->result){
+        // Nothing of the program loaded before is kept outside the segments of this one
+        privateFlash();
+        sim->result = elfLoad(&elf, (uint8_t *)FLASH, FLASHSIZE * 2, eepromContents(), EEPROMSIZE);
+        sramRegions(&elf);
+        nativeSymbols(&elf);
+        elfClose(&elf);
+    }
+    invalidateFlash(0, FLASHSIZE);
+}
+
+static int hexByte(const char *s){
+    int value;
+
+    if(sscanf(s, "%2x", &value) != 1){
+        return -1;
+    }
+    return value;
+}
+
+// Intel HEX records 00 (data), 01 (end), 02 (segment address) and 04 (linear address)
+static void loadHexJob(struct simulador *sim){
+    FILE *f = fopen(sim->buffer, "r");
+    uint32_t base = 0;
+    char line[600];
+
+    sim->result = f != 0;
+    while(f && fgets(line, sizeof(line), f)){
+        int count, type, sum, i;
+        uint32_t addr;
+
+        if(line[0] != ':'){
+            continue;
+        }
+        count = hexByte(line + 1);
+        addr = (hexByte(line + 3) << 8) | hexByte(line + 5);
+        type = hexByte(line + 7);
+        if(count < 0 || type < 0 || strlen(line) < (size_t)(11 + 2 * count)){
+            sim->result = 0;
+            break;
+        }
+
+        sum = count + (addr >> 8) + (addr & 0xFF) + type + hexByte(line + 9 + 2 * count);
+        for(i = 0; i < count; i++){
+            sum += hexByte(line + 9 + 2 * i);
+        }
+        if(sum & 0xFF){
+            sim->result = 0;
+            break;
+        }
+
+        if(type == 0){
+            for(i = 0; i < count; i++){
+                uint32_t byte = base + addr + i;
+
+                if(byte < FLASHSIZE * 2){
+                    ((uint8_t *)FLASH)[byte] = hexByte(line + 9 + 2 * i);
+                }
+            }
+        }
+        else if(type == 1){
+            break;
+        }
+        else if(type == 2 || type == 4){
+            base = ((hexByte(line + 9) << 8) | hexByte(line + 11)) << (type == 2 ? 4 : 16);
+        }
+    }
+    if(f){
+        fclose(f);
+    }
+    invalidateFlash(0, FLASHSIZE);
+}
+
+static void assembleJob(struct simulador *sim){
+    sim->result = assemble(sim->buffer, FLASH, FLASHSIZE, sim->error, sim->errorSize);
+    invalidateFlash(0, FLASHSIZE);
+}
+
+static void imageCreateJob(struct simulador *sim){
+    sim->image = imageCreate(FLASH, FLASHSIZE);
+}
+
+static void imageUseJob(struct simulador *sim){
+    useImage(sim->image);
+}
+
+static void warmBootJob(struct simulador *sim){
+    int i;
+
+    sim->result = warmBoot(sim->buffer, sim->symbol, sim->directory, sim->cycles);
+    for(i = 0; sim->io && i < SRAMSTART; i++){
+        connect(sim, i);
+    }
+    observePins(sim->pins);
+}
+
+static void saveCheckpointJob(struct simulador *sim){
+    sim->result = checkpointSave(sim->buffer);
+}
+
+static void loadCheckpointJob(struct simulador *sim){
+    sim->result = checkpointLoad(sim->buffer);
+}
+
+static void getStackJob(struct simulador *sim){
+    struct simStack *stack = sim->buffer;
+
+    stack->lowestSp = LOWEST.sp;
+    stack->lowestPc = LOWEST.pc;
+    stack->lowestDepth = LOWEST.depth;
+    stack->lowestCycle = LOWEST.cycle;
+    stack->collided = COLLISION.cycle != 0;
+    stack->collisionSp = COLLISION.sp;
+    stack->collisionPc = COLLISION.pc;
+    stack->collisionCycle = COLLISION.cycle;
+}
+
+static void clearStackJob(struct simulador *sim){
+    sramClear();
+}
+
+static void sramReportJob(struct simulador *sim){
+    sim->result = sramReport(sim->buffer);
+}
+
+static void recordJob(struct simulador *sim){
+    sim->result = recordStart(sim->buffer);
+}
+
+static void replayJob(struct simulador *sim){
+    sim->result = replayStart(sim->buffer);
+}
+
+static void replayStopJob(struct simulador *sim){
+    replayStop();
+}
+
+static void nativeJob(struct simulador *sim){
+    sim->result = nativeMode(sim->result);
+}
+
+static void nativeReportJob(struct simulador *sim){
+    sim->result = nativeReport(sim->buffer);
+}
+
+static void spiFlashJob(struct simulador *sim){
+    struct spidevice *flash;
+
+    sim->result = 0;
+    if(sim->nflashes == MAXSPIDEVICES){
+        return;
+    }
+    flash = spiFlashOpen(sim->buffer, sim->size);
+    if(flash == 0){
+        return;
+    }
+    if(!spiAttach(flash, sim->addr >> 8, sim->addr & 0xFF)){
+        spiFlashClose(flash);
+        return;
+    }
+    sim->flashes[sim->nflashes++] = flash;
+    sim->result = 1;
+}
+
+static void twiEepromJob(struct simulador *sim){
+    struct twidevice *eeprom;
+
+    sim->result = 0;
+    if(sim->neeproms == MAXTWIDEVICES){
+        return;
+    }
+    eeprom = twiEepromOpen(sim->buffer, sim->size, sim->addr);
+    if(eeprom == 0){
+        return;
+    }
+    if(!twiAttach(eeprom)){
+        twiEepromClose(eeprom);
+        return;
+    }
+    sim->eeproms[sim->neeproms++] = eeprom;
+    sim->result = 1;
+}
+
+static void twiSensorJob(struct simulador *sim){
+    struct twidevice *sensor;
+
+    sim->buffer = 0;
+    if(sim->nsensors == MAXTWIDEVICES){
+        return;
+    }
+    sensor = twiSensorCreate(sim->addr);
+    if(!twiAttach(sensor)){
+        twiSensorDestroy(sensor);
+        return;
+    }
+    sim->sensors[sim->nsensors++] = sensor;
+    sim->buffer = twiSensorRegisters(sensor);
+}
+
+static void twiMasterJob(struct simulador *sim){
+    sim->result = twiMaster(&sim->transfer);
+}
+
+static void observePinsJob(struct simulador *sim){
+    observePins(0);
+    if(sim->pins){
+        pinRingClose(sim->pins);
+        sim->pins = 0;
+    }
+    if(sim->size){
+        sim->pins = pinRingCreate(sim->symbol, sim->size);
+        observePins(sim->pins);
+    }
+    sim->result = sim->pins != 0 || sim->size == 0;
+}
+
+static void setPinJob(struct simulador *sim){
+    setPin(sim->addr >> 8, sim->addr & 7, sim->result);
+}
+
+static void releasePinJob(struct simulador *sim){
+    releasePin(sim->addr >> 8, sim->addr & 7);
+}
+
+static void adcAttachJob(struct simulador *sim){
+    sim->result = adcAttach(sim->addr, sim->buffer, sim->cycles);
+}
+
+static void adcSetVoltageJob(struct simulador *sim){
+    adcSetVoltage(sim->addr >> 16, sim->addr & 0xFFFF);
+}
+
+static void adcSetReferenceJob(struct simulador *sim){
+    adcSetReference(sim->addr >> 16, sim->addr & 0xFFFF);
+}
+
+static void eepromOpenJob(struct simulador *sim){
+    sim->result = eepromOpen(sim->buffer);
+}
+
+static void statsJob(struct simulador *sim){
+    statsClose();
+    sim->stats = statsCreate(sim->symbol);
+    sim->result = sim->stats != 0;
+}
+
+static void coverageClearJob(struct simulador *sim){
+    coverageClear();
+}
+
+static void coverageSaveJob(struct simulador *sim){
+    sim->result = coverageSave(sim->buffer);
+}
+
+static void coverageMergeJob(struct simulador *sim){
+    sim->result = coverageMerge(sim->buffer);
+}
+
+static void coverageLcovJob(struct simulador *sim){
+    sim->result = coverageLcov(sim->directory, sim->buffer, sim->symbol);
+}
+
+static void coveredJob(struct simulador *sim){
+    uint32_t word = sim->addr;
+
+    sim->result = COVERED(EXECUTED, word) | COVERED(TAKEN, word) << 1 | COVERED(NOTTAKEN, word) << 2;
+}
+
+// Runs to end unless the MCU is stopped on an invalid opcode; stops and breakpoints are ignored
+static void cosimRunTo(uint64_t end){
+    while(CYCLES < end && instance->result != SIM_INVALID){
+        if(runUntil(instance, end) == SIM_INVALID){
+            instance->result = SIM_INVALID;
+        }
+    }
+}
+
+static void cosimJob(struct simulador *sim){
+    atomic_store_explicit(&sim->stop, 0, memory_order_relaxed);
+    cosimLoop(sim->addr, cosimRunTo);
+    flushPins();
+}
+
+static void cosimUartJob(struct simulador *sim){
+    cosimUart();
+}
+
+static void cosimSpiMasterJob(struct simulador *sim){
+    sim->result = cosimSpiMaster(sim->addr >> 8, sim->addr & 0xFF);
+}
+
+static void cosimSpiSlaveJob(struct simulador *sim){
+    cosimSpiSlave();
+}
+
+static void cosimTwiMasterJob(struct simulador *sim){
+    sim->result = cosimTwiMaster(sim->addr);
+}
+
+static void cosimTwiSlaveJob(struct simulador *sim){
+    cosimTwiSlave();
+}
+
+static void setIOJob(struct simulador *sim){
+    uint16_t addr = sim->addr;
+
+    setIOHandlers(addr, 0, 0);
+    connect(sim, addr);
+}
+
+/* API */
+
+/* The SIMULADOR_API_VERSION the library was built with. */
+int simVersion(void){
+    return SIMULADOR_API_VERSION;
+}
+
+/* The device the library simulates, "ATmega328P" for libsimulador.so (device.h). PCs and flash
+addresses in this API are word addresses, up to FLASHSIZE (device.h). */
+const char *simDevice(void){
+    return DEVICE_NAME;
+}
+
+/* Creates an MCU in its reset state, with an erased flash. Returns 0 if its thread cannot be
+started. */
+simulador *simCreate(void){
+    struct simulador *sim = calloc(1, sizeof(struct simulador));
+
+    if(sim == 0){
+        return 0;
+    }
+    pacingInit(&sim->pacing, 0, 0);
+    pthread_mutex_init(&sim->lock, 0);
+    pthread_cond_init(&sim->wake, 0);
+    pthread_cond_init(&sim->done, 0);
+    if(pthread_create(&sim->thread, 0, worker, sim) != 0){
+        free(sim);
+        return 0;
+    }
+
+    call(sim, resetJob);
+
+    return sim;
+}
+
+void simDestroy(simulador *sim){
+    call(sim, quitJob);
+    pthread_join(sim->thread, 0);
+    pthread_mutex_destroy(&sim->lock);
+    pthread_cond_destroy(&sim->wake);
+    pthread_cond_destroy(&sim->done);
+    free(sim->io);
+    free(sim->breakpoints);
+    free(sim);
+}
+
+/* Makes a shareable image of the flash of sim, as it is now. Returns 0 if the host cannot
+make one. The image is kept until simImageRelease(), and after that for as long as an
+instance uses it. */
+simImage *simImageCreate(simulador *sim){
+    call(sim, imageCreateJob);
+    return (simImage *)sim->image;
+}
+
+/* Replaces the flash of sim by the image, shared with the other instances using it; the
+pages sim writes later become its own. The MCU is not reset. */
+void simImageUse(simulador *sim, simImage *image){
+    sim->image = (struct image *)image;
+    call(sim, imageUseJob);
+}
+
+void simImageRelease(simImage *image){
+    imageRelease((struct image *)image);
+}
+
+/* Loads the flash and EEPROM contents of an avr-gcc ELF file, in an erased flash. Returns 0
+on failure. */
+int simLoadElf(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, loadElfJob);
+    return sim->result;
+}
+
+/* Loads an Intel HEX file into flash. Returns 0 on failure. */
+int simLoadHex(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, loadHexJob);
+    return sim->result;
+}
+
+/* Copies a raw flash image, at most the size of the flash. Returns 0 if it does not fit. An
+odd last byte is completed to a word with a zero high byte. */
+int simLoadBinary(simulador *sim, const void *image, size_t size){
+    size_t bytes = size < FLASHSIZE * 2 ? size : FLASHSIZE * 2;
+    uint16_t *words = calloc((bytes + 1) / 2, 2);
+
+    if(words == 0){
+        return 0;
+    }
+    memcpy(words, image, bytes);
+    simWriteFlash(sim, 0, words, (bytes + 1) / 2);
+    free(words);
+
+    return size <= FLASHSIZE * 2;
+}
+
+/* Assembles AVR source (assembler.c) into flash; the words it does not set are kept. Returns
+the number of words up to the last one written, or -1 with the error in error. */
+int simAssemble(simulador *sim, const char *source, char *error, size_t errorSize){
+    sim->buffer = (void *)source;
+    sim->error = error;
+    sim->errorSize = errorSize;
+    call(sim, assembleJob);
+    return sim->result;
+}
+
+/* Resets the MCU and loads the ELF file, then runs it up to symbol (main if 0), for at most
+the given cycles. The state reached is saved in a checkpoint in directory, and later warm
+boots of the same file restore it instead of running. Returns 0 if the file cannot be loaded
+or the symbol is not reached. */
+int simWarmBoot(simulador *sim, const char *path, const char *symbol, const char *directory, uint64_t cycles){
+    sim->buffer = (void *)path;
+    sim->symbol = symbol;
+    sim->directory = directory;
+    sim->cycles = cycles;
+    call(sim, warmBootJob);
+    return sim->result;
+}
+
+/* Saves the whole MCU, flash and EEPROM included, to a checkpoint file. Returns 0 on failure. */
+int simSaveCheckpoint(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, saveCheckpointJob);
+    return sim->result;
+}
+
+/* Resumes from a checkpoint saved by the same build of the library. The callbacks are kept.
+Returns 0, with the MCU unchanged, if the file cannot be read or does not fit. */
+int simLoadCheckpoint(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, loadCheckpointJob);
+    return sim->result;
+}
+
+/* Puts the MCU in its reset state. Flash and EEPROM are kept, and so are the callbacks. */
+void simReset(simulador *sim){
+    call(sim, resetJob);
+}
+
+/* Runs at least the given cycles, or until simStop(), a breakpoint or an invalid opcode.
+Returns why it returned: SIM_DONE, SIM_STOPPED, SIM_BREAKPOINT or SIM_INVALID. */
+int simRun(simulador *sim, uint64_t cycles){
+    sim->cycles = cycles;
+    call(sim, runJob);
+    return sim->result;
+}
+
+/* Makes the running simRun() return after the current instruction. Can be called from a
+callback or from another thread. */
+void simStop(simulador *sim){
+    atomic_store_explicit(&sim->stop, 1, memory_order_relaxed);
+}
+
+uint64_t simCycles(simulador *sim){
+    call(sim, cyclesJob);
+    return sim->cycles;
+}
+
+/* Sets or clears a breakpoint at a word address: simRun() returns when PC gets there.
+Addresses past the flash are ignored. */
+void simSetBreakpoint(simulador *sim, uint32_t pc, int set){
+    uint8_t bit = 1 << (pc & 7);
+    uint8_t *byte;
+
+    if(pc >= FLASHSIZE){
+        return;
+    }
+    if(sim->breakpoints == 0){
+        sim->breakpoints = calloc(FLASHSIZE / 8, 1);
+    }
+    byte = &sim->breakpoints[pc >> 3];
+
+    if(set && !(*byte & bit)){
+        *byte |= bit;
+        sim->nbreakpoints++;
+    }
+    else if(!set && (*byte & bit)){
+        *byte &= ~bit;
+        sim->nbreakpoints--;
+    }
+}
+
+/* Copies the data space from addr: registers, I/O as stored (no peripheral is read) and SRAM. */
+void simReadData(simulador *sim, uint16_t addr, void *buffer, size_t size){
+    sim->addr = addr;
+    sim->buffer = buffer;
+    sim->size = size;
+    call(sim, readDataJob);
+}
+
+/* Writes the data space from addr, without notifying peripherals. */
+void simWriteData(simulador *sim, uint16_t addr, const void *buffer, size_t size){
+    sim->addr = addr;
+    sim->buffer = (void *)buffer;
+    sim->size = size;
+    call(sim, writeDataJob);
+}
+
+/* Flash and EEPROM blocks are cut at the end of the memory; nothing is copied from an
+address past it. */
+void simReadFlash(simulador *sim, uint32_t word, uint16_t *buffer, size_t words){
+    sim->addr = word;
+    sim->buffer = buffer;
+    sim->size = words;
+    call(sim, readFlashJob);
+}
+
+void simWriteFlash(simulador *sim, uint32_t word, const uint16_t *buffer, size_t words){
+    sim->addr = word;
+    sim->buffer = (void *)buffer;
+    sim->size = words;
+    call(sim, writeFlashJob);
+}
+
+void simReadEeprom(simulador *sim, uint16_t addr, void *buffer, size_t size){
+    sim->addr = addr;
+    sim->buffer = buffer;
+    sim->size = size;
+    call(sim, readEepromJob);
+}
+
+void simWriteEeprom(simulador *sim, uint16_t addr, const void *buffer, size_t size){
+    sim->addr = addr;
+    sim->buffer = (void *)buffer;
+    sim->size = size;
+    call(sim, writeEepromJob);
+}
+
+void simGetRegisters(simulador *sim, struct simRegisters *registers){
+    sim->registers = registers;
+    call(sim, getRegistersJob);
+}
+
+void simSetRegisters(simulador *sim, const struct simRegisters *registers){
+    sim->registers = (struct simRegisters *)registers;
+    call(sim, setRegistersJob);
+}
+
+/* The stack high-water mark, and where the stack first went into the heap or .bss (sram.c).
+Collisions are only seen for ELF images, whose symbols tell where .bss and the heap are. */
+void simGetStack(simulador *sim, struct simStack *stack){
+    sim->buffer = stack;
+    call(sim, getStackJob);
+}
+
+/* Forgets the high-water mark, the collision and the SRAM map. They otherwise add up over
+simReset(). */
+void simClearStack(simulador *sim){
+    call(sim, clearStackJob);
+}
+
+/* Writes the SRAM regions, the stack marks and the map of the bytes written and read to
+path ("-" for stdout). Returns 0 if it cannot be written. */
+int simSramReport(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, sramReportJob);
+    return sim->result;
+}
+
+/* Logs every input of the MCU from now on to path: pins set by the host, ADC samples, values
+returned by read callbacks and bytes of asynchronous models, each with its cycle. Start it
+from a state simReplay() can start from again, such as after loading and simReset(). Ends
+with simReplayStop(), simReset() or simDestroy(). Returns 0 if path cannot be written. */
+int simRecord(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, recordJob);
+    return sim->result;
+}
+
+/* Feeds the inputs recorded in path back, from the state the recording started from, for
+the same run. Pins set and callbacks read meanwhile are ignored; a run that leaves the
+recording ends the program. Returns 0 if path is not a recording of this build from this
+cycle. */
+int simReplay(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, replayJob);
+    return sim->result;
+}
+
+void simReplayStop(simulador *sim){
+    call(sim, replayStopJob);
+}
+
+/* Runs the libgcc divisions and the avr-libc memcpy, memset and strlen of the program on the
+host when they are called (SIM_NATIVE_ON), with the registers, flags, memory and cycles the
+routine itself would leave (native.c). SIM_NATIVE_VERIFY also steps every call and keeps the
+stepped result, reporting the routines whose results differ. The routines are found by the
+symbols of the ELF file loaded last; returns how many were found. */
+int simNativeCalls(simulador *sim, int mode){
+    sim->result = mode;
+    call(sim, nativeJob);
+    return sim->result;
+}
+
+/* Writes the routines found and how their calls ran to path ("-" for stdout). Returns 0 if
+it cannot be written. */
+int simNativeReport(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, nativeReportJob);
+    return sim->result;
+}
+
+/* Sets how simRunRealtime() paces: the clock frequency (0 for F_CPU), the cycles run between
+two sleeps (0 for a millisecond), the ns before a deadline spent polling the clock rather
+than sleeping, for less jitter, and the lag after which the schedule starts again rather
+than catching up (0 never). Clears the statistics; the next run starts a new schedule. Call
+it between runs. */
+void simSetPacing(simulador *sim, uint64_t hz, uint64_t burst, uint64_t spinNs, uint64_t lagLimitNs){
+    pacingInit(&sim->pacing, hz, burst);
+    sim->pacing.spin = spinNs;
+    sim->pacing.lagLimit = lagLimitNs;
+}
+
+/* Like simRun(), but at the pace of the simulated clock against CLOCK_MONOTONIC, sleeping
+between bursts (pacing.c). The schedule goes on from one call to the next, so a host loop
+of short simRunRealtime() calls does not drift; the time spent outside of them is caught
+up. */
+int simRunRealtime(simulador *sim, uint64_t cycles){
+    sim->cycles = cycles;
+    call(sim, realtimeJob);
+    return sim->result;
+}
+
+/* Statistics of simRunRealtime() since simSetPacing(). */
+void simGetPacing(simulador *sim, struct simPacing *pacing){
+    sim->pacingStats = pacing;
+    call(sim, pacingJob);
+}
+
+/* Puts a SPI NOR flash of size bytes (a power of two) on the SPI bus, stored in path and
+created, erased, if needed; the chip select is pin of port (0 for port B, 1 for C, 2 for D).
+It answers the usual 25-series commands (spiflash.c) and what the firmware writes is in the
+file once the instance is destroyed. Returns 0 if the file cannot be mapped. */
+int simAttachSpiFlash(simulador *sim, const char *path, uint32_t size, int port, int pin){
+    sim->buffer = (void *)path;
+    sim->size = size;
+    sim->addr = port << 8 | pin;
+    call(sim, spiFlashJob);
+    return sim->result;
+}
+
+/* Puts a 24-series EEPROM of size bytes (128 or 256, or 4KB to 64KB) on the TWI bus at the 7
+bit address, stored in path and created, erased, if needed (twislaves.c). Returns 0 if the
+file cannot be mapped. */
+int simAttachTwiEeprom(simulador *sim, const char *path, uint32_t size, uint8_t address){
+    sim->buffer = (void *)path;
+    sim->size = size;
+    sim->addr = address;
+    call(sim, twiEepromJob);
+    return sim->result;
+}
+
+/* Puts a register file sensor on the TWI bus at the 7 bit address. Returns its 256 registers,
+for the host to write readings into while the instance does not run, or 0 if the bus is
+full. */
+uint8_t *simAttachTwiSensor(simulador *sim, uint8_t address){
+    sim->addr = address;
+    call(sim, twiSensorJob);
+    return sim->buffer;
+}
+
+/* Starts a transfer of a master outside the MCU, which answers as a TWI slave: length bytes
+of data written to the 7 bit address, or read from it. It goes on while simRun() runs;
+simTwiResult() tells when it is over. data must stay valid until then. Returns 0 if a
+transfer is going on already. */
+int simTwiMaster(simulador *sim, uint8_t address, int read, uint8_t *data, int length){
+    if(sim->transfer.data && !sim->transfer.finished){
+        return 0;
+    }
+    sim->transfer.address = address;
+    sim->transfer.read = read;
+    sim->transfer.data = data;
+    sim->transfer.length = length;
+    call(sim, twiMasterJob);
+    return sim->result;
+}
+
+/* -1 while the transfer of simTwiMaster() goes on, then the bytes transferred: 0 if the MCU
+did not acknowledge the address. */
+int simTwiResult(simulador *sim){
+    if(!sim->transfer.finished){
+        return -1;
+    }
+    return sim->transfer.acknowledged ? sim->transfer.count : 0;
+}
+
+/* Writes every pin change of sim from now on to a ring of at least size events, or stops
+with size 0. With a name, the ring is a POSIX shared memory object (e.g. "/simulador-pins")
+that other processes can open (pinring.h); either way simReadPins() reads it. The ring is
+kept over simReset(). Returns 0 if it cannot be created. */
+int simObservePins(simulador *sim, const char *name, uint32_t size){
+    sim->symbol = name;
+    sim->size = size;
+    call(sim, observePinsJob);
+    return sim->result;
+}
+
+/* Copies up to max pin changes from the ring of simObservePins(), oldest first, and frees
+their room in the ring. The changes of a simRun() are all there when it returns; while it
+runs they come in batches. Can be called from any thread. Returns how many were copied. */
+int simReadPins(simulador *sim, struct simPinEvent *events, int max){
+    if(sim->pins == 0){
+        return 0;
+    }
+    return pinRingRead(sim->pins, (struct pinevent *)events, max);
+}
+
+/* Drives an input pin of port (0 for port B, 1 for C, 2 for D, 3 for E on the ATmega2560)
+high (1) or low (0), from the current cycle. */
+void simSetPin(simulador *sim, int port, int pin, int level){
+    if(port < 0 || port >= NPORTS || pin < 0 || pin > 7){
+        return;
+    }
+    sim->addr = port << 8 | pin;
+    sim->result = level;
+    call(sim, setPinJob);
+}
+
+/* Stops driving a pin, which follows its pull-up again. */
+void simReleasePin(simulador *sim, int port, int pin){
+    if(port < 0 || port >= NPORTS || pin < 0 || pin > 7){
+        return;
+    }
+    sim->addr = port << 8 | pin;
+    call(sim, releasePinJob);
+}
+
+/* Feeds ADC channel (0 to 7) from a file of uint16 millivolt samples, in host byte order, one
+every cyclesPerSample cycles of simulated time. The file is mapped, not read, so it may be
+larger than memory. Returns 0 if the file cannot be mapped. */
+int simAdcAttach(simulador *sim, int channel, const char *path, uint64_t cyclesPerSample){
+    if(channel < 0 || channel >= ADCCHANNELS){
+        return 0;
+    }
+    sim->addr = channel;
+    sim->buffer = (void *)path;
+    sim->cycles = cyclesPerSample;
+    call(sim, adcAttachJob);
+    return sim->result;
+}
+
+/* Feeds ADC channel (0 to 7) with a constant voltage, in millivolts. */
+void simAdcSetVoltage(simulador *sim, int channel, uint16_t millivolts){
+    if(channel < 0 || channel >= ADCCHANNELS){
+        return;
+    }
+    sim->addr = channel << 16 | millivolts;
+    call(sim, adcSetVoltageJob);
+}
+
+/* Voltages of AVCC and of the AREF pin, in millivolts; 5000 both by default. */
+void simAdcSetReference(simulador *sim, uint16_t avcc, uint16_t aref){
+    sim->addr = (uint32_t)avcc << 16 | aref;
+    call(sim, adcSetReferenceJob);
+}
+
+/* Maps the EEPROM to a host file, created erased if it does not exist, so its contents
+persist across runs and instances and can be seeded or inspected directly. What the
+firmware writes is in the file right away. Returns 0 if the file cannot be mapped. */
+int simEepromOpen(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, eepromOpenJob);
+    return sim->result;
+}
+
+/* Starts counting, for sim, the instructions by opcode, the branches taken and not taken,
+the interrupts by vector and the cycles slept or skipped (stats.c). With a name the counters
+are in a POSIX shared memory object (e.g. "/simulador-stats") that a monitor maps with the
+layout of struct stats in stats.h. Counting again starts new counters. Returns 0 if they
+cannot be created. */
+int simStats(simulador *sim, const char *name){
+    sim->symbol = name;
+    call(sim, statsJob);
+    return sim->result;
+}
+
+/* Simulated seconds per host second since simStats(), 0 without counters. Can be called from
+any thread, while the instance runs. */
+double simStatsSpeed(simulador *sim){
+    return sim->stats ? statsSpeed(sim->stats) : 0;
+}
+
+/* Forgets the code coverage of sim, which otherwise adds up over resets (coverage.c). */
+void simCoverageClear(simulador *sim){
+    call(sim, coverageClearJob);
+}
+
+/* Writes the coverage maps of sim to path. Returns 0 on failure. */
+int simCoverageSave(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, coverageSaveJob);
+    return sim->result;
+}
+
+/* Adds the maps saved in path, by any instance of the same device, to the coverage of sim.
+Returns 0 if path cannot be read or is not a coverage file of this device. */
+int simCoverageMerge(simulador *sim, const char *path){
+    sim->buffer = (void *)path;
+    call(sim, coverageMergeJob);
+    return sim->result;
+}
+
+/* Writes the line and branch coverage of the program of sim, built as the ELF file elfPath,
+to the lcov tracefile path, under the test name (0 for none). Returns 0 if the ELF file
+has no line table or path cannot be written. */
+int simCoverageLcov(simulador *sim, const char *elfPath, const char *path, const char *test){
+    sim->directory = elfPath;
+    sim->buffer = (void *)path;
+    sim->symbol = test;
+    call(sim, coverageLcovJob);
+    return sim->result;
+}
+
+/* Coverage of a flash word: SIM_EXECUTED, SIM_TAKEN and SIM_NOT_TAKEN for a branch, or 0. */
+int simCovered(simulador *sim, uint32_t word){
+    if(word >= FLASHSIZE){
+        return 0;
+    }
+    sim->addr = word;
+    call(sim, coveredJob);
+    return sim->result;
+}
+
+/* Starts a co-simulation of the given number of instances (cosim.c), run together by
+simCosimRun() in quanta of cycles and connected by simCosimConnect(). There is one
+co-simulation per process; this one replaces the last one and its wires. */
+void simCosimInit(int instances, uint64_t quantum){
+    cosimInit(instances, quantum);
+}
+
+/* Connects port (SIM_PORT_UART, SIM_PORT_SPI or SIM_PORT_TWI) of instance from to the same port of instance
+to, by their index in simCosimRun(); bytes take latency cycles. Returns 0 if there are too
+many wires. */
+int simCosimConnect(int from, int to, int port, uint64_t latency){
+    return cosimConnect(from, to, port, latency) >= 0;
+}
+
+/* Connects the USART of sim to its UART wires: the bytes it transmits go out at the end of
+their frame and the ones coming in are received at their arrival cycle. */
+void simCosimUart(simulador *sim){
+    call(sim, cosimUartJob);
+}
+
+/* Puts the SPI wires of sim on its SPI bus as a slave selected by pin of port (0 for port B,
+1 for C, 2 for D). The other end answers a byte once it got it, so the master reads the
+last answer that came back, 0xFF at first: the answer to the byte before when the bytes
+are further apart than the round trip. Returns 0 if the bus is full. */
+int simCosimSpiMaster(simulador *sim, int port, int pin){
+    sim->addr = port << 8 | pin;
+    call(sim, cosimSpiMasterJob);
+    return sim->result;
+}
+
+/* Clocks the bytes coming on the SPI wires into the SPI of sim, as a slave, and sends back
+the bytes it shifts out. */
+void simCosimSpiSlave(simulador *sim){
+    call(sim, cosimSpiSlaveJob);
+}
+
+/* Puts the TWI wires of sim on its TWI bus at the 7 bit address: they acknowledge everything
+and carry the writes, reads return 0xFF. Returns 0 if the bus is full. */
+int simCosimTwiMaster(simulador *sim, uint8_t address){
+    sim->addr = address;
+    call(sim, cosimTwiMasterJob);
+    return sim->result;
+}
+
+/* Writes the transactions coming on the TWI wires to sim, as a TWI slave (simTwiMaster()). */
+void simCosimTwiSlave(simulador *sim){
+    call(sim, cosimTwiSlaveJob);
+}
+
+/* Runs the instances of simCosimInit() together for the given cycles, each on its thread,
+from where the last simCosimRun() left them. They should be at the same cycle to begin
+with, e.g. just reset. Breakpoints and simStop() do not stop them; an instance that fetches
+an invalid opcode stays on it while the others go on. Returns SIM_INVALID if one did,
+SIM_DONE otherwise. Not to be called from a callback. */
+int simCosimRun(simulador **sims, uint64_t cycles){
+    int i, n = cosimMCUs(), result = SIM_DONE;
+
+    cosimBegin(cycles);
+    for(i = 0; i < n; i++){
+        sims[i]->addr = i;
+        sims[i]->result = SIM_DONE;
+        postJob(sims[i], cosimJob);
+    }
+    for(i = 0; i < n; i++){
+        waitJob(sims[i]);
+        if(sims[i]->result == SIM_INVALID){
+            result = SIM_INVALID;
+        }
+    }
+    cosimEnd();
+
+    return result;
+}
+
+/* Routes the accesses of the CPU to an I/O register (below $100) to callbacks, instead of the
+built-in peripheral. Either callback may be null; both null give the register back to the
+built-in peripheral at the next simReset(). */
+void simSetIO(simulador *sim, uint16_t addr, simRead read, simWrite write, void *user){
+    if(addr < 32 || addr >= SRAMSTART){
+        return;
+    }
+    if(sim->io == 0){
+        sim->io = calloc(SRAMSTART, sizeof(struct callback));
+    }
+    sim->io[addr].read = read;
+    sim->io[addr].write = write;
+    sim->io[addr].user = user;
+    sim->addr = addr;
+    call(sim, setIOJob);
+}
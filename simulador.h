@@ -0,0 +1,199 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#ifndef SIMULADOR_H
+#define SIMULADOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Public API of libsimulador.so and libsimulador.a. Everything else in the library is
+internal and may change; this header only changes in ways that keep old programs working,
+and SIMULADOR_API_VERSION says which functions a build has.
+*/
+
+#define SIMULADOR_API_VERSION 1
+
+#if defined(__GNUC__)
+#define SIMAPI __attribute__((visibility("default")))
+#else
+#define SIMAPI
+#endif
+
+/* Why simRun() returned */
+#define SIM_DONE 0          // All the cycles ran
+#define SIM_STOPPED 1       // simStop() was called
+#define SIM_BREAKPOINT 2    // PC reached a breakpoint
+#define SIM_INVALID 3       // An invalid opcode, PC is on it
+
+/* Wires of simCosimConnect() */
+#define SIM_PORT_UART 0
+#define SIM_PORT_SPI 1
+#define SIM_PORT_TWI 2
+
+/* simCovered() bits */
+#define SIM_EXECUTED 1
+#define SIM_TAKEN 2         // A conditional branch was taken
+#define SIM_NOT_TAKEN 4     // A conditional branch was not taken
+
+/* simNativeCalls() modes */
+#define SIM_NATIVE_OFF 0
+#define SIM_NATIVE_ON 1     // Library routines run on the host
+#define SIM_NATIVE_VERIFY 2 // And stepped too, to compare
+
+typedef struct simulador simulador;
+
+/* Flash image shared by instances, see simImageCreate() */
+typedef struct simImage simImage;
+
+struct simRegisters{
+    uint8_t r[32];
+    uint8_t sreg;
+    uint16_t sp;
+    uint32_t pc;            // Word address
+};
+
+struct simStack{
+    uint16_t lowestSp;      // High-water mark: lowest SP reached
+    uint32_t lowestPc;      // Word address where it was reached
+    uint16_t lowestDepth;   // Return addresses on the stack then
+    uint64_t lowestCycle;
+    int collided;           // Nonzero once the stack went into the heap or .bss
+    uint16_t collisionSp;
+    uint32_t collisionPc;
+    uint64_t collisionCycle;
+};
+
+struct simPacing{
+    uint64_t hz;
+    uint64_t bursts;
+    uint64_t late;          // Bursts that ended after their deadline
+    uint64_t resyncs;       // Schedules started again after a lag over the limit
+    int64_t lagNs;          // Behind the deadline at the end of the last burst, < 0 ahead
+    int64_t maxLagNs;
+    uint64_t meanJitterNs;  // Wake-up after the deadline
+    uint64_t maxJitterNs;
+};
+
+/* A change of the pins of a port, as in the ring of simObservePins() */
+struct simPinEvent{
+    uint64_t cycle;
+    uint8_t port;           // 0 = B, 1 = C, 2 = D, 3 = E on the ATmega2560
+    uint8_t pins;           // Levels of the 8 pins after the change
+    uint8_t ddr;            // Data direction of the 8 pins
+    uint8_t reserved[5];
+};
+
+/* Peripheral callbacks, called while simRun() runs, on the thread of the instance */
+typedef uint8_t (*simRead)(simulador *sim, uint16_t addr, void *user);
+typedef void (*simWrite)(simulador *sim, uint16_t addr, uint8_t value, void *user);
+
+SIMAPI int simVersion(void);
+SIMAPI const char *simDevice(void);
+
+SIMAPI simulador *simCreate(void);
+SIMAPI void simDestroy(simulador *sim);
+
+SIMAPI int simLoadElf(simulador *sim, const char *path);
+SIMAPI int simLoadHex(simulador *sim, const char *path);
+SIMAPI int simLoadBinary(simulador *sim, const void *image, size_t size);
+SIMAPI int simAssemble(simulador *sim, const char *source, char *error, size_t errorSize);
+
+SIMAPI simImage *simImageCreate(simulador *sim);
+SIMAPI void simImageUse(simulador *sim, simImage *image);
+SIMAPI void simImageRelease(simImage *image);
+
+SIMAPI int simWarmBoot(simulador *sim, const char *path, const char *symbol, const char *directory, uint64_t cycles);
+SIMAPI int simSaveCheckpoint(simulador *sim, const char *path);
+SIMAPI int simLoadCheckpoint(simulador *sim, const char *path);
+
+SIMAPI void simReset(simulador *sim);
+SIMAPI int simRun(simulador *sim, uint64_t cycles);
+SIMAPI int simRunRealtime(simulador *sim, uint64_t cycles);
+SIMAPI void simSetPacing(simulador *sim, uint64_t hz, uint64_t burst, uint64_t spinNs, uint64_t lagLimitNs);
+SIMAPI void simGetPacing(simulador *sim, struct simPacing *pacing);
+SIMAPI void simStop(simulador *sim);
+SIMAPI uint64_t simCycles(simulador *sim);
+SIMAPI void simSetBreakpoint(simulador *sim, uint32_t pc, int set);
+
+SIMAPI void simReadData(simulador *sim, uint16_t addr, void *buffer, size_t size);
+SIMAPI void simWriteData(simulador *sim, uint16_t addr, const void *buffer, size_t size);
+SIMAPI void simReadFlash(simulador *sim, uint32_t word, uint16_t *buffer, size_t words);
+SIMAPI void simWriteFlash(simulador *sim, uint32_t word, const uint16_t *buffer, size_t words);
+SIMAPI int simEepromOpen(simulador *sim, const char *path);
+SIMAPI void simReadEeprom(simulador *sim, uint16_t addr, void *buffer, size_t size);
+SIMAPI void simWriteEeprom(simulador *sim, uint16_t addr, const void *buffer, size_t size);
+SIMAPI void simGetRegisters(simulador *sim, struct simRegisters *registers);
+SIMAPI void simSetRegisters(simulador *sim, const struct simRegisters *registers);
+
+SIMAPI void simGetStack(simulador *sim, struct simStack *stack);
+SIMAPI void simClearStack(simulador *sim);
+SIMAPI int simSramReport(simulador *sim, const char *path);
+
+SIMAPI int simRecord(simulador *sim, const char *path);
+SIMAPI int simReplay(simulador *sim, const char *path);
+SIMAPI void simReplayStop(simulador *sim);
+SIMAPI int simNativeCalls(simulador *sim, int mode);
+SIMAPI int simNativeReport(simulador *sim, const char *path);
+
+SIMAPI int simAttachSpiFlash(simulador *sim, const char *path, uint32_t size, int port, int pin);
+SIMAPI int simAttachTwiEeprom(simulador *sim, const char *path, uint32_t size, uint8_t address);
+SIMAPI uint8_t *simAttachTwiSensor(simulador *sim, uint8_t address);
+SIMAPI int simTwiMaster(simulador *sim, uint8_t address, int read, uint8_t *data, int length);
+SIMAPI int simTwiResult(simulador *sim);
+
+SIMAPI int simObservePins(simulador *sim, const char *name, uint32_t size);
+SIMAPI int simReadPins(simulador *sim, struct simPinEvent *events, int max);
+SIMAPI void simSetPin(simulador *sim, int port, int pin, int level);
+SIMAPI void simReleasePin(simulador *sim, int port, int pin);
+
+SIMAPI int simAdcAttach(simulador *sim, int channel, const char *path, uint64_t cyclesPerSample);
+SIMAPI void simAdcSetVoltage(simulador *sim, int channel, uint16_t millivolts);
+SIMAPI void simAdcSetReference(simulador *sim, uint16_t avcc, uint16_t aref);
+
+SIMAPI int simStats(simulador *sim, const char *name);
+SIMAPI double simStatsSpeed(simulador *sim);
+
+SIMAPI void simCoverageClear(simulador *sim);
+SIMAPI int simCoverageSave(simulador *sim, const char *path);
+SIMAPI int simCoverageMerge(simulador *sim, const char *path);
+SIMAPI int simCoverageLcov(simulador *sim, const char *elfPath, const char *path, const char *test);
+SIMAPI int simCovered(simulador *sim, uint32_t word);
+
+SIMAPI void simCosimInit(int instances, uint64_t quantum);
+SIMAPI int simCosimConnect(int from, int to, int port, uint64_t latency);
+SIMAPI void simCosimUart(simulador *sim);
+SIMAPI int simCosimSpiMaster(simulador *sim, int port, int pin);
+SIMAPI void simCosimSpiSlave(simulador *sim);
+SIMAPI int simCosimTwiMaster(simulador *sim, uint8_t address);
+SIMAPI void simCosimTwiSlave(simulador *sim);
+SIMAPI int simCosimRun(simulador **sims, uint64_t cycles);
+
+SIMAPI void simSetIO(simulador *sim, uint16_t addr, simRead read, simWrite write, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
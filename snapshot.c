@@ -0,0 +1,116 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "snapshot.h"
+#include "registers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+The state of the MCU is spread over the modules, in static MCUSTATE variables. Each module
+hands the variables that change while the MCU runs to keepState(), from reset() or from
+its init function, and a snapshot is the bytes of all of them, one after the other.
+
+Only values are kept. What the modules set up once (I/O handlers, interrupt vectors) and
+what lives outside the MCU (FLASH, host files other than the EEPROM, coverage, statistics)
+is not, so a snapshot is only restored on the thread that saved it, after the same reset.
+*/
+
+#define MAXREGIONS 48
+
+struct region{
+    void *addr;
+    size_t size;
+};
+
+static MCUSTATE struct region regions[MAXREGIONS];
+static MCUSTATE int nregions;
+static MCUSTATE size_t total;
+
+/* Called by reset(), before the modules keep their state. */
+void clearState(){
+    nregions = 0;
+    total = 0;
+}
+
+void keepState(void *addr, size_t size){
+    int i;
+
+    for(i = 0; i < nregions; i++){
+        if(regions[i].addr == addr){
+            return;
+        }
+    }
+    if(nregions == MAXREGIONS){
+        printf("TOO MANY STATE REGIONS.");
+        exit(1);
+    }
+
+    regions[nregions].addr = addr;
+    regions[nregions].size = size;
+    nregions++;
+    total += size;
+}
+
+/* Stops keeping the variable at addr, which is about to go away. */
+void forgetState(void *addr){
+    int i;
+
+    for(i = 0; i < nregions; i++){
+        if(regions[i].addr == addr){
+            total -= regions[i].size;
+            regions[i] = regions[--nregions];
+            return;
+        }
+    }
+}
+
+/* Hash of the sizes of the regions, in order: snapshots of the same layout fit each other. */
+uint32_t stateLayout(){
+    uint32_t hash = 0x811C9DC5;
+    int i;
+
+    for(i = 0; i < nregions; i++){
+        hash = (hash ^ (uint32_t)regions[i].size) * 0x01000193;
+    }
+    return hash;
+}
+
+/* Bytes of a snapshot */
+size_t stateSize(){
+    return total;
+}
+
+void saveState(uint8_t *to){
+    int i;
+
+    for(i = 0; i < nregions; i++){
+        memcpy(to, regions[i].addr, regions[i].size);
+        to += regions[i].size;
+    }
+}
+
+void restoreState(const uint8_t *from){
+    int i;
+
+    for(i = 0; i < nregions; i++){
+        memcpy(regions[i].addr, from, regions[i].size);
+        from += regions[i].size;
+    }
+}
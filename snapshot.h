@@ -0,0 +1,35 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Saving and restoring the state of the MCU of this thread (see snapshot.c) */
+
+void clearState();
+void keepState(void *addr, size_t size);
+void forgetState(void *addr);
+size_t stateSize();
+uint32_t stateLayout();
+void saveState(uint8_t *to);
+void restoreState(const uint8_t *from);
+
+#endif
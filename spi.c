@@ -0,0 +1,287 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "spi.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "gpio.h"
+#include "replay.h"
+
+/*
+SPI in master mode, at the level of the byte.
+
+Writing SPDR starts a transfer that takes 8 SCK periods (4 to 128 cycles each, SPR1:0 and
+SPI2X). It is not shifted bit by bit: a single event at its end exchanges the byte with the
+slaves, writes the received one to SPDR, sets SPIF and requests the interrupt. Writing SPDR
+during a transfer sets WCOL and is ignored. SPSR has no read handler, so polling SPIF is a
+busy-wait loop (busywait.c) that jumps straight to the end of the byte, and streaming a
+buffer costs one event per byte.
+
+SPIF and WCOL are cleared by the access to SPDR that follows reading SPSR; reading SPSR is
+not tracked, any access to SPDR clears them. With DORD set the byte goes LSB first: the
+slaves, which speak MSB first, see it and answer reversed. The clock mode (CPOL, CPHA) is
+not checked against the slave. A master with SS an input driven low becomes a slave
+(mode fault): MSTR is cleared and SPIF set. As a slave, the MCU exchanges the bytes of a
+master outside it (spiSlaveExchange(), from cosim.c) with the byte last written to SPDR; SS
+is not checked.
+
+Slaves are devices attached to a chip select pin (spidevice in spi.h). A device is
+selected while its pin is an output at 0; it is told when that changes, and the byte
+exchanged with it at the end of each transfer. With several devices selected, MISO is the
+AND of their answers, 0xFF with none. Devices belong to the host and stay attached on
+reset; their answers are inputs of the MCU for replay.c.
+*/
+
+struct attachment{
+    struct spidevice *device;
+    int port;
+    int pin;
+    int selected;
+};
+
+static const uint8_t divisions[4] = {4, 16, 64, 128};
+
+static MCUSTATE struct attachment attached[MAXSPIDEVICES];
+static MCUSTATE int nattached;
+static MCUSTATE uint8_t shift;          // Byte being sent
+static MCUSTATE uint8_t busy;
+
+static uint8_t reverse(uint8_t b){
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    return (b & 0xAA) >> 1 | (b & 0x55) << 1;
+}
+
+// Cycles of a byte: 8 SCK periods
+static uint64_t byteCycles(){
+    uint64_t period = divisions[DATA[SPCR] & 0x03];
+
+    if(DATA[SPSR] & (1 << SPI2X)){
+        period /= 2;
+    }
+    return 8 * period;
+}
+
+static int isSelected(const struct attachment *a){
+    uint8_t bit = 1 << a->pin;
+
+    return (DATA[DDRB + 3 * a->port] & bit) && !(DATA[PINB + 3 * a->port] & bit);
+}
+
+// The byte the selected slaves shift out for mosi
+static uint8_t answer(uint8_t mosi){
+    uint8_t miso = 0xFF;
+    int i;
+
+    if(DATA[SPCR] & (1 << DORD)){
+        mosi = reverse(mosi);
+    }
+
+    if(REPLAY == REPLAYING){
+        miso = replayInput(INPUT_SPI, mosi);
+    }
+    else{
+        for(i = 0; i < nattached; i++){
+            if(attached[i].selected){
+                miso &= attached[i].device->exchange(attached[i].device, mosi);
+            }
+        }
+        if(REPLAY == RECORDING){
+            recordInput(INPUT_SPI, mosi, miso);
+        }
+    }
+
+    if(DATA[SPCR] & (1 << DORD)){
+        miso = reverse(miso);
+    }
+    return miso;
+}
+
+static void transferDone(uint64_t when){
+    DATA[SPDR] = answer(shift);
+    busy = 0;
+    DATA[SPSR] |= 1 << SPIF;
+    updateInterrupts();
+}
+
+// Mode fault: SS is an input and low while the SPI is a master
+static void checkSS(){
+    uint8_t ss = 1 << SPI_SS;
+
+    if((DATA[SPCR] & (1 << SPE)) && (DATA[SPCR] & (1 << MSTR)) && !(DATA[DDRB] & ss) && !(DATA[PINB] & ss)){
+        DATA[SPCR] &= ~(1 << MSTR);
+        DATA[SPSR] |= 1 << SPIF;
+        busy = 0;
+        unschedule(transferDone);
+        updateInterrupts();
+    }
+}
+
+static void watch(int port){
+    int i;
+
+    if(port == GPIOB){
+        checkSS();
+    }
+
+    for(i = 0; i < nattached; i++){
+        struct attachment *a = &attached[i];
+
+        if(a->port == port && a->selected != isSelected(a)){
+            a->selected = !a->selected;
+            a->device->select(a->device, a->selected);
+        }
+    }
+}
+
+// SPIF and WCOL are cleared by accessing SPDR
+static void clearFlags(){
+    if(DATA[SPSR] & (1 << SPIF)){
+        DATA[SPSR] &= ~((1 << SPIF) | (1 << WCOL));
+        updateInterrupts();
+    }
+}
+
+static uint8_t readSPDR(uint16_t addr){
+    clearFlags();
+    return DATA[SPDR];
+}
+
+static void writeSPDR(uint16_t addr, uint8_t value){
+    clearFlags();
+
+    if(!(DATA[SPCR] & (1 << SPE)) || !(DATA[SPCR] & (1 << MSTR))){
+        shift = value;
+        return;
+    }
+    if(busy){
+        DATA[SPSR] |= 1 << WCOL;
+        return;
+    }
+
+    shift = value;
+    busy = 1;
+    schedule(transferDone, CYCLES + byteCycles());
+}
+
+static void writeSPCR(uint16_t addr, uint8_t value){
+    DATA[SPCR] = value;
+
+    if(!(value & (1 << SPE)) || !(value & (1 << MSTR))){
+        busy = 0;
+        unschedule(transferDone);
+    }
+    checkSS();
+    updateInterrupts();
+}
+
+// Only SPI2X can be written
+static void writeSPSR(uint16_t addr, uint8_t value){
+    DATA[SPSR] = (DATA[SPSR] & ~(1 << SPI2X)) | (value & (1 << SPI2X));
+}
+
+static int pendingSPI(){
+    return DATA[SPSR] & (1 << SPIF) && DATA[SPCR] & (1 << SPIE);
+}
+
+static void acknowledgeSPI(){
+    DATA[SPSR] &= ~(1 << SPIF);
+}
+
+void initSpi(){
+    int i;
+
+    shift = 0;
+    busy = 0;
+
+    // A reset releases the chip selects
+    for(i = 0; i < nattached; i++){
+        if(attached[i].selected){
+            attached[i].selected = 0;
+            attached[i].device->select(attached[i].device, 0);
+        }
+    }
+
+    keepState(&shift, sizeof(shift));
+    keepState(&busy, sizeof(busy));
+
+    keepHandler(transferDone);
+
+    setIOHandlers(SPCR, 0, writeSPCR);
+    setIOHandlers(SPSR, 0, writeSPSR);
+    setIOHandlers(SPDR, readSPDR, writeSPDR);
+    setInterrupt(SPI_STC_vect, pendingSPI, acknowledgeSPI);
+    watchPorts(watch);
+}
+
+/* Puts device on the bus, selected by pin of port (GPIOB, GPIOC or GPIOD). Returns 0 if
+MAXSPIDEVICES are attached already. */
+int spiAttach(struct spidevice *device, int port, int pin){
+    struct attachment *a;
+
+    if(nattached == MAXSPIDEVICES){
+        return 0;
+    }
+
+    a = &attached[nattached++];
+    a->device = device;
+    a->port = port;
+    a->pin = pin;
+    a->selected = isSelected(a);
+    if(a->selected){
+        device->select(device, 1);
+    }
+    return 1;
+}
+
+/* Takes device off the bus. */
+void spiDetach(struct spidevice *device){
+    int i;
+
+    for(i = 0; i < nattached; i++){
+        if(attached[i].device == device){
+            attached[i] = attached[--nattached];
+            return;
+        }
+    }
+}
+
+/* A byte clocked in by a master outside the MCU: with the SPI enabled as a slave, mosi goes
+to SPDR, SPIF is set and the byte written to SPDR before is shifted out. Returns the byte
+on MISO, 0xFF if the MCU does not drive it. Like twiMaster(), a host input that is not
+recorded and is ignored while a recording replays. */
+uint8_t spiSlaveExchange(uint8_t mosi){
+    uint8_t miso = shift;
+
+    if(!(DATA[SPCR] & (1 << SPE)) || (DATA[SPCR] & (1 << MSTR)) || REPLAY == REPLAYING){
+        return 0xFF;
+    }
+
+    if(DATA[SPCR] & (1 << DORD)){
+        mosi = reverse(mosi);
+        miso = reverse(miso);
+    }
+    DATA[SPDR] = mosi;
+    DATA[SPSR] |= 1 << SPIF;
+    updateInterrupts();
+
+    return miso;
+}
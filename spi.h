@@ -0,0 +1,58 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef SPI_H
+#define SPI_H
+
+#include <stdint.h>
+
+/* SPI registers, as data space addresses */
+#define SPCR 0x4C
+#define SPSR 0x4D
+#define SPDR 0x4E
+
+/* SPCR bits */
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+
+/* SPSR bits */
+#define SPIF 7
+#define WCOL 6
+#define SPI2X 0
+
+#define MAXSPIDEVICES 8
+
+/* A slave on the bus, selected while its chip select pin is an output driven low. Both
+are called on the thread of the MCU, at the cycle the byte or the edge happens. */
+struct spidevice{
+    // Chip select went low (1) or high (0): a command starts or ends
+    void (*select)(struct spidevice *device, int selected);
+    // One byte of the transfer: gets the byte on MOSI, returns the one put on MISO
+    uint8_t (*exchange)(struct spidevice *device, uint8_t mosi);
+};
+
+void initSpi();
+int spiAttach(struct spidevice *device, int port, int pin);
+void spiDetach(struct spidevice *device);
+uint8_t spiSlaveExchange(uint8_t mosi);
+
+#endif
@@ -0,0 +1,222 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "spiflash.h"
+#include "registers.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+A serial NOR flash with the command set common to the 25-series parts (W25Q, MX25L,
+AT25SF...), as an SPI slave for spi.c:
+
+    0x9F    read JEDEC ID: manufacturer 0xEF, memory type 0x40, capacity (log2 of the size)
+    0x05    read status register: BUSY (bit 0), WEL (bit 1)
+    0x06    write enable, 0x04 write disable
+    0x03    read data: 24 bit address, then data for as long as CS stays low, wrapping at
+            the end of the memory
+    0x0B    fast read: 24 bit address, a dummy byte, then data
+    0x02    page program: 24 bit address, then up to a page (256 bytes) of data, wrapping
+            inside the page; programming only clears bits
+    0x20    erase the 4KB sector of the 24 bit address, 0x52 the 32KB block, 0xD8 the 64KB
+            block; 0xC7 or 0x60 erase the whole memory
+
+Program and erase need WEL, which they clear. Erases and the write enable run when CS goes
+high, after the whole command. Program and erase keep BUSY set for the typical time of the
+datasheets (0.4ms a page, 45ms a sector, 120/150ms a block, 40s the chip) in cycles of
+F_CPU; meanwhile only the status can be read.
+
+The memory is the file, mapped shared: reads and programs touch the mapped pages only, so
+a flash of any size costs what the firmware reads of it, and what it writes is in the file
+when the simulation ends. A new or short file is extended with erased (0xFF) bytes.
+*/
+
+#define PAGEBYTES 256
+#define US(us) ((uint64_t)(us) * (F_CPU / 1000000))
+
+struct spiflash{
+    struct spidevice device;        // First, so a spidevice pointer is a spiflash one
+    uint8_t *data;
+    uint32_t size;
+    uint8_t command;
+    uint32_t count;                 // Bytes of the command so far
+    uint32_t address;
+    int wel;
+    uint64_t busyUntil;
+};
+
+static int isBusy(struct spiflash *f){
+    return CYCLES < f->busyUntil;
+}
+
+static uint8_t status(struct spiflash *f){
+    return (isBusy(f) ? 0x01 : 0) | (f->wel ? 0x02 : 0);
+}
+
+static void erase(struct spiflash *f, uint32_t bytes, uint64_t cycles){
+    uint32_t start = f->address % f->size & ~(bytes - 1);
+
+    if(bytes > f->size){
+        bytes = f->size;
+        start = 0;
+    }
+    memset(f->data + start, 0xFF, bytes);
+    f->wel = 0;
+    f->busyUntil = CYCLES + cycles;
+}
+
+static void flashSelect(struct spidevice *device, int selected){
+    struct spiflash *f = (struct spiflash *)device;
+
+    if(selected){
+        f->count = 0;
+        return;
+    }
+    if(f->count == 0 || isBusy(f)){
+        return;
+    }
+
+    switch(f->command){
+    case 0x06:
+        f->wel = 1;
+        break;
+    case 0x04:
+        f->wel = 0;
+        break;
+    case 0x02:
+        if(f->wel && f->count > 4){
+            f->wel = 0;
+            f->busyUntil = CYCLES + US(400);
+        }
+        break;
+    case 0x20:
+    case 0x52:
+    case 0xD8:
+        if(f->wel && f->count >= 4){
+            if(f->command == 0x20){
+                erase(f, 4096, US(45000));
+            }
+            else if(f->command == 0x52){
+                erase(f, 32768, US(120000));
+            }
+            else{
+                erase(f, 65536, US(150000));
+            }
+        }
+        break;
+    case 0xC7:
+    case 0x60:
+        if(f->wel){
+            erase(f, f->size, US(40000000));
+        }
+        break;
+    }
+}
+
+static uint8_t flashExchange(struct spidevice *device, uint8_t mosi){
+    struct spiflash *f = (struct spiflash *)device;
+    uint32_t n = f->count++;
+
+    if(n == 0){
+        f->command = mosi;
+        f->address = 0;
+        return 0xFF;
+    }
+    if(f->command == 0x05){
+        return status(f);
+    }
+    if(isBusy(f)){
+        return 0xFF;
+    }
+    if(f->command == 0x9F){
+        uint8_t capacity = 0;
+
+        while((1u << capacity) < f->size){
+            capacity++;
+        }
+        return n == 1 ? 0xEF : n == 2 ? 0x40 : n == 3 ? capacity : 0x00;
+    }
+    if(n <= 3){
+        f->address = f->address << 8 | mosi;
+        return 0xFF;
+    }
+
+    switch(f->command){
+    case 0x0B:
+        if(n == 4){
+            return 0xFF;
+        }
+        // Fall through
+    case 0x03:
+        return f->data[f->address++ % f->size];
+    case 0x02:
+        if(f->wel){
+            uint32_t page = f->address % f->size & ~(PAGEBYTES - 1);
+
+            f->data[page | (f->address & (PAGEBYTES - 1))] &= mosi;
+            f->address = page | ((f->address + 1) & (PAGEBYTES - 1));
+        }
+        return 0xFF;
+    }
+    return 0xFF;
+}
+
+/* A flash of size bytes (a power of two, at least a page) stored in path, created if needed.
+Attach it with spiAttach(). Returns 0 if the file cannot be mapped. */
+struct spidevice *spiFlashOpen(const char *path, uint32_t size){
+    struct spiflash *f;
+    struct stat st;
+    void *data;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if(fd < 0){
+        return 0;
+    }
+    if(fstat(fd, &st) < 0 || (st.st_size < size && ftruncate(fd, size) < 0)){
+        close(fd);
+        return 0;
+    }
+    data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+        return 0;
+    }
+    if(st.st_size < size){
+        memset((uint8_t *)data + st.st_size, 0xFF, size - st.st_size);
+    }
+
+    f = calloc(1, sizeof(*f));
+    f->device.select = flashSelect;
+    f->device.exchange = flashExchange;
+    f->data = data;
+    f->size = size;
+    return &f->device;
+}
+
+/* Writes the flash back to its file and frees it. Detach it first. */
+void spiFlashClose(struct spidevice *device){
+    struct spiflash *f = (struct spiflash *)device;
+
+    msync(f->data, f->size, MS_SYNC);
+    munmap(f->data, f->size);
+    free(f);
+}
@@ -0,0 +1,26 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+#include "spi.h"
+
+/* SPI NOR flash stand-in, stored in a file */
+
+struct spidevice *spiFlashOpen(const char *path, uint32_t size);
+void spiFlashClose(struct spidevice *device);
@@ -0,0 +1,196 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "spm.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "decoder.h"
+#include "snapshot.h"
+#include <string.h>
+
+/*
+Self-programming of the flash by a boot loader.
+
+SPM only works from the Boot Loader section (words BOOTSTART and up, the NRWW section) and
+only within four cycles of setting SELFPRGEN in SPMCSR, together with the bits that pick
+the operation:
+
+- SELFPRGEN alone loads R1:R0 into the page buffer word addressed by Z.
+- PGERS erases the page addressed by Z, PGWRT writes the page buffer to it. Both take 4.5 ms.
+  On a page of the NRWW section the CPU is halted until they are done. On a page of the RWW
+  section (the application) the CPU goes on and RWWSB stays set until RWWSRE is written.
+- BLBSET programs the Boot Lock bits with the zeros of R0.
+- RWWSRE, once nothing is running, clears RWWSB.
+
+As on the chip, writing a page only clears bits, and the page buffer is erased after a write.
+The Boot Lock bits stop SPM from changing the Application (BLB01 programmed) or Boot Loader
+(BLB11 programmed) sections; their restrictions on LPM are not modeled, and neither is
+reading the RWW section while it is busy, which the boot loader has to avoid on its own.
+
+Every change to FLASH is followed by invalidateFlash() on the page, so nothing the decoder
+derived from the old code is used again. The lock bits and the flash are kept over reset().
+*/
+
+#define OPERATION ((1 << PGERS) | (1 << PGWRT) | (1 << BLBSET) | (1 << RWWSRE) | (1 << SIGRD))
+#define WRITETIME (45 * F_CPU / 10000)
+
+/* Lock bits */
+#define BLB01 2
+#define BLB11 4
+
+static MCUSTATE uint16_t buffer[PAGESIZE];
+static MCUSTATE uint8_t lockBits = 0xFF;
+static MCUSTATE uint16_t busyPage;
+static MCUSTATE uint8_t busyOperation;
+
+static void eraseBuffer(){
+    int i;
+
+    for(i = 0; i < PAGESIZE; i++){
+        buffer[i] = 0xFFFF;
+    }
+}
+
+static void clearSELFPRGEN(uint64_t when){
+    DATA[SPMCSR] &= ~((1 << SELFPRGEN) | OPERATION);
+    updateInterrupts();
+}
+
+// Erases or writes the page, at the end of the operation
+static void program(uint16_t page, uint8_t operation){
+    uint16_t *words = FLASH + page * PAGESIZE;
+    int i;
+
+    if(operation & (1 << PGERS)){
+        for(i = 0; i < PAGESIZE; i++){
+            words[i] = 0xFFFF;
+        }
+    }
+    else{
+        for(i = 0; i < PAGESIZE; i++){
+            words[i] &= buffer[i];
+        }
+        eraseBuffer();
+    }
+
+    invalidateFlash(page * PAGESIZE, PAGESIZE);
+}
+
+static void programDone(uint64_t when){
+    program(busyPage, busyOperation);
+    busyOperation = 0;
+    clearSELFPRGEN(when);
+}
+
+static int writable(uint16_t page){
+    if(page * PAGESIZE >= BOOTSTART){
+        return lockBits & (1 << BLB11);
+    }
+    return lockBits & (1 << BLB01);
+}
+
+/* Runs the operation selected in SPMCSR, for SPM with the Z pointer (RAMPZ:Z on devices with
+RAMPZ) and R1:R0. */
+void storeProgramMemory(uint32_t z, uint16_t data){
+    uint8_t operation = DATA[SPMCSR] & OPERATION;
+    uint16_t page = (z >> 1) / PAGESIZE % (FLASHSIZE / PAGESIZE);
+
+    if(PC < BOOTSTART || !(DATA[SPMCSR] & (1 << SELFPRGEN)) || busyOperation){
+        return;
+    }
+    unschedule(clearSELFPRGEN);
+
+    switch(operation){
+    case 0:
+        buffer[(z >> 1) % PAGESIZE] = data;
+        break;
+    case 1 << PGERS:
+    case 1 << PGWRT:
+        if(!writable(page)){
+            break;
+        }
+        if(page * PAGESIZE >= BOOTSTART){
+            program(page, operation);
+            CYCLES += WRITETIME;
+            break;
+        }
+        busyPage = page;
+        busyOperation = operation;
+        DATA[SPMCSR] |= 1 << RWWSB;
+        schedule(programDone, CYCLES + WRITETIME);
+        return;
+    case 1 << BLBSET:
+        lockBits &= (data & 0xFF) | ~((3 << BLB01) | (3 << BLB11));
+        break;
+    case 1 << RWWSRE:
+        DATA[SPMCSR] &= ~(1 << RWWSB);
+        break;
+    }
+
+    clearSELFPRGEN(CYCLES);
+}
+
+static void writeSPMCSR(uint16_t addr, uint8_t value){
+    uint8_t old = DATA[SPMCSR];
+
+    if(busyOperation){
+        // only SPMIE can change while the RWW section is being programmed
+        DATA[SPMCSR] = (old & ~(1 << SPMIE)) | (value & (1 << SPMIE));
+    }
+    else{
+        DATA[SPMCSR] = (old & (1 << RWWSB)) | (value & ~(1 << RWWSB));
+        if(value & (1 << SELFPRGEN)){
+            schedule(clearSELFPRGEN, CYCLES + 4);
+        }
+    }
+
+    updateInterrupts();
+}
+
+// SPM_READY is requested as long as SELFPRGEN is clear
+static int pendingSPM(){
+    return (DATA[SPMCSR] & (1 << SPMIE)) && !(DATA[SPMCSR] & (1 << SELFPRGEN));
+}
+
+void initSpm(){
+    eraseBuffer();
+    busyOperation = 0;
+
+    keepState(buffer, sizeof(buffer));
+    keepState(&lockBits, sizeof(lockBits));
+    keepState(&busyPage, sizeof(busyPage));
+    keepState(&busyOperation, sizeof(busyOperation));
+
+    keepHandler(programDone);
+    keepHandler(clearSELFPRGEN);
+
+    setIOHandlers(SPMCSR, 0, writeSPMCSR);
+    setInterrupt(SPM_READY_vect, pendingSPM, 0);
+}
+
+/* The lock byte, as read back by avrdude: unprogrammed bits are one. */
+uint8_t getLockBits(){
+    return lockBits;
+}
+
+/* Sets the lock byte, as an external programmer would. Chip erase sets it back to $FF. */
+void setLockBits(uint8_t bits){
+    lockBits = bits;
+}
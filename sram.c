@@ -0,0 +1,197 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "sram.h"
+#include "functions.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+Stack overflows are found by two cheap checks.
+
+Every change of SP (push, pop, CALL, RET, interrupts, and writes to SPL) compares it with
+LOWEST.sp, the high-water mark; only a new low calls stackLow(), which records the PC, the
+call depth and the cycle, and tests whether the stack has gone into the heap or .bss. SP is
+compared on the write of SPL only, since avr-gcc writes SPH first and SPL last, and the
+value in between is neither the old SP nor the new one.
+
+Every store to SRAM sets a bit of SRAMWRITTEN and every load one of SRAMREAD, so a report
+shows which bytes of .data, .bss, the heap and the stack the program used, and which it
+read without writing first. Loops run on the host (idioms.c) mark their ranges.
+
+The regions come from the symbols avr-libc and the avr-gcc linker script define, so they
+are only known for ELF images: __data_start, __data_end, __bss_start, __bss_end,
+__heap_start and __brkval, the top of the heap once malloc() ran. A collision is flagged
+as soon as the stack gets to a new low inside them; the heap growing into where the stack
+once was shows in the report.
+
+The maps and marks add up over reset() until sramClear().
+*/
+
+MCUSTATE uint8_t SRAMWRITTEN[SRAMBYTES / 8];
+MCUSTATE uint8_t SRAMREAD[SRAMBYTES / 8];
+
+MCUSTATE struct stackMark LOWEST = {0xFFFF};
+MCUSTATE struct stackMark COLLISION;
+MCUSTATE uint16_t DEPTH;
+
+struct regions{
+    uint16_t dataStart, dataEnd;
+    uint16_t bssStart, bssEnd;
+    uint16_t heapStart;
+    uint16_t brkval;        // address of __brkval, 0 if malloc() is not linked
+};
+
+static MCUSTATE struct regions regions;
+
+static MCUSTATE void (*collision)();
+
+// First address past the heap, or past .bss if there is none; 0 if unknown
+static uint16_t heapTop(){
+    uint16_t top = regions.heapStart;
+
+    if(regions.brkval && ((DATA[regions.brkval + 1] << 8) | DATA[regions.brkval])){
+        top = (DATA[regions.brkval + 1] << 8) | DATA[regions.brkval];
+    }
+    return top;
+}
+
+/* New high-water mark. The newest byte of the stack is at sp + 1. */
+void stackLow(uint16_t sp){
+    LOWEST.sp = sp;
+    LOWEST.pc = PC;
+    LOWEST.depth = DEPTH;
+    LOWEST.cycle = CYCLES;
+
+    if(COLLISION.cycle == 0 && sp + 1 < heapTop()){
+        COLLISION = LOWEST;
+        if(COLLISION.cycle == 0){
+            COLLISION.cycle = 1;
+        }
+        if(collision){
+            collision();
+        }
+    }
+}
+
+void sramClear(){
+    memset(SRAMWRITTEN, 0, sizeof(SRAMWRITTEN));
+    memset(SRAMREAD, 0, sizeof(SRAMREAD));
+    memset(&COLLISION, 0, sizeof(COLLISION));
+    LOWEST.sp = 0xFFFF;
+    STACKMOVED(getSP());
+}
+
+static uint16_t symbol(const struct elf *elf, const char *name){
+    uint32_t value, size;
+
+    return elfSymbol(elf, name, &value, &size) ? value & 0xFFFF : 0;
+}
+
+/* Takes the regions from the symbols of the ELF file of the program. */
+void sramRegions(const struct elf *elf){
+    regions.dataStart = symbol(elf, "__data_start");
+    regions.dataEnd = symbol(elf, "__data_end");
+    regions.bssStart = symbol(elf, "__bss_start");
+    regions.bssEnd = symbol(elf, "__bss_end");
+    regions.heapStart = symbol(elf, "__heap_start");
+    regions.brkval = symbol(elf, "__brkval");
+
+    if(regions.heapStart == 0){
+        regions.heapStart = regions.bssEnd;
+    }
+    if(regions.brkval < SRAMSTART || regions.brkval >= RAMEND){
+        regions.brkval = 0;
+    }
+}
+
+/* Marks n bytes from addr, all in SRAM. */
+void sramMarkRange(uint8_t *map, uint16_t addr, uint32_t n){
+    for(; n > 0; n--, addr++){
+        MARK(map, addr);
+    }
+}
+
+/* Calls handler, with PC on the instruction that moved SP, when the stack collides with
+the heap or .bss. Cleared by reset(). */
+void onStackCollision(void (*handler)()){
+    collision = handler;
+}
+
+static int used(uint16_t first, uint16_t end){
+    int n = 0;
+
+    for(; first < end; first++){
+        n += MARKED(SRAMWRITTEN, first) | MARKED(SRAMREAD, first);
+    }
+    return n;
+}
+
+static void region(FILE *f, const char *name, uint16_t first, uint16_t end){
+    if(end > first){
+        fprintf(f, "%-6s $%04X-$%04X %5d bytes, %d used\n", name, first, end - 1, end - first, used(first, end));
+    }
+}
+
+/* Writes the regions, the stack marks and the map of SRAM to path, "-" for stdout.
+Returns 0 if it cannot be written. */
+int sramReport(const char *path){
+    static const char symbols[4] = {'.', 'w', 'r', 'b'};
+    FILE *f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    uint16_t top = heapTop();
+    uint16_t stackStart = LOWEST.sp < RAMEND ? LOWEST.sp + 1 : RAMEND + 1;
+    int addr, ok;
+
+    if(f == 0){
+        return 0;
+    }
+
+    fprintf(f, "SRAM   $%04X-$%04X %5d bytes\n", SRAMSTART, RAMEND, SRAMBYTES);
+    region(f, ".data", regions.dataStart, regions.dataEnd);
+    region(f, ".bss", regions.bssStart, regions.bssEnd);
+    region(f, "heap", regions.heapStart, top);
+    if(top && stackStart > top){
+        region(f, "free", top, stackStart);
+    }
+    region(f, "stack", stackStart, RAMEND + 1);
+
+    fprintf(f, "lowest SP $%04X at PC $%04X, depth %d, cycle %llu\n",
+        LOWEST.sp, (unsigned)LOWEST.pc * 2, LOWEST.depth, (unsigned long long)LOWEST.cycle);
+    if(COLLISION.cycle){
+        fprintf(f, "STACK COLLISION: SP $%04X at PC $%04X, depth %d, cycle %llu\n",
+            COLLISION.sp, (unsigned)COLLISION.pc * 2, COLLISION.depth, (unsigned long long)COLLISION.cycle);
+    }
+    else if(top && LOWEST.sp + 1 < top){
+        fprintf(f, "STACK COLLISION: the heap grew to $%04X, over the lowest stack\n", top - 1);
+    }
+
+    // . untouched, w written, r read and never written, b written and read
+    for(addr = SRAMSTART; addr <= RAMEND; addr++){
+        if((addr - SRAMSTART) % 64 == 0){
+            fprintf(f, "\n$%04X ", addr);
+        }
+        fputc(symbols[MARKED(SRAMWRITTEN, addr) | MARKED(SRAMREAD, addr) << 1], f);
+    }
+    fputc('\n', f);
+
+    ok = !ferror(f);
+    if(f != stdout){
+        ok = fclose(f) == 0 && ok;
+    }
+    return ok;
+}
@@ -0,0 +1,61 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef SRAM_H
+#define SRAM_H
+
+#include <stdint.h>
+#include "registers.h"
+#include "elf.h"
+
+/* SRAM usage: the stack high-water mark and a map of the bytes written and read */
+
+#define SRAMBYTES (RAMEND + 1 - SRAMSTART)
+
+extern MCUSTATE uint8_t SRAMWRITTEN[SRAMBYTES / 8];
+extern MCUSTATE uint8_t SRAMREAD[SRAMBYTES / 8];
+
+#define MARK(map, addr) ((map)[((addr) - SRAMSTART) >> 3] |= 1 << (((addr) - SRAMSTART) & 7))
+#define MARKED(map, addr) (((map)[((addr) - SRAMSTART) >> 3] >> (((addr) - SRAMSTART) & 7)) & 1)
+
+// Where the stack was at a moment
+struct stackMark{
+    uint16_t sp;
+    pc_t pc;
+    uint16_t depth;         // return addresses on the stack
+    uint64_t cycle;
+};
+
+// Lowest SP reached
+extern MCUSTATE struct stackMark LOWEST;
+// First time the stack went into the heap or .bss, cycle 0 if it did not
+extern MCUSTATE struct stackMark COLLISION;
+// Return addresses pushed and not popped
+extern MCUSTATE uint16_t DEPTH;
+
+/* The compare done on every change of SP */
+#define STACKMOVED(newSP) do{ if((newSP) < LOWEST.sp) stackLow(newSP); }while(0)
+
+void stackLow(uint16_t sp);
+void sramClear();
+void sramRegions(const struct elf *elf);
+void sramMarkRange(uint8_t *map, uint16_t addr, uint32_t n);
+void onStackCollision(void (*handler)());
+int sramReport(const char *path);
+
+#endif
@@ -0,0 +1,137 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "stats.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+Counters of the MCU of the calling thread, updated while it runs. They are off (STATS is
+null) until statsCreate() is called, and then cost one test and a few relaxed stores per
+instruction: no lock, no system call.
+
+A monitor in another process maps the same POSIX shared memory object with statsOpen()
+and reads the counters whenever it wants. Each counter is read atomically, but they are
+not a consistent snapshot: one may already include an instruction another does not. The
+layout only changes with STATS_VERSION. The counters add up over reset(); cycles follows
+CYCLES.
+*/
+
+MCUSTATE struct stats *STATS;
+
+static uint64_t now(){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Starts counting for the MCU of the calling thread. With a name the counters are in a POSIX
+shared memory object (e.g. "/simulador-stats") that other processes can open, otherwise
+they are private. */
+struct stats *statsCreate(const char *name){
+    struct stats *stats;
+
+    if(name){
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+
+        // truncating to 0 first clears counters left by an earlier run
+        if(fd < 0){
+            return 0;
+        }
+        if(ftruncate(fd, 0) < 0 || ftruncate(fd, sizeof(struct stats)) < 0){
+            close(fd);
+            return 0;
+        }
+        stats = mmap(0, sizeof(struct stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(stats == MAP_FAILED){
+            return 0;
+        }
+    }
+    else{
+        stats = mmap(0, sizeof(struct stats), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(stats == MAP_FAILED){
+            return 0;
+        }
+    }
+
+    stats->frequency = F_CPU;
+    stats->hostStart = now();
+    stats->startCycle = CYCLES;
+    stats->version = STATS_VERSION;
+    atomic_store_explicit(&stats->cycles, CYCLES, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    stats->magic = STATS_MAGIC;
+
+    STATS = stats;
+
+    return stats;
+}
+
+/* Maps, read only, the counters of a simulator in another process. */
+const struct stats *statsOpen(const char *name){
+    struct stats *stats;
+    struct stat st;
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if(fd < 0 || fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct stats)){
+        if(fd >= 0){
+            close(fd);
+        }
+        return 0;
+    }
+    stats = mmap(0, sizeof(struct stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(stats == MAP_FAILED){
+        return 0;
+    }
+    if(stats->magic != STATS_MAGIC || stats->version != STATS_VERSION){
+        munmap(stats, sizeof(struct stats));
+        return 0;
+    }
+
+    return stats;
+}
+
+/* Stops counting and unmaps the counters; the shared memory object stays for its monitors. */
+void statsClose(){
+    if(STATS){
+        munmap(STATS, sizeof(struct stats));
+        STATS = 0;
+    }
+}
+
+/* Simulated seconds per host second since the counters were created. */
+double statsSpeed(const struct stats *stats){
+    uint64_t cycles = atomic_load_explicit(&stats->cycles, memory_order_relaxed);
+    double simulated;
+
+    // A reset since the counters were created started the cycles over
+    if(cycles >= stats->startCycle){
+        cycles -= stats->startCycle;
+    }
+    simulated = (double)cycles / stats->frequency;
+    double host = (now() - stats->hostStart) / 1e9;
+
+    return host > 0 ? simulated / host : 0;
+}
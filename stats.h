@@ -0,0 +1,59 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "registers.h"
+
+/* Execution counters, shared with host monitors */
+
+#define STATS_MAGIC 0x54415453      // "STAT"
+#define STATS_VERSION 2
+
+struct stats{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t frequency;                 // F_CPU
+    uint64_t hostStart;                 // CLOCK_MONOTONIC, in ns, when the counters were created
+    uint64_t startCycle;                // CYCLES when the counters were created
+    _Atomic uint64_t cycles;            // CYCLES after the last instruction
+    _Atomic uint64_t instructions;      // Instructions stepped one by one
+    _Atomic uint64_t sleepCycles;       // Cycles spent sleeping
+    _Atomic uint64_t skippedCycles;     // Cycles of loops and routines run on the host (idioms.c, busywait.c, native.c)
+    _Atomic uint64_t interrupts[64];    // Interrupts serviced, by vector (NVECTORS of them)
+    _Atomic uint64_t taken[16];         // Conditional branches taken, BRBS s = 0-7, BRBC s = 8-15
+    _Atomic uint64_t notTaken[16];      // Conditional branches not taken, same order
+    _Atomic uint64_t opcodes[65536];    // Instructions stepped, by first opcode word
+};
+
+/* Adds n to a counter. There is one writer per counter, so a relaxed load and store is
+enough: no locked instruction on the simulation side. */
+#define COUNT(counter, n) atomic_store_explicit(&(counter), atomic_load_explicit(&(counter), memory_order_relaxed) + (n), memory_order_relaxed)
+
+extern MCUSTATE struct stats *STATS;
+
+struct stats *statsCreate(const char *name);
+void statsClose();
+const struct stats *statsOpen(const char *name);
+double statsSpeed(const struct stats *stats);
+
+#endif
@@ -0,0 +1,244 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../timer0.h"
+
+/* The loops of idioms.c and busywait.c, run once one instruction at a time (plainFlash()) and
+once accelerated: registers, SREG, SP, PC, data and cycles must come out the same. */
+
+#define MARKS 64
+#define LIMIT 10000000
+
+// The state after each of the first steps of the accelerated run, and at its end
+static struct machine marks[MARKS];
+static struct machine accelerated, stepped;
+
+/* Runs the words of program accelerated after setup(arg), then one instruction at a time, and checks the
+state at the cycles each of the first accelerated steps ended on. An accelerated step stops
+short of the last iteration, whose stepped instructions would hide wrong flags at the end.
+Also checks that the accelerated run did skip instructions, so that the comparison is not
+between two stepped runs. */
+static void compare(const uint16_t *program, int words, void (*setup)(int), int arg, const char *what){
+    int count = 0;
+    int m = 0;
+    uint64_t acceleratedSteps = 0;
+    uint64_t plainSteps = 0;
+
+    loadWords(program, words);
+    setup(arg);
+    while(FLASH[PC] != HALT && CYCLES < LIMIT){
+        step();
+        acceleratedSteps++;
+        if(count < MARKS){
+            capture(&marks[count++]);
+        }
+    }
+    CHECK(FLASH[PC] == HALT, "%s %d: the accelerated run did not halt", what, arg);
+    capture(&accelerated);
+
+    loadWords(program, words);
+    plainFlash();
+    setup(arg);
+    while(FLASH[PC] != HALT && CYCLES < LIMIT){
+        step();
+        plainSteps++;
+        if(m < count && marks[m].cycles < CYCLES){
+            CHECK(0, "%s %d: no instruction ends at cycle %llu", what, arg, (unsigned long long)marks[m].cycles);
+            m++;
+        }
+        if(m < count && marks[m].cycles == CYCLES){
+            capture(&stepped);
+            CHECKSAME(&marks[m], &stepped, what);
+            m++;
+        }
+    }
+    CHECK(FLASH[PC] == HALT, "%s %d: the stepped run did not halt", what, arg);
+    capture(&stepped);
+    CHECKSAME(&accelerated, &stepped, what);
+    CHECK(arg < 3 || acceleratedSteps < plainSteps, "%s %d: nothing was accelerated", what, arg);
+}
+
+/* The loops, each ending on HALT */
+
+static const uint16_t memcpyLoop[] = {
+    0x900D,      // 1: ld r0,X+
+    0x9201,      // st Z+,r0
+    0x9701,      // sbiw r24,1
+    0xF7E1,      // brne 1b
+    HALT
+};
+
+static const uint16_t memsetLoop[] = {
+    0x9301,      // 1: st Z+,r16
+    0x9701,      // sbiw r24,1
+    0xF7E9,      // brne 1b
+    HALT
+};
+
+static const uint16_t strlenLoop[] = {
+    0x9101,      // 1: ld r16,Z+
+    0x2300,      // tst r16
+    0xF7E9,      // brne 1b
+    HALT
+};
+
+static const uint16_t decLoop[] = {
+    0x950A,      // 1: dec r16
+    0xF7F1,      // brne 1b
+    HALT
+};
+
+static const uint16_t sbiwLoop[] = {
+    0x9701,      // 1: sbiw r24,1
+    0xF7F1,      // brne 1b
+    HALT
+};
+
+static const uint16_t sbisPoll[] = {
+    0x9BA8,      // 1: sbis 0x15,0
+    0xCFFE,      // rjmp 1b
+    HALT
+};
+
+static const uint16_t inPoll[] = {
+    0xB305,      // 1: in r16,0x15
+    0xFF00,      // sbrs r16,0
+    0xCFFD,      // rjmp 1b
+    HALT
+};
+
+static const uint16_t ldsPoll[] = {
+    0x9100, 0x0035, // 1: lds r16,0x35
+    0xFF00,      // sbrs r16,0
+    0xCFFC,      // rjmp 1b
+    HALT
+};
+
+// The overflow of timer 0 is pending when sei enables it: its handler runs after one dec
+static const uint16_t pendingLoop[TIMER0_OVF_vect * VECTORSIZE + 2] = {
+    0x9478,      // sei
+    0x950A,      // 1: dec r16
+    0xF7F1,      // brne 1b
+    HALT,
+    [TIMER0_OVF_vect * VECTORSIZE] = 0x2F50, // mov r21,r16
+    0x9518       // reti
+};
+
+// Bytes with and without bit 7, none zero
+static void fill(uint16_t addr, int n, int seed){
+    int i;
+
+    for(i = 0; i < n; i++){
+        DATA[addr + i] = 1 + (seed + i * 37) % 255;
+    }
+}
+
+static void copySetup(int n){
+    fill(SRAMSTART, n, n);
+    setPointer(REGX, SRAMSTART);
+    setPointer(REGZ, SRAMSTART + 0x200);
+    setPointer(24, n);
+}
+
+static void overlapSetup(int n){
+    fill(SRAMSTART, n + 3, n);
+    setPointer(REGX, SRAMSTART);
+    setPointer(REGZ, SRAMSTART + 3);
+    setPointer(24, n);
+}
+
+static void setSetup(int n){
+    R[16] = 0xA5;
+    setPointer(REGZ, SRAMSTART + 0x10);
+    setPointer(24, n);
+}
+
+static void stringSetup(int n){
+    fill(SRAMSTART, n, n);
+    DATA[SRAMSTART + n] = 0;
+    setPointer(REGZ, SRAMSTART);
+}
+
+// The overflows of timer 0 stop the accelerated steps at counts other than 1
+static void countSetup(int n){
+    R[16] = n;
+    setPointer(24, n * 97);
+    writeDATA(TCCR0B, 1);
+}
+
+static void timerSetup(int prescaler){
+    writeDATA(TCCR0B, prescaler);
+}
+
+static void pendingSetup(int n){
+    R[16] = n;
+    DATA[TIFR0] = 1 << TOV0;
+    writeDATA(TIMSK0, 1 << TOV0);
+}
+
+static const int sizes[] = {1, 2, 3, 7, 100, 255, 256, 300};
+
+static void blocks(){
+    unsigned i;
+
+    for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+        compare(memcpyLoop, WORDS(memcpyLoop), copySetup, sizes[i], "memcpy");
+        compare(memcpyLoop, WORDS(memcpyLoop), overlapSetup, sizes[i], "overlapping memcpy");
+        compare(memsetLoop, WORDS(memsetLoop), setSetup, sizes[i], "memset");
+        compare(strlenLoop, WORDS(strlenLoop), stringSetup, sizes[i], "strlen");
+    }
+}
+
+static void countDowns(){
+    int n;
+
+    // Every count of dec, 0 counting 256 times, so that the steps stop on each value
+    for(n = 1; n <= 256; n++){
+        compare(decLoop, WORDS(decLoop), countSetup, n, "dec");
+    }
+    for(n = 1; n <= 300; n += 13){
+        compare(sbiwLoop, WORDS(sbiwLoop), countSetup, n, "sbiw");
+    }
+}
+
+static void polls(){
+    int prescaler;
+
+    for(prescaler = 1; prescaler <= 5; prescaler++){
+        compare(sbisPoll, WORDS(sbisPoll), timerSetup, prescaler, "sbis");
+        compare(inPoll, WORDS(inPoll), timerSetup, prescaler, "in/sbrs");
+        compare(ldsPoll, WORDS(ldsPoll), timerSetup, prescaler, "lds/sbrs");
+    }
+}
+
+static void pending(){
+    int n;
+
+    for(n = 3; n <= 300; n += 37){
+        compare(pendingLoop, WORDS(pendingLoop), pendingSetup, n, "interrupt pending at sei");
+    }
+}
+
+int main(){
+    blocks();
+    countDowns();
+    polls();
+    pending();
+    return done();
+}
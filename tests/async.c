@@ -0,0 +1,195 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../async.h"
+#include "../queue.h"
+#include "../scheduler.h"
+#include <unistd.h>
+
+/* Channels to models on threads of their own. An echo model answers each byte after a
+latency: the answers must reach the MCU at the same cycles however slow the model is. A
+model playing a recording posts ahead on two channels at once: bytes of the same cycle come
+in the order the channels were opened. Closing drops what was not delivered. */
+
+#define LATENCY 500
+#define CYCLESRUN 20000
+
+// A loop that is not accelerated, so the MCU goes through every cycle
+static const char *program =
+    "1:  inc r16\n"
+    "    rjmp 1b\n";
+
+struct delivery{
+    uint64_t cycle;
+    int port;
+    uint8_t data;
+};
+
+static struct delivery deliveries[64];
+static int ndeliveries;
+
+static void received(int port, uint8_t data){
+    if(ndeliveries < 64){
+        deliveries[ndeliveries].cycle = CYCLES;
+        deliveries[ndeliveries].port = port;
+        deliveries[ndeliveries].data = data;
+        ndeliveries++;
+    }
+}
+
+static int modelDelay;      // us the echo model takes over each byte
+
+static void echo(struct channel *channel){
+    struct message m;
+    uint64_t cycle;
+
+    while((cycle = asyncWait(channel)) != NEVER){
+        while(asyncReceive(channel, &m)){
+            if(modelDelay){
+                usleep(modelDelay);
+            }
+            asyncPost(channel, m.cycle + LATENCY, m.port, m.data + 1);
+        }
+        asyncAdvance(channel, cycle + LATENCY);
+    }
+}
+
+// Posts all its bytes at the start and promises there are no others
+static void recording(struct channel *channel){
+    asyncPost(channel, 2000, 1, 0x10);
+    asyncPost(channel, 3000, 2, 0x20);
+    asyncPost(channel, 1000000, 3, 0x30);
+    asyncAdvance(channel, NEVER);
+    while(asyncWait(channel) != NEVER){
+    }
+}
+
+static void runTo(uint64_t cycle){
+    while(CYCLES < cycle){
+        step();
+    }
+}
+
+// Sends of the echo run: cycle and byte; two at the same cycle
+static const uint64_t sendCycles[] = {100, 250, 1000, 1000, 5000, 5200};
+
+/* The echo run, its deliveries in out */
+static void echoRun(int delay, struct delivery *out, uint64_t *sent){
+    struct channel *channel;
+    int i;
+
+    load(program);
+    ndeliveries = 0;
+    modelDelay = delay;
+    channel = asyncOpen(echo, received);
+    for(i = 0; i < WORDS(sendCycles); i++){
+        runTo(sendCycles[i]);
+        sent[i] = CYCLES;
+        asyncSend(channel, i, 0x40 + i);
+    }
+    runTo(CYCLESRUN);
+    asyncClose(channel);
+    memcpy(out, deliveries, sizeof(deliveries));
+}
+
+static void echoes(){
+    struct delivery fast[64], slow[64];
+    uint64_t sent[WORDS(sendCycles)], sentSlow[WORDS(sendCycles)];
+    int i, n;
+
+    echoRun(0, fast, sent);
+    n = ndeliveries;
+    CHECK(n == WORDS(sendCycles), "%d answers", n);
+    for(i = 0; i < n && i < WORDS(sendCycles); i++){
+        CHECK(fast[i].port == i && fast[i].data == 0x41 + i, "answer %d: port %d, %02X", i, fast[i].port, fast[i].data);
+        CHECK(fast[i].cycle >= sent[i] + LATENCY && fast[i].cycle < sent[i] + LATENCY + 3,
+              "answer %d at cycle %llu, sent at %llu", i, (unsigned long long)fast[i].cycle, (unsigned long long)sent[i]);
+    }
+
+    echoRun(2000, slow, sentSlow);
+    CHECK(ndeliveries == n, "%d answers from the slow model, %d from the fast one", ndeliveries, n);
+    for(i = 0; i < n && i < ndeliveries; i++){
+        CHECK(slow[i].cycle == fast[i].cycle && sentSlow[i] == sent[i] && slow[i].data == fast[i].data,
+              "answer %d at cycle %llu from the slow model, %llu from the fast one", i,
+              (unsigned long long)slow[i].cycle, (unsigned long long)fast[i].cycle);
+    }
+}
+
+static void recordings(){
+    struct channel *first, *second;
+    int i;
+
+    load(program);
+    ndeliveries = 0;
+    first = asyncOpen(recording, received);
+    second = asyncOpen(recording, received);
+    runTo(CYCLESRUN);
+
+    CHECK(ndeliveries == 4, "%d bytes from the recordings", ndeliveries);
+    if(ndeliveries == 4){
+        CHECK(deliveries[0].cycle >= 2000 && deliveries[0].cycle < 2003 && deliveries[0].port == 1 &&
+              deliveries[1].cycle == deliveries[0].cycle && deliveries[1].port == 1, "the bytes of cycle 2000");
+        CHECK(deliveries[2].cycle >= 3000 && deliveries[2].port == 2 && deliveries[3].port == 2, "the bytes of cycle 3000");
+    }
+
+    // Injected bytes come at once, as if from the model; none into a closed channel
+    asyncInject(0, 4, 0x50);
+    CHECK(ndeliveries == 5 && deliveries[4].port == 4 && deliveries[4].cycle == CYCLES, "not injected");
+    asyncClose(first);
+    asyncInject(0, 5, 0x60);
+    CHECK(ndeliveries == 5, "injected into a closed channel");
+
+    // Closing the first channel dropped its byte at 1000000; the second one still delivers
+    runTo(1000010);
+    CHECK(ndeliveries == 6 && deliveries[5].port == 3, "%d bytes after closing", ndeliveries);
+    asyncClose(second);
+
+    // Closed channels give their slots back; the recording would now post in the past
+    for(i = 0; i < 2 * MAXCHANNELS; i++){
+        asyncClose(asyncOpen(echo, received));
+    }
+}
+
+/* The queue alone: fills up, keeps the order, and empties */
+static void queue(){
+    static struct queue q;
+    struct message m = {0};
+    uint32_t i;
+    int ok = 1;
+
+    queueInit(&q);
+    CHECK(!queuePeek(&q, &m), "a new queue is not empty");
+    for(i = 0; i < QUEUESIZE; i++){
+        m.cycle = i;
+        ok &= queuePush(&q, m);
+    }
+    CHECK(ok && !queuePush(&q, m), "%d messages do not fill the queue", QUEUESIZE);
+    for(i = 0; i < QUEUESIZE && queuePeek(&q, &m) && m.cycle == i; i++){
+        queuePop(&q);
+    }
+    CHECK(i == QUEUESIZE && !queuePeek(&q, &m), "popped %u in order", i);
+}
+
+int main(){
+    queue();
+    echoes();
+    recordings();
+
+    return done();
+}
@@ -0,0 +1,97 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../checkpoint.h"
+#include "../scheduler.h"
+#include <unistd.h>
+
+/* Checkpoints saved with a timer interrupt pending, restored and run on: the run must go on
+exactly as the one that was not interrupted by the save. */
+
+static const char *program =
+    "    rjmp main\n"
+    ".org %d\n"
+    "    inc r20\n"
+    "    reti\n"
+    "main:\n"
+    "    ldi r16, 1\n"
+    "    out 0x25, r16\n"       // TCCR0B: clock / 1
+    "    sts 0x6E, r16\n"       // TIMSK0: TOIE0
+    "    sei\n"
+    "1:  subi r21, 1\n"
+    "    sbci r22, 0\n"
+    "    push r21\n"
+    "    pop r23\n"
+    "    rjmp 1b\n";
+
+static int marked;
+
+static void marker(uint64_t when){
+    marked = 1;
+}
+
+static void runFor(uint64_t cycles){
+    uint64_t end = CYCLES + cycles;
+
+    while(CYCLES < end){
+        step();
+    }
+}
+
+int main(){
+    struct machine uninterrupted, restored, before;
+    char source[1024], path[64];
+    uint8_t byte;
+    FILE *f;
+
+    snprintf(source, sizeof(source), program, TIMER0_OVF_vect * VECTORSIZE * 2);
+    snprintf(path, sizeof(path), "/tmp/checkpoint-test-%d.ckpt", (int)getpid());
+
+    load(source);
+    runFor(5000);
+    schedule(marker, CYCLES + 100);
+    CHECK(checkpointSave(path), "cannot save %s", path);
+    unschedule(marker);
+    runFor(20000);
+    capture(&uninterrupted);
+    CHECK(uninterrupted.r[20] > 50, "%d interrupts", uninterrupted.r[20]);
+
+    load("rjmp .-2\n");
+    CHECK(checkpointLoad(path), "cannot load %s", path);
+    CHECK(CYCLES < 5100, "restored at cycle %llu", (unsigned long long)CYCLES);
+    runFor(20000);
+    capture(&restored);
+    CHECKSAME(&uninterrupted, &restored, "restored");
+    CHECK(!marked, "the event of a handler not kept by reset() was restored");
+
+    // The build id comes after the counts of the header
+    f = fopen(path, "r+b");
+    fseek(f, 32, SEEK_SET);
+    byte = fgetc(f);
+    fseek(f, 32, SEEK_SET);
+    fputc(byte ^ 1, f);
+    fclose(f);
+    capture(&before);
+    CHECK(!checkpointLoad(path), "a checkpoint of another build was loaded");
+    capture(&restored);
+    CHECKSAME(&before, &restored, "refused");
+
+    unlink(path);
+    return done();
+}
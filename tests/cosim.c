@@ -0,0 +1,230 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+
+/* Two instances on the wires of simCosimConnect(), through the library API. */
+
+// Sends "ABC" on USART0 at 16 cycles a bit, polling UDRE
+static const uint16_t uartSender[] = {
+    0xE008,      // ldi r16,0x08
+    0x9300, 0x00C1, // sts 0xC1,r16: UCSR0B, TXEN0
+    0xE441,      // ldi r20,0x41
+    0x9100, 0x00C0, // 1: lds r16,0xC0
+    0xFF05,      // sbrs r16,5
+    0xCFFC,      // rjmp 1b
+    0x9340, 0x00C6, // sts 0xC6,r20
+    0x9543,      // inc r20
+    0x3444,      // cpi r20,0x44
+    0xF7B9,      // brne 1b
+    HALT
+};
+
+// Keeps the bytes it receives at $200, polling RXC
+static const uint16_t uartReceiver[] = {
+    0xE100,      // ldi r16,0x10
+    0x9300, 0x00C1, // sts 0xC1,r16: UCSR0B, RXEN0
+    0xE0A0,      // ldi r26,0x00
+    0xE0B2,      // ldi r27,0x02
+    0x9100, 0x00C0, // 1: lds r16,0xC0
+    0xFF07,      // sbrs r16,7
+    0xCFFC,      // rjmp 1b
+    0x9110, 0x00C6, // lds r17,0xC6
+    0x931D,      // st X+,r17
+    0xCFF8       // rjmp 1b
+};
+
+// Sends $11, $22 and $33, selecting the wire with PB1, and keeps what comes back at $200
+static const char *spiMaster =
+    "    ldi r16, 0x06\n"
+    "    out 0x04, r16\n"           // DDRB: PB1 and SS outputs at 0
+    "    ldi r16, 0x50\n"
+    "    out 0x2C, r16\n"           // SPCR: SPE, MSTR
+    "    ldi r26, 0x00\n"
+    "    ldi r27, 0x02\n"
+    "    ldi r20, 0x11\n"
+    "1:  out 0x2E, r20\n"
+    "2:  in r16, 0x2D\n"
+    "    sbrs r16, 7\n"
+    "    rjmp 2b\n"
+    "    in r17, 0x2E\n"
+    "    st X+, r17\n"
+    "    ldi r18, 100\n"            // Leaves time for the answer to come back
+    "3:  dec r18\n"
+    "    brne 3b\n"
+    "    subi r20, -0x11\n"
+    "    cpi r20, 0x44\n"
+    "    brne 1b\n"
+    "    rjmp .-2\n";
+
+// Keeps the bytes it gets at $200 and answers each with the byte plus one, $A5 first
+static const char *spiSlave =
+    "    ldi r16, 0x40\n"
+    "    out 0x2C, r16\n"           // SPCR: SPE
+    "    ldi r16, 0xA5\n"
+    "    out 0x2E, r16\n"
+    "    ldi r26, 0x00\n"
+    "    ldi r27, 0x02\n"
+    "1:  in r16, 0x2D\n"
+    "    sbrs r16, 7\n"
+    "    rjmp 1b\n"
+    "    in r17, 0x2E\n"
+    "    st X+, r17\n"
+    "    inc r17\n"
+    "    out 0x2E, r17\n"
+    "    rjmp 1b\n";
+
+// Writes $DE, $AD to address $20
+static const char *twiMaster =
+    "    ldi r16, 0xA4\n"           // START
+    "    rcall 1f\n"
+    "    ldi r16, 0x40\n"
+    "    rcall 2f\n"
+    "    ldi r16, 0xDE\n"
+    "    rcall 2f\n"
+    "    ldi r16, 0xAD\n"
+    "    rcall 2f\n"
+    "    ldi r16, 0x94\n"           // STOP
+    "    sts 0xBC, r16\n"
+    "    rjmp .-2\n"
+    "2:  sts 0xBB, r16\n"
+    "    ldi r16, 0x84\n"
+    "1:  sts 0xBC, r16\n"
+    "3:  lds r16, 0xBC\n"
+    "    sbrs r16, 7\n"
+    "    rjmp 3b\n"
+    "    ret\n";
+
+// Answers at address $20 and keeps the bytes written to it at $200
+static const char *twiSlave =
+    "    ldi r16, 0x40\n"
+    "    sts 0xBA, r16\n"           // TWAR
+    "    ldi r26, 0x00\n"
+    "    ldi r27, 0x02\n"
+    "    ldi r16, 0xC4\n"           // TWINT, TWEA, TWEN
+    "    sts 0xBC, r16\n"
+    "1:  lds r16, 0xBC\n"
+    "    sbrs r16, 7\n"
+    "    rjmp 1b\n"
+    "    lds r17, 0xB9\n"
+    "    andi r17, 0xF8\n"
+    "    cpi r17, 0x80\n"
+    "    brne 2f\n"
+    "    lds r18, 0xBB\n"
+    "    st X+, r18\n"
+    "2:  ldi r16, 0xC4\n"
+    "    sts 0xBC, r16\n"
+    "    rjmp 1b\n";
+
+static void uart(){
+    simulador *sims[2];
+    uint8_t received[4];
+
+    sims[0] = created(uartSender, WORDS(uartSender));
+    sims[1] = created(uartReceiver, WORDS(uartReceiver));
+    simCosimInit(2, 100);
+    CHECK(simCosimConnect(0, 1, SIM_PORT_UART, 100), "no wire");
+    CHECK(simCosimConnect(1, 0, SIM_PORT_UART, 100), "no wire");
+    simCosimUart(sims[0]);
+    simCosimUart(sims[1]);
+
+    // Frames of 160 cycles from about cycle 8, the last one arriving 100 cycles after its end
+    CHECK(simCosimRun(sims, 550) == SIM_DONE, "an instance failed");
+    simReadData(sims[1], 0x200, received, 3);
+    CHECK(received[0] == 'A' && received[1] == 'B' && received[2] == 0, "by cycle 550: %02X %02X %02X",
+          received[0], received[1], received[2]);
+    CHECK(simCosimRun(sims, 1000) == SIM_DONE, "an instance failed");
+    simReadData(sims[1], 0x200, received, 4);
+    CHECK(received[0] == 'A' && received[1] == 'B' && received[2] == 'C' && received[3] == 0,
+          "received %02X %02X %02X %02X", received[0], received[1], received[2], received[3]);
+
+    simDestroy(sims[0]);
+    simDestroy(sims[1]);
+}
+
+static void spi(){
+    simulador *sims[2];
+    uint8_t master[3], slave[3];
+
+    sims[0] = assembled(spiMaster);
+    sims[1] = assembled(spiSlave);
+    simCosimInit(2, 10);
+    CHECK(simCosimConnect(0, 1, SIM_PORT_SPI, 10), "no wire");
+    CHECK(simCosimConnect(1, 0, SIM_PORT_SPI, 10), "no wire");
+    CHECK(simCosimSpiMaster(sims[0], 0, 1), "the bus is full");
+    simCosimSpiSlave(sims[1]);
+
+    CHECK(simCosimRun(sims, 5000) == SIM_DONE, "an instance failed");
+    CHECK(simCycles(sims[0]) >= 5000 && simCycles(sims[1]) >= 5000, "cycles %llu %llu",
+        (unsigned long long)simCycles(sims[0]), (unsigned long long)simCycles(sims[1]));
+
+    simReadData(sims[1], 0x200, slave, 3);
+    CHECK(slave[0] == 0x11 && slave[1] == 0x22 && slave[2] == 0x33, "slave got %02X %02X %02X", slave[0], slave[1], slave[2]);
+    simReadData(sims[0], 0x200, master, 3);
+    CHECK(master[0] == 0xFF && master[1] == 0xA5 && master[2] == 0x12, "master got %02X %02X %02X", master[0], master[1], master[2]);
+
+    simDestroy(sims[0]);
+    simDestroy(sims[1]);
+}
+
+static void twi(){
+    simulador *sims[2];
+    uint8_t slave[2];
+
+    sims[0] = assembled(twiMaster);
+    sims[1] = assembled(twiSlave);
+    simCosimInit(2, 100);
+    CHECK(simCosimConnect(0, 1, SIM_PORT_TWI, 100), "no wire");
+    CHECK(simCosimTwiMaster(sims[0], 0x20), "the bus is full");
+    simCosimTwiSlave(sims[1]);
+
+    // In two runs: what is on its way at the end of the first goes on in the second
+    CHECK(simCosimRun(sims, 1000) == SIM_DONE, "an instance failed");
+    CHECK(simCosimRun(sims, 9000) == SIM_DONE, "an instance failed");
+
+    simReadData(sims[1], 0x200, slave, 2);
+    CHECK(slave[0] == 0xDE && slave[1] == 0xAD, "slave got %02X %02X", slave[0], slave[1]);
+
+    simDestroy(sims[0]);
+    simDestroy(sims[1]);
+}
+
+// An instance on an invalid opcode stays there while the others go on
+static void invalid(){
+    simulador *sims[2];
+
+    sims[0] = assembled(".word 0xFFFF\n");
+    sims[1] = assembled("rjmp .-2\n");
+    simCosimInit(2, 100);
+
+    CHECK(simCosimRun(sims, 1000) == SIM_INVALID, "the invalid opcode was not reported");
+    CHECK(simCycles(sims[0]) < 100, "the invalid opcode ran for %llu cycles", (unsigned long long)simCycles(sims[0]));
+    CHECK(simCycles(sims[1]) >= 1000, "the other instance stopped at %llu", (unsigned long long)simCycles(sims[1]));
+
+    simDestroy(sims[0]);
+    simDestroy(sims[1]);
+}
+
+int main(){
+    CHECK(simVersion() == SIMULADOR_API_VERSION, "version %d", simVersion());
+    uart();
+    spi();
+    twi();
+    invalid();
+    return done();
+}
@@ -0,0 +1,92 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../fuzz.h"
+
+/* A parser with one input per outcome of fuzzRun(): the first byte picks an invalid opcode
+of each of the decoder groups, a jump to the reset vector, a stack out of SRAM, an endless
+loop or the exit. */
+
+#define BUFFER 0x300
+
+static const char *parser =
+    "    ldi r17, 1\n"
+    "    rjmp entry\n"
+    ".org 0x40\n"
+    "entry:\n"
+    "    lds r16, 0x300\n"
+    "    cpi r16, 'A'\n"
+    "    breq 1f\n"
+    "    cpi r16, 'B'\n"
+    "    breq 2f\n"
+    "    cpi r16, 'C'\n"
+    "    breq 3f\n"
+    "    cpi r16, 'D'\n"
+    "    breq 4f\n"
+    "    cpi r16, 'E'\n"
+    "    breq 5f\n"
+    "    cpi r16, 'F'\n"
+    "    breq 6f\n"
+    "    rjmp exit\n"
+    "1:  .word 0x9204\n"          // ST into the LPM slot
+    "2:  .word 0x9404\n"          // one operand group
+    "3:  .word 0xFFFF\n"
+    "4:  clr r30\n"
+    "    clr r31\n"
+    "    ijmp\n"
+    "5:  out 0x3e, r1\n"
+    "    out 0x3d, r1\n"
+    "    push r1\n"
+    "6:  rjmp 6b\n"
+    ".org 0x100\n"
+    "exit:\n"
+    "    rjmp .-2\n";
+
+static int outcome(char first){
+    uint8_t input[2] = {first, 0};
+
+    return fuzzRun(input, sizeof(input));
+}
+
+int main(){
+    struct fuzzTarget target = {0x20, 0x80, BUFFER, 16, 0, 0, 10000};
+    static const char *crashing = "ABCDE";
+    int i, edges;
+
+    load(parser);
+    CHECK(fuzzBoot(&target, 1000), "the entry point was not reached");
+    CHECK(R[17] == 1, "the boot code did not run");
+
+    CHECK(outcome('Z') == FUZZ_OK, "a good input did not reach the exit");
+    for(i = 0; crashing[i]; i++){
+        CHECK(outcome(crashing[i]) == FUZZ_CRASH, "input %c did not crash", crashing[i]);
+    }
+    CHECK(outcome('F') == FUZZ_TIMEOUT, "the endless loop did not time out");
+    CHECK(outcome('Z') == FUZZ_OK, "the snapshot did not undo the crashes");
+
+    for(edges = i = 0; i < FUZZMAPSIZE; i++){
+        edges += FUZZMAP[i] != 0;
+    }
+    CHECK(edges > 10, "%d edges", edges);
+
+    load(".word 0x9204\n rjmp .-2\n");
+    CHECK(!fuzzBoot(&target, 1000), "an invalid opcode during the boot was not seen");
+
+    return done();
+}
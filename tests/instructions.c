@@ -0,0 +1,278 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+
+/* The instructions of the decoder, one small program each, checked against the results
+and flags of the instruction set manual. */
+
+#define C 0x01
+#define Z 0x02
+#define N 0x04
+#define V 0x08
+#define S 0x10
+#define H 0x20
+
+static int invalids;
+static uint16_t lastInvalid;
+
+static void countInvalid(uint16_t opcode){
+    invalids++;
+    lastInvalid = opcode;
+    PC++;
+}
+
+static void logic(){
+    LOAD(0xE00F,       // ldi r16,0x0F
+         0xEF10,       // ldi r17,0xF0
+         0x2B01,       // or r16,r17
+         HALT);
+    CHECK(runToHalt(100), "or did not halt");
+    CHECK(R[16] == 0xFF, "or: %02X", R[16]);
+    CHECK((getSREG() & (N | V | S | Z)) == (N | S), "or: SREG %02X", getSREG());
+
+    LOAD(0xE30C,       // ldi r16,0x3C
+         0x9502,       // swap r16
+         HALT);
+    CHECK(runToHalt(100), "swap did not halt");
+    CHECK(R[16] == 0xC3, "swap: %02X", R[16]);
+}
+
+static void arithmetic(){
+    LOAD(0xE00F,       // ldi r16,0x0F
+         0xEF10,       // ldi r17,0xF0
+         0x9408,       // sec
+         0x1F01,       // adc r16,r17
+         HALT);
+    CHECK(runToHalt(100), "adc did not halt");
+    CHECK(R[16] == 0x00, "adc: %02X", R[16]);
+    CHECK((getSREG() & (C | Z | N | V | S | H)) == (C | Z | H), "adc: SREG %02X", getSREG());
+
+    LOAD(0xE70F,       // ldi r16,0x7F
+         0xE011,       // ldi r17,1
+         0x0F01,       // add r16,r17
+         HALT);
+    CHECK(runToHalt(100), "add did not halt");
+    CHECK((getSREG() & (C | Z | N | V | S | H)) == (N | V | H), "add: SREG %02X", getSREG());
+
+    LOAD(0xE001,       // ldi r16,1
+         0x3002,       // cpi r16,2
+         HALT);
+    CHECK(runToHalt(100), "cpi did not halt");
+    CHECK((getSREG() & (C | Z | N | V | S | H)) == (C | N | S | H), "cpi: SREG %02X", getSREG());
+
+    LOAD(0xE800,       // ldi r16,0x80
+         0xE011,       // ldi r17,1
+         0x1701,       // cp r16,r17
+         HALT);
+    CHECK(runToHalt(100), "cp did not halt");
+    CHECK((getSREG() & (C | Z | N | V | S | H)) == (V | S | H), "cp: SREG %02X", getSREG());
+
+    // 0x0102 - 0x0101: the high bytes are equal, but the low ones are not
+    LOAD(0xE002,       // ldi r16,0x02
+         0xE011,       // ldi r17,0x01
+         0xE021,       // ldi r18,0x01
+         0xE031,       // ldi r19,0x01
+         0x1702,       // cp r16,r18
+         0x0713,       // cpc r17,r19
+         HALT);
+    CHECK(runToHalt(100), "cpc did not halt");
+    CHECK((getSREG() & (C | Z)) == 0, "cpc: SREG %02X", getSREG());
+
+    LOAD(0xE50A,       // ldi r16,0x5A
+         0x9500,       // com r16
+         HALT);
+    CHECK(runToHalt(100), "com did not halt");
+    CHECK(R[16] == 0xA5, "com: %02X", R[16]);
+    CHECK((getSREG() & (C | Z | N | V | S)) == (C | N | S), "com: SREG %02X", getSREG());
+
+    LOAD(0xE800,       // ldi r16,0x80
+         0x9501,       // neg r16
+         HALT);
+    CHECK(runToHalt(100), "neg did not halt");
+    CHECK(R[16] == 0x80, "neg: %02X", R[16]);
+    CHECK((getSREG() & (C | Z | N | V | S)) == (C | N | V), "neg: SREG %02X", getSREG());
+
+    LOAD(0xE70F,       // ldi r16,0x7F
+         0x9503,       // inc r16
+         HALT);
+    CHECK(runToHalt(100), "inc did not halt");
+    CHECK((getSREG() & (Z | N | V | S)) == (N | V), "inc: SREG %02X", getSREG());
+
+    LOAD(0xE001,       // ldi r16,0x01
+         0x9506,       // lsr r16
+         HALT);
+    CHECK(runToHalt(100), "lsr did not halt");
+    CHECK((getSREG() & (C | Z | N | V | S)) == (C | Z | V | S), "lsr: SREG %02X", getSREG());
+}
+
+static void shifts(){
+    LOAD(0xE801,       // ldi r16,0x81
+         0x9505,       // asr r16
+         HALT);
+    CHECK(runToHalt(100), "asr did not halt");
+    CHECK(R[16] == 0xC0, "asr: %02X", R[16]);
+    CHECK((getSREG() & (C | Z | N | V | S)) == (C | N | S), "asr: SREG %02X", getSREG());
+
+    LOAD(0xE002,       // ldi r16,0x02
+         0x9408,       // sec
+         0x9507,       // ror r16
+         HALT);
+    CHECK(runToHalt(100), "ror did not halt");
+    CHECK(R[16] == 0x81, "ror: %02X", R[16]);
+    CHECK((getSREG() & (C | Z | N | V | S)) == (N | V), "ror: SREG %02X", getSREG());
+}
+
+static void multiply(){
+    LOAD(0xEC08,       // ldi r16,200
+         0xE614,       // ldi r17,100
+         0x9F01,       // mul r16,r17
+         HALT);
+    CHECK(runToHalt(100), "mul did not halt");
+    CHECK(R[1] == 0x4E && R[0] == 0x20, "mul: %02X%02X", R[1], R[0]);
+    CHECK((getSREG() & (C | Z)) == 0, "mul: SREG %02X", getSREG());
+    CHECK(CYCLES == 4, "mul: %llu cycles", (unsigned long long)CYCLES);
+
+    LOAD(0xEF0E,       // ldi r16,-2
+         0xE013,       // ldi r17,3
+         0x0201,       // muls r16,r17
+         HALT);
+    CHECK(runToHalt(100), "muls did not halt");
+    CHECK(R[1] == 0xFF && R[0] == 0xFA, "muls: %02X%02X", R[1], R[0]);
+    CHECK((getSREG() & (C | Z)) == C, "muls: SREG %02X", getSREG());
+
+    LOAD(0xEF0E,       // ldi r16,-2
+         0xEC18,       // ldi r17,200
+         0x0301,       // mulsu r16,r17
+         HALT);
+    CHECK(runToHalt(100), "mulsu did not halt");
+    CHECK(R[1] == 0xFE && R[0] == 0x70, "mulsu: %02X%02X", R[1], R[0]);
+
+    LOAD(0xE000,       // ldi r16,0
+         0xE41D,       // ldi r17,77
+         0x9F01,       // mul r16,r17
+         HALT);
+    CHECK(runToHalt(100), "mul by 0 did not halt");
+    CHECK((getSREG() & (C | Z)) == Z, "mul by 0: SREG %02X", getSREG());
+}
+
+static void stack(){
+    uint16_t sp;
+
+    LOAD(0xE101,       // ldi r16,0x11
+         0xE212,       // ldi r17,0x22
+         0x930F,       // push r16
+         0x931F,       // push r17
+         0x912F,       // pop r18
+         0x913F,       // pop r19
+         HALT);
+    sp = getSP();
+    CHECK(runToHalt(100), "push/pop did not halt");
+    CHECK(R[18] == 0x22 && R[19] == 0x11, "push/pop: %02X %02X", R[18], R[19]);
+    CHECK(getSP() == sp, "push/pop: SP %04X, was %04X", getSP(), sp);
+    CHECK(CYCLES == 10, "push/pop: %llu cycles", (unsigned long long)CYCLES);
+
+    LOAD(0xD001,       // rcall 1f
+         0xCFFF,       // rjmp .-2
+         0xE041,       // 1: ldi r20,1
+         0x9508);      // ret
+    sp = getSP();
+    CHECK(runToHalt(100), "rcall did not halt");
+    CHECK(R[20] == 1, "rcall: the subroutine did not run");
+    CHECK(getSP() == sp, "rcall: SP %04X, was %04X", getSP(), sp);
+    CHECK(CYCLES == (1 + PCBYTES) + 1 + (2 + PCBYTES), "rcall: %llu cycles", (unsigned long long)CYCLES);
+}
+
+static void skips(){
+    LOAD(0xE005,       // ldi r16,5
+         0xE015,       // ldi r17,5
+         0x1301,       // cpse r16,r17
+         0xE041,       // ldi r20,1
+         HALT);
+    CHECK(runToHalt(100), "cpse did not halt");
+    CHECK(R[20] == 0, "cpse: equal registers did not skip");
+    CHECK(CYCLES == 4, "cpse: %llu cycles", (unsigned long long)CYCLES);
+
+    LOAD(0xE005,       // ldi r16,5
+         0xE015,       // ldi r17,5
+         0x1301,       // cpse r16,r17
+         0x9300, 0x0100, // sts 0x100,r16
+         HALT);
+    CHECK(runToHalt(100), "cpse over sts did not halt");
+    CHECK(DATA[0x100] == 0, "cpse: did not skip sts");
+    CHECK(CYCLES == 5, "cpse over sts: %llu cycles", (unsigned long long)CYCLES);
+
+    LOAD(0xE005,       // ldi r16,5
+         0xE016,       // ldi r17,6
+         0x1301,       // cpse r16,r17
+         0xE041,       // ldi r20,1
+         HALT);
+    CHECK(runToHalt(100), "cpse did not halt");
+    CHECK(R[20] == 1, "cpse: different registers skipped");
+}
+
+static void branches(){
+    LOAD(0xE002,       // ldi r16,2
+         0x9498,       // clz
+         0xF401,       // brne .+0
+         HALT);
+    CHECK(runToHalt(100), "brne .+0 did not halt");
+    CHECK(CYCLES == 4, "taken brne .+0: %llu cycles", (unsigned long long)CYCLES);
+
+    LOAD(0xE002,       // ldi r16,2
+         0x9418,       // sez
+         0xF401,       // brne .+0
+         HALT);
+    CHECK(runToHalt(100), "brne .+0 did not halt");
+    CHECK(CYCLES == 3, "not taken brne .+0: %llu cycles", (unsigned long long)CYCLES);
+
+    LOAD(0x9418,       // sez
+         0xF009,       // breq 1f
+         0xE041,       // ldi r20,1
+         HALT);        // 1: rjmp .-2
+    CHECK(runToHalt(100), "breq did not halt");
+    CHECK(R[20] == 0, "breq: did not branch");
+    CHECK(CYCLES == 3, "breq: %llu cycles", (unsigned long long)CYCLES);
+}
+
+static void invalidOpcodes(){
+    LOAD(0x0001,       // .word 0x0001
+         0xE041,       // ldi r20,1
+         HALT);
+    invalids = 0;
+    onInvalidOpcode(countInvalid);
+    CHECK(runToHalt(100), "invalid opcode did not halt");
+    CHECK(invalids == 1 && lastInvalid == 0x0001, "handler: %d calls, %04X", invalids, lastInvalid);
+    CHECK(R[20] == 1, "handler: did not go on after the invalid opcode");
+
+    LOAD(0x0001,       // .word 0x0001
+         HALT);
+    CHECK(onInvalidOpcode(0) == 0, "reset() did not clear the handler");
+}
+
+int main(){
+    logic();
+    arithmetic();
+    shifts();
+    multiply();
+    stack();
+    skips();
+    branches();
+    invalidOpcodes();
+    return done();
+}
@@ -0,0 +1,376 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+
+/* The public API, as a program linked with libsimulador would use it. */
+
+static void invalidOpcodes(){
+    simulador *sim = assembled("ldi r16, 1\n .word 0xFFFF\n ldi r17, 2\n rjmp .-2\n");
+    struct simRegisters registers;
+
+    CHECK(simRun(sim, 1000) == SIM_INVALID, "the invalid opcode did not end simRun()");
+    simGetRegisters(sim, &registers);
+    CHECK(registers.pc == 1, "PC %04X, not on the invalid opcode", registers.pc);
+    CHECK(registers.r[16] == 1 && registers.r[17] == 0, "r16 %d r17 %d", registers.r[16], registers.r[17]);
+    CHECK(simRun(sim, 1000) == SIM_INVALID, "the invalid opcode was run past");
+
+    simReset(sim);
+    CHECK(simRun(sim, 1000) == SIM_INVALID, "reset cleared the handling of invalid opcodes");
+    simDestroy(sim);
+}
+
+static void memories(){
+    simulador *sim = simCreate();
+    static const uint8_t odd[3] = {0x01, 0xE0, 0x5A};
+    uint16_t words[2] = {0x1234, 0x1234};
+    uint8_t bytes[4] = {0x55, 0x55, 0x55, 0x55};
+    uint8_t written[4] = {1, 2, 3, 4};
+
+    CHECK(simLoadBinary(sim, odd, sizeof(odd)), "an odd image was refused");
+    simReadFlash(sim, 0, words, 2);
+    CHECK(words[0] == 0xE001 && words[1] == 0x005A, "odd image: %04X %04X", words[0], words[1]);
+
+    // Blocks are cut at the end of the memory, and nothing is copied past it
+    words[0] = words[1] = 0x1234;
+    simReadFlash(sim, FLASHSIZE - 1, words, 2);
+    CHECK(words[1] == 0x1234, "read past the end of the flash");
+    words[0] = 0x1234;
+    simReadFlash(sim, FLASHSIZE, words, 1);
+    CHECK(words[0] == 0x1234, "read past the end of the flash");
+
+    simWriteEeprom(sim, EEPROMSIZE - 2, written, 4);
+    simReadEeprom(sim, EEPROMSIZE - 2, bytes, 4);
+    CHECK(bytes[0] == 1 && bytes[1] == 2 && bytes[2] == 0x55, "EEPROM end: %02X %02X %02X", bytes[0], bytes[1], bytes[2]);
+    simReadEeprom(sim, EEPROMSIZE, bytes, 4);
+    CHECK(bytes[0] == 1, "read past the end of the EEPROM");
+    simDestroy(sim);
+}
+
+static void pins(){
+    simulador *sim = CREATE(0x9A20,       // sbi 0x04,0
+                            0x9A28,       // sbi 0x05,0
+                            0x9828,       // cbi 0x05,0
+                            0xB106,       // in r16,0x06
+                            0x9300, 0x0200, // sts 0x200,r16
+                            0xCFFC);      // rjmp .-8
+    struct simPinEvent events[16];
+    uint8_t pinc;
+    int n, high = -1, low = -1, i;
+
+    CHECK(simObservePins(sim, 0, 16), "no ring");
+    simReset(sim);
+    simSetPin(sim, 1, 3, 1);
+    simRun(sim, 100);
+    n = simReadPins(sim, events, 16);
+    for(i = 0; i < n; i++){
+        if(events[i].port == 0 && (events[i].pins & 1) && high < 0){
+            high = i;
+        }
+        if(events[i].port == 0 && !(events[i].pins & 1) && high >= 0 && low < 0){
+            low = i;
+        }
+    }
+    CHECK(high >= 0 && low > high && events[low].cycle > events[high].cycle, "PB0 did not go high then low in %d events", n);
+    CHECK(simReadPins(sim, events, 16) == 0, "the events were read twice");
+
+    simReadData(sim, 0x200, &pinc, 1);
+    CHECK(pinc == 0x08, "PINC %02X", pinc);
+    simReleasePin(sim, 1, 3);
+    simRun(sim, 100);
+    simReadData(sim, 0x200, &pinc, 1);
+    CHECK(pinc == 0, "PINC %02X after the release", pinc);
+
+    CHECK(simObservePins(sim, 0, 0), "could not stop");
+    simRun(sim, 100);
+    CHECK(simReadPins(sim, events, 16) == 0, "events without a ring");
+    simDestroy(sim);
+}
+
+// Converts channel 0 against AVCC and keeps the result at $200
+static uint16_t convert(simulador *sim){
+    uint8_t result[2];
+
+    simRun(sim, 10000);
+    simReadData(sim, 0x200, result, 2);
+    return result[0] | result[1] << 8;
+}
+
+static void adc(){
+    simulador *sim = CREATE(0xE400,       // ldi r16,0x40
+                            0x9300, 0x007C, // sts 0x7C,r16: ADMUX, AVCC, channel 0
+                            0xEC07,       // ldi r16,0xC7
+                            0x9300, 0x007A, // sts 0x7A,r16: ADCSRA, ADEN, ADSC, clock / 128
+                            0x9100, 0x007A, // 1: lds r16,0x7A
+                            0xFD06,       // sbrc r16,6
+                            0xCFFC,       // rjmp 1b
+                            0x9100, 0x0078, // lds r16,0x78
+                            0x9110, 0x0079, // lds r17,0x79
+                            0x9300, 0x0200, // sts 0x200,r16
+                            0x9310, 0x0201, // sts 0x201,r17
+                            HALT);
+    const char *path = "/tmp/simulador-test.adc";
+    uint16_t samples[4] = {1250, 1250, 1250, 1250};
+    FILE *f;
+    uint16_t value;
+
+    simAdcSetVoltage(sim, 0, 2500);
+    value = convert(sim);
+    CHECK(value == 512, "2.5V: %d", value);
+
+    simReset(sim);
+    simAdcSetReference(sim, 2500, 5000);
+    value = convert(sim);
+    CHECK(value == 1023, "2.5V against AVCC at 2.5V: %d", value);
+    simAdcSetReference(sim, 5000, 5000);
+
+    f = fopen(path, "wb");
+    fwrite(samples, sizeof(samples), 1, f);
+    fclose(f);
+    simReset(sim);
+    CHECK(simAdcAttach(sim, 0, path, 1000), "the samples were not mapped");
+    value = convert(sim);
+    CHECK(value == 256, "1.25V sample: %d", value);
+    CHECK(!simAdcAttach(sim, 8, path, 1000), "channel 8 was attached");
+    CHECK(!simAdcAttach(sim, 1, "/nonexistent/samples", 1000), "a missing file was attached");
+    remove(path);
+    simDestroy(sim);
+}
+
+static void eepromFile(){
+    const char *path = "/tmp/simulador-test.eeprom";
+    simulador *sim = simCreate();
+    uint8_t bytes[2] = {0x12, 0x34};
+    uint8_t file[EEPROMSIZE];
+    FILE *f;
+
+    remove(path);
+    CHECK(simEepromOpen(sim, path), "the file was not mapped");
+    simReadEeprom(sim, 0, bytes, 1);
+    CHECK(bytes[0] == 0xFF, "a new file is not erased: %02X", bytes[0]);
+    bytes[0] = 0x12;
+    simWriteEeprom(sim, 10, bytes, 2);
+    simDestroy(sim);
+
+    f = fopen(path, "rb");
+    CHECK(f && fread(file, 1, EEPROMSIZE, f) == EEPROMSIZE && file[10] == 0x12 && file[11] == 0x34, "the file does not have the EEPROM");
+    if(f){
+        fclose(f);
+    }
+
+    sim = simCreate();
+    CHECK(simEepromOpen(sim, path), "the file was not mapped again");
+    simReadEeprom(sim, 10, bytes, 2);
+    CHECK(bytes[0] == 0x12 && bytes[1] == 0x34, "reopened: %02X %02X", bytes[0], bytes[1]);
+    CHECK(!simEepromOpen(sim, "/nonexistent/eeprom"), "a file that cannot be created was mapped");
+    simReadEeprom(sim, 10, bytes, 1);
+    CHECK(bytes[0] == 0x12, "a failed open lost the contents");
+    simDestroy(sim);
+    remove(path);
+}
+
+static void stats(){
+    simulador *sim = CREATE(HALT);
+
+    CHECK(simStatsSpeed(sim) == 0, "speed without counters");
+    simRun(sim, 10000000);
+    CHECK(simStats(sim, 0), "no counters");
+    CHECK(simStatsSpeed(sim) < 1, "the cycles before simStats() count: %g", simStatsSpeed(sim));
+    simRun(sim, 1000000);
+    CHECK(simStatsSpeed(sim) > 0, "no speed after a run");
+    simDestroy(sim);
+}
+
+static void coverage(){
+    simulador *sim = CREATE(0xE002,       // ldi r16,2
+                            0x950A,       // dec r16
+                            0xF7F1,       // brne .-4
+                            HALT,
+                            0x0000);      // nop
+    const char *path = "/tmp/simulador-test.coverage";
+
+    simRun(sim, 100);
+    CHECK(simCovered(sim, 0) == SIM_EXECUTED, "ldi: %d", simCovered(sim, 0));
+    CHECK(simCovered(sim, 2) == (SIM_EXECUTED | SIM_TAKEN | SIM_NOT_TAKEN), "brne: %d", simCovered(sim, 2));
+    CHECK(simCovered(sim, 4) == 0, "nop: %d", simCovered(sim, 4));
+
+    CHECK(simCoverageSave(sim, path), "not saved");
+    simCoverageClear(sim);
+    CHECK(simCovered(sim, 0) == 0, "not cleared");
+    CHECK(simCoverageMerge(sim, path), "not merged");
+    CHECK(simCovered(sim, 2) == (SIM_EXECUTED | SIM_TAKEN | SIM_NOT_TAKEN), "merged brne: %d", simCovered(sim, 2));
+    CHECK(!simCoverageMerge(sim, "/nonexistent/coverage"), "a missing file was merged");
+    CHECK(!simCoverageLcov(sim, "/nonexistent/program.elf", "/tmp/simulador-test.info", 0), "lcov without an ELF file");
+    remove(path);
+    simDestroy(sim);
+}
+
+// The last external interrupt of the device, on a rising edge of its pin, counts at $300
+static void externalInterrupts(){
+    static const uint8_t pins[NEXTINT] = EXTINT_PINS;
+    int n = NEXTINT - 1, port = pins[n] >> 3, bit = pins[n] & 7;
+    char source[512];
+    simulador *sim;
+    uint8_t count;
+
+    snprintf(source, sizeof(source),
+        "    rjmp 1f\n"
+        "    .org %d\n"
+        "    inc r17\n"
+        "    sts 0x300, r17\n"
+        "    reti\n"
+        "1:  ldi r16, %d\n"
+        "    out 0x1D, r16\n"          // EIMSK
+        "    ldi r16, %d\n"
+        "    sts %d, r16\n"            // EICRA or EICRB: rising edge
+        "    sei\n"
+        "    rjmp .-2\n",
+        (INT0_vect + n) * VECTORSIZE * 2, 1 << n, 3 << 2 * (n & 3), n < 4 ? 0x69 : 0x6A);
+    sim = assembled(source);
+
+    simSetPin(sim, port, bit, 0);
+    simRun(sim, 100);
+    simSetPin(sim, port, bit, 1);
+    simRun(sim, 100);
+    simSetPin(sim, port, bit, 0);
+    simRun(sim, 100);
+    simSetPin(sim, port, bit, 1);
+    simRun(sim, 100);
+    simReadData(sim, 0x300, &count, 1);
+    CHECK(count == 2, "INT%d ran %d times for two rising edges", n, count);
+    simDestroy(sim);
+}
+
+#if FLASHSIZE > 0x10000
+// PCs past 64K words
+static void widePcs(){
+    simulador *sim = simCreate();
+    uint16_t words[2] = {0x0000, 0xCFFE}, back[2];
+    struct simRegisters registers;
+
+    simWriteFlash(sim, 0x10000, words, 2);
+    simReadFlash(sim, 0x10000, back, 2);
+    CHECK(back[0] == 0x0000 && back[1] == 0xCFFE, "flash at $10000: %04X %04X", back[0], back[1]);
+
+    simGetRegisters(sim, &registers);
+    registers.pc = 0x10000;
+    simSetRegisters(sim, &registers);
+    simSetBreakpoint(sim, 0x10001, 1);
+    CHECK(simRun(sim, 100) == SIM_BREAKPOINT, "the breakpoint at $10001 was not hit");
+    simGetRegisters(sim, &registers);
+    CHECK(registers.pc == 0x10001, "PC %05X", (unsigned)registers.pc);
+    simDestroy(sim);
+}
+#endif
+
+/* Instances sharing a flash image must run as instances with a flash of their own, and a
+write to the flash of one (a copy-on-write page) must be seen by it alone. The loop of the
+program is a delay loop that idioms.c accelerates, so the LOOPKIND of the image runs it. */
+static const char *imageProgram =
+    "    ldi r17, 1\n"
+    "1:  add r16, r17\n"
+    "    ldi r24, %d\n"
+    "2:  dec r24\n"
+    "    brne 2b\n"
+    "    inc r19\n"
+    "    rjmp 1b\n";
+
+static void sameState(simulador *a, simulador *b, const char *what){
+    struct simRegisters ra, rb;
+
+    simGetRegisters(a, &ra);
+    simGetRegisters(b, &rb);
+    CHECK(memcmp(ra.r, rb.r, sizeof(ra.r)) == 0 && ra.sreg == rb.sreg && ra.sp == rb.sp && ra.pc == rb.pc,
+          "%s: r16 %d/%d r19 %d/%d PC %04X/%04X", what, ra.r[16], rb.r[16], ra.r[19], rb.r[19],
+          (unsigned)ra.pc, (unsigned)rb.pc);
+    CHECK(simCycles(a) == simCycles(b), "%s: cycles %llu/%llu", what,
+          (unsigned long long)simCycles(a), (unsigned long long)simCycles(b));
+}
+
+static void images(){
+    char source[512];
+    simulador *own[2], *shared[2], *patched;
+    simImage *image;
+    struct simRegisters first, second;
+    uint16_t word, original, read;
+    int i;
+
+    // Instance i of each kind gets the same runs and writes
+    snprintf(source, sizeof(source), imageProgram, 100);
+    for(i = 0; i < 2; i++){
+        own[i] = assembled(source);
+    }
+    image = simImageCreate(own[0]);
+    CHECK(image != NULL, "no image");
+    for(i = 0; i < 2; i++){
+        shared[i] = simCreate();
+        simImageUse(shared[i], image);
+    }
+    simImageRelease(image);
+
+    for(i = 0; i < 2; i++){
+        CHECK(simRun(shared[i], 100000) == SIM_DONE, "the image did not run");
+        simRun(own[i], 100000);
+        sameState(own[i], shared[i], "shared image");
+    }
+
+    // The delay of another program, written into instances 0
+    snprintf(source, sizeof(source), imageProgram, 50);
+    patched = assembled(source);
+    simReadFlash(patched, 2, &word, 1);
+    simDestroy(patched);
+    simReadFlash(shared[0], 2, &original, 1);
+    CHECK(word != original, "the programs do not differ");
+    simWriteFlash(shared[0], 2, &word, 1);
+    simWriteFlash(own[0], 2, &word, 1);
+    simReadFlash(shared[0], 2, &read, 1);
+    CHECK(read == word, "the write was lost");
+    simReadFlash(shared[1], 2, &read, 1);
+    CHECK(read == original, "the write reached the other instance");
+
+    for(i = 0; i < 2; i++){
+        simRun(shared[i], 100000);
+        simRun(own[i], 100000);
+        sameState(own[i], shared[i], "after the write");
+    }
+    simGetRegisters(shared[0], &first);
+    simGetRegisters(shared[1], &second);
+    CHECK(first.r[19] != second.r[19], "the write changed nothing");
+
+    for(i = 0; i < 2; i++){
+        simDestroy(shared[i]);
+        simDestroy(own[i]);
+    }
+}
+
+int main(){
+    CHECK(simVersion() == SIMULADOR_API_VERSION, "version %d", simVersion());
+    invalidOpcodes();
+    memories();
+    pins();
+    adc();
+    eepromFile();
+    stats();
+    coverage();
+    externalInterrupts();
+    images();
+#if FLASHSIZE > 0x10000
+    widePcs();
+#endif
+    return done();
+}
@@ -0,0 +1,341 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../native.h"
+#include <string.h>
+#include <unistd.h>
+
+/* The host models of native.c, called with random arguments: each call must end in the same
+state whether it runs on the host or is stepped, and must pass verification. The routines are
+the ones the models were written from, so nativeRoutine() would refuse them if the assembler
+or the models' copies differed. */
+
+#define CASES 300
+
+// One "call routine; rjmp .-2" per routine, from byte STUBS on, and the routines from byte ROUTINES
+#define STUBS 0x40
+#define ROUTINES 0x100
+
+static const char *program =
+    ".org 0x40\n"
+    "    call udivmodqi4\n"
+    "    rjmp .-2\n"
+    "    call udivmodhi4\n"
+    "    rjmp .-2\n"
+    "    call udivmodsi4\n"
+    "    rjmp .-2\n"
+    "    call umulhisi3\n"
+    "    rjmp .-2\n"
+    "    call memcpy\n"
+    "    rjmp .-2\n"
+    "    call memset\n"
+    "    rjmp .-2\n"
+    "    call strlen\n"
+    "    rjmp .-2\n"
+
+    ".org 0x100\n"
+    "udivmodqi4:\n"
+    "    sub r25, r25\n"
+    "    ldi r23, 9\n"
+    "    rjmp .+8\n"
+    "    rol r25\n"
+    "    cp r25, r22\n"
+    "    brcs .+2\n"
+    "    sub r25, r22\n"
+    "    rol r24\n"
+    "    dec r23\n"
+    "    brne .-14\n"
+    "    com r24\n"
+    "    ret\n"
+
+    ".org 0x180\n"
+    "udivmodhi4:\n"
+    "    sub r26, r26\n"
+    "    sub r27, r27\n"
+    "    ldi r21, 17\n"
+    "    rjmp .+14\n"
+    "    rol r26\n"
+    "    rol r27\n"
+    "    cp r26, r22\n"
+    "    cpc r27, r23\n"
+    "    brcs .+4\n"
+    "    sub r26, r22\n"
+    "    sbc r27, r23\n"
+    "    rol r24\n"
+    "    rol r25\n"
+    "    dec r21\n"
+    "    brne .-22\n"
+    "    com r24\n"
+    "    com r25\n"
+    "    movw r22, r24\n"
+    "    movw r24, r26\n"
+    "    ret\n"
+
+    ".org 0x200\n"
+    "udivmodsi4:\n"
+    "    ldi r26, 33\n"
+    "    mov r1, r26\n"
+    "    sub r26, r26\n"
+    "    sub r27, r27\n"
+    "    movw r30, r26\n"
+    "    rjmp .+26\n"
+    "    rol r26\n"
+    "    rol r27\n"
+    "    rol r30\n"
+    "    rol r31\n"
+    "    cp r26, r18\n"
+    "    cpc r27, r19\n"
+    "    cpc r30, r20\n"
+    "    cpc r31, r21\n"
+    "    brcs .+8\n"
+    "    sub r26, r18\n"
+    "    sbc r27, r19\n"
+    "    sbc r30, r20\n"
+    "    sbc r31, r21\n"
+    "    rol r22\n"
+    "    rol r23\n"
+    "    rol r24\n"
+    "    rol r25\n"
+    "    dec r1\n"
+    "    brne .-38\n"
+    "    com r22\n"
+    "    com r23\n"
+    "    com r24\n"
+    "    com r25\n"
+    "    movw r18, r22\n"
+    "    movw r20, r24\n"
+    "    movw r22, r26\n"
+    "    movw r24, r30\n"
+    "    ret\n"
+
+    ".org 0x280\n"
+    "umulhisi3:\n"
+    "    mul r26, r18\n"
+    "    movw r22, r0\n"
+    "    mul r27, r19\n"
+    "    movw r24, r0\n"
+    "    mul r26, r19\n"
+    "    add r23, r0\n"
+    "    adc r24, r1\n"
+    "    clr r1\n"
+    "    adc r25, r1\n"
+    "    mul r27, r18\n"
+    "    add r23, r0\n"
+    "    adc r24, r1\n"
+    "    clr r1\n"
+    "    adc r25, r1\n"
+    "    ret\n"
+
+    ".org 0x300\n"
+    "memcpy:\n"
+    "    movw r30, r22\n"
+    "    movw r26, r24\n"
+    "    rjmp .+4\n"
+    "    ld r0, Z+\n"
+    "    st X+, r0\n"
+    "    subi r20, 1\n"
+    "    sbci r21, 0\n"
+    "    brcc .-10\n"
+    "    ret\n"
+
+    ".org 0x380\n"
+    "memset:\n"
+    "    movw r26, r24\n"
+    "    rjmp .+2\n"
+    "    st X+, r22\n"
+    "    subi r20, 1\n"
+    "    sbci r21, 0\n"
+    "    brcc .-8\n"
+    "    ret\n"
+
+    ".org 0x400\n"
+    "strlen:\n"
+    "    movw r30, r24\n"
+    "    ld r0, Z+\n"
+    "    tst r0\n"
+    "    brne .-6\n"
+    "    com r24\n"
+    "    com r25\n"
+    "    add r24, r30\n"
+    "    adc r25, r31\n"
+    "    ret\n";
+
+static const char *symbols[] = {
+    "__udivmodqi4", "__udivmodhi4", "__udivmodsi4", "__umulhisi3", "memcpy", "memset", "strlen"
+};
+
+#define ROUTINECOUNT (int)(sizeof(symbols) / sizeof(symbols[0]))
+
+static uint32_t seed = 12345;
+
+static uint32_t random32(){
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* Operands that reach the edges more often than uniform ones would: zero, one, all ones */
+static uint32_t operand(){
+    switch(random32() % 8){
+    case 0:
+        return 0;
+    case 1:
+        return 1;
+    case 2:
+        return 0xFFFFFFFF;
+    default:
+        return random32();
+    }
+}
+
+// The arguments of one call: r18..r27, and the SRAM the string routines work on
+struct arguments{
+    uint8_t r[10];
+    uint8_t sram[256];
+};
+
+static void arguments(int routine, struct arguments *a){
+    uint32_t x = operand(), y = operand();
+    uint16_t buffer = SRAMSTART + 0x10;
+    int i;
+
+    for(i = 0; i < 10; i++){
+        a->r[i] = random32();
+    }
+    for(i = 0; i < 256; i++){
+        a->sram[i] = random32() | 1;
+    }
+    switch(routine){
+    case 0:
+        a->r[24 - 18] = x;
+        a->r[22 - 18] = y;
+        break;
+    case 1:
+    case 3:
+        a->r[routine == 1 ? 24 - 18 : 26 - 18] = x;
+        a->r[routine == 1 ? 25 - 18 : 27 - 18] = x >> 8;
+        a->r[routine == 1 ? 22 - 18 : 18 - 18] = y;
+        a->r[routine == 1 ? 23 - 18 : 19 - 18] = y >> 8;
+        break;
+    case 2:
+        for(i = 0; i < 4; i++){
+            a->r[22 - 18 + i] = x >> (8 * i);
+            a->r[i] = y >> (8 * i);
+        }
+        break;
+    case 4:
+    case 5:
+    case 6:
+        // Destination, source and length inside the 256 bytes from buffer
+        x = buffer + random32() % 128;
+        y = buffer + random32() % 128;
+        a->r[24 - 18] = x;
+        a->r[25 - 18] = x >> 8;
+        if(routine == 4){
+            a->r[22 - 18] = y;
+            a->r[23 - 18] = y >> 8;
+        }
+        a->r[20 - 18] = random32() % 128;
+        a->r[21 - 18] = 0;
+        a->sram[x - buffer + random32() % 128] = 0;
+        break;
+    }
+}
+
+/* Calls routine with a, from a freshly loaded program, and returns the calls step() made */
+static uint64_t call(int routine, const struct arguments *a, int mode, struct machine *m){
+    int i;
+
+    load(program);
+    nativeMode(mode);
+    for(i = 0; i < 10; i++){
+        R[18 + i] = a->r[i];
+    }
+    for(i = 0; i < 256; i++){
+        DATA[SRAMSTART + 0x10 + i] = a->sram[i];
+    }
+    PC = (STUBS + 6 * routine) / 2;
+    CHECK(runToHalt(1000000), "%s did not return", symbols[routine]);
+    capture(m);
+
+    return steps;
+}
+
+/* Reads the native, stepped, verified and mismatches columns of routine from the report */
+static int report(const char *path, int routine, unsigned long long counts[5]){
+    char line[256], name[64];
+    unsigned address;
+    int found = 0;
+    FILE *f = fopen(path, "r");
+
+    if(f == NULL){
+        return 0;
+    }
+    while(fgets(line, sizeof(line), f)){
+        if(sscanf(line, "%63s $%x %llu %llu %llu %llu %llu", name, &address, &counts[0], &counts[1],
+                  &counts[2], &counts[3], &counts[4]) == 7 && strcmp(name, symbols[routine]) == 0){
+            found = 1;
+        }
+        CHECK(strstr(line, "DIFFERS") == NULL, "%s", line);
+    }
+    fclose(f);
+
+    return found;
+}
+
+int main(){
+    struct arguments a;
+    struct machine stepped, native, verified;
+    unsigned long long counts[5];
+    char path[64];
+    int routine, i;
+
+    snprintf(path, sizeof(path), "/tmp/native-test-%d.txt", (int)getpid());
+
+    load(program);
+    for(routine = 0; routine < ROUTINECOUNT; routine++){
+        CHECK(nativeRoutine(symbols[routine], (ROUTINES + 0x80 * routine) / 2),
+              "%s is not the routine of its model", symbols[routine]);
+    }
+    CHECK(nativeRoutine("__udivmodqi4", ROUTINES / 2) == 0, "a routine registered twice");
+    CHECK(nativeRoutine("__mulsi3", 0) == 0, "a routine without a model");
+
+    for(routine = 0; routine < ROUTINECOUNT; routine++){
+        for(i = 0; i < CASES; i++){
+            arguments(routine, &a);
+            call(routine, &a, NATIVE_OFF, &stepped);
+            CHECK(call(routine, &a, NATIVE_ON, &native) == 2, "%s was stepped", symbols[routine]);
+            CHECKSAME(&stepped, &native, symbols[routine]);
+            call(routine, &a, NATIVE_VERIFY, &verified);
+            CHECKSAME(&stepped, &verified, symbols[routine]);
+        }
+    }
+
+    CHECK(nativeReport(path), "cannot write %s", path);
+    for(routine = 0; routine < ROUTINECOUNT; routine++){
+        CHECK(report(path, routine, counts), "%s is not in the report", symbols[routine]);
+        CHECK(counts[0] == 2 * CASES, "%s: %llu native calls", symbols[routine], counts[0]);
+        CHECK(counts[2] == CASES, "%s: %llu verified", symbols[routine], counts[2]);
+        CHECK(counts[4] == 0, "%s: %llu mismatches", symbols[routine], counts[4]);
+    }
+    unlink(path);
+
+    return done();
+}
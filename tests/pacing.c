@@ -0,0 +1,108 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../pacing.h"
+#include <time.h>
+
+/* Pacing against the host clock, with bursts of 10ms at 1MHz: bursts on schedule sleep to
+their deadline, a late one runs the next bursts back to back without moving the schedule,
+and a hiccup over the lag limit starts the schedule again. Only lower bounds are checked on
+the clock, which a loaded host can only make longer. */
+
+#define HZ 1000000
+#define BURST 10000
+#define MS 1000000LL
+
+static int64_t now(){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000 * MS + t.tv_nsec;
+}
+
+static void hiccup(int64_t ns){
+    struct timespec t = {ns / (1000 * MS), ns % (1000 * MS)};
+
+    nanosleep(&t, 0);
+}
+
+int main(){
+    struct pacing p;
+    uint64_t cycle = 0;
+    uint64_t sleeps, late;
+    int64_t start, anchor;
+    int i;
+
+    pacingInit(&p, 0, 0);
+    CHECK(p.hz == F_CPU && p.burst == F_CPU / 1000 && p.lagLimit == 100 * MS,
+          "defaults %llu Hz, %llu cycles", (unsigned long long)p.hz, (unsigned long long)p.burst);
+
+    // On schedule: five bursts take 50ms from the anchor
+    pacingInit(&p, HZ, BURST);
+    start = now();
+    pacingStart(&p, cycle);
+    for(i = 0; i < 5; i++){
+        cycle += BURST;
+        pacingWait(&p, cycle);
+    }
+    CHECK(now() - start >= 50 * MS, "5 bursts in %lld ns", (long long)(now() - start));
+    CHECK(p.bursts == 5 && p.sleeps + p.late == 5 && p.sleeps > 0, "%llu bursts, %llu sleeps, %llu late",
+          (unsigned long long)p.bursts, (unsigned long long)p.sleeps, (unsigned long long)p.late);
+    sleeps = p.sleeps;
+    late = p.late;
+
+    // A start later on goes on with the schedule
+    anchor = p.anchorNs;
+    pacingStart(&p, cycle);
+    CHECK(p.anchorNs == anchor && p.anchorCycle == 0, "schedule moved by a start");
+
+    // 25ms late, under the limit: no sleep until caught up, the anchor stays
+    hiccup(35 * MS);
+    cycle += BURST;
+    pacingWait(&p, cycle);
+    CHECK(p.late == late + 1 && p.sleeps == sleeps && p.resyncs == 0, "%llu late, %llu sleeps, %llu resyncs",
+          (unsigned long long)p.late, (unsigned long long)p.sleeps, (unsigned long long)p.resyncs);
+    CHECK(p.lag >= 25 * MS && p.maxLag >= p.lag, "lag %lld ns, max %lld", (long long)p.lag, (long long)p.maxLag);
+    CHECK(p.anchorNs == anchor && p.anchorCycle == 0, "resynced under the limit");
+    for(i = 0; i < 10 && p.sleeps == sleeps; i++){
+        cycle += BURST;
+        pacingWait(&p, cycle);
+    }
+    CHECK(p.sleeps == sleeps + 1 && p.late >= late + 3, "caught up after %llu late bursts",
+          (unsigned long long)(p.late - late));
+    CHECK(now() - start >= (int64_t)cycle * (1000 * MS / HZ), "ahead of the schedule");
+
+    // Over the limit: the schedule starts again from the late burst
+    p.lagLimit = 20 * MS;
+    hiccup(40 * MS);
+    cycle += BURST;
+    pacingWait(&p, cycle);
+    CHECK(p.resyncs == 1 && p.anchorCycle == cycle && p.anchorNs > anchor, "not resynced");
+    start = now();
+    cycle += BURST;
+    pacingWait(&p, cycle);
+    CHECK(now() - start >= 9 * MS && p.lag < 0, "the burst after a resync took %lld ns, lag %lld",
+          (long long)(now() - start), (long long)p.lag);
+
+    // A reset goes back in time: its cycle is due now
+    pacingStart(&p, 0);
+    CHECK(p.anchorCycle == 0 && p.anchorNs >= (uint64_t)start, "not anchored again after a reset");
+
+    return done();
+}
@@ -0,0 +1,181 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* regress.exe run on a manifest of firmware made here, one test per outcome, then again on
+the cache it left, and on a directory. */
+
+// Prints "ok" on GPIOR0 and returns 3; the exit point is byte address 10
+static const char *passing =
+    "    ldi r16, 0x6F\n"
+    "    out 0x1E, r16\n"
+    "    ldi r16, 0x6B\n"
+    "    out 0x1E, r16\n"
+    "    ldi r24, 3\n"
+    "    rjmp .-2\n";
+
+static const char *manifest =
+    "# one test per outcome\n"
+    "pass       pass.bin exit=10 status=3 expect=pass.out\n"
+    "hex        pass.hex exit=0xA expect=pass.out cycles=5000\n"
+    "status     pass.bin exit=10 status=4\n"
+    "output     pass.bin exit=10 expect=other.out\n"
+    "noexit     pass.bin exit=12 cycles=1000\n"
+    "invalid    invalid.bin cycles=1000\n"
+    "missing    missing.bin\n";
+
+static char directory[64];
+
+static void writeFile(const char *name, const void *data, size_t size){
+    char path[128];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    f = fopen(path, "wb");
+    if(f == 0 || fwrite(data, 1, size, f) != size){
+        printf("cannot write %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+}
+
+// The words of source in name.bin and as Intel HEX in name.hex
+static void image(const char *name, const char *source){
+    uint16_t words[64];
+    uint8_t *bytes = (uint8_t *)words;
+    char error[256], path[64], hex[1024];
+    int n = assemble(source, words, 64, error, sizeof(error)), i, length = 0;
+
+    if(n < 0){
+        printf("%s\n", error);
+        exit(1);
+    }
+    snprintf(path, sizeof(path), "%s.bin", name);
+    writeFile(path, words, n * 2);
+
+    for(i = 0; i < n * 2; i += 16){
+        int count = n * 2 - i < 16 ? n * 2 - i : 16, sum = count + (i >> 8) + (i & 0xFF), j;
+
+        length += sprintf(hex + length, ":%02X%04X00", count, i);
+        for(j = 0; j < count; j++){
+            length += sprintf(hex + length, "%02X", bytes[i + j]);
+            sum += bytes[i + j];
+        }
+        length += sprintf(hex + length, "%02X\n", -sum & 0xFF);
+    }
+    length += sprintf(hex + length, ":00000001FF\n");
+    snprintf(path, sizeof(path), "%s.hex", name);
+    writeFile(path, hex, length);
+}
+
+/* Runs regress.exe with arguments; its output in out. Returns its exit status. */
+static int regress(const char *arguments, char *out, size_t size){
+    char command[512];
+    size_t n = 0;
+    FILE *p;
+    int status;
+
+    snprintf(command, sizeof(command), "./regress.exe -n 2 -C %s/cache %s", directory, arguments);
+    p = popen(command, "r");
+    if(p == 0){
+        printf("cannot run %s\n", command);
+        exit(1);
+    }
+    while(n + 1 < size && !feof(p)){
+        n += fread(out + n, 1, size - 1 - n, p);
+    }
+    out[n] = 0;
+    status = pclose(p);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int contains(const char *path, const char *text){
+    char buffer[8192];
+    FILE *f = fopen(path, "r");
+    size_t n = f ? fread(buffer, 1, sizeof(buffer) - 1, f) : 0;
+
+    if(f){
+        fclose(f);
+    }
+    buffer[n] = 0;
+    return strstr(buffer, text) != 0;
+}
+
+#define OUTPUT(text) CHECK(strstr(out, text), "no \"%s\" in:\n%s", text, out)
+
+int main(){
+    char out[4096], arguments[256], path[128];
+    int status;
+
+    snprintf(directory, sizeof(directory), "/tmp/regress-test-%d", (int)getpid());
+    mkdir(directory, 0755);
+    image("pass", passing);
+    image("invalid", ".word 0xFFFF\n");
+    writeFile("pass.out", "ok", 2);
+    writeFile("other.out", "no", 2);
+    writeFile("manifest", manifest, strlen(manifest));
+
+    snprintf(arguments, sizeof(arguments), "-J %s/summary.json -j %s/junit.xml %s/manifest", directory, directory, directory);
+    status = regress(arguments, out, sizeof(out));
+    CHECK(status == 1, "exit status %d with failures", status);
+    OUTPUT("fail status: status 3, expected 4\n");
+    OUTPUT("fail output: output differs (2 bytes, expected 2)\n");
+    OUTPUT("fail noexit: exit not reached\n");
+    OUTPUT("fail invalid: invalid opcode $FFFF at PC $0000\n");
+    OUTPUT("error missing: cannot load the image\n");
+    OUTPUT("7 tests: 2 passed, 4 failed, 1 errors, 0 cached");
+    CHECK(!strstr(out, " pass:") && !strstr(out, " hex:"), "the passing tests are reported:\n%s", out);
+
+    snprintf(path, sizeof(path), "%s/summary.json", directory);
+    CHECK(contains(path, "\"tests\": 7, \"passed\": 2, \"failed\": 4, \"errors\": 1, \"cached\": 0"), "summary.json");
+    CHECK(contains(path, "{\"name\": \"invalid\", \"outcome\": \"fail\", \"cycles\": 1,"), "summary.json: invalid");
+    snprintf(path, sizeof(path), "%s/junit.xml", directory);
+    CHECK(contains(path, "tests=\"7\" failures=\"4\" errors=\"1\""), "junit.xml");
+    CHECK(contains(path, "name=\"noexit\" time="), "junit.xml: noexit");
+    CHECK(contains(path, "<failure message=\"status 3, expected 4\"/>"), "junit.xml: status");
+
+    // Everything but the error comes from the cache, with the same results
+    snprintf(arguments, sizeof(arguments), "%s/manifest", directory);
+    status = regress(arguments, out, sizeof(out));
+    CHECK(status == 1, "exit status %d from the cache", status);
+    OUTPUT("fail status: status 3, expected 4\n");
+    OUTPUT("7 tests: 2 passed, 4 failed, 1 errors, 6 cached");
+
+    // A changed expected output is another key
+    writeFile("other.out", "ok", 2);
+    status = regress(arguments, out, sizeof(out));
+    OUTPUT("7 tests: 3 passed, 3 failed, 1 errors, 5 cached");
+
+    // A directory of passing images, .bin and .hex, with their output
+    snprintf(path, sizeof(path), "%s/directory", directory);
+    mkdir(path, 0755);
+    image("directory/pass", passing);
+    writeFile("directory/pass.out", "ok", 2);
+    status = regress(path, out, sizeof(out));
+    CHECK(status == 0, "exit status %d with no failures", status);
+    OUTPUT("2 tests: 2 passed, 0 failed, 0 errors, 0 cached");
+
+    snprintf(arguments, sizeof(arguments), "rm -rf %s", directory);
+    CHECK(system(arguments) == 0, "cannot remove %s", directory);
+
+    return done();
+}
@@ -0,0 +1,115 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../replay.h"
+#include "../gpio.h"
+#include "../adc.h"
+#include <string.h>
+#include <unistd.h>
+
+/* A run with pins and ADC samples from the host, recorded and replayed from the same reset:
+the replay must end in the same state although the host drives other inputs meanwhile. */
+
+#define CYCLESRUN 200000
+#define INTERVAL 500
+
+// Sums PINB and the free running ADC into registers and logs them in SRAM from 0x100
+static const char *program =
+    "    ldi r16, 0x40\n"
+    "    sts 0x7C, r16\n"       // ADMUX: AVCC, channel 0
+    "    ldi r16, 0xE1\n"
+    "    sts 0x7A, r16\n"       // ADCSRA: ADEN, ADSC, ADATE, clock / 2
+    "    ldi r26, 0x00\n"
+    "    ldi r27, 0x01\n"
+    "1:  in r17, 0x03\n"        // PINB
+    "    add r20, r17\n"
+    "    lds r18, 0x78\n"       // ADCL
+    "    lds r19, 0x79\n"       // ADCH
+    "    add r21, r18\n"
+    "    adc r22, r19\n"
+    "    st X+, r17\n"
+    "    st X+, r18\n"
+    "    andi r27, 0x03\n"
+    "    ori r27, 0x01\n"
+    "    rjmp 1b\n";
+
+static uint32_t seed;
+
+static uint32_t random32(){
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* Runs the program for CYCLESRUN cycles, driving a pin of port B and the voltage of ADC0
+at random every INTERVAL cycles from the inputs of seed s. A replay applies an input before
+the next instruction, so none is given after the last one. */
+static void drive(uint32_t s, struct machine *m){
+    uint64_t next = INTERVAL;
+
+    seed = s;
+    while(CYCLES < CYCLESRUN){
+        step();
+        if(CYCLES >= next && CYCLES < CYCLESRUN){
+            uint32_t r = random32();
+
+            if(r % 5 == 0){
+                releasePin(GPIOB, r >> 8 & 7);
+            }
+            else{
+                setPin(GPIOB, r >> 8 & 7, r >> 11 & 1);
+            }
+            adcSetVoltage(0, r >> 16 & 0x1FFF);
+            next += INTERVAL;
+        }
+    }
+    capture(m);
+}
+
+int main(){
+    struct machine recorded, replayed, other;
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/replay-test-%d.rply", (int)getpid());
+
+    load(program);
+    CHECK(recordStart(path), "cannot record to %s", path);
+    drive(1, &recorded);
+    replayStop();
+
+    load(program);
+    drive(2, &other);
+    CHECK(memcmp(other.data, recorded.data, sizeof(other.data)) != 0 || other.r[20] != recorded.r[20],
+          "the inputs change nothing");
+
+    load(program);
+    CHECK(replayStart(path), "cannot replay %s", path);
+    CHECK(REPLAY == REPLAYING, "not replaying");
+    drive(2, &replayed);
+    CHECKSAME(&recorded, &replayed, "replayed");
+    replayStop();
+
+    load(program);
+    CYCLES = 1;
+    CHECK(replayStart(path) == 0, "replayed from another cycle");
+    unlink(path);
+
+    return done();
+}
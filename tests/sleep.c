@@ -0,0 +1,223 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../timer0.h"
+#include "../usart.h"
+#include "../gpio.h"
+#include "../adc.h"
+
+/* SLEEP in each SMCR mode, with the wake-up sources of the modes: the MCU must wake at the
+cycle the interrupt is requested plus the response and the wake-up time, only in the modes
+the source wakes, and the cycles asleep must be skipped, not stepped. */
+
+#define IDLE 0
+#define ADCNR 1
+#define POWERDOWN 2
+#define POWERSAVE 3
+#define STANDBY 6
+#define EXTSTANDBY 7
+
+// Cycles from the request of an interrupt to the first instruction of its vector, asleep
+#define WAKEUP (2 + PCBYTES + 4)
+#define LIMIT 10000000
+
+static const int modes[] = {IDLE, ADCNR, POWERDOWN, POWERSAVE, STANDBY, EXTSTANDBY};
+static const char *modeNames[] = {"Idle", "ADC Noise Reduction", "Power-down", "Power-save", "", "",
+                                  "Standby", "Extended Standby"};
+
+#define MODES (int)(sizeof(modes) / sizeof(modes[0]))
+
+// Cycle SLEEP put the MCU to sleep at
+static uint64_t slept;
+
+/* Loads a program that sleeps in mode with the interrupts enabled, and a vector table whose
+vectors all return to "rjmp .-2" at once. SE is only set with sleepEnable. */
+static void prepare(int mode, int sleepEnable){
+    uint16_t program[NVECTORS * VECTORSIZE + 5];
+    int main = NVECTORS * VECTORSIZE;
+    uint8_t smcr = mode << 1 | sleepEnable;
+    int i;
+
+    for(i = 0; i < main; i += VECTORSIZE){
+        program[i] = 0x9518;                                        // reti
+        program[i + 1] = 0x0000;
+    }
+    program[0] = 0xC000 | (main - 1);                               // rjmp main
+    program[main] = 0xE000 | (smcr & 0xF0) << 4 | (smcr & 0x0F);    // ldi r16,smcr
+    program[main + 1] = 0xBF03;                                     // out 0x33,r16
+    program[main + 2] = 0x9478;                                     // sei
+    program[main + 3] = 0x9588;                                     // sleep
+    program[main + 4] = HALT;
+    loadWords(program, WORDS(program));
+}
+
+/* Runs to the SLEEP and past it: the cycle the MCU woke at, with PC on vector, or 0 if it
+does not wake within LIMIT cycles. wake() runs as soon as it sleeps. */
+static uint64_t sleepAndWake(int vector, void (*wake)(), const char *what){
+    uint64_t calls = 0;
+    uint64_t woken;
+
+    while(!SLEEPING && CYCLES < LIMIT && FLASH[PC] != HALT){
+        step();
+    }
+    if(!SLEEPING){
+        return 0;
+    }
+
+    slept = CYCLES;
+    if(wake){
+        wake();
+    }
+    while(SLEEPING && CYCLES < slept + LIMIT){
+        if(step() == 0){
+            return 0;
+        }
+        calls++;
+    }
+    if(SLEEPING){
+        return 0;
+    }
+
+    woken = CYCLES;
+    CHECK(PC == vector * VECTORSIZE, "%s: woke to %04X", what, (unsigned)PC);
+    CHECK(calls < 100, "%s: %llu steps asleep", what, (unsigned long long)calls);
+    CHECK(runToHalt(100), "%s: did not return from the interrupt", what);
+    return woken;
+}
+
+// Without SE, SLEEP is a NOP
+static void sleepEnable(){
+    prepare(IDLE, 0);
+    writeDATA(TCCR0B, 1);
+    writeDATA(TIMSK0, 1 << TOV0);
+    CHECK(sleepAndWake(TIMER0_OVF_vect, 0, "no SE") == 0 && FLASH[PC] == HALT && CYCLES < 10,
+          "SLEEP without SE slept");
+}
+
+/* Timer 0 runs from cycle 0 and overflows after 256 ticks of its clock; it only wakes the MCU
+from Idle */
+static void timer(){
+    static const int prescalers[] = {0, 1, 8, 64, 256, 1024};
+    int m, p;
+
+    for(m = 0; m < MODES; m++){
+        for(p = 1; p <= 5; p++){
+            uint64_t woken;
+
+            prepare(modes[m], 1);
+            writeDATA(TCCR0B, p);
+            writeDATA(TIMSK0, 1 << TOV0);
+            woken = sleepAndWake(TIMER0_OVF_vect, 0, modeNames[modes[m]]);
+            if(modes[m] == IDLE){
+                CHECK(woken == 256ULL * prescalers[p] + WAKEUP, "timer 0 / %d: woke at %llu", prescalers[p],
+                      (unsigned long long)woken);
+            }
+            else{
+                CHECK(woken == 0, "%s: timer 0 woke the MCU", modeNames[modes[m]]);
+            }
+        }
+    }
+}
+
+static void receive(){
+    usartReceive(0x55);
+}
+
+// A byte received while asleep: the RX complete interrupt only wakes the MCU from Idle
+static void uart(){
+    int m;
+
+    for(m = 0; m < MODES; m++){
+        uint64_t woken;
+
+        prepare(modes[m], 1);
+        writeDATA(UCSR0B, 1 << RXEN0 | 1 << RXCIE0);
+        woken = sleepAndWake(USART_RX_vect, receive, modeNames[modes[m]]);
+        if(modes[m] == IDLE){
+            CHECK(woken == slept + WAKEUP, "USART RX: slept at %llu, woke at %llu", (unsigned long long)slept,
+                  (unsigned long long)woken);
+        }
+        else{
+            CHECK(woken == 0, "%s: USART RX woke the MCU", modeNames[modes[m]]);
+        }
+    }
+}
+
+static void risePD2(){
+    setPin(GPIOD, 2, 1);
+}
+
+static void risePB0(){
+    setPin(GPIOB, 0, 1);
+}
+
+// A rising edge on INT0 and a pin change on PCINT0 wake the MCU from every mode
+static void pins(){
+    int m;
+
+    for(m = 0; m < MODES; m++){
+        uint64_t woken;
+
+        prepare(modes[m], 1);
+        setPin(GPIOD, 2, 0);
+        writeDATA(EICRA, 0x03);
+        writeDATA(EIMSK, 0x01);
+        woken = sleepAndWake(INT0_vect, risePD2, modeNames[modes[m]]);
+        CHECK(woken == slept + WAKEUP, "%s: INT0 slept at %llu, woke at %llu", modeNames[modes[m]],
+              (unsigned long long)slept, (unsigned long long)woken);
+
+        prepare(modes[m], 1);
+        setPin(GPIOB, 0, 0);
+        writeDATA(PCMSK0, 0x01);
+        writeDATA(PCICR, 0x01);
+        woken = sleepAndWake(PCINT0_vect, risePB0, modeNames[modes[m]]);
+        CHECK(woken == slept + WAKEUP, "%s: PCINT0 slept at %llu, woke at %llu", modeNames[modes[m]],
+              (unsigned long long)slept, (unsigned long long)woken);
+    }
+}
+
+/* A first conversion started at cycle 0 ends after 25 ADC clocks of 4 cycles; it wakes the MCU
+from Idle and ADC Noise Reduction */
+static void adc(){
+    int m;
+
+    for(m = 0; m < MODES; m++){
+        uint64_t woken;
+
+        prepare(modes[m], 1);
+        writeDATA(ADMUX, 0x40);
+        writeDATA(ADCSRA, 1 << ADEN | 1 << ADSC | 1 << ADIE | 0x02);
+        woken = sleepAndWake(ADC_vect, 0, modeNames[modes[m]]);
+        if(modes[m] == IDLE || modes[m] == ADCNR){
+            CHECK(woken == 25 * 4 + WAKEUP, "%s: ADC woke at %llu", modeNames[modes[m]], (unsigned long long)woken);
+        }
+        else{
+            CHECK(woken == 0, "%s: the ADC woke the MCU", modeNames[modes[m]]);
+        }
+    }
+}
+
+int main(){
+    sleepEnable();
+    timer();
+    uart();
+    pins();
+    adc();
+    return done();
+}
@@ -0,0 +1,198 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../spi.h"
+#include "../spiflash.h"
+#include "../gpio.h"
+#include <unistd.h>
+
+/* The commands of the SPI NOR flash, sent straight to the device between selects with the
+time given by CYCLES, and the JEDEC ID read by firmware through the SPI of the MCU. */
+
+#define SIZE 65536
+#define US(us) ((uint64_t)(us) * (F_CPU / 1000000))
+
+// Reads the JEDEC ID into r20-r22 with chip select on PB2 (SS)
+static const char *program =
+    "    ldi r16, 0x2C\n"
+    "    out 0x04, r16\n"       // DDRB: SS, MOSI, SCK
+    "    ldi r16, 0x04\n"
+    "    out 0x05, r16\n"       // PORTB: SS high
+    "    ldi r16, 0x50\n"
+    "    out 0x2C, r16\n"       // SPCR: SPE, MSTR, clock / 4
+    "    cbi 0x05, 2\n"
+    "    ldi r16, 0x9F\n"
+    "    rcall exchange\n"
+    "    rcall exchange\n"
+    "    mov r20, r16\n"
+    "    rcall exchange\n"
+    "    mov r21, r16\n"
+    "    rcall exchange\n"
+    "    mov r22, r16\n"
+    "    sbi 0x05, 2\n"
+    "    rjmp .-2\n"
+    "exchange:\n"
+    "    out 0x2E, r16\n"       // SPDR
+    "1:  in r17, 0x2D\n"        // SPSR
+    "    sbrs r17, 7\n"         // SPIF
+    "    rjmp 1b\n"
+    "    in r16, 0x2E\n"
+    "    ret\n";
+
+static struct spidevice *flash;
+
+/* One command: n bytes out, the answers in in (if not 0), chip select high at the end. */
+static void command(const uint8_t *out, uint8_t *in, int n){
+    int i;
+
+    flash->select(flash, 1);
+    for(i = 0; i < n; i++){
+        uint8_t answer = flash->exchange(flash, out[i]);
+
+        if(in){
+            in[i] = answer;
+        }
+    }
+    flash->select(flash, 0);
+}
+
+#define COMMAND(...) command((const uint8_t[]){__VA_ARGS__}, 0, sizeof((const uint8_t[]){__VA_ARGS__}))
+
+static uint8_t status(){
+    uint8_t in[2];
+
+    command((const uint8_t[]){0x05, 0}, in, 2);
+    return in[1];
+}
+
+/* n bytes from address with command 0x03, or 0x0B and its dummy byte */
+static void readData(uint8_t code, uint32_t address, uint8_t *data, int n){
+    uint8_t out[5 + 16] = {code, address >> 16, address >> 8, address}, in[5 + 16];
+    int skip = code == 0x0B ? 5 : 4;
+
+    command(out, in, skip + n);
+    memcpy(data, in + skip, n);
+}
+
+static uint8_t readByte(uint32_t address){
+    uint8_t data;
+
+    readData(0x03, address, &data, 1);
+    return data;
+}
+
+int main(){
+    uint8_t data[16], in[5];
+    char path[64];
+    uint64_t start;
+    FILE *f;
+    int c;
+
+    snprintf(path, sizeof(path), "/tmp/spiflash-test-%d.bin", (int)getpid());
+    unlink(path);
+    reset();
+    flash = spiFlashOpen(path, SIZE);
+    CHECK(flash, "cannot open %s", path);
+    if(flash == 0){
+        return done();
+    }
+
+    command((const uint8_t[]){0x9F, 0, 0, 0}, in, 4);
+    CHECK(in[1] == 0xEF && in[2] == 0x40 && in[3] == 16, "JEDEC ID %02X %02X %02X", in[1], in[2], in[3]);
+    CHECK(readByte(0x1234) == 0xFF && readByte(SIZE - 1) == 0xFF, "a new flash is not erased");
+    CHECK(status() == 0, "status %02X", status());
+
+    // Without WEL nothing is programmed
+    COMMAND(0x02, 0x00, 0x01, 0x00, 0x12);
+    CHECK(readByte(0x100) == 0xFF && status() == 0, "programmed without WEL");
+
+    // Three bytes from the end of a page wrap to its start; BUSY for 0.4ms, reading 0xFF meanwhile
+    COMMAND(0x06);
+    CHECK(status() == 0x02, "status %02X after write enable", status());
+    COMMAND(0x02, 0x00, 0x01, 0xFE, 0xAA, 0xBB, 0xCC);
+    start = CYCLES;
+    CHECK(status() == 0x01, "status %02X while programming", status());
+    CHECK(readByte(0x1FE) == 0xFF, "read while busy");
+    CYCLES = start + US(400) - 1;
+    CHECK(status() == 0x01, "ready before 0.4ms");
+    CYCLES = start + US(400);
+    CHECK(status() == 0x00, "status %02X after programming", status());
+    CHECK(readByte(0x1FE) == 0xAA && readByte(0x1FF) == 0xBB && readByte(0x100) == 0xCC,
+          "page %02X %02X %02X", readByte(0x1FE), readByte(0x1FF), readByte(0x100));
+    CHECK(readByte(0x200) == 0xFF, "programmed past the page");
+
+    // Programming only clears bits
+    COMMAND(0x06);
+    COMMAND(0x02, 0x00, 0x01, 0xFE, 0x0F);
+    CYCLES += US(400);
+    CHECK(readByte(0x1FE) == 0x0A, "0xAA programmed with 0x0F is %02X", readByte(0x1FE));
+
+    // Reads go on from the address and wrap at the end of the memory; fast read skips a byte
+    readData(0x03, 0x1FE, data, 3);
+    CHECK(data[0] == 0x0A && data[1] == 0xBB && data[2] == 0xFF, "read %02X %02X %02X", data[0], data[1], data[2]);
+    readData(0x0B, 0x1FE, data, 2);
+    CHECK(data[0] == 0x0A && data[1] == 0xBB, "fast read %02X %02X", data[0], data[1]);
+    COMMAND(0x06);
+    COMMAND(0x02, 0x00, 0x00, 0x00, 0x55);
+    CYCLES += US(400);
+    readData(0x03, SIZE - 1, data, 2);
+    CHECK(data[0] == 0xFF && data[1] == 0x55, "read across the end %02X %02X", data[0], data[1]);
+
+    // Write disable
+    COMMAND(0x06);
+    COMMAND(0x04);
+    CHECK(status() == 0, "status %02X after write disable", status());
+
+    // A sector erase erases its 4KB and takes 45ms
+    COMMAND(0x06);
+    COMMAND(0x02, 0x00, 0x10, 0x00, 0x33);
+    CYCLES += US(400);
+    COMMAND(0x06);
+    COMMAND(0x20, 0x00, 0x01, 0x23);
+    start = CYCLES;
+    CHECK(status() == 0x01, "status %02X while erasing", status());
+    COMMAND(0x06);
+    CHECK(status() == 0x01, "write enable taken while busy");
+    CYCLES = start + US(45000);
+    CHECK(readByte(0x1FE) == 0xFF && readByte(0x100) == 0xFF && readByte(0) == 0xFF, "the sector is not erased");
+    CHECK(readByte(0x1000) == 0x33, "erased past the sector");
+
+    // What was programmed is in the file
+    COMMAND(0x06);
+    COMMAND(0x02, 0x00, 0x20, 0x00, 0x42);
+    CYCLES += US(400);
+    spiFlashClose(flash);
+    f = fopen(path, "rb");
+    CHECK(f && fseek(f, 0x2000, SEEK_SET) == 0 && (c = fgetc(f)) == 0x42, "0x42 is not in the file");
+    if(f){
+        fclose(f);
+    }
+
+    // Through the SPI of the MCU
+    flash = spiFlashOpen(path, SIZE);
+    load(program);
+    CHECK(spiAttach(flash, GPIOB, 2), "cannot attach");
+    CHECK(runToHalt(10000), "no halt, PC %04X", (unsigned)PC);
+    CHECK(R[20] == 0xEF && R[21] == 0x40 && R[22] == 16, "JEDEC ID %02X %02X %02X by the MCU", R[20], R[21], R[22]);
+    spiDetach(flash);
+    spiFlashClose(flash);
+    unlink(path);
+
+    return done();
+}
@@ -0,0 +1,130 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+
+/* A boot loader rewriting a page of the application with SPM, after the routines on it ran:
+the decoder must not keep what it derived from the old code. The busy-wait loop (busywait.c)
+of the first routine becomes plain code, which must run as written, and the plain loop of
+the second one becomes a busy-wait loop, which must be skipped. */
+
+#define LIMIT 1000000
+
+static const uint16_t program[BOOTSTART + 36] = {
+    0xD03F,         // rcall .+126: first routine
+    0xD043,         // rcall .+134: second routine
+    0x940C, 0x3800, // jmp 0x7000: the boot loader
+    0xD03B,         // rcall .+118: first routine, rewritten
+    0xD03F,         // rcall .+126: second routine, rewritten
+    HALT,
+
+    // Counts 200 down in r16, then in r16 and r18
+    [64] = 0xEC08,  // ldi r16,200
+    0x950A,         // 1: dec r16
+    0xF7F1,         // brne 1b
+    0x9508,         // ret
+    0x0000,         // nop
+    0xEC08,         // ldi r16,200
+    0x9523,         // 1: inc r18
+    0x950A,         // dec r16
+    0xF7E9,         // brne 1b
+    0x9508,         // ret
+
+    // What the boot loader writes in their place: the loops the other way round
+    [128] = 0xEC08, // ldi r16,200
+    0x9513,         // 1: inc r17
+    0x950A,         // dec r16
+    0xF7E9,         // brne 1b
+    0x9508,         // ret
+    0xEC08,         // ldi r16,200
+    0x950A,         // 1: dec r16
+    0xF7F1,         // brne 1b
+    0x9508,         // ret
+
+    // Erases the page at word 64, fills the page buffer from word 128 and writes it
+    [BOOTSTART] = 0xE8E0, // ldi r30,0x80
+    0xE0F0,         // ldi r31,0x00
+    0xE003,         // ldi r16,0x03
+    0xBF07,         // out 0x37,r16: SPMCSR, PGERS
+    0x95E8,         // spm
+    0xB707,         // 1: in r16,0x37
+    0xFD00,         // sbrc r16,0
+    0xCFFD,         // rjmp 1b
+    0xE0C0,         // ldi r28,0x00
+    0xE0D1,         // ldi r29,0x01
+    0xE420,         // ldi r18,64
+    0x01DF,         // 2: movw r26,r30
+    0x01FE,         // movw r30,r28
+    0x9005,         // lpm r0,Z+
+    0x9015,         // lpm r1,Z+
+    0x01EF,         // movw r28,r30
+    0x01FD,         // movw r30,r26
+    0xE001,         // ldi r16,0x01
+    0xBF07,         // out 0x37,r16: SPMCSR, SELFPRGEN
+    0x95E8,         // spm
+    0x9632,         // adiw r30,2
+    0x952A,         // dec r18
+    0xF7A1,         // brne 2b
+    0xE8E0,         // ldi r30,0x80
+    0xE0F0,         // ldi r31,0x00
+    0xE005,         // ldi r16,0x05
+    0xBF07,         // out 0x37,r16: SPMCSR, PGWRT
+    0x95E8,         // spm
+    0xB707,         // 3: in r16,0x37
+    0xFD00,         // sbrc r16,0
+    0xCFFD,         // rjmp 3b
+    0xE101,         // ldi r16,0x11
+    0xBF07,         // out 0x37,r16: SPMCSR, RWWSRE
+    0x95E8,         // spm
+    0x940C, 0x0004  // jmp 8
+};
+
+// Steps until PC reaches pc, returning the calls to step()
+static uint64_t stepTo(pc_t pc){
+    uint64_t calls = 0;
+
+    while(PC != pc && calls < LIMIT){
+        step();
+        calls++;
+    }
+    return calls;
+}
+
+static void rewrite(){
+    uint64_t calls;
+
+    loadWords(program, WORDS(program));
+    calls = stepTo(1);
+    CHECK(calls < 20, "the busy-wait loop was stepped: %llu steps", (unsigned long long)calls);
+    calls = stepTo(2);
+    CHECK(R[18] == 200 && calls > 600, "the plain loop: r18 %d, %llu steps", R[18], (unsigned long long)calls);
+
+    stepTo(5);
+    CHECK(PC == 5, "the boot loader did not jump back");
+    CHECK(FLASH[65] == 0x9513 && FLASH[70] == 0x950A, "the page was not written: %04X %04X", FLASH[65], FLASH[70]);
+    CHECK(R[16] == 0 && R[17] == 200, "the first routine rewritten: r16 %d, r17 %d", R[16], R[17]);
+
+    calls = stepTo(6);
+    CHECK(PC == 6 && R[16] == 0, "the second routine rewritten: r16 %d", R[16]);
+    CHECK(calls < 20, "the new busy-wait loop was stepped: %llu steps", (unsigned long long)calls);
+}
+
+int main(){
+    rewrite();
+    return done();
+}
@@ -0,0 +1,157 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../sram.h"
+#include <unistd.h>
+
+/* The stack high-water mark of a recursion five calls deep, and the collision of the same
+recursion with a .bss that ends close to RAMEND, its symbols given by an ELF image built
+here with only a symbol table. */
+
+static const char *program =
+    "    ldi r16, 5\n"
+    "    rcall f\n"
+    "    rjmp .-2\n"
+    "f:  push r16\n"
+    "    dec r16\n"
+    "    breq 1f\n"
+    "    rcall f\n"
+    "1:  pop r16\n"
+    "    ret\n";
+
+// Word address of f
+#define F 3
+
+// Bytes each level of the recursion takes on the stack
+#define LEVEL (PCBYTES + 1)
+
+static void put16(uint8_t *p, uint16_t value){
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t value){
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+/* An ELF image in image whose .symtab holds __bss_start and __bss_end, data addresses as
+avr-gcc gives them. Sections: none, .shstrtab, .symtab, .strtab. */
+static struct elf symbols(uint8_t *image, uint16_t bssStart, uint16_t bssEnd){
+    static const char names[] = "\0.shstrtab\0.symtab\0.strtab";
+    static const char strings[] = "\0__bss_start\0__bss_end";
+    uint8_t *sh = image + 52;
+    uint8_t *symtab = sh + 4 * 40;
+    uint8_t *strtab = symtab + 2 * 16;
+    uint8_t *shstrtab = strtab + sizeof(strings);
+    struct elf elf = {image, shstrtab + sizeof(names) - image};
+
+    memset(image, 0, elf.size);
+    memcpy(image, "\177ELF", 4);
+    put32(image + 32, sh - image);
+    put16(image + 46, 40);
+    put16(image + 48, 4);
+    put16(image + 50, 1);
+
+    put32(sh + 40, 1);
+    put32(sh + 40 + 16, shstrtab - image);
+    put32(sh + 40 + 20, sizeof(names));
+    put32(sh + 80, 11);
+    put32(sh + 80 + 16, symtab - image);
+    put32(sh + 80 + 20, 2 * 16);
+    put32(sh + 120, 19);
+    put32(sh + 120 + 16, strtab - image);
+    put32(sh + 120 + 20, sizeof(strings));
+
+    put32(symtab, 1);
+    put32(symtab + 4, 0x800000 + bssStart);
+    put32(symtab + 16, 13);
+    put32(symtab + 16 + 4, 0x800000 + bssEnd);
+    memcpy(strtab, strings, sizeof(strings));
+    memcpy(shstrtab, names, sizeof(names));
+    return elf;
+}
+
+static int collisions;
+static pc_t collisionPC;
+
+static void collided(){
+    collisions++;
+    collisionPC = PC;
+}
+
+/* Loads the program with .bss up to bssEnd and runs it with the maps and marks cleared. */
+static void recurse(uint16_t bssEnd){
+    uint8_t image[512];
+    struct elf elf = symbols(image, SRAMSTART, bssEnd);
+
+    load(program);
+    sramRegions(&elf);
+    sramClear();
+    collisions = 0;
+    onStackCollision(collided);
+    CHECK(runToHalt(1000), "no halt, PC %04X", (unsigned)PC);
+}
+
+int main(){
+    uint16_t lowest = RAMEND - 5 * LEVEL;
+    uint16_t bssEnd = RAMEND - 3 * LEVEL;
+    char path[64], report[4096], line[64];
+    FILE *f;
+    size_t n;
+
+    snprintf(path, sizeof(path), "/tmp/stack-test-%d.txt", (int)getpid());
+
+    recurse(lowest - 8);
+    CHECK(LOWEST.sp == lowest, "lowest SP %04X, not %04X", LOWEST.sp, lowest);
+    CHECK(LOWEST.pc == F, "lowest at PC %04X", (unsigned)LOWEST.pc);
+    CHECK(LOWEST.depth == 5, "lowest at depth %d", LOWEST.depth);
+    CHECK(LOWEST.cycle > 0 && LOWEST.cycle < CYCLES, "lowest at cycle %llu", (unsigned long long)LOWEST.cycle);
+    CHECK(getSP() == RAMEND && DEPTH == 0, "SP %04X, depth %d after the recursion", getSP(), DEPTH);
+    CHECK(COLLISION.cycle == 0 && collisions == 0, "collision at SP %04X", COLLISION.sp);
+    CHECK(MARKED(SRAMWRITTEN, RAMEND) && MARKED(SRAMWRITTEN, lowest + 1), "the stack is not marked written");
+    CHECK(MARKED(SRAMREAD, lowest + 1), "the last push is not marked read");
+    CHECK(!MARKED(SRAMWRITTEN, lowest) && !MARKED(SRAMREAD, lowest), "below the stack is marked");
+
+    // The first new low below bssEnd collides: the return address of the fourth call
+    recurse(bssEnd);
+    CHECK(collisions == 1, "%d collisions", collisions);
+    CHECK(COLLISION.sp + 1 < bssEnd && COLLISION.sp + LEVEL >= bssEnd - 1, "collision at SP %04X", COLLISION.sp);
+    CHECK(COLLISION.depth == 4, "collision at depth %d", COLLISION.depth);
+    CHECK(collisionPC == COLLISION.pc, "handler called at PC %04X, collision at %04X",
+          (unsigned)collisionPC, (unsigned)COLLISION.pc);
+    CHECK(LOWEST.sp == lowest, "lowest SP %04X after the collision", LOWEST.sp);
+
+    CHECK(sramReport(path), "cannot write %s", path);
+    f = fopen(path, "r");
+    n = f ? fread(report, 1, sizeof(report) - 1, f) : 0;
+    report[n] = 0;
+    if(f){
+        fclose(f);
+    }
+    unlink(path);
+    snprintf(line, sizeof(line), "lowest SP $%04X at PC $%04X, depth 5", lowest, F * 2);
+    CHECK(strstr(report, line), "no \"%s\" in the report", line);
+    snprintf(line, sizeof(line), "STACK COLLISION: SP $%04X", COLLISION.sp);
+    CHECK(strstr(report, line), "no \"%s\" in the report", line);
+    snprintf(line, sizeof(line), ".bss   $%04X-$%04X", SRAMSTART, bssEnd - 1);
+    CHECK(strstr(report, line), "no \"%s\" in the report", line);
+
+    return done();
+}
@@ -0,0 +1,167 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef TEST_H
+#define TEST_H
+
+#include "../registers.h"
+#include "../functions.h"
+#include "../decoder.h"
+#include "../flash.h"
+#include "../assembler.h"
+#include "../simulador.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* What the tests share. A program is either a list of flash words, each with the
+instruction it encodes, or source for the in-process assembler (assembler.c), so the tests
+need no AVR toolchain. Every program ends on "rjmp .-2" (HALT), where runToHalt() stops.
+Each test file is one executable (make test) that prints the failed checks and exits with
+their count. The tests of the library (simulador.h) only call its API; the others drive
+the MCU of their thread directly. */
+
+static int failures;
+
+#define CHECK(condition, ...) do{ \
+    if(!(condition)){ \
+        printf("%s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+}while(0)
+
+#define HALT 0xCFFF
+
+// Words of a program given as an array
+#define WORDS(program) (int)(sizeof(program) / sizeof(program[0]))
+
+/* Resets the MCU and loads count words into an erased flash of its own. */
+static void loadWords(const uint16_t *words, int count){
+    reset();
+    privateFlash();
+    memcpy(FLASH, words, count * sizeof(uint16_t));
+    invalidateFlash(0, FLASHSIZE);
+}
+
+// LOAD(0xE001, HALT) loads "ldi r16, 1" and "rjmp .-2"
+#define LOAD(...) loadWords((const uint16_t[]){__VA_ARGS__}, sizeof((const uint16_t[]){__VA_ARGS__}) / sizeof(uint16_t))
+
+/* Resets the MCU and assembles source into an erased flash of its own. */
+static void load(const char *source){
+    char error[256];
+
+    reset();
+    privateFlash();
+    if(assemble(source, FLASH, FLASHSIZE, error, sizeof(error)) < 0){
+        printf("%s\n", error);
+        exit(1);
+    }
+    invalidateFlash(0, FLASHSIZE);
+}
+
+// Calls to step() made by the last runToHalt()
+static uint64_t steps;
+
+/* Steps until PC is on the final "rjmp .-2", or for at most limit cycles. Returns nonzero
+if it got there. */
+static int runToHalt(uint64_t limit){
+    uint64_t end = CYCLES + limit;
+
+    steps = 0;
+    while(FLASH[PC] != HALT){
+        if(CYCLES >= end || step() == 0){
+            return 0;
+        }
+        steps++;
+    }
+    return 1;
+}
+
+/* The state two runs are compared on */
+struct machine{
+    uint8_t r[32];
+    uint8_t sreg;
+    uint16_t sp;
+    pc_t pc;
+    uint64_t cycles;
+    uint8_t data[DATASIZE];
+};
+
+static void capture(struct machine *m){
+    int i;
+
+    for(i = 0; i < 32; i++){
+        m->r[i] = R[i];
+    }
+    m->sreg = getSREG();
+    m->sp = getSP();
+    m->pc = PC;
+    m->cycles = CYCLES;
+    for(i = 0; i < DATASIZE; i++){
+        m->data[i] = DATA[i];
+    }
+}
+
+/* Checks that two runs ended in the same state, naming the first difference. */
+#define CHECKSAME(a, b, what) do{ \
+    int i_; \
+    for(i_ = 0; i_ < 32 && (a)->r[i_] == (b)->r[i_]; i_++); \
+    CHECK(i_ == 32, "%s: r%d %02X/%02X", what, i_, (a)->r[i_ % 32], (b)->r[i_ % 32]); \
+    CHECK((a)->sreg == (b)->sreg, "%s: SREG %02X/%02X", what, (a)->sreg, (b)->sreg); \
+    CHECK((a)->sp == (b)->sp, "%s: SP %04X/%04X", what, (a)->sp, (b)->sp); \
+    CHECK((a)->pc == (b)->pc, "%s: PC %04X/%04X", what, (unsigned)(a)->pc, (unsigned)(b)->pc); \
+    CHECK((a)->cycles == (b)->cycles, "%s: cycles %llu/%llu", what, \
+        (unsigned long long)(a)->cycles, (unsigned long long)(b)->cycles); \
+    for(i_ = 32; i_ < DATASIZE && (a)->data[i_] == (b)->data[i_]; i_++); \
+    CHECK(i_ == DATASIZE, "%s: data %04X %02X/%02X", what, i_, \
+        (a)->data[i_ % DATASIZE], (b)->data[i_ % DATASIZE]); \
+}while(0)
+
+/* A library instance running count words */
+static simulador *created(const uint16_t *words, int count){
+    simulador *sim = simCreate();
+
+    simWriteFlash(sim, 0, words, count);
+    return sim;
+}
+
+// CREATE(0xE001, HALT) is an instance running "ldi r16, 1" and "rjmp .-2"
+#define CREATE(...) created((const uint16_t[]){__VA_ARGS__}, sizeof((const uint16_t[]){__VA_ARGS__}) / sizeof(uint16_t))
+
+/* A library instance running source */
+static simulador *assembled(const char *source){
+    simulador *sim = simCreate();
+    char error[256];
+
+    if(simAssemble(sim, source, error, sizeof(error)) < 0){
+        printf("%s\n", error);
+        exit(1);
+    }
+    return sim;
+}
+
+static int done(){
+    if(failures){
+        printf("%d FAILED\n", failures);
+    }
+    return failures != 0;
+}
+
+#endif
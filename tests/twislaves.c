@@ -0,0 +1,209 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "test.h"
+#include "../twi.h"
+#include "../twislaves.h"
+#include <unistd.h>
+
+/* The EEPROM and the sensor, driven straight through their twidevice calls with the time
+given by CYCLES, and the sensor read by firmware through the TWI of the MCU. */
+
+#define SIZE 32768
+#define WRITECYCLE ((uint64_t)5000 * (F_CPU / 1000000))
+#define SENSOR 0x48
+
+// Reads sensor registers 0x20 and 0x21 into r20 and r21: register pointer, repeated START, two reads
+static const char *program =
+    "    ldi r16, 12\n"
+    "    sts 0xB8, r16\n"       // TWBR
+    "    ldi r16, 0xA4\n"       // TWINT, TWSTA, TWEN
+    "    rcall command\n"
+    "    ldi r16, 0x90\n"       // SLA+W
+    "    sts 0xBB, r16\n"
+    "    ldi r16, 0x84\n"       // TWINT, TWEN
+    "    rcall command\n"
+    "    ldi r16, 0x20\n"
+    "    sts 0xBB, r16\n"
+    "    ldi r16, 0x84\n"
+    "    rcall command\n"
+    "    ldi r16, 0xA4\n"
+    "    rcall command\n"
+    "    ldi r16, 0x91\n"       // SLA+R
+    "    sts 0xBB, r16\n"
+    "    ldi r16, 0x84\n"
+    "    rcall command\n"
+    "    ldi r16, 0xC4\n"       // TWINT, TWEA, TWEN: ACK
+    "    rcall command\n"
+    "    lds r20, 0xBB\n"
+    "    ldi r16, 0x84\n"       // NACK
+    "    rcall command\n"
+    "    lds r21, 0xBB\n"
+    "    ldi r16, 0x94\n"       // TWINT, TWSTO, TWEN
+    "    sts 0xBC, r16\n"
+    "    rjmp .-2\n"
+    "command:\n"
+    "    sts 0xBC, r16\n"       // TWCR
+    "1:  lds r17, 0xBC\n"
+    "    sbrs r17, 7\n"         // TWINT
+    "    rjmp 1b\n"
+    "    ret\n";
+
+/* A write of n bytes, the address first, ended by a STOP. Returns 0 if not acknowledged. */
+static int writeBytes(struct twidevice *device, const uint8_t *data, int n){
+    int i;
+
+    if(!device->start(device, 0)){
+        return 0;
+    }
+    for(i = 0; i < n; i++){
+        device->write(device, data[i]);
+    }
+    device->stop(device);
+    return 1;
+}
+
+#define WRITE(device, ...) writeBytes(device, (const uint8_t[]){__VA_ARGS__}, sizeof((const uint8_t[]){__VA_ARGS__}))
+
+/* A random read: the address written (addressBytes of it), a repeated START, n bytes read */
+static int readBytes(struct twidevice *device, uint32_t address, int addressBytes, uint8_t *data, int n){
+    int i;
+
+    if(!device->start(device, 0)){
+        return 0;
+    }
+    if(addressBytes == 2){
+        device->write(device, address >> 8);
+    }
+    device->write(device, address);
+    device->start(device, 1);
+    for(i = 0; i < n; i++){
+        data[i] = device->read(device);
+    }
+    device->stop(device);
+    return 1;
+}
+
+static void eeprom(const char *path){
+    struct twidevice *e = twiEepromOpen(path, SIZE, 0x50);
+    uint8_t data[8];
+    uint64_t start;
+    FILE *f;
+    int c;
+
+    CHECK(e && e->address == 0x50, "cannot open %s", path);
+    if(e == 0){
+        return;
+    }
+    CHECK(readBytes(e, 0x1234, 2, data, 1) && data[0] == 0xFF, "a new EEPROM is not erased");
+
+    // Six bytes from 4 before the end of a 64 byte page wrap to its start, programmed at the STOP
+    e->start(e, 0);
+    e->write(e, 0x00);
+    e->write(e, 0x7C);
+    e->write(e, 1);
+    e->write(e, 2);
+    e->write(e, 3);
+    e->write(e, 4);
+    e->write(e, 5);
+    e->write(e, 6);
+    e->stop(e);
+    start = CYCLES;
+
+    // Acknowledge polling: no acknowledge for the 5ms of the write cycle
+    CHECK(!e->start(e, 0), "acknowledged during the write cycle");
+    CYCLES = start + WRITECYCLE - 1;
+    CHECK(!e->start(e, 0), "acknowledged before 5ms");
+    CYCLES = start + WRITECYCLE;
+    CHECK(readBytes(e, 0x7C, 2, data, 4), "not acknowledged after 5ms");
+    CHECK(data[0] == 1 && data[1] == 2 && data[2] == 3 && data[3] == 4,
+          "page end %02X %02X %02X %02X", data[0], data[1], data[2], data[3]);
+    CHECK(readBytes(e, 0x40, 2, data, 3) && data[0] == 5 && data[1] == 6 && data[2] == 0xFF,
+          "page start %02X %02X %02X", data[0], data[1], data[2]);
+    CHECK(readBytes(e, 0x80, 2, data, 1) && data[0] == 0xFF, "programmed past the page");
+
+    // The address of a random read is not a write
+    CHECK(readBytes(e, 0x100, 2, data, 1) && e->start(e, 0), "a read started a write cycle");
+    e->stop(e);
+
+    // Reads wrap at the end of the memory
+    WRITE(e, 0x7F, 0xFF, 0x77);
+    CYCLES += WRITECYCLE;
+    WRITE(e, 0x00, 0x00, 0x88);
+    CYCLES += WRITECYCLE;
+    CHECK(readBytes(e, SIZE - 1, 2, data, 2) && data[0] == 0x77 && data[1] == 0x88,
+          "read across the end %02X %02X", data[0], data[1]);
+
+    twiEepromClose(e);
+    f = fopen(path, "rb");
+    CHECK(f && fseek(f, 0x7C, SEEK_SET) == 0 && (c = fgetc(f)) == 1, "the page is not in the file");
+    if(f){
+        fclose(f);
+    }
+    unlink(path);
+
+    // Up to 256 bytes, one address byte and 8 byte pages
+    e = twiEepromOpen(path, 256, 0x51);
+    WRITE(e, 0x06, 0xA1, 0xA2, 0xA3);
+    CYCLES += WRITECYCLE;
+    CHECK(readBytes(e, 0x06, 1, data, 2) && data[0] == 0xA1 && data[1] == 0xA2, "small %02X %02X", data[0], data[1]);
+    CHECK(readBytes(e, 0x00, 1, data, 1) && data[0] == 0xA3, "small page start %02X", data[0]);
+    twiEepromClose(e);
+    unlink(path);
+}
+
+static void sensor(){
+    struct twidevice *s = twiSensorCreate(SENSOR);
+    uint8_t *registers = twiSensorRegisters(s);
+    uint8_t data[3];
+
+    CHECK(s->address == SENSOR && registers[0x20] == 0, "sensor at %02X", s->address);
+
+    // Written by the firmware from the register pointer on, read back and by the host
+    WRITE(s, 0x10, 0x01, 0x02);
+    CHECK(registers[0x10] == 0x01 && registers[0x11] == 0x02, "registers %02X %02X", registers[0x10], registers[0x11]);
+    registers[0x12] = 0x03;
+    CHECK(readBytes(s, 0x10, 1, data, 3) && data[0] == 1 && data[1] == 2 && data[2] == 3,
+          "read %02X %02X %02X", data[0], data[1], data[2]);
+
+    // The pointer wraps at 256
+    WRITE(s, 0xFF, 0x5A, 0xA5);
+    CHECK(registers[0xFF] == 0x5A && registers[0] == 0xA5, "wrap %02X %02X", registers[0xFF], registers[0]);
+
+    // Readings written by the host, read by firmware
+    registers[0x20] = 0x12;
+    registers[0x21] = 0x34;
+    load(program);
+    CHECK(twiAttach(s), "cannot attach");
+    CHECK(runToHalt(100000), "no halt, PC %04X", (unsigned)PC);
+    CHECK(R[20] == 0x12 && R[21] == 0x34, "read by the MCU %02X %02X", R[20], R[21]);
+    twiDetach(s);
+    twiSensorDestroy(s);
+}
+
+int main(){
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/twislaves-test-%d.bin", (int)getpid());
+    unlink(path);
+    reset();
+    eeprom(path);
+    sensor();
+
+    return done();
+}
@@ -0,0 +1,234 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "timer0.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "snapshot.h"
+
+/*
+8-bit Timer/Counter0.
+
+TCNT0 is not incremented every cycle. The timer keeps the count it had at syncCycle and
+computes the current one from the prescaler when it is read. The compare matches and the
+overflow are scheduled as events at the cycle of the timer clock where they happen, and
+only while their flag is clear, so an idle timer costs nothing.
+
+The prescaler is shared and free running: with division p, the timer clock ticks on the
+cycles that are multiples of p.
+
+Normal, CTC and Fast PWM modes are modeled. Phase Correct PWM counts as Normal mode.
+*/
+
+static const uint16_t prescaler[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+static MCUSTATE uint8_t count;
+static MCUSTATE uint64_t syncCycle;
+static MCUSTATE uint64_t due[3];
+
+static int mode(){
+    return ((DATA[TCCR0B] >> 1) & 0x04) | (DATA[TCCR0A] & 0x03);
+}
+
+static int top(){
+    if(mode() == 2 || mode() == 7){
+        return DATA[OCR0A];
+    }
+    return 0xFF;
+}
+
+// Bring count up to cycle now
+static void sync(uint64_t now){
+    uint16_t p = prescaler[DATA[TCCR0B] & 0x07];
+
+    if(p && now > syncCycle){
+        uint64_t ticks = now / p - syncCycle / p;
+        int t = top();
+
+        if(count > t){
+            if(ticks < (uint64_t)(256 - count)){
+                count += ticks;
+                ticks = 0;
+            }
+            else{
+                ticks -= 256 - count;
+                count = 0;
+            }
+        }
+        count = (count + ticks) % (t + 1);
+    }
+
+    syncCycle = now;
+}
+
+// Timer clock ticks until the count becomes v, 0 if it never does
+static uint32_t ticksUntil(int v){
+    int t = top();
+    uint32_t d;
+
+    if(count > t){
+        if(v > count){
+            return v - count;
+        }
+        if(v > t){
+            return 0;
+        }
+        return 256 - count + v;
+    }
+    if(v > t){
+        return 0;
+    }
+
+    d = (v - count + t + 1) % (t + 1);
+    return d ? d : t + 1;
+}
+
+static void timer0Event(uint64_t when);
+
+// Compute when each clear flag gets set and schedule the earliest
+static void reschedule(){
+    uint16_t p = prescaler[DATA[TCCR0B] & 0x07];
+    uint32_t ticks[3];
+    uint64_t next = NEVER;
+    int i;
+
+    if(p){
+        ticks[TOV0] = (mode() == 2 && count <= top() && top() != 0xFF) ? 0 : ticksUntil(0);
+        ticks[OCF0A] = ticksUntil(DATA[OCR0A]);
+        ticks[OCF0B] = ticksUntil(DATA[OCR0B]);
+    }
+
+    for(i = 0; i < 3; i++){
+        due[i] = NEVER;
+        if(p && ticks[i] && !(DATA[TIFR0] & (1 << i))){
+            due[i] = (syncCycle / p + ticks[i]) * p;
+        }
+        if(due[i] < next){
+            next = due[i];
+        }
+    }
+
+    if(next == NEVER){
+        unschedule(timer0Event);
+    }
+    else{
+        schedule(timer0Event, next);
+    }
+}
+
+static void timer0Event(uint64_t when){
+    int i;
+
+    sync(when);
+    for(i = 0; i < 3; i++){
+        if(due[i] == when){
+            DATA[TIFR0] |= 1 << i;
+        }
+    }
+
+    reschedule();
+    updateInterrupts();
+}
+
+static uint8_t readTCNT0(uint16_t addr){
+    sync(CYCLES);
+    return count;
+}
+
+static void writeTCNT0(uint16_t addr, uint8_t value){
+    sync(CYCLES);
+    count = value;
+    reschedule();
+}
+
+// TCCR0A, TCCR0B, OCR0A and OCR0B
+static void writeControl(uint16_t addr, uint8_t value){
+    sync(CYCLES);
+    DATA[addr] = value;
+    reschedule();
+}
+
+// Flags are cleared by writing a logical one to them
+static void writeTIFR0(uint16_t addr, uint8_t value){
+    sync(CYCLES);
+    DATA[TIFR0] &= ~value;
+    reschedule();
+    updateInterrupts();
+}
+
+static void writeTIMSK0(uint16_t addr, uint8_t value){
+    DATA[TIMSK0] = value;
+    updateInterrupts();
+}
+
+static int pendingOVF(){
+    return DATA[TIFR0] & DATA[TIMSK0] & (1 << TOV0);
+}
+
+static int pendingCOMPA(){
+    return DATA[TIFR0] & DATA[TIMSK0] & (1 << OCF0A);
+}
+
+static int pendingCOMPB(){
+    return DATA[TIFR0] & DATA[TIMSK0] & (1 << OCF0B);
+}
+
+// Executing the interrupt vector clears its flag
+static void clearFlag(int bit){
+    sync(CYCLES);
+    DATA[TIFR0] &= ~(1 << bit);
+    reschedule();
+}
+
+static void acknowledgeOVF(){
+    clearFlag(TOV0);
+}
+
+static void acknowledgeCOMPA(){
+    clearFlag(OCF0A);
+}
+
+static void acknowledgeCOMPB(){
+    clearFlag(OCF0B);
+}
+
+void initTimer0(){
+    count = 0;
+    syncCycle = CYCLES;
+    due[0] = due[1] = due[2] = NEVER;
+
+    keepState(&count, sizeof(count));
+    keepState(&syncCycle, sizeof(syncCycle));
+    keepState(due, sizeof(due));
+
+    keepHandler(timer0Event);
+
+    setIOHandlers(TCNT0, readTCNT0, writeTCNT0);
+    setIOHandlers(TCCR0A, 0, writeControl);
+    setIOHandlers(TCCR0B, 0, writeControl);
+    setIOHandlers(OCR0A, 0, writeControl);
+    setIOHandlers(OCR0B, 0, writeControl);
+    setIOHandlers(TIFR0, 0, writeTIFR0);
+    setIOHandlers(TIMSK0, 0, writeTIMSK0);
+
+    setInterrupt(TIMER0_OVF_vect, pendingOVF, acknowledgeOVF);
+    setInterrupt(TIMER0_COMPA_vect, pendingCOMPA, acknowledgeCOMPA);
+    setInterrupt(TIMER0_COMPB_vect, pendingCOMPB, acknowledgeCOMPB);
+}
@@ -0,0 +1,36 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+
+/* Timer/Counter0 registers, as data space addresses */
+#define TIFR0 0x35
+#define TCCR0A 0x44
+#define TCCR0B 0x45
+#define TCNT0 0x46
+#define OCR0A 0x47
+#define OCR0B 0x48
+#define TIMSK0 0x6E
+
+/* TIFR0 and TIMSK0 bits */
+#define TOV0 0
+#define OCF0A 1
+#define OCF0B 2
+
+void initTimer0();
@@ -0,0 +1,507 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "twi.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "replay.h"
+
+/*
+Two-wire Serial Interface (I2C), at the level of the byte.
+
+The bus is not clocked edge by edge. Each operation, a START, an address or data byte with
+its acknowledge, or a STOP, is one event at the cycle it ends: a byte takes 9 SCL periods,
+a START or a STOP one, a period being 16 + 2 * TWBR * 4^TWPS cycles. At the end the status
+is written to TWSR, TWINT is set and the interrupt requested, and the bus waits (SCL held
+low) until the firmware clears TWINT, which starts the next operation from TWCR, TWDR and
+the status, as in the datasheet.
+
+Master: START (0x08) or repeated START (0x10), SLA+W acknowledged or not (0x18, 0x20),
+data sent (0x28, 0x30), SLA+R (0x40, 0x48), data received with ACK or NACK (0x50, 0x58),
+STOP. The slaves are twidevices (twi.h) attached to the bus; an address nobody answers is
+not acknowledged, and reads with no slave get 0xFF. What the slaves answer is an input of
+the MCU for replay.c.
+
+Slave: a master outside the MCU (twiMaster()) addressing TWAR, under TWAMR, or the general
+call with TWGCE, while TWEA is set: SLA+W (0x60), general call (0x70), data received
+(0x80, 0x88, 0x90, 0x98), STOP (0xA0), SLA+R (0xA8), data sent (0xB8, 0xC0, 0xC8). Its
+transfers are host inputs that are not recorded, so a replay ignores them.
+
+There is a single master at a time: a START waits for the transfer of the other master to
+end, so arbitration is never lost (0x38, 0x68, 0x78, 0xB0 are not produced). Writing TWDR
+while TWINT is clear sets TWWC.
+*/
+
+/* Status codes (TWSR bits 7:3) */
+#define START 0x08
+#define REP_START 0x10
+#define MT_SLA_ACK 0x18
+#define MT_SLA_NACK 0x20
+#define MT_DATA_ACK 0x28
+#define MT_DATA_NACK 0x30
+#define MR_SLA_ACK 0x40
+#define MR_SLA_NACK 0x48
+#define MR_DATA_ACK 0x50
+#define MR_DATA_NACK 0x58
+#define SR_SLA_ACK 0x60
+#define SR_GCALL_ACK 0x70
+#define SR_DATA_ACK 0x80
+#define SR_DATA_NACK 0x88
+#define SR_GCALL_DATA_ACK 0x90
+#define SR_GCALL_DATA_NACK 0x98
+#define SR_STOP 0xA0
+#define ST_SLA_ACK 0xA8
+#define ST_DATA_ACK 0xB8
+#define ST_DATA_NACK 0xC0
+#define ST_LAST_DATA 0xC8
+#define NO_INFO 0xF8
+
+/* Bus operations, ended by busEvent */
+#define OP_NONE 0
+#define OP_START 1
+#define OP_ADDRESS 2
+#define OP_WRITE 3
+#define OP_READ 4
+#define OP_STOP 5
+#define OP_HOST_ADDRESS 6       // START and address of the outside master
+#define OP_HOST_WRITE 7         // A byte from the outside master to the MCU
+#define OP_HOST_READ 8          // A byte from the MCU to the outside master
+#define OP_HOST_STOP 9
+
+/* Questions to the slaves, for slave() */
+#define ASK_ADDRESS 1
+#define ASK_WRITE 2
+#define ASK_READ 3
+
+static MCUSTATE struct twidevice *attached[MAXTWIDEVICES];
+static MCUSTATE int nattached;
+static MCUSTATE struct twitransfer *transfer;
+
+static MCUSTATE int pending;            // Operation on the bus, OP_NONE when idle
+static MCUSTATE uint8_t shift;          // Byte being sent
+static MCUSTATE uint8_t ack;            // TWEA when TWINT was cleared
+static MCUSTATE uint8_t master;         // The MCU holds the bus as master
+static MCUSTATE uint8_t startWaiting;   // A START waits for the outside master
+static MCUSTATE uint8_t addressed;      // The MCU is an addressed slave
+static MCUSTATE uint8_t generalCall;
+static MCUSTATE int target = -1;        // Attached slave addressed by the MCU, -1 for none
+
+static void busEvent(uint64_t when);
+
+// SCL period, in cycles
+static uint64_t period(){
+    return 16 + 2 * (uint64_t)DATA[TWBR] * (1 << (2 * (DATA[TWSR] & 0x03)));
+}
+
+static uint8_t status(){
+    return DATA[TWSR] & 0xF8;
+}
+
+static void setStatus(uint8_t s){
+    DATA[TWSR] = s | (DATA[TWSR] & 0x03);
+}
+
+// End of an operation: the status, TWINT and the interrupt
+static void interrupt(uint8_t s){
+    setStatus(s);
+    DATA[TWCR] |= 1 << TWINT;
+    updateInterrupts();
+}
+
+static void begin(int op, uint64_t from, uint64_t cycles){
+    pending = op;
+    schedule(busEvent, from + cycles);
+}
+
+// The attached slave addressed by the MCU, told of the STOP
+static void release(){
+    if(target >= 0 && REPLAY != REPLAYING){
+        attached[target]->stop(attached[target]);
+    }
+    target = -1;
+}
+
+static uint32_t ask(int question, uint8_t byte){
+    struct twidevice *d = target >= 0 ? attached[target] : 0;
+    int i;
+
+    switch(question){
+    case ASK_ADDRESS:
+        for(i = 0; i < nattached; i++){
+            if(attached[i]->address == byte >> 1){
+                if(i != target){
+                    release();
+                }
+                if(attached[i]->start(attached[i], byte & 1)){
+                    target = i;
+                    return 1;
+                }
+            }
+        }
+        release();
+        return 0;
+    case ASK_WRITE:
+        return d && d->write(d, byte);
+    }
+    return d ? d->read(d) : 0xFF;
+}
+
+// What the slaves answer, an input of the MCU for replay.c
+static uint32_t slave(int question, uint8_t byte){
+    uint32_t answer;
+
+    if(REPLAY == REPLAYING){
+        return replayInput(INPUT_TWI, question << 8 | byte);
+    }
+    answer = ask(question, byte);
+    if(REPLAY == RECORDING){
+        recordInput(INPUT_TWI, question << 8 | byte, answer);
+    }
+    return answer;
+}
+
+// TWAR, under TWAMR, or the general call
+static int matches(uint8_t address, int read){
+    if(address == 0){
+        return !read && (DATA[TWAR] & 0x01);
+    }
+    return ((address ^ (DATA[TWAR] >> 1)) & ~(DATA[TWAMR] >> 1) & 0x7F) == 0;
+}
+
+static void finish(){
+    transfer->finished = 1;
+    transfer = 0;
+}
+
+// The bus is free: the waiting master goes on. An outside master waits for the STOP of the
+// last one to be acknowledged.
+static void busFree(uint64_t when){
+    if(transfer && !transfer->count && !master && status() != SR_STOP){
+        begin(OP_HOST_ADDRESS, when, 10 * period());
+    }
+    else if(startWaiting){
+        startWaiting = 0;
+        begin(OP_START, when, period());
+    }
+}
+
+static void busEvent(uint64_t when){
+    int op = pending;
+
+    pending = OP_NONE;
+
+    switch(op){
+    case OP_START:
+        interrupt(master ? REP_START : START);
+        master = 1;
+        break;
+    case OP_ADDRESS:
+        if(shift & 1){
+            interrupt(slave(ASK_ADDRESS, shift) ? MR_SLA_ACK : MR_SLA_NACK);
+        }
+        else{
+            interrupt(slave(ASK_ADDRESS, shift) ? MT_SLA_ACK : MT_SLA_NACK);
+        }
+        break;
+    case OP_WRITE:
+        interrupt(slave(ASK_WRITE, shift) ? MT_DATA_ACK : MT_DATA_NACK);
+        break;
+    case OP_READ:
+        DATA[TWDR] = slave(ASK_READ, 0);
+        interrupt(ack ? MR_DATA_ACK : MR_DATA_NACK);
+        break;
+    case OP_STOP:
+        master = 0;
+        release();
+        DATA[TWCR] &= ~(1 << TWSTO);
+        setStatus(NO_INFO);
+        if(DATA[TWCR] & (1 << TWSTA)){
+            begin(OP_START, when, period());
+        }
+        else{
+            busFree(when);
+        }
+        break;
+    case OP_HOST_ADDRESS:
+        if(!(DATA[TWCR] & (1 << TWEN)) || !(DATA[TWCR] & (1 << TWEA)) || !matches(transfer->address, transfer->read)){
+            begin(OP_HOST_STOP, when, period());
+            break;
+        }
+        transfer->acknowledged = 1;
+        addressed = 1;
+        generalCall = transfer->address == 0;
+        interrupt(transfer->read ? ST_SLA_ACK : generalCall ? SR_GCALL_ACK : SR_SLA_ACK);
+        break;
+    case OP_HOST_WRITE:
+        DATA[TWDR] = transfer->data[transfer->count++];
+        if(generalCall){
+            interrupt(ack ? SR_GCALL_DATA_ACK : SR_GCALL_DATA_NACK);
+        }
+        else{
+            interrupt(ack ? SR_DATA_ACK : SR_DATA_NACK);
+        }
+        break;
+    case OP_HOST_READ:
+        transfer->data[transfer->count++] = shift;
+        if(transfer->count == transfer->length){
+            interrupt(ST_DATA_NACK);
+        }
+        else{
+            interrupt(ack ? ST_DATA_ACK : ST_LAST_DATA);
+        }
+        break;
+    case OP_HOST_STOP:
+        if(addressed){
+            addressed = 0;
+            interrupt(SR_STOP);
+        }
+        finish();
+        busFree(when);
+        break;
+    }
+}
+
+// The firmware cleared TWINT: the next operation, from TWCR and the status
+static void next(){
+    uint8_t control = DATA[TWCR];
+
+    ack = (control >> TWEA) & 1;
+
+    if(control & (1 << TWSTO)){
+        if(master){
+            begin(OP_STOP, CYCLES, period());
+            return;
+        }
+        // In slave mode, STOP only recovers from an error: not addressed, bus released
+        DATA[TWCR] &= ~(1 << TWSTO);
+        addressed = 0;
+        setStatus(NO_INFO);
+    }
+
+    switch(status()){
+    case START:
+    case REP_START:
+        shift = DATA[TWDR];
+        begin(OP_ADDRESS, CYCLES, 9 * period());
+        return;
+    case MT_SLA_ACK:
+    case MT_SLA_NACK:
+    case MT_DATA_ACK:
+    case MT_DATA_NACK:
+    case MR_SLA_ACK:
+    case MR_DATA_ACK:
+        if(control & (1 << TWSTA)){
+            begin(OP_START, CYCLES, period());
+        }
+        else if(status() == MR_SLA_ACK || status() == MR_DATA_ACK){
+            begin(OP_READ, CYCLES, 9 * period());
+        }
+        else{
+            shift = DATA[TWDR];
+            begin(OP_WRITE, CYCLES, 9 * period());
+        }
+        return;
+    case MR_SLA_NACK:
+    case MR_DATA_NACK:
+        if(control & (1 << TWSTA)){
+            begin(OP_START, CYCLES, period());
+        }
+        return;
+    case SR_SLA_ACK:
+    case SR_GCALL_ACK:
+    case SR_DATA_ACK:
+    case SR_GCALL_DATA_ACK:
+        if(transfer->count < transfer->length){
+            begin(OP_HOST_WRITE, CYCLES, 9 * period());
+        }
+        else{
+            begin(OP_HOST_STOP, CYCLES, period());
+        }
+        return;
+    case ST_SLA_ACK:
+    case ST_DATA_ACK:
+        shift = DATA[TWDR];
+        begin(OP_HOST_READ, CYCLES, 9 * period());
+        return;
+    case SR_DATA_NACK:
+    case SR_GCALL_DATA_NACK:
+    case ST_DATA_NACK:
+    case ST_LAST_DATA:
+        // Not addressed anymore; the outside master ends its transfer
+        if(status() == ST_LAST_DATA){
+            while(transfer->count < transfer->length){
+                transfer->data[transfer->count++] = 0xFF;
+            }
+        }
+        addressed = 0;
+        setStatus(NO_INFO);
+        begin(OP_HOST_STOP, CYCLES, period());
+        return;
+    case SR_STOP:
+        setStatus(NO_INFO);
+        if(transfer){
+            busFree(CYCLES);
+        }
+        break;
+    }
+
+    if(control & (1 << TWSTA)){
+        if(transfer){
+            startWaiting = 1;
+        }
+        else{
+            begin(OP_START, CYCLES, period());
+        }
+    }
+}
+
+static void stopAll(){
+    unschedule(busEvent);
+    pending = OP_NONE;
+    master = 0;
+    startWaiting = 0;
+    addressed = 0;
+    release();
+    if(transfer){
+        finish();
+    }
+}
+
+static void writeTWCR(uint16_t addr, uint8_t value){
+    uint8_t old = DATA[TWCR];
+
+    // TWINT is cleared by writing a one to it, TWWC is read only
+    DATA[TWCR] = (value & ~((1 << TWINT) | (1 << TWWC))) | (old & ~value & (1 << TWINT)) | (old & (1 << TWWC));
+
+    if(!(value & (1 << TWEN))){
+        stopAll();
+        DATA[TWCR] &= ~(1 << TWSTO);
+        setStatus(NO_INFO);
+    }
+    else if((value & (1 << TWINT)) && pending == OP_NONE){
+        next();
+    }
+
+    updateInterrupts();
+}
+
+static void writeTWDR(uint16_t addr, uint8_t value){
+    if(!(DATA[TWCR] & (1 << TWINT))){
+        DATA[TWCR] |= 1 << TWWC;
+        return;
+    }
+    DATA[TWDR] = value;
+    DATA[TWCR] &= ~(1 << TWWC);
+}
+
+// Only the prescaler bits can be written
+static void writeTWSR(uint16_t addr, uint8_t value){
+    DATA[TWSR] = (DATA[TWSR] & 0xF8) | (value & 0x03);
+}
+
+static int pendingTWI(){
+    return DATA[TWCR] & (1 << TWINT) && DATA[TWCR] & (1 << TWIE);
+}
+
+// TWINT is not cleared by the interrupt: the routine clears it
+static void acknowledgeTWI(){
+}
+
+void initTwi(){
+    stopAll();
+    target = -1;
+    shift = 0;
+    ack = 0;
+    generalCall = 0;
+
+    DATA[TWBR] = 0x00;
+    DATA[TWSR] = NO_INFO;
+    DATA[TWAR] = 0xFE;
+    DATA[TWDR] = 0xFF;
+    DATA[TWCR] = 0x00;
+    DATA[TWAMR] = 0x00;
+
+    keepState(&pending, sizeof(pending));
+    keepState(&shift, sizeof(shift));
+    keepState(&ack, sizeof(ack));
+    keepState(&master, sizeof(master));
+    keepState(&startWaiting, sizeof(startWaiting));
+    keepState(&addressed, sizeof(addressed));
+    keepState(&generalCall, sizeof(generalCall));
+    keepState(&target, sizeof(target));
+
+    keepHandler(busEvent);
+
+    setIOHandlers(TWCR, 0, writeTWCR);
+    setIOHandlers(TWDR, 0, writeTWDR);
+    setIOHandlers(TWSR, 0, writeTWSR);
+    setInterrupt(TWI_vect, pendingTWI, acknowledgeTWI);
+}
+
+/* Puts device on the bus. Returns 0 if MAXTWIDEVICES are attached already. */
+int twiAttach(struct twidevice *device){
+    if(nattached == MAXTWIDEVICES){
+        return 0;
+    }
+    attached[nattached++] = device;
+    return 1;
+}
+
+/* Takes device off the bus. */
+void twiDetach(struct twidevice *device){
+    int i;
+
+    for(i = 0; i < nattached; i++){
+        if(attached[i] == device){
+            if(target == nattached - 1){
+                target = i;
+            }
+            else if(target == i){
+                target = -1;
+            }
+            attached[i] = attached[--nattached];
+            return;
+        }
+    }
+}
+
+/* Starts a transfer of a master outside the MCU: it addresses transfer->address and writes
+or reads transfer->length bytes, as soon as the bus is free. The MCU answers as a slave
+through TWAR and TWCR; transfer is updated as the bytes go and finished is set at the end.
+Returns 0 if a transfer is going on already. Ignored while a recording replays. */
+int twiMaster(struct twitransfer *t){
+    if(transfer){
+        return 0;
+    }
+    t->count = 0;
+    t->acknowledged = 0;
+    t->finished = 0;
+    if(REPLAY == REPLAYING){
+        t->finished = 1;
+        return 1;
+    }
+
+    transfer = t;
+    if(!master && pending == OP_NONE && status() != SR_STOP){
+        begin(OP_HOST_ADDRESS, CYCLES, 10 * period());
+    }
+    return 1;
+}
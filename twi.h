@@ -0,0 +1,73 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef TWI_H
+#define TWI_H
+
+#include <stdint.h>
+
+/* TWI registers, as data space addresses */
+#define TWBR 0xB8
+#define TWSR 0xB9
+#define TWAR 0xBA
+#define TWDR 0xBB
+#define TWCR 0xBC
+#define TWAMR 0xBD
+
+/* TWCR bits */
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC 3
+#define TWEN 2
+#define TWIE 0
+
+#define MAXTWIDEVICES 8
+
+/* A slave on the bus, for the MCU as master. Called on the thread of the MCU, at the cycle
+the byte ends. */
+struct twidevice{
+    uint8_t address;        // 7 bit address
+    // START or repeated START with the address of the device; returns 1 to acknowledge
+    int (*start)(struct twidevice *device, int read);
+    // A byte written by the master; returns 1 to acknowledge
+    int (*write)(struct twidevice *device, uint8_t data);
+    // The next byte read by the master
+    uint8_t (*read)(struct twidevice *device);
+    // STOP, or the master addressing another device
+    void (*stop)(struct twidevice *device);
+};
+
+/* A transfer of a master outside the MCU to the MCU as slave (twiMaster()) */
+struct twitransfer{
+    uint8_t address;        // 7 bit address, 0 for a general call
+    uint8_t read;           // 1 if the master reads from the MCU
+    uint8_t *data;
+    int length;
+    int count;              // Bytes transferred
+    int acknowledged;       // The MCU acknowledged its address
+    int finished;
+};
+
+void initTwi();
+int twiAttach(struct twidevice *device);
+void twiDetach(struct twidevice *device);
+int twiMaster(struct twitransfer *transfer);
+
+#endif
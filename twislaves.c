@@ -0,0 +1,211 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "twislaves.h"
+#include "registers.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Two slaves for twi.c, enough to run the drivers of most I2C parts.
+
+An EEPROM of the 24-series (24C01/02, 24C32 to 24C512): the first bytes of a write set the
+address, one byte up to 256 bytes of memory and two above. The data bytes that follow are
+written in the page of that address (8 bytes up to 256 bytes of memory, 32 up to 8KB, 64 up
+to 32KB, 128 above), wrapping inside it, and programmed at the STOP. During the write cycle (5ms of
+F_CPU cycles) the EEPROM does not acknowledge its address, so acknowledge polling works.
+Reads go on from the address, wrapping at the end of the memory. Like spiflash.c, the
+memory is a shared mapping of a file, erased (0xFF) where the file is short.
+
+A register file sensor: 256 registers behind a register pointer, set by the first byte of a
+write and incremented by each byte written or read. The host writes the readings into the
+registers (twiSensorRegisters()) between runs; the firmware can write them too, as it does
+configuration registers.
+*/
+
+#define WRITECYCLE ((uint64_t)5000 * (F_CPU / 1000000))
+
+struct eeprom{
+    struct twidevice device;        // First, so a twidevice pointer is an eeprom one
+    uint8_t *data;
+    uint32_t size;
+    uint32_t page;
+    int addressBytes;
+    uint32_t address;
+    int count;                      // Bytes written since the START
+    uint32_t base;                  // Page being written
+    uint8_t buffer[128];
+    uint64_t busyUntil;
+};
+
+struct sensor{
+    struct twidevice device;
+    uint8_t registers[256];
+    uint8_t pointer;
+    int count;
+};
+
+/* EEPROM */
+
+static int eepromStart(struct twidevice *device, int read){
+    struct eeprom *e = (struct eeprom *)device;
+
+    if(CYCLES < e->busyUntil){
+        return 0;
+    }
+    // A repeated START drops the bytes written so far
+    e->count = read ? e->addressBytes : 0;
+    return 1;
+}
+
+static int eepromWrite(struct twidevice *device, uint8_t data){
+    struct eeprom *e = (struct eeprom *)device;
+
+    if(e->count < e->addressBytes){
+        e->address = (e->address << 8 | data) % e->size;
+    }
+    else{
+        if(e->count == e->addressBytes){
+            e->base = e->address & ~(e->page - 1);
+            memcpy(e->buffer, e->data + e->base, e->page);
+        }
+        e->buffer[e->address - e->base] = data;
+        e->address = e->base | ((e->address + 1) & (e->page - 1));
+    }
+    e->count++;
+    return 1;
+}
+
+static uint8_t eepromRead(struct twidevice *device){
+    struct eeprom *e = (struct eeprom *)device;
+    uint8_t data = e->data[e->address];
+
+    e->address = (e->address + 1) % e->size;
+    return data;
+}
+
+// The page is programmed at the STOP
+static void eepromStop(struct twidevice *device){
+    struct eeprom *e = (struct eeprom *)device;
+
+    if(e->count > e->addressBytes){
+        memcpy(e->data + e->base, e->buffer, e->page);
+        e->busyUntil = CYCLES + WRITECYCLE;
+    }
+    e->count = 0;
+}
+
+/* An EEPROM of size bytes (a power of two: 128 or 256, or 4KB to 64KB) at address, stored in path and
+created if needed. Attach it with twiAttach(). Returns 0 if the file cannot be mapped. */
+struct twidevice *twiEepromOpen(const char *path, uint32_t size, uint8_t address){
+    struct eeprom *e;
+    struct stat st;
+    void *data;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if(fd < 0){
+        return 0;
+    }
+    if(fstat(fd, &st) < 0 || (st.st_size < size && ftruncate(fd, size) < 0)){
+        close(fd);
+        return 0;
+    }
+    data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+        return 0;
+    }
+    if(st.st_size < size){
+        memset((uint8_t *)data + st.st_size, 0xFF, size - st.st_size);
+    }
+
+    e = calloc(1, sizeof(*e));
+    e->device.address = address;
+    e->device.start = eepromStart;
+    e->device.write = eepromWrite;
+    e->device.read = eepromRead;
+    e->device.stop = eepromStop;
+    e->data = data;
+    e->size = size;
+    e->page = size <= 256 ? 8 : size <= 8192 ? 32 : size <= 32768 ? 64 : 128;
+    e->addressBytes = size <= 256 ? 1 : 2;
+    return &e->device;
+}
+
+/* Writes the EEPROM back to its file and frees it. Detach it first. */
+void twiEepromClose(struct twidevice *device){
+    struct eeprom *e = (struct eeprom *)device;
+
+    msync(e->data, e->size, MS_SYNC);
+    munmap(e->data, e->size);
+    free(e);
+}
+
+/* Sensor */
+
+static int sensorStart(struct twidevice *device, int read){
+    ((struct sensor *)device)->count = 0;
+    return 1;
+}
+
+static int sensorWrite(struct twidevice *device, uint8_t data){
+    struct sensor *s = (struct sensor *)device;
+
+    if(s->count++ == 0){
+        s->pointer = data;
+    }
+    else{
+        s->registers[s->pointer++] = data;
+    }
+    return 1;
+}
+
+static uint8_t sensorRead(struct twidevice *device){
+    struct sensor *s = (struct sensor *)device;
+
+    return s->registers[s->pointer++];
+}
+
+static void sensorStop(struct twidevice *device){
+}
+
+/* A register file sensor at address, its registers cleared. Attach it with twiAttach(). */
+struct twidevice *twiSensorCreate(uint8_t address){
+    struct sensor *s = calloc(1, sizeof(*s));
+
+    s->device.address = address;
+    s->device.start = sensorStart;
+    s->device.write = sensorWrite;
+    s->device.read = sensorRead;
+    s->device.stop = sensorStop;
+    return &s->device;
+}
+
+/* The 256 registers of the sensor, for the host to write readings into. */
+uint8_t *twiSensorRegisters(struct twidevice *device){
+    return ((struct sensor *)device)->registers;
+}
+
+/* Frees the sensor. Detach it first. */
+void twiSensorDestroy(struct twidevice *device){
+    free(device);
+}
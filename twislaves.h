@@ -0,0 +1,30 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+
+#include <stdint.h>
+#include "twi.h"
+
+/* Stand-ins for common I2C slaves (twislaves.c) */
+
+struct twidevice *twiEepromOpen(const char *path, uint32_t size, uint8_t address);
+void twiEepromClose(struct twidevice *device);
+
+struct twidevice *twiSensorCreate(uint8_t address);
+uint8_t *twiSensorRegisters(struct twidevice *device);
+void twiSensorDestroy(struct twidevice *device);
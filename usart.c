@@ -0,0 +1,202 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#include "usart.h"
+#include "registers.h"
+#include "functions.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "replay.h"
+
+/*
+USART0 in asynchronous mode, at the level of the frame.
+
+Writing UDR0 with the transmitter enabled starts a frame when the shift register is free
+and leaves UDRE set; during a frame the byte waits in the buffer, UDRE is cleared, and it
+starts as soon as the frame before it ends. A frame is one event at its end: a start bit,
+5 to 9 data bits (UCSZ02:0), the parity bit if UPM01 is set and 1 or 2 stop bits (USBS),
+each 16 cycles times UBRR0 + 1, 8 with U2X0. At that event the byte goes to the host
+(usartAttach()), and TXC is set once the buffer is empty too. TXC is cleared by writing a
+one to it or by its vector. UCSR0A has no read handler, so polling UDRE or RXC is a
+busy-wait loop (busywait.c) that jumps straight to the end of the frame or to the next
+byte received.
+
+Bytes come in from the host (usartReceive(), from cosim.c) at the cycle their frame
+ends, with the receiver enabled. They go to a FIFO of two bytes, read through UDR0; a
+byte arriving with both taken is lost and sets DOR. Disabling the receiver empties the
+FIFO. The pins (PD0, PD1) are not taken over, the frame format of the two sides is not
+compared, frames are never in error (FE, UPE) and the ninth bit (RXB8, TXB8) is not
+carried. Synchronous and SPI master modes (UMSEL0) run as asynchronous.
+
+The RX complete, data register empty and TX complete interrupts are the ones of
+USART_RX_vect, USART_UDRE_vect and USART_TX_vect.
+*/
+
+static MCUSTATE void (*transmitter)(uint8_t data);
+static MCUSTATE uint8_t shift;          // Byte being sent
+static MCUSTATE uint8_t sending;
+static MCUSTATE uint8_t buffer;         // Next one, while UDRE is clear
+static MCUSTATE uint8_t received[2];
+static MCUSTATE uint8_t nreceived;
+
+// Cycles of a frame: start bit, data bits, parity and stop bits
+static uint64_t frameCycles(){
+    static const uint8_t dataBits[8] = {5, 6, 7, 8, 8, 8, 8, 9};
+    int size = (DATA[UCSR0B] & (1 << UCSZ02)) | (DATA[UCSR0C] >> UCSZ00 & 0x03);
+    uint64_t bits = 1 + dataBits[size] + (DATA[UCSR0C] >> UPM01 & 1) + 1 + (DATA[UCSR0C] >> USBS0 & 1);
+    uint64_t ubrr = (DATA[UBRR0H] & 0x0F) << 8 | DATA[UBRR0L];
+
+    return bits * (DATA[UCSR0A] & (1 << U2X0) ? 8 : 16) * (ubrr + 1);
+}
+
+static void frameSent(uint64_t when);
+
+static void startFrame(uint8_t data){
+    shift = data;
+    sending = 1;
+    schedule(frameSent, CYCLES + frameCycles());
+}
+
+static void frameSent(uint64_t when){
+    if(transmitter){
+        transmitter(shift);
+    }
+
+    if(!(DATA[UCSR0A] & (1 << UDRE0))){
+        DATA[UCSR0A] |= 1 << UDRE0;
+        startFrame(buffer);
+    }
+    else{
+        sending = 0;
+        DATA[UCSR0A] |= 1 << TXC0;
+    }
+    updateInterrupts();
+}
+
+static void writeUDR0(uint16_t addr, uint8_t value){
+    if(!(DATA[UCSR0B] & (1 << TXEN0)) || !(DATA[UCSR0A] & (1 << UDRE0))){
+        return;
+    }
+
+    if(sending){
+        buffer = value;
+        DATA[UCSR0A] &= ~(1 << UDRE0);
+    }
+    else{
+        startFrame(value);
+    }
+    updateInterrupts();
+}
+
+static uint8_t readUDR0(uint16_t addr){
+    if(nreceived){
+        DATA[UDR0] = received[0];
+        received[0] = received[1];
+        nreceived--;
+        DATA[UCSR0A] &= ~(1 << DOR0);
+        if(nreceived == 0){
+            DATA[UCSR0A] &= ~(1 << RXC0);
+        }
+        updateInterrupts();
+    }
+    return DATA[UDR0];
+}
+
+// TXC is cleared by writing a one to it; U2X and MPCM are the only other bits written
+static void writeUCSR0A(uint16_t addr, uint8_t value){
+    uint8_t writable = (1 << U2X0) | (1 << MPCM0);
+
+    if(value & (1 << TXC0)){
+        DATA[UCSR0A] &= ~(1 << TXC0);
+    }
+    DATA[UCSR0A] = (DATA[UCSR0A] & ~writable) | (value & writable);
+    updateInterrupts();
+}
+
+static void writeUCSR0B(uint16_t addr, uint8_t value){
+    DATA[UCSR0B] = (DATA[UCSR0B] & (1 << RXB80)) | (value & ~(1 << RXB80));
+
+    if(!(value & (1 << RXEN0))){
+        nreceived = 0;
+        DATA[UCSR0A] &= ~((1 << RXC0) | (1 << DOR0));
+    }
+    updateInterrupts();
+}
+
+static int pendingRX(){
+    return DATA[UCSR0A] & (1 << RXC0) && DATA[UCSR0B] & (1 << RXCIE0);
+}
+
+static int pendingUDRE(){
+    return DATA[UCSR0A] & (1 << UDRE0) && DATA[UCSR0B] & (1 << UDRIE0);
+}
+
+static int pendingTX(){
+    return DATA[UCSR0A] & (1 << TXC0) && DATA[UCSR0B] & (1 << TXCIE0);
+}
+
+static void acknowledgeTX(){
+    DATA[UCSR0A] &= ~(1 << TXC0);
+}
+
+void initUsart(){
+    shift = 0;
+    sending = 0;
+    buffer = 0;
+    nreceived = 0;
+    DATA[UCSR0A] = 1 << UDRE0;
+    DATA[UCSR0C] = 1 << UCSZ01 | 1 << UCSZ00;
+
+    keepState(&shift, sizeof(shift));
+    keepState(&sending, sizeof(sending));
+    keepState(&buffer, sizeof(buffer));
+    keepState(received, sizeof(received));
+    keepState(&nreceived, sizeof(nreceived));
+
+    keepHandler(frameSent);
+
+    setIOHandlers(UCSR0A, 0, writeUCSR0A);
+    setIOHandlers(UCSR0B, 0, writeUCSR0B);
+    setIOHandlers(UDR0, readUDR0, writeUDR0);
+    setInterrupt(USART_RX_vect, pendingRX, 0);
+    setInterrupt(USART_UDRE_vect, pendingUDRE, 0);
+    setInterrupt(USART_TX_vect, pendingTX, acknowledgeTX);
+}
+
+/* Gives the bytes sent by the MCU to transmit, called at the cycle each frame ends; 0 drops
+them. It belongs to the host and stays set on reset. */
+void usartAttach(void (*transmit)(uint8_t data)){
+    transmitter = transmit;
+}
+
+/* A frame received from outside the MCU, at the cycle it ends. Ignored with the receiver
+disabled and, like spiSlaveExchange(), while a recording replays. */
+void usartReceive(uint8_t data){
+    if(!(DATA[UCSR0B] & (1 << RXEN0)) || REPLAY == REPLAYING){
+        return;
+    }
+
+    if(nreceived == sizeof(received)){
+        DATA[UCSR0A] |= 1 << DOR0;
+        return;
+    }
+    received[nreceived++] = data;
+    DATA[UCSR0A] |= 1 << RXC0;
+    updateInterrupts();
+}
@@ -0,0 +1,63 @@
+/*
+
+Simulador ATMEGA328p
+Universidade Estadual de Maringá
+Implementado por: Raul Ramires
+
+Autorizo a continuação desse projeto
+para a comunidade acadêmica e sem
+fins lucrativos.
+
+Alterações e inclusões podem ser feitas
+desde que os nomes dos autores
+sempre constem no código.
+
+Contato:
+email: rrramires@homail.com
+
+*/
+#ifndef USART_H
+#define USART_H
+
+#include <stdint.h>
+
+/* USART0 registers, as data space addresses */
+#define UCSR0A 0xC0
+#define UCSR0B 0xC1
+#define UCSR0C 0xC2
+#define UBRR0L 0xC4
+#define UBRR0H 0xC5
+#define UDR0 0xC6
+
+/* UCSR0A bits */
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define MPCM0 0
+
+/* UCSR0B bits */
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ02 2
+#define RXB80 1
+#define TXB80 0
+
+/* UCSR0C bits */
+#define UPM01 5
+#define UPM00 4
+#define USBS0 3
+#define UCSZ01 2
+#define UCSZ00 1
+
+void initUsart();
+void usartAttach(void (*transmit)(uint8_t data));
+void usartReceive(uint8_t data);
+
+#endif